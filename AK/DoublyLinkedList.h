@@ -183,6 +183,26 @@ public:
         delete node;
     }
 
+    void insert_before(Iterator iterator, T&& value)
+    {
+        if (iterator.is_end()) {
+            append(move(value));
+            return;
+        }
+        auto* node = new Node(move(value));
+        auto* next = iterator.m_node;
+        node->prev = next->prev;
+        node->next = next;
+        if (next->prev) {
+            ASSERT(next != m_head);
+            next->prev->next = node;
+        } else {
+            ASSERT(next == m_head);
+            m_head = node;
+        }
+        next->prev = node;
+    }
+
 private:
     void append_node(Node* node)
     {
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/TestSuite.h>
+
+#include <AK/DoublyLinkedList.h>
+
+static Vector<int> to_vector(const DoublyLinkedList<int>& list)
+{
+    Vector<int> values;
+    for (auto value : list)
+        values.append(value);
+    return values;
+}
+
+TEST_CASE(construct)
+{
+    EXPECT(DoublyLinkedList<int>().is_empty());
+}
+
+TEST_CASE(append_prepend)
+{
+    DoublyLinkedList<int> list;
+    list.append(2);
+    list.append(3);
+    list.prepend(1);
+    EXPECT_EQ(list.first(), 1);
+    EXPECT_EQ(list.last(), 3);
+    EXPECT(to_vector(list) == Vector<int>({ 1, 2, 3 }));
+}
+
+TEST_CASE(insert_before)
+{
+    DoublyLinkedList<int> list;
+    list.insert_before(list.end(), 3);
+    list.insert_before(list.begin(), 1);
+    list.insert_before(list.find(3), 2);
+    list.insert_before(list.end(), 4);
+    EXPECT_EQ(list.first(), 1);
+    EXPECT_EQ(list.last(), 4);
+    EXPECT(to_vector(list) == Vector<int>({ 1, 2, 3, 4 }));
+
+    list.remove(list.find(2));
+    list.remove(list.begin());
+    EXPECT(to_vector(list) == Vector<int>({ 3, 4 }));
+}
+
+TEST_MAIN(DoublyLinkedList)
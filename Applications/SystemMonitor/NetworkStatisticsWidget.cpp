@@ -55,6 +55,8 @@ NetworkStatisticsWidget::NetworkStatisticsWidget()
         net_adapters_fields.empend("packets_out", "Pkt Out", Gfx::TextAlignment::CenterRight);
         net_adapters_fields.empend("bytes_in", "Bytes In", Gfx::TextAlignment::CenterRight);
         net_adapters_fields.empend("bytes_out", "Bytes Out", Gfx::TextAlignment::CenterRight);
+        net_adapters_fields.empend("packets_in_per_second", "Pkt In/s", Gfx::TextAlignment::CenterRight);
+        net_adapters_fields.empend("packets_out_per_second", "Pkt Out/s", Gfx::TextAlignment::CenterRight);
         m_adapter_model = GUI::JsonArrayModel::create("/proc/net/adapters", move(net_adapters_fields));
         m_adapter_table_view->set_model(GUI::SortingProxyModel::create(*m_adapter_model));
 
@@ -78,6 +80,9 @@ NetworkStatisticsWidget::NetworkStatisticsWidget()
         net_tcp_fields.empend("packets_out", "Pkt Out", Gfx::TextAlignment::CenterRight);
         net_tcp_fields.empend("bytes_in", "Bytes In", Gfx::TextAlignment::CenterRight);
         net_tcp_fields.empend("bytes_out", "Bytes Out", Gfx::TextAlignment::CenterRight);
+        net_tcp_fields.empend("retransmitted_segments", "Retrans", Gfx::TextAlignment::CenterRight);
+        net_tcp_fields.empend("congestion_window", "CWnd", Gfx::TextAlignment::CenterRight);
+        net_tcp_fields.empend("smoothed_rtt_ms", "RTT (ms)", Gfx::TextAlignment::CenterRight);
         m_socket_model = GUI::JsonArrayModel::create("/proc/net/tcp", move(net_tcp_fields));
         m_socket_table_view->set_model(GUI::SortingProxyModel::create(*m_socket_model));
 
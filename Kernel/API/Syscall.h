@@ -36,6 +36,8 @@
 constexpr int syscall_vector = 0x82;
 
 extern "C" {
+struct epoll_event;
+struct iovec;
 struct pollfd;
 struct timeval;
 struct timespec;
@@ -195,7 +197,18 @@ namespace Kernel {
     S(set_process_name)       \
     S(disown)                 \
     S(adjtime)                \
-    S(allocate_tls)
+    S(allocate_tls)           \
+    S(epoll_create)           \
+    S(epoll_ctl)              \
+    S(epoll_wait)             \
+    S(sendfile)               \
+    S(splice)                 \
+    S(readv)                  \
+    S(pread)                  \
+    S(pwrite)                 \
+    S(preadv)                 \
+    S(pwritev)                \
+    S(anon_create)
 
 namespace Syscall {
 
@@ -279,6 +292,58 @@ struct SC_poll_params {
     const u32* sigmask;
 };
 
+struct SC_sendfile_params {
+    int out_fd;
+    int in_fd;
+    ssize_t* offset;
+    size_t count;
+};
+
+struct SC_splice_params {
+    int in_fd;
+    ssize_t* in_offset;
+    int out_fd;
+    ssize_t* out_offset;
+    size_t length;
+    unsigned flags;
+};
+
+struct SC_pread_params {
+    int fd;
+    void* buffer;
+    size_t size;
+    ssize_t offset;
+};
+
+struct SC_pwrite_params {
+    int fd;
+    const void* buffer;
+    size_t size;
+    ssize_t offset;
+};
+
+struct SC_preadv_params {
+    int fd;
+    const struct iovec* iov;
+    int iov_count;
+    ssize_t offset;
+};
+
+struct SC_epoll_ctl_params {
+    int epfd;
+    int op;
+    int fd;
+    const struct epoll_event* event;
+};
+
+struct SC_epoll_wait_params {
+    int epfd;
+    struct epoll_event* events;
+    int max_events;
+    const struct timespec* timeout;
+    const u32* sigmask;
+};
+
 struct SC_clock_nanosleep_params {
     int clock_id;
     int flags;
@@ -318,7 +383,12 @@ struct SC_futex_params {
     const i32* userspace_address;
     int futex_op;
     i32 val;
-    const timespec* timeout;
+    union {
+        const timespec* timeout;
+        u32 val2;
+    };
+    const i32* userspace_address2;
+    i32 val3;
 };
 
 struct SC_setkeymap_params {
@@ -225,6 +225,8 @@ extern "C" u8* safe_memset_ins_1;
 extern "C" u8* safe_memset_1_faulted;
 extern "C" u8* safe_memset_ins_2;
 extern "C" u8* safe_memset_2_faulted;
+extern "C" u8* safe_atomic_compare_exchange_relaxed_ins;
+extern "C" u8* safe_atomic_compare_exchange_relaxed_faulted;
 
 bool safe_memcpy(void* dest_ptr, const void* src_ptr, size_t n, void*& fault_at)
 {
@@ -357,10 +359,36 @@ bool safe_memset(void* dest_ptr, int c, size_t n, void*& fault_at)
     return true;
 }
 
+bool safe_atomic_compare_exchange_relaxed(volatile u32* var, u32& expected, u32 desired, bool& did_exchange)
+{
+    // Returns false if accessing var faulted.
+    u32 fault_at = 0;
+    u8 exchanged;
+    asm volatile(
+        ".global safe_atomic_compare_exchange_relaxed_ins \n"
+        "safe_atomic_compare_exchange_relaxed_ins: \n"
+        "lock cmpxchgl %[desired], %[var] \n"
+        ".global safe_atomic_compare_exchange_relaxed_faulted \n"
+        "safe_atomic_compare_exchange_relaxed_faulted: \n" // handle_safe_access_fault() set edx to the fault address!
+        "setz %[exchanged] \n"
+        : "=a" (expected),
+          [var] "+m" (*var),
+          [exchanged] "=c" (exchanged),
+          [fault_at] "+d" (fault_at)
+        : "a" (expected),
+          [desired] "b" (desired)
+        : "memory", "cc");
+    if (fault_at != 0)
+        return false;
+    did_exchange = exchanged;
+    return true;
+}
+
 static bool handle_safe_access_fault(RegisterState& regs, u32 fault_address)
 {
     // If we detect that the fault happened in safe_memcpy() safe_strnlen(),
-    // or safe_memset() then resume at the appropriate _faulted label
+    // safe_memset() or safe_atomic_compare_exchange_relaxed() then resume at
+    // the appropriate _faulted label
     if (regs.eip == (FlatPtr)&safe_memcpy_ins_1)
         regs.eip = (FlatPtr)&safe_memcpy_1_faulted;
     else if (regs.eip == (FlatPtr)&safe_memcpy_ins_2)
@@ -371,6 +399,8 @@ static bool handle_safe_access_fault(RegisterState& regs, u32 fault_address)
         regs.eip = (FlatPtr)&safe_memset_1_faulted;
     else if (regs.eip == (FlatPtr)&safe_memset_ins_2)
         regs.eip = (FlatPtr)&safe_memset_2_faulted;
+    else if (regs.eip == (FlatPtr)&safe_atomic_compare_exchange_relaxed_ins)
+        regs.eip = (FlatPtr)&safe_atomic_compare_exchange_relaxed_faulted;
     else
         return false;
 
@@ -617,7 +647,7 @@ void unregister_generic_interrupt_handler(u8 interrupt_number, GenericInterruptH
         return;
     }
     if (!s_interrupt_handler[interrupt_number]->is_shared_handler()) {
-        ASSERT(s_interrupt_handler[interrupt_number]->type() == HandlerType::IRQHandler);
+        ASSERT(s_interrupt_handler[interrupt_number]->type() == HandlerType::IRQHandler || s_interrupt_handler[interrupt_number]->type() == HandlerType::MSIHandler);
         revert_to_unused_handler(interrupt_number);
         return;
     }
@@ -1189,10 +1219,15 @@ void Processor::early_initialize(u32 cpu)
     m_scheduler_initialized = false;
 
     m_message_queue = nullptr;
+    m_loaded_cr3 = read_cr3();
+    m_tlb_shootdowns_sent = 0;
+    m_tlb_shootdowns_received = 0;
     m_idle_thread = nullptr;
     m_current_thread = nullptr;
     m_scheduler_data = nullptr;
+    m_timer_queue_data = nullptr;
     m_mm_data = nullptr;
+    m_heap_data = nullptr;
     m_info = nullptr;
 
     m_halt_requested = false;
@@ -1428,7 +1463,7 @@ extern "C" void enter_thread_context(Thread* from_thread, Thread* to_thread)
     tls_descriptor.set_limit(to_thread->thread_specific_region_size());
 
     if (from_tss.cr3 != to_tss.cr3)
-        write_cr3(to_tss.cr3);
+        processor.load_cr3(to_tss.cr3);
 
     to_thread->set_cpu(processor.id());
 
@@ -1768,6 +1803,14 @@ void Processor::check_invoke_scheduler()
 
 void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
 {
+    // Past this many pages it's cheaper to reload CR3 than to invalidate page by page.
+    // That only drops non-global entries, so kernel ranges always go page by page.
+    static constexpr size_t max_invlpg_pages = 32;
+    if (page_count > max_invlpg_pages && vaddr.get() < 0xc0000000) {
+        flush_entire_tlb_local();
+        return;
+    }
+
     auto ptr = vaddr.as_ptr();
     while (page_count > 0) {
         asm volatile("invlpg %0"
@@ -1779,12 +1822,33 @@ void Processor::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
     }
 }
 
-void Processor::flush_tlb(VirtualAddress vaddr, size_t page_count)
+void Processor::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
-    if (s_smp_enabled)
+    if (!s_smp_enabled) {
+        flush_tlb_local(vaddr, page_count);
+        return;
+    }
+
+    // Kernel mappings are global and shared by every page directory, so they
+    // have to go everywhere. Userspace mappings can only be cached by processors
+    // that have this page directory loaded right now; everyone else will drop
+    // their stale entries when they load its CR3 again, so they don't need to
+    // be interrupted at all.
+    if (!page_directory || !page_directory->process() || vaddr.get() >= 0xc0000000)
         smp_broadcast_flush_tlb(vaddr, page_count);
     else
-        flush_tlb_local(vaddr, page_count);
+        smp_multicast_flush_tlb(page_directory->cr3(), vaddr, page_count);
+}
+
+void Processor::load_cr3(u32 cr3)
+{
+    ASSERT(this == &Processor::current());
+    // Publish the new page directory *before* loading it, and with a full barrier.
+    // Anyone who changes its page tables from now on will see us in
+    // smp_multicast_flush_tlb(); anyone who changed them before we got here is
+    // already visible to our page walks.
+    atomic_store(&m_loaded_cr3, cr3, AK::MemoryOrder::memory_order_seq_cst);
+    write_cr3(cr3);
 }
 
 static volatile ProcessorMessage* s_message_pool;
@@ -1901,6 +1965,7 @@ bool Processor::smp_process_pending_messages()
                 break;
             case ProcessorMessage::FlushTlb:
                 flush_tlb_local(VirtualAddress(msg->flush_tlb.ptr), msg->flush_tlb.page_count);
+                m_tlb_shootdowns_received++;
                 break;
             }
 
@@ -2065,12 +2130,57 @@ void Processor::smp_broadcast_flush_tlb(VirtualAddress vaddr, size_t page_count)
     msg.flush_tlb.ptr = vaddr.as_ptr();
     msg.flush_tlb.page_count = page_count;
     smp_broadcast_message(msg);
+    Processor::current().m_tlb_shootdowns_sent += count() - 1;
     // While the other processors handle this request, we'll flush ours
     flush_tlb_local(vaddr, page_count);
     // Now wait until everybody is done as well
     smp_broadcast_wait_sync(msg);
 }
 
+void Processor::smp_multicast_flush_tlb(u32 cr3, VirtualAddress vaddr, size_t page_count)
+{
+    if (count() > 32) {
+        smp_broadcast_flush_tlb(vaddr, page_count);
+        return;
+    }
+
+    auto& cur_proc = Processor::current();
+
+    // The page table updates must be globally visible before we look at which
+    // processors have this page directory loaded. This pairs with load_cr3().
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    u32 targets = 0;
+    for_each(
+        [&](Processor& proc) -> IterationDecision {
+            if (&proc != &cur_proc && proc.loaded_cr3() == cr3)
+                targets |= 1u << proc.id();
+            return IterationDecision::Continue;
+        });
+
+    if (targets) {
+        auto& msg = smp_get_from_pool();
+        msg.async = false;
+        msg.type = ProcessorMessage::FlushTlb;
+        msg.flush_tlb.ptr = vaddr.as_ptr();
+        msg.flush_tlb.page_count = page_count;
+        atomic_store(&msg.refs, (u32)__builtin_popcount(targets), AK::MemoryOrder::memory_order_release);
+        for (u32 cpu = 0; cpu < count(); cpu++) {
+            if (!(targets & (1u << cpu)))
+                continue;
+            // A target may have switched away by the time it sees this, in
+            // which case the flush is merely redundant.
+            if (processors()[cpu]->smp_queue_message(msg))
+                APIC::the().send_ipi(cpu);
+            cur_proc.m_tlb_shootdowns_sent++;
+        }
+        flush_tlb_local(vaddr, page_count);
+        smp_broadcast_wait_sync(msg);
+    } else {
+        flush_tlb_local(vaddr, page_count);
+    }
+}
+
 void Processor::smp_broadcast_halt()
 {
     // We don't want to use a message, because this could have been triggered
@@ -282,6 +282,7 @@ void handle_crash(RegisterState&, const char* description, int signal, bool out_
 [[nodiscard]] bool safe_memcpy(void* dest_ptr, const void* src_ptr, size_t n, void*& fault_at);
 [[nodiscard]] ssize_t safe_strnlen(const char* str, size_t max_n, void*& fault_at);
 [[nodiscard]] bool safe_memset(void* dest_ptr, int c, size_t n, void*& fault_at);
+[[nodiscard]] bool safe_atomic_compare_exchange_relaxed(volatile u32* var, u32& expected, u32 desired, bool& did_exchange);
 
 #define LSW(x) ((u32)(x)&0xFFFF)
 #define MSW(x) (((u32)(x) >> 16) & 0xFFFF)
@@ -638,9 +639,12 @@ static_assert(GDT_SELECTOR_CODE0 + 8 == GDT_SELECTOR_DATA0); // SS0 = CS0 + 8
 static_assert(GDT_SELECTOR_CODE0 + 16 == GDT_SELECTOR_CODE3); // CS3 = CS0 + 16
 static_assert(GDT_SELECTOR_CODE0 + 24 == GDT_SELECTOR_DATA3); // SS3 = CS0 + 32
 
+class PageDirectory;
 class ProcessorInfo;
 class SchedulerPerProcessorData;
 struct MemoryManagerData;
+struct HeapPerProcessorData;
+struct TimerQueuePerProcessorData;
 struct ProcessorMessageEntry;
 
 struct ProcessorMessage {
@@ -716,11 +720,16 @@ class Processor {
 
     ProcessorInfo* m_info;
     MemoryManagerData* m_mm_data;
+    HeapPerProcessorData* m_heap_data;
     SchedulerPerProcessorData* m_scheduler_data;
+    TimerQueuePerProcessorData* m_timer_queue_data;
     Thread* m_current_thread;
     Thread* m_idle_thread;
 
     volatile ProcessorMessageEntry* m_message_queue; // atomic, LIFO
+    volatile u32 m_loaded_cr3;                       // atomic
+    u32 m_tlb_shootdowns_sent;
+    u32 m_tlb_shootdowns_received;
 
     bool m_invoke_scheduler_async;
     bool m_scheduler_initialized;
@@ -743,6 +752,7 @@ class Processor {
     static void smp_broadcast_message(ProcessorMessage& msg);
     static void smp_broadcast_wait_sync(ProcessorMessage& msg);
     static void smp_broadcast_halt();
+    static void smp_multicast_flush_tlb(u32 cr3, VirtualAddress vaddr, size_t page_count);
 
     void deferred_call_pool_init();
     void deferred_call_execute_pending();
@@ -782,7 +792,13 @@ public:
     }
 
     static void flush_tlb_local(VirtualAddress vaddr, size_t page_count);
-    static void flush_tlb(VirtualAddress vaddr, size_t page_count);
+    static void flush_tlb(const PageDirectory*, VirtualAddress vaddr, size_t page_count);
+
+    void load_cr3(u32 cr3);
+    u32 loaded_cr3() const { return atomic_load(&m_loaded_cr3, AK::MemoryOrder::memory_order_relaxed); }
+
+    u32 tlb_shootdowns_sent() const { return m_tlb_shootdowns_sent; }
+    u32 tlb_shootdowns_received() const { return m_tlb_shootdowns_received; }
 
     Descriptor& get_gdt_entry(u16 selector);
     void flush_gdt();
@@ -826,6 +842,26 @@ public:
         return *m_scheduler_data;
     }
 
+    ALWAYS_INLINE bool has_scheduler_data() const
+    {
+        return m_scheduler_data != nullptr;
+    }
+
+    ALWAYS_INLINE void set_timer_queue_data(TimerQueuePerProcessorData& timer_queue_data)
+    {
+        m_timer_queue_data = &timer_queue_data;
+    }
+
+    ALWAYS_INLINE TimerQueuePerProcessorData& get_timer_queue_data() const
+    {
+        return *m_timer_queue_data;
+    }
+
+    ALWAYS_INLINE bool has_timer_queue_data() const
+    {
+        return m_timer_queue_data != nullptr;
+    }
+
     ALWAYS_INLINE void set_mm_data(MemoryManagerData& mm_data)
     {
         m_mm_data = &mm_data;
@@ -836,6 +872,21 @@ public:
         return *m_mm_data;
     }
 
+    ALWAYS_INLINE bool has_mm_data() const
+    {
+        return m_mm_data != nullptr;
+    }
+
+    ALWAYS_INLINE void set_heap_data(HeapPerProcessorData& heap_data)
+    {
+        m_heap_data = &heap_data;
+    }
+
+    ALWAYS_INLINE HeapPerProcessorData* heap_data() const
+    {
+        return m_heap_data;
+    }
+
     ALWAYS_INLINE Thread* idle_thread() const
     {
         return m_idle_thread;
@@ -83,6 +83,15 @@ public:
         do_start();
     }
 
+    // For requests that the driver services along with another one, so
+    // start() is never called for them.
+    void mark_started(Badge<Device>)
+    {
+        ScopedSpinLock lock(m_lock);
+        ASSERT(m_result == Pending);
+        m_result = Started;
+    }
+
     void complete(RequestResult result);
 
     void set_private(void* priv)
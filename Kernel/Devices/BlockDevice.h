@@ -62,12 +62,17 @@ public:
     }
 
 private:
+    friend class StorageDevice;
+
     BlockDevice& m_block_device;
     const RequestType m_request_type;
     const u32 m_block_index;
     const u32 m_block_count;
     UserOrKernelBuffer m_buffer;
     const size_t m_buffer_size;
+
+    // Bookkeeping for StorageDevice's request queue.
+    u32 m_queue_sequence { 0 };
 };
 
 class BlockDevice : public Device {
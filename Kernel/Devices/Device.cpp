@@ -80,22 +80,60 @@ String Device::absolute_path(const FileDescription&) const
     return absolute_path();
 }
 
+void Device::attach_queued_request(RequestList::Iterator it)
+{
+    ASSERT(m_requests_lock.is_locked());
+    m_attached_requests.append(*it);
+    m_requests.remove(it);
+    m_attached_requests.last()->mark_started({});
+}
+
+void Device::dispatch_queued_requests()
+{
+    bool started_any = false;
+    for (;;) {
+        RefPtr<AsyncDeviceRequest> request;
+        {
+            ScopedSpinLock lock(m_requests_lock);
+            if (m_requests.is_empty() || m_outstanding_request_count >= max_outstanding_requests())
+                break;
+            request = m_requests.first();
+            m_requests.remove(m_requests.begin());
+            m_outstanding_requests.append(request);
+            m_outstanding_request_count++;
+        }
+        request->do_start({});
+        started_any = true;
+    }
+    if (started_any)
+        did_start_requests();
+}
+
 void Device::process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest& completed_request)
 {
-    AsyncDeviceRequest* next_request = nullptr;
+    // Drivers may complete their requests in any order.
+    auto remove_request = [&completed_request](RequestList& list) {
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (it->ptr() == &completed_request) {
+                list.remove(it);
+                return true;
+            }
+        }
+        return false;
+    };
 
     {
         ScopedSpinLock lock(m_requests_lock);
-        ASSERT(!m_requests.is_empty());
-        ASSERT(m_requests.first().ptr() == &completed_request);
-        m_requests.remove(m_requests.begin());
-        if (!m_requests.is_empty())
-            next_request = m_requests.first().ptr();
+        if (remove_request(m_outstanding_requests)) {
+            ASSERT(m_outstanding_request_count > 0);
+            m_outstanding_request_count--;
+        } else {
+            bool was_attached = remove_request(m_attached_requests);
+            ASSERT(was_attached);
+        }
     }
 
-    if (next_request)
-        next_request->start();
-
+    dispatch_queued_requests();
     evaluate_block_conditions();
 }
 
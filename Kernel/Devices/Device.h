@@ -65,18 +65,19 @@ public:
 
     void process_next_queued_request(Badge<AsyncDeviceRequest>, const AsyncDeviceRequest&);
 
+    // How many requests the driver can service at once. Any others wait in
+    // the queue until one of those completes.
+    virtual size_t max_outstanding_requests() const { return 1; }
+
     template<typename AsyncRequestType, typename... Args>
     NonnullRefPtr<AsyncRequestType> make_request(Args&&... args)
     {
         auto request = adopt(*new AsyncRequestType(*this, forward<Args>(args)...));
-        bool was_empty;
         {
             ScopedSpinLock lock(m_requests_lock);
-            was_empty = m_requests.is_empty();
-            m_requests.append(request);
+            queue_request(request);
         }
-        if (was_empty)
-            request->do_start({});
+        dispatch_queued_requests();
         return request;
     }
 
@@ -87,14 +88,36 @@ protected:
 
     static HashMap<u32, Device*>& all_devices();
 
+    using RequestList = DoublyLinkedList<RefPtr<AsyncDeviceRequest>>;
+
+    // Called with m_requests_lock held. m_requests only holds requests that
+    // haven't been started yet, in the order they should be started in.
+    virtual void queue_request(NonnullRefPtr<AsyncDeviceRequest> request) { m_requests.append(move(request)); }
+
+    // Called after one or more requests were started, so drivers that can
+    // queue several of them only need to poke the hardware once.
+    virtual void did_start_requests() { }
+
+    // Lets a driver service a queued request along with one it was asked to
+    // start. The request doesn't count against max_outstanding_requests().
+    // Called with m_requests_lock held.
+    void attach_queued_request(RequestList::Iterator);
+
+    SpinLock<u8> m_requests_lock;
+    RequestList m_requests;
+
+private:
+    void dispatch_queued_requests();
+
+    RequestList m_outstanding_requests;
+    RequestList m_attached_requests;
+    size_t m_outstanding_request_count { 0 };
+
 private:
     unsigned m_major { 0 };
     unsigned m_minor { 0 };
     uid_t m_uid { 0 };
     gid_t m_gid { 0 };
-
-    SpinLock<u8> m_requests_lock;
-    DoublyLinkedList<RefPtr<AsyncDeviceRequest>> m_requests;
 };
 
 }
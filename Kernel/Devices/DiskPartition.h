@@ -44,6 +44,9 @@ public:
     virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override;
     virtual bool can_write(const FileDescription&, size_t) const override;
 
+    // ^Device
+    virtual size_t max_outstanding_requests() const override { return m_device->max_outstanding_requests(); }
+
 private:
     virtual const char* class_name() const override;
 
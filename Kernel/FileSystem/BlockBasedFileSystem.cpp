@@ -24,122 +24,99 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <AK/IntrusiveList.h>
+#include <AK/QuickSort.h>
+#include <AK/Singleton.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/Process.h>
+#include <Kernel/Time/TimeManagement.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 
 //#define BBFS_DEBUG
 
 namespace Kernel {
 
-struct CacheEntry {
-    IntrusiveListNode list_node;
-    u32 block_index { 0 };
-    u8* data { nullptr };
-    bool has_data { false };
-};
-
-class DiskCache {
-public:
-    explicit DiskCache(BlockBasedFS& fs)
-        : m_fs(fs)
-        , m_cached_block_data(KBuffer::create_with_size(m_entry_count * m_fs.block_size()))
-        , m_entries(KBuffer::create_with_size(m_entry_count * sizeof(CacheEntry)))
-    {
-        for (size_t i = 0; i < m_entry_count; ++i) {
-            entries()[i].data = m_cached_block_data.data() + i * m_fs.block_size();
-            m_clean_list.append(entries()[i]);
-        }
-    }
-
-    ~DiskCache() { }
-
-    bool is_dirty() const { return m_dirty; }
-    void set_dirty(bool b) { m_dirty = b; }
-
-    void mark_all_clean()
-    {
-        while (auto* entry = m_dirty_list.first())
-            m_clean_list.prepend(*entry);
-        m_dirty = false;
-    }
-
-    void mark_dirty(CacheEntry& entry)
-    {
-        m_dirty_list.prepend(entry);
-        m_dirty = true;
-    }
-
-    void mark_clean(CacheEntry& entry)
-    {
-        m_clean_list.prepend(entry);
-    }
-
-    CacheEntry& get(u32 block_index) const
-    {
-        if (auto it = m_hash.find(block_index); it != m_hash.end()) {
-            auto& entry = const_cast<CacheEntry&>(*it->value);
-            ASSERT(entry.block_index == block_index);
-            return entry;
-        }
+// Each filesystem has a flusher thread that writes back pages once they've been dirty
+// for a while, and keeps going while too much of memory is dirty.
+static constexpr u64 dirty_expire_ms = 3000;
+static constexpr timespec flusher_interval { 0, 500'000'000 };
+static constexpr size_t background_dirty_percent = 5;
 
-        if (m_clean_list.is_empty()) {
-            // Not a single clean entry! Flush writes and try again.
-            // NOTE: We want to make sure we only call FileBackedFS flush here,
-            //       not some FileBackedFS subclass flush!
-            m_fs.flush_writes_impl();
-            return get(block_index);
-        }
+// Past this point writers have to wait for the flushers to catch up a bit, but only for so long.
+static constexpr size_t throttle_dirty_percent = 10;
+static constexpr timespec throttle_interval { 0, 20'000'000 };
+static constexpr size_t max_throttle_waits = 10;
 
-        ASSERT(m_clean_list.last());
-        auto& new_entry = *m_clean_list.last();
-        m_clean_list.prepend(new_entry);
+// Dirty pages are collected, sorted by their place on the disk and written in batches of this many.
+static constexpr size_t writeback_batch_size = 64;
 
-        m_hash.remove(new_entry.block_index);
-        m_hash.set(block_index, &new_entry);
+// Flushers wake this up whenever they've made some progress.
+static AK::Singleton<WaitQueue> s_writeback_progress_queue;
 
-        new_entry.block_index = block_index;
-        new_entry.has_data = false;
+static size_t dirty_page_limit(size_t percent)
+{
+    return max<size_t>(MM.user_physical_pages() * percent / 100, writeback_batch_size * 2);
+}
 
-        return new_entry;
-    }
+// Runs of blocks missing from the cache are read from the disk in one go,
+// up to this many bytes at a time.
+static constexpr size_t max_read_run_size = 64 * KiB;
 
-    const CacheEntry* entries() const { return (const CacheEntry*)m_entries.data(); }
-    CacheEntry* entries() { return (CacheEntry*)m_entries.data(); }
+BlockBasedFS::BlockBasedFS(FileDescription& file_description)
+    : FileBackedFS(file_description)
+{
+    ASSERT(file_description.file().is_seekable());
+}
 
-    template<typename Callback>
-    void for_each_clean_entry(Callback callback)
-    {
-        for (auto& entry : m_clean_list)
-            callback(entry);
+BlockBasedFS::~BlockBasedFS()
+{
+    if (m_flusher_started) {
+        m_flusher_should_stop = true;
+        m_flusher_wait_queue.wake_all();
+        while (!m_flusher_has_stopped)
+            Thread::current()->sleep({ 0, 10'000'000 });
     }
 
-    template<typename Callback>
-    void for_each_dirty_entry(Callback callback)
-    {
-        for (auto& entry : m_dirty_list)
-            callback(entry);
-    }
+    ScopedSpinLock lock(PageCache::the().lock());
+    PageCache::the().invalidate_all(fsid());
+}
 
-private:
-    BlockBasedFS& m_fs;
-    size_t m_entry_count { 10000 };
-    mutable HashMap<u32, CacheEntry*> m_hash;
-    mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_clean_list;
-    mutable IntrusiveList<CacheEntry, &CacheEntry::list_node> m_dirty_list;
-    KBuffer m_cached_block_data;
-    KBuffer m_entries;
-    bool m_dirty { false };
-};
+bool BlockBasedFS::is_block_cached(unsigned index) const
+{
+    ScopedSpinLock lock(PageCache::the().lock());
+    auto* entry = PageCache::the().peek(block_cache_identifier(), index / blocks_per_page());
+    return entry && (entry->valid_blocks & (1u << (index % blocks_per_page())));
+}
 
-BlockBasedFS::BlockBasedFS(FileDescription& file_description)
-    : FileBackedFS(file_description)
+bool BlockBasedFS::read_cached_block(unsigned index, u8* data) const
 {
-    ASSERT(file_description.file().is_seekable());
+    ScopedSpinLock lock(PageCache::the().lock());
+    auto* entry = PageCache::the().find(block_cache_identifier(), index / blocks_per_page(), 1u << (index % blocks_per_page()));
+    if (!entry)
+        return false;
+    PageCache::the().read_from_page(*entry, (index % blocks_per_page()) * block_size(), data, block_size());
+    return true;
 }
 
-BlockBasedFS::~BlockBasedFS()
+bool BlockBasedFS::cache_block(unsigned index, const u8* data, bool dirty) const
 {
+    ScopedSpinLock lock(PageCache::the().lock());
+    auto page_index = index / blocks_per_page();
+    u8 block_bit = 1u << (index % blocks_per_page());
+    auto* entry = PageCache::the().peek(block_cache_identifier(), page_index);
+    if (!entry) {
+        auto page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+        if (!page)
+            return false;
+        entry = &PageCache::the().add(block_cache_identifier(), page_index, *page, 0);
+    }
+    if (!dirty && (entry->valid_blocks & block_bit))
+        return true;
+    PageCache::the().write_to_page(*entry, (index % blocks_per_page()) * block_size(), data, block_size());
+    entry->valid_blocks |= block_bit;
+    if (dirty)
+        PageCache::the().mark_dirty(*entry, block_bit);
+    return true;
 }
 
 int BlockBasedFS::write_block(unsigned index, const UserOrKernelBuffer& data, size_t count, size_t offset, bool allow_cache)
@@ -150,68 +127,125 @@ int BlockBasedFS::write_block(unsigned index, const UserOrKernelBuffer& data, si
     klog() << "BlockBasedFileSystem::write_block " << index << ", size=" << count;
 #endif
 
-    if (!allow_cache) {
+    if (!allow_cache || !can_cache_blocks()) {
+        // Don't let a flusher write an older copy of the block over this one.
+        LOCKER(m_writeback_lock);
         flush_specific_block_if_needed(index);
         u32 base_offset = static_cast<u32>(index) * static_cast<u32>(block_size()) + offset;
-        file_description().seek(base_offset, SEEK_SET);
-        auto nwritten = file_description().write(data, count);
-        if (nwritten.is_error())
-            return -EIO; // TODO: Return error code as-is, could be -EFAULT!
-        ASSERT(nwritten.value() == count);
+        int err = write_to_device(base_offset, count, data);
+        if (err < 0)
+            return err;
+        if (can_cache_blocks()) {
+            // Make sure nobody reads the old contents from the cache, and that
+            // they aren't written back over this if flushing them failed above.
+            ScopedSpinLock lock(PageCache::the().lock());
+            if (auto* entry = PageCache::the().peek(block_cache_identifier(), index / blocks_per_page())) {
+                u8 block_bit = 1u << (index % blocks_per_page());
+                PageCache::the().mark_clean(*entry, block_bit);
+                entry->valid_blocks &= ~block_bit;
+            }
+        }
         return 0;
     }
 
-    auto& entry = cache().get(index);
+    auto block = ByteBuffer::create_uninitialized(block_size());
+    u8* block_data = block.data();
     if (count < block_size()) {
-        // Fill the cache first.
-        read_block(index, nullptr, block_size());
+        // Fill in the parts of the block we're not overwriting first.
+        auto block_buffer = UserOrKernelBuffer::for_kernel_buffer(block_data);
+        int err = read_block(index, &block_buffer, block_size());
+        if (err < 0)
+            return err;
     }
-    if (!data.read(entry.data + offset, count))
+    if (!data.read(block_data + offset, count))
         return -EFAULT;
 
-    cache().mark_dirty(entry);
-    entry.has_data = true;
+    if (!cache_block(index, block_data, true)) {
+        // We couldn't get a page to cache it in, write it straight to the disk.
+        u32 base_offset = static_cast<u32>(index) * static_cast<u32>(block_size());
+        return write_to_device(base_offset, block_size(), UserOrKernelBuffer::for_kernel_buffer(block_data));
+    }
+
+    throttle_writer();
     return 0;
 }
 
+void BlockBasedFS::throttle_writer()
+{
+    size_t dirty_pages;
+    {
+        ScopedSpinLock lock(PageCache::the().lock());
+        dirty_pages = PageCache::the().dirty_page_count(fsid());
+    }
+    if (dirty_pages < dirty_page_limit(background_dirty_percent))
+        return;
+    wake_flusher();
+
+    // Slow the writer down to the pace of the disk, rather than making it write
+    // everything out itself. We might be holding filesystem locks, so don't wait forever.
+    for (size_t i = 0; i < max_throttle_waits && dirty_pages >= dirty_page_limit(throttle_dirty_percent); ++i) {
+        wake_flusher();
+        s_writeback_progress_queue->wait_on(Thread::BlockTimeout(false, &throttle_interval), "BlockBasedFS");
+        ScopedSpinLock lock(PageCache::the().lock());
+        dirty_pages = PageCache::the().dirty_page_count(fsid());
+    }
+}
+
 bool BlockBasedFS::raw_read(unsigned index, UserOrKernelBuffer& buffer)
 {
     u32 base_offset = static_cast<u32>(index) * static_cast<u32>(m_logical_block_size);
-    file_description().seek(base_offset, SEEK_SET);
-    auto nread = file_description().read(buffer, m_logical_block_size);
-    ASSERT(!nread.is_error());
-    ASSERT(nread.value() == m_logical_block_size);
+    int err = read_from_device(base_offset, m_logical_block_size, buffer);
+    ASSERT(err == 0);
     return true;
 }
 bool BlockBasedFS::raw_write(unsigned index, const UserOrKernelBuffer& buffer)
 {
     u32 base_offset = static_cast<u32>(index) * static_cast<u32>(m_logical_block_size);
-    file_description().seek(base_offset, SEEK_SET);
-    auto nwritten = file_description().write(buffer, m_logical_block_size);
-    ASSERT(!nwritten.is_error());
-    ASSERT(nwritten.value() == m_logical_block_size);
+    int err = write_to_device(base_offset, m_logical_block_size, buffer);
+    ASSERT(err == 0);
     return true;
 }
 
 bool BlockBasedFS::raw_read_blocks(unsigned index, size_t count, UserOrKernelBuffer& buffer)
 {
-    auto current = buffer;
-    for (unsigned block = index; block < (index + count); block++) {
-        if (!raw_read(block, current))
-            return false;
-        current = current.offset(logical_block_size());
-    }
-    return true;
+    u32 base_offset = static_cast<u32>(index) * static_cast<u32>(m_logical_block_size);
+    return read_from_device(base_offset, count * m_logical_block_size, buffer) == 0;
 }
 bool BlockBasedFS::raw_write_blocks(unsigned index, size_t count, const UserOrKernelBuffer& buffer)
 {
-    auto current = buffer;
-    for (unsigned block = index; block < (index + count); block++) {
-        if (!raw_write(block, current))
-            return false;
-        current = current.offset(logical_block_size());
+    u32 base_offset = static_cast<u32>(index) * static_cast<u32>(m_logical_block_size);
+    return write_to_device(base_offset, count * m_logical_block_size, buffer) == 0;
+}
+
+int BlockBasedFS::read_from_device(u32 base_offset, size_t length, UserOrKernelBuffer& buffer) const
+{
+    // The device may hand us less than we asked for if the request is large.
+    // We don't go through the description's offset, the flusher may be using the device at the same time.
+    size_t nread = 0;
+    while (nread < length) {
+        auto buffer_offset = buffer.offset(nread);
+        auto result = file_description().read(buffer_offset, base_offset + nread, length - nread);
+        if (result.is_error())
+            return -EIO;
+        if (result.value() == 0)
+            return -EIO;
+        nread += result.value();
     }
-    return true;
+    return 0;
+}
+
+int BlockBasedFS::write_to_device(u32 base_offset, size_t length, const UserOrKernelBuffer& buffer)
+{
+    size_t nwritten = 0;
+    while (nwritten < length) {
+        auto result = file_description().write(buffer.offset(nwritten), base_offset + nwritten, length - nwritten);
+        if (result.is_error())
+            return -EIO;
+        if (result.value() == 0)
+            return -EIO;
+        nwritten += result.value();
+    }
+    return 0;
 }
 
 int BlockBasedFS::write_blocks(unsigned index, unsigned count, const UserOrKernelBuffer& data, bool allow_cache)
@@ -233,29 +267,42 @@ int BlockBasedFS::read_block(unsigned index, UserOrKernelBuffer* buffer, size_t
     klog() << "BlockBasedFileSystem::read_block " << index;
 #endif
 
-    if (!allow_cache) {
-        const_cast<BlockBasedFS*>(this)->flush_specific_block_if_needed(index);
+    if (!allow_cache || !can_cache_blocks()) {
+        if (can_cache_blocks()) {
+            // We still have to see blocks that were written to the cache but not flushed yet.
+            auto block = ByteBuffer::create_uninitialized(block_size());
+            u8* block_data = block.data();
+            bool is_cached = false;
+            {
+                ScopedSpinLock lock(PageCache::the().lock());
+                auto* entry = PageCache::the().peek(block_cache_identifier(), index / blocks_per_page());
+                if (entry && (entry->valid_blocks & (1u << (index % blocks_per_page())))) {
+                    PageCache::the().read_from_page(*entry, (index % blocks_per_page()) * block_size(), block_data, block_size());
+                    is_cached = true;
+                }
+            }
+            if (is_cached) {
+                if (buffer && !buffer->write(block_data + offset, count))
+                    return -EFAULT;
+                return 0;
+            }
+        }
         u32 base_offset = static_cast<u32>(index) * static_cast<u32>(block_size()) + static_cast<u32>(offset);
-        file_description().seek(base_offset, SEEK_SET);
-        auto nread = file_description().read(*buffer, count);
-        if (nread.is_error())
-            return -EIO;
-        ASSERT(nread.value() == count);
-        return 0;
+        return read_from_device(base_offset, count, *buffer);
     }
 
-    auto& entry = cache().get(index);
-    if (!entry.has_data) {
+    auto block = ByteBuffer::create_uninitialized(block_size());
+    u8* block_data = block.data();
+    if (!read_cached_block(index, block_data)) {
         u32 base_offset = static_cast<u32>(index) * static_cast<u32>(block_size());
-        file_description().seek(base_offset, SEEK_SET);
-        auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        auto nread = file_description().read(entry_data_buffer, block_size());
-        if (nread.is_error())
-            return -EIO;
-        ASSERT(nread.value() == block_size());
-        entry.has_data = true;
+        auto block_buffer = UserOrKernelBuffer::for_kernel_buffer(block_data);
+        int err = read_from_device(base_offset, block_size(), block_buffer);
+        if (err < 0)
+            return err;
+        // If we can't get a page for it, we'll just read it from the disk again next time.
+        cache_block(index, block_data, false);
     }
-    if (buffer && !buffer->write(entry.data + offset, count))
+    if (buffer && !buffer->write(block_data + offset, count))
         return -EFAULT;
     return 0;
 }
@@ -267,12 +314,58 @@ int BlockBasedFS::read_blocks(unsigned index, unsigned count, UserOrKernelBuffer
         return false;
     if (count == 1)
         return read_block(index, &buffer, block_size(), 0, allow_cache);
-    auto out = buffer;
-    for (unsigned i = 0; i < count; ++i) {
-        auto err = read_block(index + i, &out, block_size(), 0, allow_cache);
+#ifdef BBFS_DEBUG
+    klog() << "BlockBasedFileSystem::read_blocks " << index << " x" << count;
+#endif
+
+    auto block = ByteBuffer::create_uninitialized(block_size());
+    u8* block_data = block.data();
+    if (!allow_cache || !can_cache_blocks()) {
+        u32 base_offset = static_cast<u32>(index) * static_cast<u32>(block_size());
+        int err = read_from_device(base_offset, count * block_size(), buffer);
         if (err < 0)
             return err;
-        out = out.offset(block_size());
+        if (!can_cache_blocks())
+            return 0;
+        // Blocks that were written to the cache but not flushed yet are newer than what's on the disk.
+        for (unsigned i = 0; i < count; ++i) {
+            {
+                ScopedSpinLock lock(PageCache::the().lock());
+                auto* entry = PageCache::the().peek(block_cache_identifier(), (index + i) / blocks_per_page());
+                if (!entry || !(entry->dirty_blocks & (1u << ((index + i) % blocks_per_page()))))
+                    continue;
+                PageCache::the().read_from_page(*entry, ((index + i) % blocks_per_page()) * block_size(), block_data, block_size());
+            }
+            if (!buffer.write(block_data, i * block_size(), block_size()))
+                return -EFAULT;
+        }
+        return 0;
+    }
+
+    for (unsigned i = 0; i < count;) {
+        if (read_cached_block(index + i, block_data)) {
+            if (!buffer.write(block_data, i * block_size(), block_size()))
+                return -EFAULT;
+            ++i;
+            continue;
+        }
+
+        // Read the whole run of blocks we don't have with a single request.
+        unsigned run_length = 1;
+        while (i + run_length < count && run_length < max_read_run_size / block_size() && !is_block_cached(index + i + run_length))
+            ++run_length;
+        auto run_data = ByteBuffer::create_uninitialized(run_length * block_size());
+        auto run_buffer = UserOrKernelBuffer::for_kernel_buffer(run_data.data());
+        u32 base_offset = static_cast<u32>(index + i) * static_cast<u32>(block_size());
+        int err = read_from_device(base_offset, run_length * block_size(), run_buffer);
+        if (err < 0)
+            return err;
+        // If we can't get pages for them, we'll just read them from the disk again next time.
+        for (unsigned j = 0; j < run_length; ++j)
+            cache_block(index + i + j, run_data.data() + j * block_size(), false);
+        if (!buffer.write(run_data.data(), i * block_size(), run_length * block_size()))
+            return -EFAULT;
+        i += run_length;
     }
 
     return 0;
@@ -280,54 +373,207 @@ int BlockBasedFS::read_blocks(unsigned index, unsigned count, UserOrKernelBuffer
 
 void BlockBasedFS::flush_specific_block_if_needed(unsigned index)
 {
-    LOCKER(m_lock);
-    if (!cache().is_dirty())
+    if (!can_cache_blocks())
         return;
-    Vector<CacheEntry*, 32> cleaned_entries;
-    cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        if (entry.block_index != index) {
-            u32 base_offset = static_cast<u32>(entry.block_index) * static_cast<u32>(block_size());
-            file_description().seek(base_offset, SEEK_SET);
+    LOCKER(m_writeback_lock);
+    auto block = ByteBuffer::create_uninitialized(block_size());
+    u8* block_data = block.data();
+    {
+        ScopedSpinLock lock(PageCache::the().lock());
+        auto* entry = PageCache::the().peek(block_cache_identifier(), index / blocks_per_page());
+        u8 block_bit = 1u << (index % blocks_per_page());
+        if (!entry || !(entry->dirty_blocks & block_bit))
+            return;
+        PageCache::the().read_from_page(*entry, (index % blocks_per_page()) * block_size(), block_data, block_size());
+        PageCache::the().start_writeback(*entry);
+    }
+    u32 base_offset = static_cast<u32>(index) * static_cast<u32>(block_size());
+    // FIXME: Should this error path be surfaced somehow?
+    int rc = write_to_device(base_offset, block_size(), UserOrKernelBuffer::for_kernel_buffer(block_data));
+    ScopedSpinLock lock(PageCache::the().lock());
+    auto* entry = PageCache::the().peek(block_cache_identifier(), index / blocks_per_page());
+    ASSERT(entry && entry->under_writeback);
+    PageCache::the().finish_writeback(*entry, rc < 0 ? 0 : 1u << (index % blocks_per_page()));
+}
+
+size_t BlockBasedFS::write_back_dirty_pages(size_t max_count, u64 dirtied_before_ms)
+{
+    if (!can_cache_blocks())
+        return 0;
+    LOCKER(m_writeback_lock);
+    if (!m_writeback_buffer) {
+        m_writeback_buffer = KBuffer::try_create_with_size(writeback_batch_size * PAGE_SIZE, Region::Access::Read | Region::Access::Write, "BlockBasedFS writeback");
+        if (!m_writeback_buffer)
+            return 0;
+    }
+    u8* batch_data = m_writeback_buffer->data();
+
+    struct DirtyPage {
+        size_t page_index;
+        u8 dirty_blocks;
+        bool write_failed;
+    };
+    DirtyPage pages[writeback_batch_size];
+    size_t count;
+    {
+        ScopedSpinLock lock(PageCache::the().lock());
+        PageCacheEntry* entries[writeback_batch_size];
+        count = PageCache::the().oldest_dirty_entries(fsid(), dirtied_before_ms, entries, min(max_count, writeback_batch_size));
+        // Go through them in disk order, so neighbouring pages can be written in one go.
+        quick_sort(entries, entries + count, [](auto* a, auto* b) { return a->key.page_index < b->key.page_index; });
+        for (size_t i = 0; i < count; ++i) {
+            auto& entry = *entries[i];
+            pages[i] = { entry.key.page_index, entry.dirty_blocks, false };
+            PageCache::the().read_from_page(entry, 0, batch_data + i * PAGE_SIZE, PAGE_SIZE);
+            PageCache::the().start_writeback(entry);
+        }
+    }
+
+    u8 all_blocks = (1u << blocks_per_page()) - 1;
+    size_t block_count = 0;
+    for (size_t i = 0; i < count;) {
+        if (pages[i].dirty_blocks == all_blocks) {
+            // Merge a run of consecutive, entirely dirty pages into a single write.
+            size_t run_length = 1;
+            while (i + run_length < count && pages[i + run_length].dirty_blocks == all_blocks && pages[i + run_length].page_index == pages[i].page_index + run_length)
+                ++run_length;
+            u32 base_offset = static_cast<u32>(pages[i].page_index) * PAGE_SIZE;
+            // FIXME: Should this error path be surfaced somehow?
+            if (write_to_device(base_offset, run_length * PAGE_SIZE, UserOrKernelBuffer::for_kernel_buffer(batch_data + i * PAGE_SIZE)) < 0) {
+                for (size_t j = 0; j < run_length; ++j)
+                    pages[i + j].write_failed = true;
+            } else {
+                block_count += run_length * blocks_per_page();
+            }
+            i += run_length;
+            continue;
+        }
+
+        // Write out each run of consecutive dirty blocks in the page in one go.
+        u8* page_data = batch_data + i * PAGE_SIZE;
+        size_t block = 0;
+        while (block < blocks_per_page()) {
+            if (!(pages[i].dirty_blocks & (1u << block))) {
+                ++block;
+                continue;
+            }
+            size_t run_length = 1;
+            while (block + run_length < blocks_per_page() && (pages[i].dirty_blocks & (1u << (block + run_length))))
+                ++run_length;
+            u32 base_offset = static_cast<u32>(pages[i].page_index * blocks_per_page() + block) * static_cast<u32>(block_size());
             // FIXME: Should this error path be surfaced somehow?
-            auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-            [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-            cleaned_entries.append(&entry);
+            if (write_to_device(base_offset, run_length * block_size(), UserOrKernelBuffer::for_kernel_buffer(page_data + block * block_size())) < 0)
+                pages[i].write_failed = true;
+            else
+                block_count += run_length;
+            block += run_length;
         }
-    });
-    // NOTE: We make a separate pass to mark entries clean since marking them clean
-    //       moves them out of the dirty list which would disturb the iteration above.
-    for (auto* entry : cleaned_entries)
-        cache().mark_clean(*entry);
+        ++i;
+    }
+
+    // Only now that the blocks are on the disk may the pages be reclaimed.
+    // Pages we failed to write stay dirty, so we'll try them again later.
+    size_t written_count = 0;
+    {
+        ScopedSpinLock lock(PageCache::the().lock());
+        for (size_t i = 0; i < count; ++i) {
+            auto* entry = PageCache::the().peek(block_cache_identifier(), pages[i].page_index);
+            ASSERT(entry && entry->under_writeback);
+            PageCache::the().finish_writeback(*entry, pages[i].write_failed ? 0 : pages[i].dirty_blocks);
+            if (!pages[i].write_failed)
+                ++written_count;
+        }
+    }
+
+#ifdef BBFS_DEBUG
+    if (block_count)
+        dbg() << class_name() << ": Wrote back " << block_count << " blocks in " << count << " pages";
+#endif
+    if (written_count)
+        s_writeback_progress_queue->wake_all();
+    return written_count;
 }
 
 void BlockBasedFS::flush_writes_impl()
 {
-    LOCKER(m_lock);
-    if (!cache().is_dirty())
+    if (!can_cache_blocks())
         return;
-    u32 count = 0;
-    cache().for_each_dirty_entry([&](CacheEntry& entry) {
-        u32 base_offset = static_cast<u32>(entry.block_index) * static_cast<u32>(block_size());
-        file_description().seek(base_offset, SEEK_SET);
-        // FIXME: Should this error path be surfaced somehow?
-        auto entry_data_buffer = UserOrKernelBuffer::for_kernel_buffer(entry.data);
-        [[maybe_unused]] auto rc = file_description().write(entry_data_buffer, block_size());
-        ++count;
-    });
-    cache().mark_all_clean();
-    dbg() << class_name() << ": Flushed " << count << " blocks to disk";
+
+    size_t pages_to_flush;
+    {
+        ScopedSpinLock lock(PageCache::the().lock());
+        pages_to_flush = PageCache::the().dirty_page_count(fsid());
+    }
+
+    // Pages dirtied again while we're writing go to the back of the list,
+    // so bound the loop by what was dirty when we started.
+    size_t count = 0;
+    while (count < pages_to_flush) {
+        size_t written = write_back_dirty_pages(pages_to_flush - count, NumericLimits<u64>::max());
+        if (!written)
+            break;
+        count += written;
+    }
+    if (count)
+        dbg() << class_name() << ": Flushed " << count << " pages to disk";
+}
+
+void BlockBasedFS::wake_flusher()
+{
+    if (!can_cache_blocks())
+        return;
+    if (!m_flusher_started.exchange(true)) {
+        RefPtr<Thread> flusher_thread;
+        Process::create_kernel_process(flusher_thread, String::format("%s flusher (fs %u)", class_name(), fsid()), [this] {
+            flusher_main();
+        });
+        // If we didn't get a thread, let the next writer try again, and don't
+        // let the destructor wait for a flusher that never ran.
+        if (!flusher_thread) {
+            m_flusher_started = false;
+            return;
+        }
+    }
+    m_flusher_wait_queue.wake_one();
+}
+
+void BlockBasedFS::flusher_main()
+{
+    while (!m_flusher_should_stop) {
+        for (;;) {
+            size_t dirty_pages;
+            {
+                ScopedSpinLock lock(PageCache::the().lock());
+                dirty_pages = PageCache::the().dirty_page_count(fsid());
+            }
+            // Everything that has been dirty for long enough goes, and if there's too
+            // much dirty memory around, so does the rest (oldest first).
+            u64 dirtied_before_ms = NumericLimits<u64>::max();
+            if (dirty_pages < dirty_page_limit(background_dirty_percent)) {
+                u64 now_ms = TimeManagement::the().uptime_ms();
+                if (now_ms < dirty_expire_ms)
+                    break;
+                dirtied_before_ms = now_ms - dirty_expire_ms;
+            }
+            if (!write_back_dirty_pages(writeback_batch_size, dirtied_before_ms) || m_flusher_should_stop)
+                break;
+        }
+        m_flusher_wait_queue.wait_on(Thread::BlockTimeout(false, &flusher_interval), "BlockBasedFS");
+    }
+    // The filesystem is going away once we've said so, don't touch it after this.
+    m_flusher_has_stopped = true;
 }
 
 void BlockBasedFS::flush_writes()
 {
+    flush_metadata();
     flush_writes_impl();
 }
 
-DiskCache& BlockBasedFS::cache() const
+void BlockBasedFS::start_writeback()
 {
-    if (!m_cache)
-        m_cache = make<DiskCache>(const_cast<BlockBasedFS&>(*this));
-    return *m_cache;
+    flush_metadata();
+    wake_flusher();
 }
 
 }
@@ -26,7 +26,10 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/WaitQueue.h>
 
 namespace Kernel {
 
@@ -37,11 +40,16 @@ public:
     size_t logical_block_size() const { return m_logical_block_size; };
 
     virtual void flush_writes() override;
+    virtual void start_writeback() override;
     void flush_writes_impl();
 
 protected:
     explicit BlockBasedFS(FileDescription&);
 
+    // Puts metadata the filesystem keeps outside of the block cache into it,
+    // so it gets written back along with everything else.
+    virtual void flush_metadata() { }
+
     int read_block(unsigned index, UserOrKernelBuffer* buffer, size_t count, size_t offset = 0, bool allow_cache = true) const;
     int read_blocks(unsigned index, unsigned count, UserOrKernelBuffer& buffer, bool allow_cache = true) const;
 
@@ -57,10 +65,30 @@ protected:
     size_t m_logical_block_size { 512 };
 
 private:
-    DiskCache& cache() const;
+    bool can_cache_blocks() const { return block_size() <= PAGE_SIZE; }
+    size_t blocks_per_page() const { return PAGE_SIZE / block_size(); }
+    InodeIdentifier block_cache_identifier() const { return { fsid(), 0 }; }
+
+    bool is_block_cached(unsigned index) const;
+    bool read_cached_block(unsigned index, u8* data) const;
+    bool cache_block(unsigned index, const u8* data, bool dirty) const;
     void flush_specific_block_if_needed(unsigned index);
 
-    mutable OwnPtr<DiskCache> m_cache;
+    int read_from_device(u32 base_offset, size_t length, UserOrKernelBuffer&) const;
+    int write_to_device(u32 base_offset, size_t length, const UserOrKernelBuffer&);
+
+    size_t write_back_dirty_pages(size_t max_count, u64 dirtied_before_ms);
+    void throttle_writer();
+    void wake_flusher();
+    void flusher_main();
+
+    // Held while writing back cached blocks, and while writing around the cache.
+    Lock m_writeback_lock { "BlockBasedFS writeback" };
+    OwnPtr<KBuffer> m_writeback_buffer;
+    WaitQueue m_flusher_wait_queue;
+    Atomic<bool> m_flusher_started { false };
+    Atomic<bool> m_flusher_should_stop { false };
+    Atomic<bool> m_flusher_has_stopped { false };
 };
 
 }
@@ -34,8 +34,8 @@
 
 namespace Kernel {
 
-// FIXME: Custody needs some locking.
-
+// A custody never changes once created, so it needs no locking of its own,
+// and the DentryCache can hand the same one to any number of path walks.
 class Custody : public RefCounted<Custody> {
     MAKE_SLAB_ALLOCATED(Custody)
 public:
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
+#include <Kernel/FileSystem/Inode.h>
+
+namespace Kernel {
+
+static AK::Singleton<DentryCache> s_the;
+
+DentryCache& DentryCache::the()
+{
+    return *s_the;
+}
+
+static unsigned hash_for(InodeIdentifier parent_inode, const StringView& name)
+{
+    return pair_int_hash(pair_int_hash(parent_inode.fsid(), parent_inode.index()), name.hash());
+}
+
+bool DentryCache::lookup(Custody& parent, const StringView& name, RefPtr<Custody>& child)
+{
+    auto parent_inode = parent.inode().identifier();
+    ScopedSpinLock lock(m_lock);
+    auto it = m_buckets.find(hash_for(parent_inode, name), [&](auto& bucket) {
+        return bucket.key.parent_inode == parent_inode && bucket.key.name == name;
+    });
+    if (it != m_buckets.end()) {
+        for (auto* entry : it->value) {
+            if (entry->parent.ptr() != &parent)
+                continue;
+            m_lru_list.append(*entry);
+            child = entry->child;
+            if (child)
+                m_hits++;
+            else
+                m_negative_hits++;
+            return true;
+        }
+    }
+    m_misses++;
+    return false;
+}
+
+u32 DentryCache::generation() const
+{
+    ScopedSpinLock lock(m_lock);
+    return m_generation;
+}
+
+void DentryCache::add(Custody& parent, const StringView& name, Custody* child, u32 generation)
+{
+    // Allocate up front, and let go of anything we replace or evict only after
+    // dropping the lock: releasing the last reference to an inode may do I/O.
+    auto* new_entry = new DentryCacheEntry({ parent.inode().identifier(), String(name) }, parent, child);
+    EntryList removed_entries;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (generation != m_generation) {
+            removed_entries.append(*new_entry);
+        } else {
+            auto& bucket = m_buckets.ensure(new_entry->key);
+            for (auto* entry : bucket) {
+                if (entry->parent.ptr() == &parent) {
+                    remove(*entry, removed_entries);
+                    break;
+                }
+            }
+            // remove() may have dropped the bucket.
+            m_buckets.ensure(new_entry->key).append(new_entry);
+            m_lru_list.append(*new_entry);
+            m_entry_count++;
+
+            while (m_entry_count > max_entries)
+                remove(*m_lru_list.first(), removed_entries);
+        }
+    }
+    destroy_entries(removed_entries);
+}
+
+void DentryCache::remove(DentryCacheEntry& entry, EntryList& removed_entries)
+{
+    auto it = m_buckets.find(entry.key);
+    ASSERT(it != m_buckets.end());
+    auto& bucket = it->value;
+    bucket.remove_first_matching([&](auto* other) { return other == &entry; });
+    if (bucket.is_empty())
+        m_buckets.remove(it);
+    removed_entries.append(entry);
+    m_entry_count--;
+}
+
+void DentryCache::destroy_entries(EntryList& entries)
+{
+    while (auto* entry = entries.take_first())
+        delete entry;
+}
+
+void DentryCache::invalidate(InodeIdentifier parent_inode, const StringView& name)
+{
+    EntryList removed_entries;
+    {
+        ScopedSpinLock lock(m_lock);
+        m_generation++;
+        auto it = m_buckets.find(hash_for(parent_inode, name), [&](auto& bucket) {
+            return bucket.key.parent_inode == parent_inode && bucket.key.name == name;
+        });
+        if (it == m_buckets.end())
+            return;
+        for (auto* entry : it->value) {
+            removed_entries.append(*entry);
+            m_entry_count--;
+        }
+        m_buckets.remove(it);
+    }
+    destroy_entries(removed_entries);
+}
+
+void DentryCache::invalidate_all()
+{
+    EntryList removed_entries;
+    {
+        ScopedSpinLock lock(m_lock);
+        m_generation++;
+        while (auto* entry = m_lru_list.take_first())
+            removed_entries.append(*entry);
+        m_buckets.clear();
+        m_entry_count = 0;
+    }
+    destroy_entries(removed_entries);
+}
+
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/NonnullRefPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/InodeIdentifier.h>
+#include <Kernel/Forward.h>
+#include <Kernel/SpinLock.h>
+
+namespace Kernel {
+
+struct DentryCacheKey {
+    InodeIdentifier parent_inode;
+    String name;
+
+    bool operator==(const DentryCacheKey& other) const { return parent_inode == other.parent_inode && name == other.name; }
+};
+
+}
+
+namespace AK {
+
+template<>
+struct Traits<Kernel::DentryCacheKey> : public GenericTraits<Kernel::DentryCacheKey> {
+    static unsigned hash(const Kernel::DentryCacheKey& key) { return pair_int_hash(pair_int_hash(key.parent_inode.fsid(), key.parent_inode.index()), key.name.hash()); }
+};
+
+}
+
+namespace Kernel {
+
+struct DentryCacheEntry {
+    DentryCacheEntry(const DentryCacheKey& key, Custody& parent, Custody* child)
+        : key(key)
+        , parent(parent)
+        , child(child)
+    {
+    }
+
+    IntrusiveListNode lru_list_node;
+    DentryCacheKey key;
+    NonnullRefPtr<Custody> parent;
+
+    // Null if the name is known not to exist in the parent directory.
+    RefPtr<Custody> child;
+};
+
+// Remembers which custody (or lack of one) a name resolved to inside a parent
+// custody, so that walking a path doesn't have to ask the filesystem about every
+// component again. Custodies are immutable, so the same one can be handed out to
+// any number of path walks.
+//
+// Entries are filed under the parent's inode and the name, since that's what
+// filesystems know about when a directory changes. Each bucket can hold entries
+// for several parent custodies of the same inode (e.g. via bind mounts).
+//
+// Only filesystems that report every directory change through did_add_child()
+// and did_remove_child() opt in; see FS::supports_dentry_cache().
+class DentryCache {
+    AK_MAKE_ETERNAL
+
+public:
+    static DentryCache& the();
+
+    DentryCache() { }
+
+    // Returns true if the result of looking up `name` in `parent` is cached.
+    // `child` is then set to the cached custody, or to null if the name doesn't exist.
+    bool lookup(Custody& parent, const StringView& name, RefPtr<Custody>& child);
+
+    // Lookups that miss should grab the generation before asking the filesystem,
+    // and pass it to add(). If anything was invalidated in the meantime, the
+    // result may already be stale and is not cached.
+    u32 generation() const;
+    void add(Custody& parent, const StringView& name, Custody* child, u32 generation);
+
+    void invalidate(InodeIdentifier parent_inode, const StringView& name);
+    void invalidate_all();
+
+    size_t entry_count() const { return m_entry_count; }
+    size_t hits() const { return m_hits; }
+    size_t negative_hits() const { return m_negative_hits; }
+    size_t misses() const { return m_misses; }
+
+private:
+    using EntryList = IntrusiveList<DentryCacheEntry, &DentryCacheEntry::lru_list_node>;
+
+    void remove(DentryCacheEntry&, EntryList& removed_entries);
+    static void destroy_entries(EntryList&);
+
+    static constexpr size_t max_entries = 4096;
+
+    mutable SpinLock<u8> m_lock;
+    HashMap<DentryCacheKey, Vector<DentryCacheEntry*, 1>> m_buckets;
+    EntryList m_lru_list;
+    u32 m_generation { 0 };
+    size_t m_entry_count { 0 };
+    size_t m_hits { 0 };
+    size_t m_negative_hits { 0 };
+    size_t m_misses { 0 };
+};
+
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Singleton.h>
+#include <Kernel/FileSystem/EventQueue.h>
+#include <Kernel/FileSystem/FileDescription.h>
+
+//#define EVENTQUEUE_DEBUG
+
+namespace Kernel {
+
+// Creating and destroying watches is serialized by this lock, which also protects
+// the mapping from file descriptions back to the watches referring to them.
+// FileDescription is slab allocated and has no room to keep that list itself.
+static SpinLock<u8> s_watches_lock;
+static AK::Singleton<HashMap<FileDescription*, Vector<EventWatch*>>> s_watches_by_description;
+
+EventWatch::EventWatch(EventQueue& queue, int fd, FileDescription& description, const epoll_event& event)
+    : m_queue(queue)
+    , m_fd(fd)
+    , m_description(description)
+    , m_events(event.events)
+    , m_data(event.data)
+{
+}
+
+EventWatch::~EventWatch()
+{
+}
+
+bool EventWatch::register_with_file()
+{
+    return set_block_condition(m_description.block_condition());
+}
+
+Thread::FileBlocker::BlockFlags EventWatch::block_flags() const
+{
+    u32 block_flags = (u32)BlockFlags::Exception;
+    if (m_events & EPOLLIN)
+        block_flags |= (u32)BlockFlags::Read;
+    if (m_events & EPOLLOUT)
+        block_flags |= (u32)BlockFlags::Write;
+    if (m_events & EPOLLPRI)
+        block_flags |= (u32)BlockFlags::ReadPriority;
+    return (BlockFlags)block_flags;
+}
+
+bool EventWatch::unblock(bool, void*)
+{
+    m_queue.watch_did_change(*this);
+    // Never let the file take us off its list, we want to hear about the next change too.
+    return false;
+}
+
+static u32 epoll_events_from_unblock_flags(u32 unblock_flags)
+{
+    u32 events = 0;
+    if (unblock_flags & (u32)Thread::FileBlocker::BlockFlags::Read)
+        events |= EPOLLIN;
+    if (unblock_flags & (u32)Thread::FileBlocker::BlockFlags::ReadPriority)
+        events |= EPOLLPRI;
+    if (unblock_flags & (u32)Thread::FileBlocker::BlockFlags::Write)
+        events |= EPOLLOUT;
+    if (unblock_flags & (u32)Thread::FileBlocker::BlockFlags::ReadHangUp)
+        events |= EPOLLRDHUP;
+    if (unblock_flags & (u32)Thread::FileBlocker::BlockFlags::WriteError)
+        events |= EPOLLERR;
+    if (unblock_flags & (u32)Thread::FileBlocker::BlockFlags::WriteHangUp)
+        events |= EPOLLHUP;
+    return events;
+}
+
+NonnullRefPtr<EventQueue> EventQueue::create()
+{
+    return adopt(*new EventQueue);
+}
+
+EventQueue::EventQueue()
+{
+}
+
+EventQueue::~EventQueue()
+{
+    ScopedSpinLock lock(s_watches_lock);
+    while (!m_watches.is_empty())
+        destroy_watch(*m_watches.begin()->value);
+}
+
+bool EventQueue::can_read(const FileDescription&, size_t) const
+{
+    ScopedSpinLock lock(m_lock);
+    return !m_ready.is_empty();
+}
+
+KResult EventQueue::add_watch(int fd, FileDescription& description, const epoll_event& event)
+{
+    // Nesting event queues would let them keep each other alive.
+    if (description.file().is_event_queue())
+        return KResult(-EINVAL);
+
+    ScopedSpinLock lock(s_watches_lock);
+    auto it = m_watches.find(fd);
+    if (it != m_watches.end()) {
+        if (&it->value->description() == &description)
+            return KResult(-EEXIST);
+        // The fd was closed and reused while its old description stayed open
+        // somewhere else, so this watch is stale.
+        destroy_watch(*it->value);
+    }
+
+    auto watch = make<EventWatch>(*this, fd, description, event);
+    auto& watch_ref = *watch;
+    m_watches.set(fd, move(watch));
+    s_watches_by_description->ensure(&description).append(&watch_ref);
+
+    // This evaluates the file right away, so a watch that is already
+    // ready ends up on the ready list before we return.
+    bool registered = watch_ref.register_with_file();
+    ASSERT(registered);
+#ifdef EVENTQUEUE_DEBUG
+    dbg() << "EventQueue{" << this << "}: Watching fd " << fd << " (" << description.absolute_path() << ") for " << String::format("%x", event.events);
+#endif
+    return KSuccess;
+}
+
+KResult EventQueue::modify_watch(int fd, FileDescription& description, const epoll_event& event)
+{
+    ScopedSpinLock lock(s_watches_lock);
+    auto it = m_watches.find(fd);
+    if (it == m_watches.end() || &it->value->description() != &description)
+        return KResult(-ENOENT);
+
+    auto& watch = *it->value;
+    {
+        ScopedSpinLock queue_lock(m_lock);
+        watch.m_events = event.events;
+        watch.m_data = event.data;
+        watch.m_is_disarmed = false;
+    }
+    watch_did_change(watch);
+    return KSuccess;
+}
+
+KResult EventQueue::remove_watch(int fd, FileDescription& description)
+{
+    ScopedSpinLock lock(s_watches_lock);
+    auto it = m_watches.find(fd);
+    if (it == m_watches.end() || &it->value->description() != &description)
+        return KResult(-ENOENT);
+    destroy_watch(*it->value);
+    return KSuccess;
+}
+
+void EventQueue::destroy_watch(EventWatch& watch)
+{
+    ASSERT(s_watches_lock.is_locked());
+    {
+        // Disarm first so that a concurrent notification from the file
+        // doesn't put the watch back on the ready list.
+        ScopedSpinLock lock(m_lock);
+        watch.m_is_disarmed = true;
+        if (watch.m_is_ready) {
+            m_ready.remove_first_matching([&](auto* entry) { return entry == &watch; });
+            watch.m_is_ready = false;
+        }
+    }
+
+    auto it = s_watches_by_description->find(&watch.description());
+    ASSERT(it != s_watches_by_description->end());
+    it->value.remove_first_matching([&](auto* entry) { return entry == &watch; });
+    if (it->value.is_empty())
+        s_watches_by_description->remove(it);
+
+    // This takes the watch off the file's block condition.
+    m_watches.remove(watch.fd());
+}
+
+void EventQueue::description_destroyed(Badge<FileDescription>, FileDescription& description)
+{
+    ScopedSpinLock lock(s_watches_lock);
+    auto it = s_watches_by_description->find(&description);
+    if (it == s_watches_by_description->end())
+        return;
+    auto watches = it->value;
+    for (auto* watch : watches)
+        watch->m_queue.destroy_watch(*watch);
+}
+
+void EventQueue::watch_did_change(EventWatch& watch)
+{
+    {
+        ScopedSpinLock lock(m_lock);
+        if (watch.m_is_ready || watch.m_is_disarmed)
+            return;
+        if (watch.m_description.should_unblock(watch.block_flags()) == Thread::FileBlocker::BlockFlags::None)
+            return;
+        watch.m_is_ready = true;
+        m_ready.append(&watch);
+    }
+    evaluate_block_conditions();
+}
+
+size_t EventQueue::collect_ready_events(epoll_event* events, size_t max_events)
+{
+    ScopedSpinLock lock(m_lock);
+    size_t count = 0;
+    Vector<EventWatch*> remaining;
+    Vector<EventWatch*> still_ready;
+    for (auto* watch : m_ready) {
+        if (count == max_events) {
+            remaining.append(watch);
+            continue;
+        }
+        auto unblock_flags = watch->m_description.should_unblock(watch->block_flags());
+        if (unblock_flags == Thread::FileBlocker::BlockFlags::None) {
+            watch->m_is_ready = false;
+            continue;
+        }
+
+        auto& event = events[count++];
+        event.events = epoll_events_from_unblock_flags((u32)unblock_flags);
+        event.data = watch->m_data;
+
+        if (watch->m_events & EPOLLONESHOT) {
+            watch->m_is_disarmed = true;
+            watch->m_is_ready = false;
+        } else if (watch->m_events & EPOLLET) {
+            watch->m_is_ready = false;
+        } else {
+            // Level-triggered watches are checked again on the next call,
+            // after the ones we didn't get to this time.
+            still_ready.append(watch);
+        }
+    }
+    remaining.append(move(still_ready));
+    m_ready = move(remaining);
+    return count;
+}
+
+}
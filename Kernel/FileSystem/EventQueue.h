@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Badge.h>
+#include <AK/HashMap.h>
+#include <AK/NonnullOwnPtr.h>
+#include <AK/Vector.h>
+#include <Kernel/FileSystem/File.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/Thread.h>
+
+namespace Kernel {
+
+class EventQueue;
+
+// An EventWatch is a FileBlocker that never blocks a thread. It stays on the
+// watched file's block condition for as long as the watch exists, and every
+// time the file re-evaluates its blockers the watch gets a chance to put
+// itself on its EventQueue's ready list.
+class EventWatch final : public Thread::FileBlocker {
+public:
+    EventWatch(EventQueue&, int fd, FileDescription&, const epoll_event&);
+    virtual ~EventWatch() override;
+
+    virtual const char* state_string() const override { return "Watching"; }
+    virtual void not_blocking(bool) override { }
+    virtual bool unblock(bool, void*) override;
+
+    bool register_with_file();
+
+    int fd() const { return m_fd; }
+    FileDescription& description() { return m_description; }
+
+private:
+    friend class EventQueue;
+
+    BlockFlags block_flags() const;
+
+    EventQueue& m_queue;
+    const int m_fd;
+    FileDescription& m_description;
+
+    // These are protected by the owning EventQueue's lock.
+    u32 m_events { 0 };
+    epoll_data_t m_data {};
+    bool m_is_ready { false };
+    bool m_is_disarmed { false };
+};
+
+class EventQueue final : public File {
+public:
+    static NonnullRefPtr<EventQueue> create();
+    virtual ~EventQueue() override;
+
+    KResult add_watch(int fd, FileDescription&, const epoll_event&);
+    KResult modify_watch(int fd, FileDescription&, const epoll_event&);
+    KResult remove_watch(int fd, FileDescription&);
+
+    // Fills in up to max_events ready events and returns how many there were.
+    // Level-triggered watches that are still ready stay on the ready list.
+    size_t collect_ready_events(epoll_event* events, size_t max_events);
+
+    static void description_destroyed(Badge<FileDescription>, FileDescription&);
+
+    virtual bool can_read(const FileDescription&, size_t) const override;
+    virtual bool can_write(const FileDescription&, size_t) const override { return false; }
+    virtual KResultOr<size_t> read(FileDescription&, size_t, UserOrKernelBuffer&, size_t) override { return KResult(-EINVAL); }
+    virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override { return KResult(-EINVAL); }
+    virtual String absolute_path(const FileDescription&) const override { return "EventQueue"; }
+    virtual const char* class_name() const override { return "EventQueue"; }
+    virtual bool is_event_queue() const override { return true; }
+
+private:
+    friend class EventWatch;
+
+    EventQueue();
+
+    void watch_did_change(EventWatch&);
+    void destroy_watch(EventWatch&);
+
+    // Watches are created and destroyed under a global lock (see EventQueue.cpp),
+    // m_lock only protects the ready list and the watches' interest sets.
+    mutable SpinLock<u8> m_lock;
+    HashMap<int, NonnullOwnPtr<EventWatch>> m_watches;
+    Vector<EventWatch*> m_ready;
+};
+
+}
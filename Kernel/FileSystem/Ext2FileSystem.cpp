@@ -27,14 +27,19 @@
 #include <AK/Bitmap.h>
 #include <AK/HashMap.h>
 #include <AK/MemoryStream.h>
+#include <AK/NumericLimits.h>
+#include <AK/QuickSort.h>
 #include <AK/StdLibExtras.h>
 #include <AK/StringView.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/FileSystem/Ext2FileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/ext2_fs.h>
+#include <Kernel/KBuffer.h>
 #include <Kernel/Process.h>
 #include <Kernel/UnixTypes.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <LibC/errno_numbers.h>
 
 //#define EXT2_DEBUG
@@ -46,6 +51,11 @@ static const size_t max_link_count = 65535;
 static const size_t max_block_size = 4096;
 static const ssize_t max_inline_symlink_length = 60;
 
+// Where things live in the blocks of a hashed directory index.
+static const size_t directory_index_root_info_offset = 24;
+static const size_t directory_index_node_entries_offset = 8;
+static const u8 max_directory_index_indirect_levels = 1;
+
 struct Ext2FSDirectoryEntry {
     String name;
     InodeIdentifier inode;
@@ -71,6 +81,154 @@ static u8 to_ext2_file_type(mode_t mode)
     return EXT2_FT_UNKNOWN;
 }
 
+// The directory index hashes are shared with the other ext2/3/4 implementations,
+// so these have to match them bit for bit.
+
+static void str_to_hash_buffer(const StringView& name, size_t offset, u32* buffer, int count, bool is_unsigned)
+{
+    // The padding is derived from the length of what's left, not of the whole name.
+    u32 length = name.length() - offset;
+    u32 padding = length | (length << 8);
+    padding |= padding << 16;
+
+    size_t bytes = min((size_t)length, (size_t)count * 4);
+    u32 value = padding;
+    for (size_t i = 0; i < bytes; ++i) {
+        char ch = name[offset + i];
+        u32 c = is_unsigned ? (u32)(u8)ch : (u32)(i32)(i8)ch;
+        value = c + (value << 8);
+        if ((i % 4) == 3) {
+            *buffer++ = value;
+            value = padding;
+            --count;
+        }
+    }
+    if (--count >= 0)
+        *buffer++ = value;
+    while (--count >= 0)
+        *buffer++ = padding;
+}
+
+static u32 legacy_hash(const StringView& name, bool is_unsigned)
+{
+    u32 hash = 0;
+    u32 hash0 = 0x12a3fe2d;
+    u32 hash1 = 0x37abe8f9;
+    for (size_t i = 0; i < name.length(); ++i) {
+        u32 c = is_unsigned ? (u32)(u8)name[i] : (u32)(i32)(i8)name[i];
+        hash = hash1 + (hash0 ^ (c * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+static void tea_transform(u32* buffer, const u32* in)
+{
+    u32 sum = 0;
+    u32 b0 = buffer[0];
+    u32 b1 = buffer[1];
+    for (int n = 0; n < 16; ++n) {
+        sum += 0x9e3779b9;
+        b0 += ((b1 << 4) + in[0]) ^ (b1 + sum) ^ ((b1 >> 5) + in[1]);
+        b1 += ((b0 << 4) + in[2]) ^ (b0 + sum) ^ ((b0 >> 5) + in[3]);
+    }
+    buffer[0] += b0;
+    buffer[1] += b1;
+}
+
+static void half_md4_transform(u32* buffer, const u32* in)
+{
+    auto rotate_left = [](u32 value, int shift) { return (value << shift) | (value >> (32 - shift)); };
+    auto f = [](u32 x, u32 y, u32 z) { return z ^ (x & (y ^ z)); };
+    auto g = [](u32 x, u32 y, u32 z) { return (x & y) + ((x ^ y) & z); };
+    auto h = [](u32 x, u32 y, u32 z) { return x ^ y ^ z; };
+
+    u32 a = buffer[0];
+    u32 b = buffer[1];
+    u32 c = buffer[2];
+    u32 d = buffer[3];
+
+#define ROUND(function, a, b, c, d, x, s) (a += function(b, c, d) + (x), a = rotate_left(a, s))
+    ROUND(f, a, b, c, d, in[0], 3);
+    ROUND(f, d, a, b, c, in[1], 7);
+    ROUND(f, c, d, a, b, in[2], 11);
+    ROUND(f, b, c, d, a, in[3], 19);
+    ROUND(f, a, b, c, d, in[4], 3);
+    ROUND(f, d, a, b, c, in[5], 7);
+    ROUND(f, c, d, a, b, in[6], 11);
+    ROUND(f, b, c, d, a, in[7], 19);
+
+    ROUND(g, a, b, c, d, in[1] + 0x5a827999, 3);
+    ROUND(g, d, a, b, c, in[3] + 0x5a827999, 5);
+    ROUND(g, c, d, a, b, in[5] + 0x5a827999, 9);
+    ROUND(g, b, c, d, a, in[7] + 0x5a827999, 13);
+    ROUND(g, a, b, c, d, in[0] + 0x5a827999, 3);
+    ROUND(g, d, a, b, c, in[2] + 0x5a827999, 5);
+    ROUND(g, c, d, a, b, in[4] + 0x5a827999, 9);
+    ROUND(g, b, c, d, a, in[6] + 0x5a827999, 13);
+
+    ROUND(h, a, b, c, d, in[3] + 0x6ed9eba1, 3);
+    ROUND(h, d, a, b, c, in[7] + 0x6ed9eba1, 9);
+    ROUND(h, c, d, a, b, in[2] + 0x6ed9eba1, 11);
+    ROUND(h, b, c, d, a, in[6] + 0x6ed9eba1, 15);
+    ROUND(h, a, b, c, d, in[1] + 0x6ed9eba1, 3);
+    ROUND(h, d, a, b, c, in[5] + 0x6ed9eba1, 9);
+    ROUND(h, c, d, a, b, in[0] + 0x6ed9eba1, 11);
+    ROUND(h, b, c, d, a, in[4] + 0x6ed9eba1, 15);
+#undef ROUND
+
+    buffer[0] += a;
+    buffer[1] += b;
+    buffer[2] += c;
+    buffer[3] += d;
+}
+
+static u32 compute_directory_hash(const StringView& name, u8 hash_version, const u32* seed)
+{
+    u32 buffer[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    if (seed[0] || seed[1] || seed[2] || seed[3])
+        memcpy(buffer, seed, sizeof(buffer));
+
+    bool is_unsigned = hash_version >= EXT2_HASH_LEGACY_UNSIGNED;
+    u32 hash = 0;
+    switch (hash_version) {
+    case EXT2_HASH_LEGACY:
+    case EXT2_HASH_LEGACY_UNSIGNED:
+        hash = legacy_hash(name, is_unsigned);
+        break;
+    case EXT2_HASH_HALF_MD4:
+    case EXT2_HASH_HALF_MD4_UNSIGNED:
+        for (size_t offset = 0; offset < name.length(); offset += 32) {
+            u32 in[8];
+            str_to_hash_buffer(name, offset, in, 8, is_unsigned);
+            half_md4_transform(buffer, in);
+        }
+        hash = buffer[1];
+        break;
+    case EXT2_HASH_TEA:
+    case EXT2_HASH_TEA_UNSIGNED:
+        for (size_t offset = 0; offset < name.length(); offset += 16) {
+            u32 in[4];
+            str_to_hash_buffer(name, offset, in, 4, is_unsigned);
+            tea_transform(buffer, in);
+        }
+        hash = buffer[0];
+        break;
+    default:
+        ASSERT_NOT_REACHED();
+    }
+
+    // The lowest bit marks hash collisions that continue in the next leaf block,
+    // and the very last hash value is reserved for the end of the directory.
+    hash &= ~1u;
+    if (hash == 0xfffffffe)
+        hash = 0xfffffffc;
+    return hash;
+}
+
 NonnullRefPtr<Ext2FS> Ext2FS::create(FileDescription& file_description)
 {
     return adopt(*new Ext2FS(file_description));
@@ -228,7 +386,8 @@ Ext2FS::BlockListShape Ext2FS::compute_block_list_shape(unsigned blocks) const
     return {};
 }
 
-bool Ext2FS::write_block_list_for_inode(InodeIndex inode_index, ext2_inode& e2inode, const Vector<BlockIndex>& blocks)
+template<typename BlockList>
+bool Ext2FS::write_block_list_for_inode(InodeIndex inode_index, ext2_inode& e2inode, const BlockList& blocks)
 {
     LOCKER(m_lock);
 
@@ -546,6 +705,7 @@ void Ext2FS::free_inode(Ext2FSInode& inode)
     write_ext2_inode(inode.index(), inode.m_raw_inode);
 
     set_inode_allocation_state(inode.index(), false);
+    inode.invalidate_cached_pages(0, NumericLimits<u64>::max());
 
     if (inode.is_directory()) {
         auto& bgd = const_cast<ext2_group_desc&>(group_descriptor(group_index_from_inode(inode.index())));
@@ -564,7 +724,7 @@ void Ext2FS::flush_block_group_descriptor_table()
     write_blocks(first_block_of_bgdt, blocks_to_write, buffer);
 }
 
-void Ext2FS::flush_writes()
+void Ext2FS::flush_metadata()
 {
     LOCKER(m_lock);
     if (m_super_block_dirty) {
@@ -585,8 +745,23 @@ void Ext2FS::flush_writes()
 #endif
         }
     }
+}
 
+void Ext2FS::flush_writes()
+{
     BlockBasedFS::flush_writes();
+    uncache_unused_inodes();
+}
+
+void Ext2FS::start_writeback()
+{
+    BlockBasedFS::start_writeback();
+    uncache_unused_inodes();
+}
+
+void Ext2FS::uncache_unused_inodes()
+{
+    LOCKER(m_lock);
 
     // Uncache Inodes that are only kept alive by the index-to-inode lookup cache.
     // We don't uncache Inodes that are being watched by at least one InodeWatcher.
@@ -708,10 +883,7 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
 
     Locker fs_locker(fs().m_lock);
 
-    if (m_block_list.is_empty())
-        m_block_list = fs().block_list_for_inode(m_raw_inode);
-
-    if (m_block_list.is_empty()) {
+    if (!ensure_extents()) {
         klog() << "ext2fs: read_bytes: empty block list for inode " << index();
         return -EIO;
     }
@@ -719,11 +891,13 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
     bool allow_cache = !description || !description->is_direct();
 
     const int block_size = fs().block_size();
+    if (allow_cache && block_size <= PAGE_SIZE)
+        return read_bytes_through_page_cache(offset, count, buffer);
 
     size_t first_block_logical_index = offset / block_size;
     size_t last_block_logical_index = (offset + count) / block_size;
-    if (last_block_logical_index >= m_block_list.size())
-        last_block_logical_index = m_block_list.size() - 1;
+    if (last_block_logical_index >= block_count_in_extents())
+        last_block_logical_index = block_count_in_extents() - 1;
 
     int offset_into_first_block = offset % block_size;
 
@@ -734,24 +908,258 @@ ssize_t Ext2FSInode::read_bytes(off_t offset, ssize_t count, UserOrKernelBuffer&
     dbg() << "Ext2FS: Reading up to " << count << " bytes " << offset << " bytes into inode " << identifier() << " to " << buffer.user_or_kernel_ptr();
 #endif
 
-    for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; ++bi) {
-        auto block_index = m_block_list[bi];
+    for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index;) {
+        size_t run_length = 0;
+        auto block_index = block_at(bi, run_length);
         ASSERT(block_index);
         size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
         auto buffer_offset = buffer.offset(nread);
-        int err = fs().read_block(block_index, &buffer_offset, num_bytes_to_copy, offset_into_block, allow_cache);
+
+        // Whole blocks that are next to each other on the disk are read with a single request.
+        if (offset_into_block == 0 && num_bytes_to_copy == (size_t)block_size)
+            run_length = min(run_length, min(last_block_logical_index - bi + 1, remaining_count / block_size));
+        else
+            run_length = 1;
+
+        int err;
+        if (run_length > 1) {
+            num_bytes_to_copy = run_length * block_size;
+            err = fs().read_blocks(block_index, run_length, buffer_offset, allow_cache);
+        } else {
+            err = fs().read_block(block_index, &buffer_offset, num_bytes_to_copy, offset_into_block, allow_cache);
+        }
         if (err < 0) {
             klog() << "ext2fs: read_bytes: read_block(" << block_index << ") failed (lbi: " << bi << ")";
             return err;
         }
         remaining_count -= num_bytes_to_copy;
         nread += num_bytes_to_copy;
+        bi += run_length;
     }
 
     return nread;
 }
 
+RefPtr<PhysicalPage> Ext2FSInode::find_cached_page(size_t page_index) const
+{
+    ScopedSpinLock lock(PageCache::the().lock());
+    if (auto* entry = PageCache::the().find(identifier(), page_index))
+        return entry->page;
+    return nullptr;
+}
+
+int Ext2FSInode::read_page(size_t page_index, u8* page_data) const
+{
+    // Read the file blocks straight into the page, so they don't also end
+    // up in the filesystem's block cache.
+    const size_t block_size = fs().block_size();
+    const size_t blocks_per_page = PAGE_SIZE / block_size;
+    memset(page_data, 0, PAGE_SIZE);
+    for (size_t i = 0; i < blocks_per_page;) {
+        size_t block_logical_index = page_index * blocks_per_page + i;
+        if (block_logical_index >= block_count_in_extents())
+            break;
+        // Blocks that are next to each other on the disk are read with a single request.
+        size_t run_length = 0;
+        auto block_index = block_at(block_logical_index, run_length);
+        ASSERT(block_index);
+        run_length = min(run_length, blocks_per_page - i);
+        auto run_buffer = UserOrKernelBuffer::for_kernel_buffer(page_data + i * block_size);
+        int err = fs().read_blocks(block_index, run_length, run_buffer, false);
+        if (err < 0) {
+            klog() << "ext2fs: read_page: read_blocks(" << block_index << ", " << run_length << ") failed (lbi: " << block_logical_index << ")";
+            return err;
+        }
+        i += run_length;
+    }
+
+    // Don't let whatever is in the last block past the end of the file leak into mappings.
+    size_t page_offset = page_index * PAGE_SIZE;
+    if (page_offset + PAGE_SIZE > size())
+        memset(page_data + (size() - page_offset), 0, page_offset + PAGE_SIZE - size());
+
+    ScopedSpinLock lock(PageCache::the().lock());
+    if (PageCache::the().peek(identifier(), page_index))
+        return 0;
+    // If we can't get a page for it, we'll just read it from the disk again next time.
+    if (auto page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No)) {
+        auto& entry = PageCache::the().add(identifier(), page_index, *page);
+        PageCache::the().write_to_page(entry, 0, page_data, PAGE_SIZE);
+    }
+    return 0;
+}
+
+RefPtr<PhysicalPage> Ext2FSInode::cached_page(size_t page_index) const
+{
+    Locker inode_locker(m_lock);
+    if ((u64)page_index * PAGE_SIZE >= size() || fs().block_size() > PAGE_SIZE)
+        return nullptr;
+    if (is_symlink() && size() < max_inline_symlink_length)
+        return nullptr;
+
+    if (auto page = find_cached_page(page_index))
+        return page;
+
+    Locker fs_locker(fs().m_lock);
+    if (!ensure_extents())
+        return nullptr;
+    auto page_data = KBuffer::try_create_with_size(PAGE_SIZE, Region::Access::Read | Region::Access::Write, "Ext2FSInode page");
+    if (!page_data || read_page(page_index, page_data->data()) < 0)
+        return nullptr;
+    ScopedSpinLock lock(PageCache::the().lock());
+    // This is nullptr if there was no memory to cache the page in.
+    if (auto* entry = PageCache::the().peek(identifier(), page_index))
+        return entry->page;
+    return nullptr;
+}
+
+ssize_t Ext2FSInode::read_bytes_through_page_cache(off_t offset, ssize_t count, UserOrKernelBuffer& buffer) const
+{
+    if ((u64)offset >= size())
+        return 0;
+
+    OwnPtr<KBuffer> page_buffer;
+    ssize_t nread = 0;
+    size_t remaining_count = min((off_t)count, (off_t)size() - offset);
+
+    while (remaining_count) {
+        size_t page_index = (offset + nread) / PAGE_SIZE;
+        size_t offset_into_page = (offset + nread) % PAGE_SIZE;
+        size_t num_bytes_to_copy = min(PAGE_SIZE - offset_into_page, remaining_count);
+
+        if (auto page = find_cached_page(page_index)) {
+            // Kernel buffers get the page copied straight into them, user buffers through a small bounce buffer.
+            size_t nread_from_page = 0;
+            auto buffer_offset = buffer.offset(nread);
+            ssize_t nwritten = buffer_offset.write_buffered<512>(num_bytes_to_copy, [&](u8* data, size_t data_size) {
+                PageCache::read_from_page(*page, offset_into_page + nread_from_page, data, data_size);
+                nread_from_page += data_size;
+                return (ssize_t)data_size;
+            });
+            if (nwritten < 0)
+                return nwritten;
+        } else {
+            // Only pages that aren't cached yet have to be read into a buffer first.
+            if (!page_buffer) {
+                page_buffer = KBuffer::try_create_with_size(PAGE_SIZE, Region::Access::Read | Region::Access::Write, "Ext2FSInode page");
+                if (!page_buffer)
+                    return -ENOMEM;
+            }
+            int err = read_page(page_index, page_buffer->data());
+            if (err < 0)
+                return err;
+            if (!buffer.write(page_buffer->data() + offset_into_page, nread, num_bytes_to_copy))
+                return -EFAULT;
+        }
+        remaining_count -= num_bytes_to_copy;
+        nread += num_bytes_to_copy;
+    }
+
+    return nread;
+}
+
+void Ext2FSInode::invalidate_cached_pages(off_t offset, u64 size) const
+{
+    if (size == 0)
+        return;
+    size_t first_page_index = offset / PAGE_SIZE;
+    size_t page_count = size == NumericLimits<u64>::max() ? NumericLimits<size_t>::max() - first_page_index : (offset + size - 1) / PAGE_SIZE - first_page_index + 1;
+    ScopedSpinLock lock(PageCache::the().lock());
+    PageCache::the().invalidate(identifier(), first_page_index, page_count);
+}
+
+bool Ext2FSInode::ensure_extents() const
+{
+    if (m_extents.is_empty())
+        set_extents(fs().block_list_for_inode(m_raw_inode));
+    return !m_extents.is_empty();
+}
+
+void Ext2FSInode::set_extents(const Vector<unsigned>& block_list) const
+{
+    m_extents.clear();
+    for (auto block_index : block_list)
+        append_to_extents(block_index);
+}
+
+void Ext2FSInode::append_to_extents(unsigned block_index) const
+{
+    if (!m_extents.is_empty()) {
+        auto& last = m_extents.last();
+        bool continues_hole = !last.physical_start && !block_index;
+        bool continues_run = last.physical_start && block_index == last.physical_start + last.length;
+        if (continues_hole || continues_run) {
+            ++last.length;
+            return;
+        }
+    }
+    m_extents.append({ (unsigned)block_count_in_extents(), block_index, 1 });
+}
+
+size_t Ext2FSInode::ExtentBlockList::size() const
+{
+    if (m_extents.is_empty())
+        return 0;
+    return m_extents.last().logical_start + m_extents.last().length;
+}
+
+unsigned Ext2FSInode::ExtentBlockList::operator[](size_t logical_index) const
+{
+    ASSERT(logical_index < size());
+    if (logical_index < m_extents[m_extent_index].logical_start)
+        m_extent_index = 0;
+    while (logical_index >= m_extents[m_extent_index].logical_start + m_extents[m_extent_index].length)
+        ++m_extent_index;
+    auto& extent = m_extents[m_extent_index];
+    return extent.physical_start ? extent.physical_start + (logical_index - extent.logical_start) : 0;
+}
+
+Vector<unsigned> Ext2FSInode::block_list_from_extents() const
+{
+    Vector<unsigned> block_list;
+    block_list.ensure_capacity(block_count_in_extents());
+    for (auto& extent : m_extents) {
+        for (unsigned i = 0; i < extent.length; ++i)
+            block_list.unchecked_append(extent.physical_start ? extent.physical_start + i : 0);
+    }
+    return block_list;
+}
+
+size_t Ext2FSInode::block_count_in_extents() const
+{
+    if (m_extents.is_empty())
+        return 0;
+    return m_extents.last().logical_start + m_extents.last().length;
+}
+
+unsigned Ext2FSInode::block_at(size_t logical_index, size_t& contiguous_blocks) const
+{
+    ASSERT(logical_index < block_count_in_extents());
+    size_t low = 0;
+    size_t high = m_extents.size();
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (m_extents[middle].logical_start <= logical_index)
+            low = middle;
+        else
+            high = middle;
+    }
+    auto& extent = m_extents[low];
+    size_t offset_into_extent = logical_index - extent.logical_start;
+    contiguous_blocks = extent.length - offset_into_extent;
+    if (!extent.physical_start)
+        return 0;
+    return extent.physical_start + offset_into_extent;
+}
+
+void Ext2FSInode::discard_preallocation()
+{
+    Locker fs_locker(fs().m_lock);
+    m_preallocation_start = 0;
+    m_preallocation_count = 0;
+}
+
 KResult Ext2FSInode::resize(u64 new_size)
 {
     u64 old_size = size();
@@ -767,43 +1175,82 @@ KResult Ext2FSInode::resize(u64 new_size)
     dbg() << "Ext2FSInode::resize(): blocks needed after  (size is  " << new_size << "): " << blocks_needed_after;
 #endif
 
+    Locker fs_locker(fs().m_lock);
+
     if (blocks_needed_after > blocks_needed_before) {
         u32 additional_blocks_needed = blocks_needed_after - blocks_needed_before;
         if (additional_blocks_needed > fs().super_block().s_free_blocks_count)
             return KResult(-ENOSPC);
+
+        // Grow the extents in place rather than rebuilding them from a block list.
+        ensure_extents();
+        // Holes at the end of the file aren't in its block list on the disk.
+        if (block_count_in_extents() < blocks_needed_before) {
+            unsigned trailing_hole_length = blocks_needed_before - block_count_in_extents();
+            if (!m_extents.is_empty() && !m_extents.last().physical_start)
+                m_extents.last().length += trailing_hole_length;
+            else
+                m_extents.append({ (unsigned)block_count_in_extents(), 0, trailing_hole_length });
+        }
+
+        // Keep the file contiguous by continuing right after its current last block.
+        Ext2FS::BlockIndex goal = (!m_extents.is_empty() && m_extents.last().physical_start) ? m_extents.last().physical_start + m_extents.last().length : 0;
+        auto new_blocks = fs().allocate_blocks_for_inode(*this, goal, additional_blocks_needed, blocks_needed_after);
+        for (auto block_index : new_blocks)
+            append_to_extents(block_index);
+
+        if (!fs().write_block_list_for_inode(index(), m_raw_inode, ExtentBlockList(m_extents))) {
+            // Start over from what's on the disk next time.
+            m_extents.clear();
+            return KResult(-EIO);
+        }
+
+        m_raw_inode.i_size = new_size;
+        set_metadata_dirty(true);
+
+        // The page straddling the old end of file was zero-filled past it.
+        invalidate_cached_pages(old_size, NumericLimits<u64>::max());
+        return KSuccess;
+    }
+
+    if (blocks_needed_after == blocks_needed_before) {
+        // The block list stays the same.
+        m_raw_inode.i_size = new_size;
+        set_metadata_dirty(true);
+        invalidate_cached_pages(min(old_size, new_size), NumericLimits<u64>::max());
+        return KSuccess;
     }
 
     Vector<Ext2FS::BlockIndex> block_list;
-    if (!m_block_list.is_empty())
-        block_list = m_block_list;
+    if (!m_extents.is_empty())
+        block_list = block_list_from_extents();
     else
         block_list = fs().block_list_for_inode(m_raw_inode);
 
-    if (blocks_needed_after > blocks_needed_before) {
-        auto new_blocks = fs().allocate_blocks(fs().group_index_from_inode(index()), blocks_needed_after - blocks_needed_before);
-        block_list.append(move(new_blocks));
-    } else if (blocks_needed_after < blocks_needed_before) {
+    discard_preallocation();
 #ifdef EXT2_DEBUG
-        dbg() << "Ext2FS: Shrinking inode " << identifier() << ". Old block list is " << block_list.size() << " entries:";
-        for (auto block_index : block_list) {
-            dbg() << "    # " << block_index;
-        }
+    dbg() << "Ext2FS: Shrinking inode " << identifier() << ". Old block list is " << block_list.size() << " entries:";
+    for (auto block_index : block_list) {
+        dbg() << "    # " << block_index;
+    }
 #endif
-        while (block_list.size() != blocks_needed_after) {
-            auto block_index = block_list.take_last();
-            if (block_index)
-                fs().set_block_allocation_state(block_index, false);
-        }
+    // Holes at the end of the file aren't in its block list, so it may already be short enough.
+    while (block_list.size() > blocks_needed_after) {
+        auto block_index = block_list.take_last();
+        if (block_index)
+            fs().set_block_allocation_state(block_index, false);
     }
 
-    int err = fs().write_block_list_for_inode(index(), m_raw_inode, block_list);
-    if (err < 0)
-        return KResult(err);
+    if (!fs().write_block_list_for_inode(index(), m_raw_inode, block_list))
+        return KResult(-EIO);
 
     m_raw_inode.i_size = new_size;
     set_metadata_dirty(true);
 
-    m_block_list = move(block_list);
+    set_extents(block_list);
+
+    // The page straddling the old end of file was zero-filled past it.
+    invalidate_cached_pages(min(old_size, new_size), NumericLimits<u64>::max());
     return KSuccess;
 }
 
@@ -844,18 +1291,15 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
     if (resize_result.is_error())
         return resize_result;
 
-    if (m_block_list.is_empty())
-        m_block_list = fs().block_list_for_inode(m_raw_inode);
-
-    if (m_block_list.is_empty()) {
+    if (!ensure_extents()) {
         dbg() << "Ext2FSInode::write_bytes(): empty block list for inode " << index();
         return -EIO;
     }
 
     size_t first_block_logical_index = offset / block_size;
     size_t last_block_logical_index = (offset + count) / block_size;
-    if (last_block_logical_index >= m_block_list.size())
-        last_block_logical_index = m_block_list.size() - 1;
+    if (last_block_logical_index >= block_count_in_extents())
+        last_block_logical_index = block_count_in_extents() - 1;
 
     size_t offset_into_first_block = offset % block_size;
 
@@ -869,12 +1313,14 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
     for (size_t bi = first_block_logical_index; remaining_count && bi <= last_block_logical_index; ++bi) {
         size_t offset_into_block = (bi == first_block_logical_index) ? offset_into_first_block : 0;
         size_t num_bytes_to_copy = min(block_size - offset_into_block, remaining_count);
+        size_t contiguous_blocks = 0;
+        auto block_index = block_at(bi, contiguous_blocks);
 #ifdef EXT2_VERY_DEBUG
-        dbg() << "Ext2FS: Writing block " << m_block_list[bi] << " (offset_into_block: " << offset_into_block << ")";
+        dbg() << "Ext2FS: Writing block " << block_index << " (offset_into_block: " << offset_into_block << ")";
 #endif
-        int err = fs().write_block(m_block_list[bi], data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache);
+        int err = fs().write_block(block_index, data.offset(nwritten), num_bytes_to_copy, offset_into_block, allow_cache);
         if (err < 0) {
-            dbg() << "Ext2FS: write_block(" << m_block_list[bi] << ") failed (bi: " << bi << ")";
+            dbg() << "Ext2FS: write_block(" << block_index << ") failed (bi: " << bi << ")";
             ASSERT_NOT_REACHED();
             return err;
         }
@@ -883,9 +1329,11 @@ ssize_t Ext2FSInode::write_bytes(off_t offset, ssize_t count, const UserOrKernel
     }
 
 #ifdef EXT2_VERY_DEBUG
-    dbg() << "Ext2FS: After write, i_size=" << m_raw_inode.i_size << ", i_blocks=" << m_raw_inode.i_blocks << " (" << m_block_list.size() << " blocks in list)";
+    dbg() << "Ext2FS: After write, i_size=" << m_raw_inode.i_size << ", i_blocks=" << m_raw_inode.i_blocks << " (" << block_count_in_extents() << " blocks in " << m_extents.size() << " extents)";
 #endif
 
+    invalidate_cached_pages(offset, nwritten);
+
     if (old_size != new_size)
         inode_size_changed(old_size, new_size);
     inode_contents_changed(offset, count, data);
@@ -1001,6 +1449,523 @@ bool Ext2FSInode::write_directory(const Vector<Ext2FSDirectoryEntry>& entries)
     return static_cast<size_t>(nwritten) == directory_data.size();
 }
 
+struct HashedDirectoryEntry {
+    u32 hash { 0 };
+    String name;
+    unsigned inode { 0 };
+    u8 file_type { 0 };
+};
+
+static ext2_dir_entry_2* directory_entry_at(ByteBuffer& block, size_t offset)
+{
+    return reinterpret_cast<ext2_dir_entry_2*>(block.data() + offset);
+}
+
+// Returns false if the entries don't add up to the block.
+template<typename Callback>
+static bool for_each_entry_in_directory_block(ByteBuffer& block, Callback callback)
+{
+    for (size_t offset = 0; offset < block.size();) {
+        if (offset + 8 > block.size())
+            return false;
+        auto& entry = *directory_entry_at(block, offset);
+        if (entry.rec_len < 8 || offset + entry.rec_len > block.size() || entry.name_len + 8u > entry.rec_len)
+            return false;
+        if (callback(entry, offset) == IterationDecision::Break)
+            return true;
+        offset += entry.rec_len;
+    }
+    return true;
+}
+
+static bool insert_into_directory_block(ByteBuffer& block, const StringView& name, unsigned inode, u8 file_type)
+{
+    size_t needed = EXT2_DIR_REC_LEN(name.length());
+    ext2_dir_entry_2* new_entry = nullptr;
+    bool is_valid = for_each_entry_in_directory_block(block, [&](auto& entry, size_t offset) {
+        size_t used = entry.inode ? EXT2_DIR_REC_LEN(entry.name_len) : 0;
+        if (entry.rec_len < used + needed)
+            return IterationDecision::Continue;
+        new_entry = &entry;
+        if (used) {
+            new_entry = directory_entry_at(block, offset + used);
+            new_entry->rec_len = entry.rec_len - used;
+            entry.rec_len = used;
+        }
+        return IterationDecision::Break;
+    });
+    if (!is_valid || !new_entry)
+        return false;
+
+    new_entry->inode = inode;
+    new_entry->name_len = name.length();
+    new_entry->file_type = file_type;
+    memcpy(new_entry->name, name.characters_without_null_termination(), name.length());
+    return true;
+}
+
+static void write_entries_to_directory_block(u8* data, size_t block_size, const HashedDirectoryEntry* entries, size_t count)
+{
+    memset(data, 0, block_size);
+    if (count == 0) {
+        reinterpret_cast<ext2_dir_entry_2*>(data)->rec_len = block_size;
+        return;
+    }
+
+    size_t offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        auto& entry = *reinterpret_cast<ext2_dir_entry_2*>(data + offset);
+        size_t record_length = (i == count - 1) ? block_size - offset : EXT2_DIR_REC_LEN(entries[i].name.length());
+        ASSERT(offset + record_length <= block_size);
+        entry.inode = entries[i].inode;
+        entry.rec_len = record_length;
+        entry.name_len = entries[i].name.length();
+        entry.file_type = entries[i].file_type;
+        memcpy(entry.name, entries[i].name.characters(), entries[i].name.length());
+        offset += record_length;
+    }
+}
+
+// Index nodes pose as a single empty directory entry spanning the whole block,
+// so anything that reads the directory linearly skips right over them.
+static void write_directory_index_node_header(u8* data, size_t block_size)
+{
+    memset(data, 0, block_size);
+    reinterpret_cast<ext2_dir_entry_2*>(data)->rec_len = block_size;
+    auto& countlimit = *reinterpret_cast<ext2_dx_countlimit*>(data + directory_index_node_entries_offset);
+    countlimit.limit = (block_size - directory_index_node_entries_offset) / sizeof(ext2_dx_entry);
+    countlimit.count = 0;
+}
+
+// The hash a leaf starting at entries[index] is filed under. If that splits up a run of
+// equal hashes, the lowest bit tells lookups to carry on from the previous leaf.
+static u32 directory_leaf_start_hash(const Vector<HashedDirectoryEntry>& entries, size_t index)
+{
+    u32 hash = entries[index].hash;
+    if (index > 0 && entries[index - 1].hash == hash)
+        hash |= 1;
+    return hash;
+}
+
+void Ext2FSInode::DirectoryIndexFrame::insert_entry_after_position(u32 hash, u32 block)
+{
+    auto& countlimit = this->countlimit();
+    ASSERT(countlimit.count < countlimit.limit);
+    size_t new_position = position + 1;
+    auto* entries = this->entries();
+    memmove(&entries[new_position + 1], &entries[new_position], (countlimit.count - new_position) * sizeof(ext2_dx_entry));
+    entries[new_position].hash = hash;
+    entries[new_position].block = block;
+    ++countlimit.count;
+}
+
+bool Ext2FSInode::is_indexed_directory() const
+{
+    return is_directory() && (m_raw_inode.i_flags & EXT2_INDEX_FL) && fs().has_directory_index();
+}
+
+KResult Ext2FSInode::read_directory_block(u32 block, ByteBuffer& data) const
+{
+    const size_t block_size = fs().block_size();
+    if ((u64)(block + 1) * block_size > size())
+        return KResult(-EIO);
+    data = ByteBuffer::create_uninitialized(block_size);
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(data.data());
+    ssize_t nread = read_bytes((off_t)block * block_size, block_size, buffer, nullptr);
+    if (nread < 0)
+        return KResult(nread);
+    if ((size_t)nread != block_size)
+        return KResult(-EIO);
+    return KSuccess;
+}
+
+KResult Ext2FSInode::write_directory_block(u32 block, const ByteBuffer& data)
+{
+    const size_t block_size = fs().block_size();
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(data.data()));
+    ssize_t nwritten = write_bytes((off_t)block * block_size, block_size, buffer, nullptr);
+    if (nwritten < 0)
+        return KResult(nwritten);
+    if ((size_t)nwritten != block_size)
+        return KResult(-EIO);
+    set_metadata_dirty(true);
+    return KSuccess;
+}
+
+KResult Ext2FSInode::find_in_directory_index(const StringView& name, DirectoryIndexLookup& lookup) const
+{
+    const size_t block_size = fs().block_size();
+
+    DirectoryIndexFrame frame;
+    auto result = read_directory_block(0, frame.data);
+    if (result.is_error())
+        return result;
+
+    auto& info = *reinterpret_cast<ext2_dx_root_info*>(frame.data.data() + directory_index_root_info_offset);
+    frame.entries_offset = directory_index_root_info_offset + info.info_length;
+    if (info.reserved_zero != 0 || info.info_length < sizeof(ext2_dx_root_info) || info.indirect_levels > max_directory_index_indirect_levels
+        || info.hash_version > EXT2_HASH_TEA || frame.entries_offset + sizeof(ext2_dx_countlimit) > block_size) {
+        klog() << "ext2fs: Corrupt directory index root in inode " << index();
+        return KResult(-EIO);
+    }
+
+    lookup.hash_version = fs().directory_hash_version(info.hash_version);
+    lookup.hash = fs().directory_hash(name, lookup.hash_version);
+    size_t levels = info.indirect_levels + 1;
+
+    for (;;) {
+        auto& countlimit = frame.countlimit();
+        if (countlimit.count == 0 || countlimit.count > countlimit.limit || frame.entries_offset + countlimit.limit * sizeof(ext2_dx_entry) > block_size) {
+            klog() << "ext2fs: Corrupt directory index block " << frame.block << " in inode " << index();
+            return KResult(-EIO);
+        }
+
+        // The first entry has no hash of its own (the count and limit live there instead),
+        // and covers everything below the second one.
+        auto* entries = frame.entries();
+        size_t low = 0;
+        size_t high = countlimit.count;
+        while (high - low > 1) {
+            size_t middle = low + (high - low) / 2;
+            if (entries[middle].hash <= lookup.hash)
+                low = middle;
+            else
+                high = middle;
+        }
+        frame.position = low;
+        u32 next_block = entries[low].block;
+        lookup.frames.append(move(frame));
+
+        if (lookup.frames.size() == levels) {
+            lookup.leaf_block = next_block;
+            break;
+        }
+
+        frame = {};
+        frame.block = next_block;
+        frame.entries_offset = directory_index_node_entries_offset;
+        result = read_directory_block(next_block, frame.data);
+        if (result.is_error())
+            return result;
+    }
+
+    for (;;) {
+        result = read_directory_block(lookup.leaf_block, lookup.leaf);
+        if (result.is_error())
+            return result;
+
+        Optional<size_t> previous_entry_offset;
+        bool is_valid = for_each_entry_in_directory_block(lookup.leaf, [&](auto& entry, size_t offset) {
+            if (entry.inode && name == StringView(entry.name, entry.name_len)) {
+                lookup.entry_offset = offset;
+                lookup.previous_entry_offset = previous_entry_offset;
+                return IterationDecision::Break;
+            }
+            previous_entry_offset = offset;
+            return IterationDecision::Continue;
+        });
+        if (!is_valid) {
+            klog() << "ext2fs: Corrupt directory leaf block " << lookup.leaf_block << " in inode " << index();
+            return KResult(-EIO);
+        }
+        if (lookup.entry_offset.has_value())
+            return KSuccess;
+
+        auto advanced_or_error = advance_to_next_directory_leaf(lookup);
+        if (advanced_or_error.is_error())
+            return advanced_or_error.error();
+        if (!advanced_or_error.value())
+            return KSuccess;
+    }
+}
+
+KResultOr<bool> Ext2FSInode::advance_to_next_directory_leaf(DirectoryIndexLookup& lookup) const
+{
+    // Names with the same hash may continue in the next leaf, in which case
+    // its hash in the index only differs from ours in the lowest bit.
+    auto& frames = lookup.frames;
+    ssize_t level = frames.size() - 1;
+    while (level >= 0 && frames[level].position + 1 >= frames[level].countlimit().count)
+        --level;
+    if (level < 0)
+        return false;
+    if ((frames[level].entries()[frames[level].position + 1].hash & ~1u) != lookup.hash)
+        return false;
+
+    ++frames[level].position;
+    u32 block = frames[level].entries()[frames[level].position].block;
+    for (size_t i = level + 1; i < frames.size(); ++i) {
+        auto result = read_directory_block(block, frames[i].data);
+        if (result.is_error())
+            return result;
+        frames[i].block = block;
+        frames[i].position = 0;
+        if (frames[i].countlimit().count == 0)
+            return KResult(-EIO);
+        block = frames[i].entries()[0].block;
+    }
+    lookup.leaf_block = block;
+    return true;
+}
+
+KResult Ext2FSInode::add_to_directory_index(DirectoryIndexLookup& lookup, const StringView& name, unsigned inode, u8 file_type)
+{
+    if (insert_into_directory_block(lookup.leaf, name, inode, file_type))
+        return write_directory_block(lookup.leaf_block, lookup.leaf);
+
+    // The leaf is full, so the upper half of it (by hash) moves to a new block.
+    auto result = make_room_in_directory_index(lookup.frames);
+    if (result.is_error())
+        return result;
+
+    Vector<HashedDirectoryEntry> entries;
+    bool is_valid = for_each_entry_in_directory_block(lookup.leaf, [&](auto& entry, size_t) {
+        if (entry.inode) {
+            StringView entry_name(entry.name, entry.name_len);
+            entries.append({ fs().directory_hash(entry_name, lookup.hash_version), entry_name, entry.inode, entry.file_type });
+        }
+        return IterationDecision::Continue;
+    });
+    if (!is_valid)
+        return KResult(-EIO);
+    entries.append({ lookup.hash, name, inode, file_type });
+    quick_sort(entries, [](auto& a, auto& b) { return a.hash < b.hash; });
+
+    size_t total_size = 0;
+    for (auto& entry : entries)
+        total_size += EXT2_DIR_REC_LEN(entry.name.length());
+    size_t split = 0;
+    for (size_t lower_size = 0; split < entries.size() - 1 && lower_size < total_size / 2; ++split)
+        lower_size += EXT2_DIR_REC_LEN(entries[split].name.length());
+    split = max(split, (size_t)1);
+
+    const size_t block_size = fs().block_size();
+    u32 new_block = size() / block_size;
+    auto lower = ByteBuffer::create_uninitialized(block_size);
+    auto upper = ByteBuffer::create_uninitialized(block_size);
+    write_entries_to_directory_block(lower.data(), block_size, entries.data(), split);
+    write_entries_to_directory_block(upper.data(), block_size, entries.data() + split, entries.size() - split);
+
+    result = write_directory_block(new_block, upper);
+    if (result.is_error())
+        return result;
+    result = write_directory_block(lookup.leaf_block, lower);
+    if (result.is_error())
+        return result;
+
+    auto& parent = lookup.frames.last();
+    parent.insert_entry_after_position(directory_leaf_start_hash(entries, split), new_block);
+    return write_directory_block(parent.block, parent.data);
+}
+
+KResult Ext2FSInode::make_room_in_directory_index(Vector<DirectoryIndexFrame, 3>& frames)
+{
+    const size_t block_size = fs().block_size();
+    if (frames.last().countlimit().count < frames.last().countlimit().limit)
+        return KSuccess;
+
+    if (frames.size() == 1) {
+        // The root is full, so everything in it moves down into a new node, and the tree grows a level.
+        auto& root = frames[0];
+        DirectoryIndexFrame node;
+        node.block = size() / block_size;
+        node.data = ByteBuffer::create_uninitialized(block_size);
+        node.entries_offset = directory_index_node_entries_offset;
+        node.position = root.position;
+        write_directory_index_node_header(node.data.data(), block_size);
+        u16 node_limit = node.countlimit().limit;
+        u16 count = root.countlimit().count;
+        memcpy(node.entries(), root.entries(), count * sizeof(ext2_dx_entry));
+        node.countlimit().limit = node_limit;
+        node.countlimit().count = count;
+
+        root.countlimit().count = 1;
+        root.entries()[0].block = node.block;
+        root.position = 0;
+        auto& info = *reinterpret_cast<ext2_dx_root_info*>(root.data.data() + directory_index_root_info_offset);
+        ++info.indirect_levels;
+
+        auto result = write_directory_block(node.block, node.data);
+        if (result.is_error())
+            return result;
+        result = write_directory_block(root.block, root.data);
+        if (result.is_error())
+            return result;
+        frames.append(move(node));
+        return KSuccess;
+    }
+
+    // A full node is split in half, which needs room in its parent. We don't grow the tree any
+    // deeper than this, as ext3 doesn't either, and it's big enough for millions of names anyway.
+    auto& frame = frames.last();
+    auto& parent = frames[frames.size() - 2];
+    if (parent.countlimit().count >= parent.countlimit().limit) {
+        dbg() << "Ext2FS: Directory index of inode " << index() << " is full";
+        return KResult(-ENOSPC);
+    }
+
+    u16 count = frame.countlimit().count;
+    u16 split = count / 2;
+    u32 split_hash = frame.entries()[split].hash;
+
+    DirectoryIndexFrame new_node;
+    new_node.block = size() / block_size;
+    new_node.data = ByteBuffer::create_uninitialized(block_size);
+    new_node.entries_offset = directory_index_node_entries_offset;
+    write_directory_index_node_header(new_node.data.data(), block_size);
+    u16 node_limit = new_node.countlimit().limit;
+    memcpy(new_node.entries(), frame.entries() + split, (count - split) * sizeof(ext2_dx_entry));
+    new_node.countlimit().limit = node_limit;
+    new_node.countlimit().count = count - split;
+    frame.countlimit().count = split;
+    parent.insert_entry_after_position(split_hash, new_node.block);
+
+    auto result = write_directory_block(new_node.block, new_node.data);
+    if (result.is_error())
+        return result;
+    result = write_directory_block(frame.block, frame.data);
+    if (result.is_error())
+        return result;
+    result = write_directory_block(parent.block, parent.data);
+    if (result.is_error())
+        return result;
+
+    if (frame.position >= split) {
+        new_node.position = frame.position - split;
+        ++parent.position;
+        frame = move(new_node);
+    }
+    return KSuccess;
+}
+
+KResult Ext2FSInode::write_indexed_directory(const Vector<Ext2FSDirectoryEntry>& entries)
+{
+    const size_t block_size = fs().block_size();
+    u8 hash_version = fs().super_block().s_def_hash_version;
+    if (hash_version > EXT2_HASH_TEA)
+        hash_version = EXT2_HASH_HALF_MD4;
+    u8 effective_hash_version = fs().directory_hash_version(hash_version);
+
+    Optional<unsigned> parent_index;
+    Vector<HashedDirectoryEntry> hashed_entries;
+    for (auto& entry : entries) {
+        if (entry.name == ".")
+            continue;
+        if (entry.name == "..") {
+            parent_index = entry.inode.index();
+            continue;
+        }
+        hashed_entries.append({ fs().directory_hash(entry.name, effective_hash_version), entry.name, entry.inode.index(), entry.file_type });
+    }
+    if (!parent_index.has_value())
+        return KResult(-EINVAL);
+    quick_sort(hashed_entries, [](auto& a, auto& b) { return a.hash < b.hash; });
+
+    // Leave some room in each leaf, so the next few names don't immediately split it.
+    struct Leaf {
+        size_t first_entry { 0 };
+        size_t entry_count { 0 };
+        u32 hash { 0 };
+    };
+    Vector<Leaf> leaves;
+    leaves.append(Leaf {});
+    size_t bytes_in_leaf = 0;
+    for (size_t i = 0; i < hashed_entries.size(); ++i) {
+        size_t record_length = EXT2_DIR_REC_LEN(hashed_entries[i].name.length());
+        if (leaves.last().entry_count && bytes_in_leaf + record_length > block_size * 3 / 4) {
+            leaves.append({ i, 0, directory_leaf_start_hash(hashed_entries, i) });
+            bytes_in_leaf = 0;
+        }
+        ++leaves.last().entry_count;
+        bytes_in_leaf += record_length;
+    }
+
+    size_t root_limit = (block_size - directory_index_root_info_offset - sizeof(ext2_dx_root_info)) / sizeof(ext2_dx_entry);
+    size_t node_limit = (block_size - directory_index_node_entries_offset) / sizeof(ext2_dx_entry);
+    size_t node_count = 0;
+    if (leaves.size() > root_limit) {
+        node_count = ceil_div(leaves.size(), node_limit);
+        if (node_count > root_limit)
+            return KResult(-ENOSPC);
+    }
+
+    size_t first_leaf_block = 1 + node_count;
+    auto directory_data = ByteBuffer::create_zeroed((first_leaf_block + leaves.size()) * block_size);
+
+    // The root starts out with "." and "..", the latter of which covers the rest of the block.
+    u8* root = directory_data.data();
+    auto& dot = *reinterpret_cast<ext2_dir_entry_2*>(root);
+    dot.inode = index();
+    dot.rec_len = 12;
+    dot.name_len = 1;
+    dot.file_type = EXT2_FT_DIR;
+    dot.name[0] = '.';
+    auto& dot_dot = *reinterpret_cast<ext2_dir_entry_2*>(root + 12);
+    dot_dot.inode = parent_index.value();
+    dot_dot.rec_len = block_size - 12;
+    dot_dot.name_len = 2;
+    dot_dot.file_type = EXT2_FT_DIR;
+    dot_dot.name[0] = '.';
+    dot_dot.name[1] = '.';
+    auto& info = *reinterpret_cast<ext2_dx_root_info*>(root + directory_index_root_info_offset);
+    info.hash_version = hash_version;
+    info.info_length = sizeof(ext2_dx_root_info);
+    info.indirect_levels = node_count ? 1 : 0;
+
+    size_t root_entries_offset = directory_index_root_info_offset + sizeof(ext2_dx_root_info);
+    auto* root_entries = reinterpret_cast<ext2_dx_entry*>(root + root_entries_offset);
+    auto set_index_entry = [](ext2_dx_entry* index_entries, size_t i, u32 hash, u32 block) {
+        // The first entry's hash is where the count and limit live.
+        if (i)
+            index_entries[i].hash = hash;
+        index_entries[i].block = block;
+    };
+
+    if (!node_count) {
+        for (size_t i = 0; i < leaves.size(); ++i)
+            set_index_entry(root_entries, i, leaves[i].hash, first_leaf_block + i);
+        auto& countlimit = *reinterpret_cast<ext2_dx_countlimit*>(root_entries);
+        countlimit.limit = root_limit;
+        countlimit.count = leaves.size();
+    } else {
+        for (size_t node = 0; node < node_count; ++node) {
+            u8* node_data = directory_data.data() + (1 + node) * block_size;
+            write_directory_index_node_header(node_data, block_size);
+            auto* node_entries = reinterpret_cast<ext2_dx_entry*>(node_data + directory_index_node_entries_offset);
+            size_t first_leaf = node * node_limit;
+            size_t leaf_count = min(node_limit, leaves.size() - first_leaf);
+            for (size_t i = 0; i < leaf_count; ++i)
+                set_index_entry(node_entries, i, leaves[first_leaf + i].hash, first_leaf_block + first_leaf + i);
+            reinterpret_cast<ext2_dx_countlimit*>(node_entries)->count = leaf_count;
+            set_index_entry(root_entries, node, leaves[first_leaf].hash, 1 + node);
+        }
+        auto& countlimit = *reinterpret_cast<ext2_dx_countlimit*>(root_entries);
+        countlimit.limit = root_limit;
+        countlimit.count = node_count;
+    }
+
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        u8* leaf_data = directory_data.data() + (first_leaf_block + i) * block_size;
+        write_entries_to_directory_block(leaf_data, block_size, hashed_entries.data() + leaves[i].first_entry, leaves[i].entry_count);
+    }
+
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(directory_data.data());
+    ssize_t nwritten = write_bytes(0, directory_data.size(), buffer, nullptr);
+    if (nwritten < 0)
+        return KResult(nwritten);
+    if ((size_t)nwritten != directory_data.size())
+        return KResult(-EIO);
+    if (size() > directory_data.size()) {
+        auto result = resize(directory_data.size());
+        if (result.is_error())
+            return result;
+    }
+
+    m_raw_inode.i_flags |= EXT2_INDEX_FL;
+    set_metadata_dirty(true);
+    return KSuccess;
+}
+
 KResultOr<NonnullRefPtr<Inode>> Ext2FSInode::create_child(const String& name, mode_t mode, dev_t dev, uid_t uid, gid_t gid)
 {
     if (mode & S_IFDIR)
@@ -1020,6 +1985,32 @@ KResult Ext2FSInode::add_child(Inode& child, const StringView& name, mode_t mode
     dbg() << "Ext2FSInode::add_child(): Adding inode " << child.index() << " with name '" << name << "' and mode " << mode << " to directory " << index();
 #endif
 
+    if (is_indexed_directory()) {
+        DirectoryIndexLookup lookup;
+        auto result = find_in_directory_index(name, lookup);
+        if (result.is_error())
+            return result;
+        if (lookup.entry_offset.has_value()) {
+            dbg() << "Ext2FSInode::add_child(): Name '" << name << "' already exists in inode " << index();
+            return KResult(-EEXIST);
+        }
+
+        result = child.increment_link_count();
+        if (result.is_error())
+            return result;
+
+        result = add_to_directory_index(lookup, name, child.index(), to_ext2_file_type(mode));
+        if (result.is_error()) {
+            (void)child.decrement_link_count();
+            return result;
+        }
+        if (!m_lookup_cache.is_empty())
+            m_lookup_cache.set(name, child.index());
+
+        did_add_child(child.identifier(), name);
+        return KSuccess;
+    }
+
     Vector<Ext2FSDirectoryEntry> entries;
     bool name_already_exists = false;
     KResult result = traverse_as_directory([&](auto& entry) {
@@ -1044,11 +2035,21 @@ KResult Ext2FSInode::add_child(Inode& child, const StringView& name, mode_t mode
         return result;
 
     entries.empend(name, child.identifier(), to_ext2_file_type(mode));
-    bool success = write_directory(entries);
+
+    size_t directory_size = 0;
+    for (auto& entry : entries)
+        directory_size += EXT2_DIR_REC_LEN(entry.name.length());
+
+    // Once a directory outgrows its first block, it's worth switching it over to a hashed index.
+    bool success;
+    if (fs().has_directory_index() && directory_size > fs().block_size() && write_indexed_directory(entries).is_success())
+        success = true;
+    else
+        success = write_directory(entries);
     if (success)
         m_lookup_cache.set(name, child.index());
 
-    did_add_child(child.identifier());
+    did_add_child(child.identifier(), name);
     return KSuccess;
 }
 
@@ -1060,30 +2061,52 @@ KResult Ext2FSInode::remove_child(const StringView& name)
 #endif
     ASSERT(is_directory());
 
-    auto it = m_lookup_cache.find(name);
-    if (it == m_lookup_cache.end())
-        return KResult(-ENOENT);
-    auto child_inode_index = (*it).value;
-
-    InodeIdentifier child_id { fsid(), child_inode_index };
+    InodeIdentifier child_id;
+    KResult result = KSuccess;
+
+    if (is_indexed_directory()) {
+        // Only the leaf block holding the name needs to change.
+        DirectoryIndexLookup lookup;
+        result = find_in_directory_index(name, lookup);
+        if (result.is_error())
+            return result;
+        if (!lookup.entry_offset.has_value())
+            return KResult(-ENOENT);
+
+        auto* entry = directory_entry_at(lookup.leaf, lookup.entry_offset.value());
+        child_id = { fsid(), entry->inode };
+        if (lookup.previous_entry_offset.has_value())
+            directory_entry_at(lookup.leaf, lookup.previous_entry_offset.value())->rec_len += entry->rec_len;
+        else
+            entry->inode = 0;
+
+        result = write_directory_block(lookup.leaf_block, lookup.leaf);
+        if (result.is_error())
+            return result;
+    } else {
+        auto it = m_lookup_cache.find(name);
+        if (it == m_lookup_cache.end())
+            return KResult(-ENOENT);
+        child_id = { fsid(), (*it).value };
 
 #ifdef EXT2_DEBUG
-    dbg() << "Ext2FSInode::remove_child(): Removing '" << name << "' in directory " << index();
+        dbg() << "Ext2FSInode::remove_child(): Removing '" << name << "' in directory " << index();
 #endif
 
-    Vector<Ext2FSDirectoryEntry> entries;
-    KResult result = traverse_as_directory([&](auto& entry) {
-        if (name != entry.name)
-            entries.append({ entry.name, entry.inode, entry.file_type });
-        return true;
-    });
-    if (result.is_error())
-        return result;
+        Vector<Ext2FSDirectoryEntry> entries;
+        result = traverse_as_directory([&](auto& entry) {
+            if (name != entry.name)
+                entries.append({ entry.name, entry.inode, entry.file_type });
+            return true;
+        });
+        if (result.is_error())
+            return result;
 
-    bool success = write_directory(entries);
-    if (!success) {
-        // FIXME: Plumb error from write_directory().
-        return KResult(-EIO);
+        bool success = write_directory(entries);
+        if (!success) {
+            // FIXME: Plumb error from write_directory().
+            return KResult(-EIO);
+        }
     }
 
     m_lookup_cache.remove(name);
@@ -1093,10 +2116,28 @@ KResult Ext2FSInode::remove_child(const StringView& name)
     if (result.is_error())
         return result;
 
-    did_remove_child(child_id);
+    did_remove_child(child_id, name);
     return KSuccess;
 }
 
+bool Ext2FS::has_directory_index() const
+{
+    return super_block().s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX;
+}
+
+u8 Ext2FS::directory_hash_version(u8 hash_version) const
+{
+    // The index root doesn't say whether names were hashed as signed or unsigned chars, the superblock does.
+    if (hash_version <= EXT2_HASH_TEA && (super_block().s_flags & EXT2_FLAGS_UNSIGNED_HASH))
+        return hash_version + EXT2_HASH_LEGACY_UNSIGNED;
+    return hash_version;
+}
+
+u32 Ext2FS::directory_hash(const StringView& name, u8 hash_version) const
+{
+    return compute_directory_hash(name, hash_version, super_block().s_hash_seed);
+}
+
 unsigned Ext2FS::inodes_per_block() const
 {
     return EXT2_INODES_PER_BLOCK(&super_block());
@@ -1173,7 +2214,14 @@ Vector<Ext2FS::BlockIndex> Ext2FS::allocate_blocks(GroupIndex preferred_group_in
 
         BlockIndex first_block_in_group = (group_index - 1) * blocks_per_group() + first_block_index();
         size_t free_region_size = 0;
-        auto first_unset_bit_index = block_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
+        // Stay out of the blocks files have set aside for their appends, unless they're all that's left.
+        Optional<size_t> first_unset_bit_index;
+        auto unreserved_bitmap_data = ByteBuffer::copy(cached_bitmap.buffer.data(), cached_bitmap.buffer.size());
+        auto unreserved_bitmap = Bitmap::wrap(unreserved_bitmap_data.data(), blocks_in_group);
+        if (mark_reserved_blocks(group_index, unreserved_bitmap))
+            first_unset_bit_index = unreserved_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
+        if (!first_unset_bit_index.has_value())
+            first_unset_bit_index = block_bitmap.find_longest_range_of_unset_bits(count - blocks.size(), free_region_size);
         ASSERT(first_unset_bit_index.has_value());
 #ifdef EXT2_DEBUG
         dbg() << "Ext2FS: allocating free region of size: " << free_region_size << "[" << group_index << "]";
@@ -1192,6 +2240,124 @@ Vector<Ext2FS::BlockIndex> Ext2FS::allocate_blocks(GroupIndex preferred_group_in
     return blocks;
 }
 
+Vector<Ext2FS::BlockIndex> Ext2FS::allocate_blocks_for_inode(Ext2FSInode& inode, BlockIndex goal, size_t count, size_t blocks_in_file)
+{
+    LOCKER(m_lock);
+    if (count == 0)
+        return {};
+
+    // The window is only useful while it continues the file.
+    if (inode.m_preallocation_count && inode.m_preallocation_start != goal)
+        inode.discard_preallocation();
+
+    Vector<BlockIndex> blocks;
+    blocks.ensure_capacity(count);
+
+    // Our window, if we have one, starts right at the goal, so this is where it gets used.
+    if (goal) {
+        size_t allocated = allocate_blocks_at(goal, count, &inode);
+        for (size_t i = 0; i < allocated; ++i)
+            blocks.unchecked_append(goal + i);
+    }
+
+    if (inode.m_preallocation_count) {
+        if (blocks.size() < min(count, inode.m_preallocation_count)) {
+            // Someone else got to the blocks in our window first.
+            inode.discard_preallocation();
+        } else {
+            size_t blocks_from_window = min(blocks.size(), inode.m_preallocation_count);
+            inode.m_preallocation_start += blocks_from_window;
+            inode.m_preallocation_count -= blocks_from_window;
+        }
+    }
+
+    if (blocks.size() < count) {
+        GroupIndex group_index = blocks.is_empty() ? group_index_from_inode(inode.index()) : group_index_from_block_index(blocks.last());
+        blocks.append(allocate_blocks(group_index, count - blocks.size()));
+    }
+
+    if (!is_regular_file(inode.m_raw_inode.i_mode) || inode.m_preallocation_count)
+        return blocks;
+
+    // Set aside the blocks after the new end of the file, so the next appends continue it
+    // instead of landing wherever the first free blocks are. The window grows along with
+    // the file, but we never hold on to more than half of what's left.
+    size_t window_size = min(blocks_in_file, max_preallocation_size / block_size());
+    window_size = min(window_size, (size_t)super_block().s_free_blocks_count / 2);
+    inode.m_preallocation_start = blocks.last() + 1;
+    inode.m_preallocation_count = free_run_length_at(inode.m_preallocation_start, window_size, &inode);
+#ifdef EXT2_DEBUG
+    dbg() << "Ext2FS: Reserved " << inode.m_preallocation_count << " block(s) at " << inode.m_preallocation_start << " for inode " << inode.index();
+#endif
+    return blocks;
+}
+
+size_t Ext2FS::free_run_length_at(BlockIndex first_block, size_t max_count, const Ext2FSInode* owner)
+{
+    LOCKER(m_lock);
+    if (first_block < first_block_index() || first_block >= super_block().s_blocks_count)
+        return 0;
+
+    // Don't run into the windows other files have set aside.
+    for (auto& it : m_inode_cache) {
+        auto* inode = it.value.ptr();
+        if (!inode || inode == owner || !inode->m_preallocation_count)
+            continue;
+        BlockIndex window_start = inode->m_preallocation_start;
+        if (window_start + inode->m_preallocation_count <= first_block || window_start >= first_block + max_count)
+            continue;
+        if (window_start <= first_block)
+            return 0;
+        max_count = window_start - first_block;
+    }
+
+    GroupIndex group_index = group_index_from_block_index(first_block);
+    auto& cached_bitmap = get_bitmap_block(group_descriptor(group_index).bg_block_bitmap);
+    auto block_bitmap = cached_bitmap.bitmap(blocks_per_group());
+    BlockIndex first_block_in_group = (group_index - 1) * blocks_per_group() + first_block_index();
+
+    size_t count = 0;
+    for (; count < max_count; ++count) {
+        BlockIndex block_index = first_block + count;
+        // The next group has its own bitmap, so we stop at the end of this one.
+        if (block_index >= super_block().s_blocks_count || group_index_from_block_index(block_index) != group_index)
+            break;
+        size_t bit_index = block_index - first_block_in_group;
+        if (bit_index >= blocks_per_group() || block_bitmap.get(bit_index))
+            break;
+    }
+    return count;
+}
+
+size_t Ext2FS::allocate_blocks_at(BlockIndex first_block, size_t max_count, const Ext2FSInode* owner)
+{
+    LOCKER(m_lock);
+    size_t count = free_run_length_at(first_block, max_count, owner);
+    for (size_t i = 0; i < count; ++i)
+        set_block_allocation_state(first_block + i, true);
+    return count;
+}
+
+bool Ext2FS::mark_reserved_blocks(GroupIndex group_index, Bitmap& block_bitmap) const
+{
+    LOCKER(m_lock);
+    BlockIndex first_block_in_group = (group_index - 1) * blocks_per_group() + first_block_index();
+    BlockIndex end_of_group = first_block_in_group + block_bitmap.size();
+    bool marked_any = false;
+    for (auto& it : m_inode_cache) {
+        auto* inode = it.value.ptr();
+        if (!inode || !inode->m_preallocation_count)
+            continue;
+        BlockIndex start = max(inode->m_preallocation_start, first_block_in_group);
+        BlockIndex end = min(inode->m_preallocation_start + (BlockIndex)inode->m_preallocation_count, end_of_group);
+        for (BlockIndex block_index = start; block_index < end; ++block_index) {
+            block_bitmap.set(block_index - first_block_in_group, true);
+            marked_any = true;
+        }
+    }
+    return marked_any;
+}
+
 unsigned Ext2FS::find_a_free_inode(GroupIndex preferred_group, off_t expected_size)
 {
     ASSERT(expected_size >= 0);
@@ -1529,7 +2695,7 @@ KResultOr<NonnullRefPtr<Inode>> Ext2FS::create_inode(InodeIdentifier parent_id,
 
     auto inode = get_inode({ fsid(), inode_id });
     // If we've already computed a block list, no sense in throwing it away.
-    static_cast<Ext2FSInode&>(*inode).m_block_list = move(blocks);
+    static_cast<Ext2FSInode&>(*inode).set_extents(blocks);
 
     auto result = parent_inode->add_child(*inode, name, mode);
     ASSERT(result.is_success());
@@ -1559,6 +2725,18 @@ void Ext2FSInode::populate_lookup_cache() const
 RefPtr<Inode> Ext2FSInode::lookup(StringView name)
 {
     ASSERT(is_directory());
+    {
+        LOCKER(m_lock);
+        // Indexed directories can be huge, so we go through the index instead of caching every name.
+        if (m_lookup_cache.is_empty() && is_indexed_directory()) {
+            DirectoryIndexLookup lookup;
+            if (find_in_directory_index(name, lookup).is_success()) {
+                if (!lookup.entry_offset.has_value())
+                    return {};
+                return fs().get_inode({ fsid(), directory_entry_at(lookup.leaf, lookup.entry_offset.value())->inode });
+            }
+        }
+    }
     populate_lookup_cache();
     LOCKER(m_lock);
     auto it = m_lookup_cache.find(name.hash(), [&](auto& entry) { return entry.key == name; });
@@ -1637,6 +2815,16 @@ KResultOr<size_t> Ext2FSInode::directory_entry_count() const
 {
     ASSERT(is_directory());
     LOCKER(m_lock);
+    if (m_lookup_cache.is_empty() && is_indexed_directory()) {
+        size_t count = 0;
+        auto result = traverse_as_directory([&](auto&) {
+            ++count;
+            return true;
+        });
+        if (result.is_error())
+            return result;
+        return count;
+    }
     populate_lookup_cache();
     return m_lookup_cache.size();
 }
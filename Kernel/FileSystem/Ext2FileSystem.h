@@ -27,7 +27,9 @@
 #pragma once
 
 #include <AK/Bitmap.h>
+#include <AK/ByteBuffer.h>
 #include <AK/HashMap.h>
+#include <AK/Optional.h>
 #include <Kernel/FileSystem/BlockBasedFileSystem.h>
 #include <Kernel/FileSystem/Inode.h>
 #include <Kernel/FileSystem/ext2_fs.h>
@@ -59,6 +61,7 @@ public:
 private:
     // ^Inode
     virtual ssize_t read_bytes(off_t, ssize_t, UserOrKernelBuffer& buffer, FileDescription*) const override;
+    virtual RefPtr<PhysicalPage> cached_page(size_t page_index) const override;
     virtual InodeMetadata metadata() const override;
     virtual KResult traverse_as_directory(Function<bool(const FS::DirectoryEntryView&)>) const override;
     virtual RefPtr<Inode> lookup(StringView name) override;
@@ -79,17 +82,93 @@ private:
 
     bool write_directory(const Vector<Ext2FSDirectoryEntry>&);
     void populate_lookup_cache() const;
+
+    // One block of a hashed directory index (the root, or a node below it) on the way to a leaf.
+    struct DirectoryIndexFrame {
+        u32 block { 0 };
+        ByteBuffer data;
+        size_t entries_offset { 0 };
+        size_t position { 0 };
+
+        ext2_dx_countlimit& countlimit() { return *reinterpret_cast<ext2_dx_countlimit*>(data.data() + entries_offset); }
+        ext2_dx_entry* entries() { return reinterpret_cast<ext2_dx_entry*>(data.data() + entries_offset); }
+        void insert_entry_after_position(u32 hash, u32 block);
+    };
+
+    struct DirectoryIndexLookup {
+        Vector<DirectoryIndexFrame, 3> frames;
+        u8 hash_version { 0 };
+        u32 hash { 0 };
+        u32 leaf_block { 0 };
+        ByteBuffer leaf;
+        Optional<size_t> entry_offset;
+        Optional<size_t> previous_entry_offset;
+    };
+
+    bool is_indexed_directory() const;
+    KResult read_directory_block(u32 block, ByteBuffer&) const;
+    KResult write_directory_block(u32 block, const ByteBuffer&);
+    KResult find_in_directory_index(const StringView& name, DirectoryIndexLookup&) const;
+    KResultOr<bool> advance_to_next_directory_leaf(DirectoryIndexLookup&) const;
+    KResult add_to_directory_index(DirectoryIndexLookup&, const StringView& name, unsigned inode, u8 file_type);
+    KResult make_room_in_directory_index(Vector<DirectoryIndexFrame, 3>&);
+    KResult write_indexed_directory(const Vector<Ext2FSDirectoryEntry>&);
     KResult resize(u64);
 
+    ssize_t read_bytes_through_page_cache(off_t, ssize_t, UserOrKernelBuffer& buffer) const;
+    RefPtr<PhysicalPage> find_cached_page(size_t page_index) const;
+    int read_page(size_t page_index, u8* page_data) const;
+    void invalidate_cached_pages(off_t offset, u64 size) const;
+
+    // A run of blocks that are next to each other both in the file and on the disk.
+    // Holes are runs with a physical_start of 0.
+    struct Extent {
+        unsigned logical_start { 0 };
+        unsigned physical_start { 0 };
+        unsigned length { 0 };
+    };
+
+    // Looks up the file's blocks by logical index straight from its extents, without
+    // flattening them into a list first. Going through them in order is cheap.
+    class ExtentBlockList {
+    public:
+        explicit ExtentBlockList(const Vector<Extent>& extents)
+            : m_extents(extents)
+        {
+        }
+
+        size_t size() const;
+        bool is_empty() const { return m_extents.is_empty(); }
+        unsigned operator[](size_t logical_index) const;
+
+    private:
+        const Vector<Extent>& m_extents;
+        mutable size_t m_extent_index { 0 };
+    };
+
+    bool ensure_extents() const;
+    void set_extents(const Vector<unsigned>& block_list) const;
+    void append_to_extents(unsigned block_index) const;
+    Vector<unsigned> block_list_from_extents() const;
+    size_t block_count_in_extents() const;
+    unsigned block_at(size_t logical_index, size_t& contiguous_blocks) const;
+    void discard_preallocation();
+
     static u8 file_type_for_directory_entry(const ext2_dir_entry_2&);
 
     Ext2FS& fs();
     const Ext2FS& fs() const;
     Ext2FSInode(Ext2FS&, unsigned index);
 
-    mutable Vector<unsigned> m_block_list;
+    mutable Vector<Extent> m_extents;
     mutable HashMap<String, unsigned> m_lookup_cache;
     ext2_inode m_raw_inode;
+
+    // Free blocks following the end of the file that are set aside for upcoming appends.
+    // This is only a reservation in memory: the blocks stay free on the disk until they
+    // are allocated, and other files' allocations steer clear of them while they can.
+    unsigned m_preallocation_start { 0 };
+    size_t m_preallocation_count { 0 };
 };
 
 class Ext2FS final : public BlockBasedFS {
@@ -109,6 +188,7 @@ public:
     virtual KResult prepare_to_unmount() const override;
 
     virtual bool supports_watchers() const override { return true; }
+    virtual bool supports_dentry_cache() const override { return true; }
 
     virtual u8 internal_file_type_to_directory_entry_type(const DirectoryEntryView& entry) const override;
 
@@ -133,22 +213,34 @@ private:
 
     bool flush_super_block();
 
+    bool has_directory_index() const;
+    u8 directory_hash_version(u8 hash_version) const;
+    u32 directory_hash(const StringView& name, u8 hash_version) const;
+
     virtual const char* class_name() const override;
     virtual NonnullRefPtr<Inode> root_inode() const override;
     RefPtr<Inode> get_inode(InodeIdentifier) const;
     KResultOr<NonnullRefPtr<Inode>> create_inode(InodeIdentifier parent_id, const String& name, mode_t, off_t size, dev_t, uid_t, gid_t);
     KResult create_directory(InodeIdentifier parent_inode, const String& name, mode_t, uid_t, gid_t);
     virtual void flush_writes() override;
+    virtual void start_writeback() override;
+    virtual void flush_metadata() override;
+    void uncache_unused_inodes();
 
     BlockIndex first_block_index() const;
     InodeIndex find_a_free_inode(GroupIndex preferred_group, off_t expected_size);
     Vector<BlockIndex> allocate_blocks(GroupIndex preferred_group_index, size_t count);
+    Vector<BlockIndex> allocate_blocks_for_inode(Ext2FSInode&, BlockIndex goal, size_t count, size_t blocks_in_file);
+    size_t allocate_blocks_at(BlockIndex first_block, size_t max_count, const Ext2FSInode* owner);
+    size_t free_run_length_at(BlockIndex first_block, size_t max_count, const Ext2FSInode* owner);
+    bool mark_reserved_blocks(GroupIndex, Bitmap&) const;
     GroupIndex group_index_from_inode(InodeIndex) const;
     GroupIndex group_index_from_block_index(BlockIndex) const;
 
     Vector<BlockIndex> block_list_for_inode_impl(const ext2_inode&, bool include_block_list_blocks = false) const;
     Vector<BlockIndex> block_list_for_inode(const ext2_inode&, bool include_block_list_blocks = false) const;
-    bool write_block_list_for_inode(InodeIndex, ext2_inode&, const Vector<BlockIndex>&);
+    template<typename BlockList>
+    bool write_block_list_for_inode(InodeIndex, ext2_inode&, const BlockList&);
 
     bool get_inode_allocation_state(InodeIndex) const;
     bool set_inode_allocation_state(InodeIndex, bool);
@@ -167,6 +259,8 @@ private:
 
     BlockListShape compute_block_list_shape(unsigned blocks) const;
 
+    static constexpr size_t max_preallocation_size = 1 * MiB;
+
     unsigned m_block_group_count { 0 };
 
     mutable ext2_super_block m_super_block;
@@ -170,6 +170,20 @@ KResultOr<size_t> FIFO::write(FileDescription&, size_t, const UserOrKernelBuffer
     return m_buffer.write(buffer, size);
 }
 
+PageRingBuffer* FIFO::buffer_for_reading(FileDescription&)
+{
+    if (m_buffer.is_empty())
+        return nullptr;
+    return &m_buffer;
+}
+
+PageRingBuffer* FIFO::buffer_for_writing(FileDescription&)
+{
+    if (!m_readers)
+        return nullptr;
+    return &m_buffer;
+}
+
 String FIFO::absolute_path(const FileDescription&) const
 {
     return String::format("fifo:%u", m_fifo_id);
@@ -26,9 +26,9 @@
 
 #pragma once
 
-#include <Kernel/DoubleBuffer.h>
 #include <Kernel/FileSystem/File.h>
 #include <Kernel/Lock.h>
+#include <Kernel/PageRingBuffer.h>
 #include <Kernel/UnixTypes.h>
 #include <Kernel/WaitQueue.h>
 
@@ -60,6 +60,10 @@ private:
     virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override;
     virtual KResultOr<size_t> read(FileDescription&, size_t, UserOrKernelBuffer&, size_t) override;
     virtual KResult stat(::stat&) const override;
+    virtual KResultOr<size_t> buffer_capacity(const FileDescription&) const override { return m_buffer.capacity(); }
+    virtual KResult set_buffer_capacity(FileDescription&, size_t capacity) override { return m_buffer.set_capacity(capacity); }
+    virtual PageRingBuffer* buffer_for_reading(FileDescription&) override;
+    virtual PageRingBuffer* buffer_for_writing(FileDescription&) override;
     virtual bool can_read(const FileDescription&, size_t) const override;
     virtual bool can_write(const FileDescription&, size_t) const override;
     virtual String absolute_path(const FileDescription&) const override;
@@ -70,7 +74,7 @@ private:
 
     unsigned m_writers { 0 };
     unsigned m_readers { 0 };
-    DoubleBuffer m_buffer;
+    PageRingBuffer m_buffer;
 
     uid_t m_uid { 0 };
 
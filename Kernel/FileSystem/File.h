@@ -95,6 +95,15 @@ private:
 //   - Optional. If unimplemented, mmap() on this File will fail with -ENODEV.
 //   - Called by mmap() when userspace wants to memory-map this File somewhere.
 //   - Should create a Region in the Process and return it if successful.
+//
+// buffer_capacity() and set_buffer_capacity()
+//   - Optional. If unimplemented, F_GETPIPE_SZ and F_SETPIPE_SZ on this File will fail with -EBADF.
+//   - Implemented by pipes and local sockets, whose data lives in a PageRingBuffer.
+//
+// buffer_for_reading() and buffer_for_writing()
+//   - Optional. Return the PageRingBuffer a description reads from or writes to, if any.
+//   - Should return nullptr whenever a plain read()/write() would not simply touch the buffer
+//     (e.g. EOF or a missing peer), so splice() can fall back to those and get the semantics right.
 
 class File
     : public RefCounted<File>
@@ -120,6 +129,11 @@ public:
     virtual KResult chown(FileDescription&, uid_t, gid_t) { return KResult(-EBADF); }
     virtual KResult chmod(FileDescription&, mode_t) { return KResult(-EBADF); }
 
+    virtual KResultOr<size_t> buffer_capacity(const FileDescription&) const { return KResult(-EBADF); }
+    virtual KResult set_buffer_capacity(FileDescription&, size_t) { return KResult(-EBADF); }
+    virtual PageRingBuffer* buffer_for_reading(FileDescription&) { return nullptr; }
+    virtual PageRingBuffer* buffer_for_writing(FileDescription&) { return nullptr; }
+
     virtual const char* class_name() const = 0;
 
     virtual bool is_seekable() const { return false; }
@@ -132,6 +146,7 @@ public:
     virtual bool is_block_device() const { return false; }
     virtual bool is_character_device() const { return false; }
     virtual bool is_socket() const { return false; }
+    virtual bool is_event_queue() const { return false; }
 
     virtual FileBlockCondition& block_condition() { return m_block_condition; }
 
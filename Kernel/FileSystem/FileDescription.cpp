@@ -28,6 +28,7 @@
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/Devices/CharacterDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/EventQueue.h>
 #include <Kernel/FileSystem/FIFO.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
@@ -66,6 +67,7 @@ FileDescription::FileDescription(File& file)
 
 FileDescription::~FileDescription()
 {
+    EventQueue::description_destroyed({}, *this);
     if (is_socket())
         socket()->detach(*this);
     if (is_fifo())
@@ -169,6 +171,38 @@ KResultOr<size_t> FileDescription::write(const UserOrKernelBuffer& data, size_t
     return nwritten_or_error;
 }
 
+KResultOr<size_t> FileDescription::read(UserOrKernelBuffer& buffer, off_t offset, size_t count)
+{
+    if (!m_file->is_seekable())
+        return -ESPIPE;
+    if (offset < 0)
+        return -EINVAL;
+    Checked<size_t> end_offset = offset;
+    end_offset += count;
+    if (end_offset.has_overflow())
+        return -EOVERFLOW;
+    auto nread_or_error = m_file->read(*this, offset, buffer, count);
+    if (!nread_or_error.is_error())
+        evaluate_block_conditions();
+    return nread_or_error;
+}
+
+KResultOr<size_t> FileDescription::write(const UserOrKernelBuffer& data, off_t offset, size_t size)
+{
+    if (!m_file->is_seekable())
+        return -ESPIPE;
+    if (offset < 0)
+        return -EINVAL;
+    Checked<size_t> end_offset = offset;
+    end_offset += size;
+    if (end_offset.has_overflow())
+        return -EOVERFLOW;
+    auto nwritten_or_error = m_file->write(*this, offset, data, size);
+    if (!nwritten_or_error.is_error())
+        evaluate_block_conditions();
+    return nwritten_or_error;
+}
+
 bool FileDescription::can_write() const
 {
     return m_file->can_write(*this, offset());
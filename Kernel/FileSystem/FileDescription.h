@@ -64,6 +64,10 @@ public:
     off_t seek(off_t, int whence);
     KResultOr<size_t> read(UserOrKernelBuffer&, size_t);
     KResultOr<size_t> write(const UserOrKernelBuffer& data, size_t);
+
+    // Positional I/O on seekable files; these leave the description's own offset alone.
+    KResultOr<size_t> read(UserOrKernelBuffer&, off_t offset, size_t);
+    KResultOr<size_t> write(const UserOrKernelBuffer& data, off_t offset, size_t);
     KResult stat(::stat&);
 
     KResult chmod(mode_t);
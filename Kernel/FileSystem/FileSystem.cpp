@@ -71,21 +71,31 @@ FS::DirectoryEntryView::DirectoryEntryView(const StringView& n, InodeIdentifier
 {
 }
 
+static NonnullRefPtrVector<FS, 32> all_fses_snapshot()
+{
+    NonnullRefPtrVector<FS, 32> fses;
+    InterruptDisabler disabler;
+    for (auto& it : all_fses())
+        fses.append(*it.value);
+    return fses;
+}
+
 void FS::sync()
 {
     Inode::sync();
 
-    NonnullRefPtrVector<FS, 32> fses;
-    {
-        InterruptDisabler disabler;
-        for (auto& it : all_fses())
-            fses.append(*it.value);
-    }
-
-    for (auto& fs : fses)
+    for (auto& fs : all_fses_snapshot())
         fs.flush_writes();
 }
 
+void FS::sync_in_background()
+{
+    Inode::sync();
+
+    for (auto& fs : all_fses_snapshot())
+        fs.start_writeback();
+}
+
 void FS::lock_all()
 {
     for (auto& it : all_fses()) {
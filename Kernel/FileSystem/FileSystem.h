@@ -54,6 +54,7 @@ public:
     unsigned fsid() const { return m_fsid; }
     static FS* from_fsid(u32);
     static void sync();
+    static void sync_in_background();
     static void lock_all();
 
     virtual bool initialize() = 0;
@@ -61,6 +62,11 @@ public:
     virtual NonnullRefPtr<Inode> root_inode() const = 0;
     virtual bool supports_watchers() const { return false; }
 
+    // Whether path lookups in this filesystem may be cached in the DentryCache.
+    // Only filesystems that call did_add_child() and did_remove_child() for every
+    // change to a directory may return true.
+    virtual bool supports_dentry_cache() const { return false; }
+
     bool is_readonly() const { return m_readonly; }
 
     virtual unsigned total_block_count() const { return 0; }
@@ -80,6 +86,9 @@ public:
 
     virtual void flush_writes() { }
 
+    // Like flush_writes(), but filesystems with a flusher thread may leave the writing to it.
+    virtual void start_writeback() { flush_writes(); }
+
     size_t block_size() const { return m_block_size; }
 
     virtual bool is_file_backed() const { return false; }
@@ -70,6 +70,9 @@ public:
     KResultOr<NonnullOwnPtr<KBuffer>> read_entire(FileDescription* = nullptr) const;
 
     virtual ssize_t read_bytes(off_t, ssize_t, UserOrKernelBuffer& buffer, FileDescription*) const = 0;
+    // Returns the page cache page holding the given page of the file, reading it in first if needed.
+    // Filesystems that don't keep file contents in the page cache return nullptr.
+    virtual RefPtr<PhysicalPage> cached_page(size_t) const { return nullptr; }
     virtual KResult traverse_as_directory(Function<bool(const FS::DirectoryEntryView&)>) const = 0;
     virtual RefPtr<Inode> lookup(StringView name) = 0;
     virtual ssize_t write_bytes(off_t, ssize_t, const UserOrKernelBuffer& data, FileDescription*) = 0;
@@ -129,8 +132,8 @@ protected:
     void inode_size_changed(size_t old_size, size_t new_size);
     KResult prepare_to_write_data();
 
-    void did_add_child(const InodeIdentifier&);
-    void did_remove_child(const InodeIdentifier&);
+    void did_add_child(const InodeIdentifier& child_id, const StringView& name);
+    void did_remove_child(const InodeIdentifier& child_id, const StringView& name);
 
     mutable Lock m_lock { "Inode" };
 
@@ -35,11 +35,13 @@
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/Devices/KeyboardDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/ProcFS.h>
 #include <Kernel/FileSystem/VirtualFileSystem.h>
 #include <Kernel/Heap/kmalloc.h>
+#include <Kernel/Interrupts/APIC.h>
 #include <Kernel/Interrupts/GenericInterruptHandler.h>
 #include <Kernel/Interrupts/InterruptManagement.h>
 #include <Kernel/KBufferBuilder.h>
@@ -57,6 +59,8 @@
 #include <Kernel/StdLib.h>
 #include <Kernel/TTY/TTY.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
+#include <Kernel/VM/PhysicalRegion.h>
 #include <Kernel/VM/PurgeableVMObject.h>
 #include <LibC/errno_numbers.h>
 
@@ -97,6 +101,8 @@ enum ProcFileType {
     FI_Root_cmdline,
     FI_Root_modules,
     FI_Root_profile,
+    FI_Root_pagefaults,
+    FI_Root_locks,
     FI_Root_self, // symlink
     FI_Root_sys,  // directory
     FI_Root_net,  // directory
@@ -394,6 +400,17 @@ static OwnPtr<KBuffer> procfs$interrupts(InodeIdentifier)
         obj.add("device_sharing", (unsigned)handler.sharing_devices_count());
         obj.add("call_count", (unsigned)handler.get_invoking_count());
     });
+    Processor::for_each([&array](Processor& processor) -> IterationDecision {
+        auto obj = array.add_object();
+        obj.add("purpose", "TLB shootdown");
+        obj.add("interrupt_line", APIC::ipi_interrupt_number());
+        obj.add("controller", "APIC");
+        obj.add("cpu_handler", processor.id());
+        obj.add("device_sharing", 0);
+        obj.add("call_count", processor.tlb_shootdowns_received());
+        obj.add("sent_count", processor.tlb_shootdowns_sent());
+        return IterationDecision::Continue;
+    });
     array.finish();
     return builder.build();
 }
@@ -514,6 +531,9 @@ static OwnPtr<KBuffer> procfs$net_adapters(InodeIdentifier)
         obj.add("bytes_in", adapter.bytes_in());
         obj.add("packets_out", adapter.packets_out());
         obj.add("bytes_out", adapter.bytes_out());
+        obj.add("packets_dropped", adapter.packets_dropped());
+        obj.add("packets_in_per_second", adapter.packets_in_per_second());
+        obj.add("packets_out_per_second", adapter.packets_out_per_second());
         obj.add("link_up", adapter.link_up());
         obj.add("mtu", adapter.mtu());
     });
@@ -552,6 +572,13 @@ static OwnPtr<KBuffer> procfs$net_tcp(InodeIdentifier)
         obj.add("bytes_in", socket.bytes_in());
         obj.add("packets_out", socket.packets_out());
         obj.add("bytes_out", socket.bytes_out());
+        obj.add("retransmitted_segments", socket.retransmitted_segments());
+        obj.add("congestion_window", socket.congestion_window());
+        obj.add("slow_start_threshold", socket.slow_start_threshold());
+        obj.add("send_window", socket.send_window());
+        obj.add("mss", socket.send_mss());
+        obj.add("smoothed_rtt_ms", socket.smoothed_rtt_ms());
+        obj.add("retransmission_timeout_ms", socket.retransmission_timeout_ms());
     });
     array.finish();
     return builder.build();
@@ -814,15 +841,102 @@ OwnPtr<KBuffer> procfs$memstat(InodeIdentifier)
     json.add("super_physical_available", MM.super_physical_pages() - MM.super_physical_pages_used());
     json.add("kmalloc_call_count", stats.kmalloc_call_count);
     json.add("kfree_call_count", stats.kfree_call_count);
-    slab_alloc_stats([&json](size_t slab_size, size_t num_allocated, size_t num_free) {
+    json.add("kmalloc_cache_hits", stats.cache_hits);
+    json.add("kmalloc_cache_misses", stats.cache_misses);
+    slab_alloc_stats([&json](size_t slab_size, size_t num_allocated, size_t num_free, size_t cache_hits, size_t cache_misses) {
         auto prefix = String::format("slab_%zu", slab_size);
         json.add(String::format("%s_num_allocated", prefix.characters()), num_allocated);
         json.add(String::format("%s_num_free", prefix.characters()), num_free);
+        json.add(String::format("%s_cache_hits", prefix.characters()), cache_hits);
+        json.add(String::format("%s_cache_misses", prefix.characters()), cache_misses);
     });
+    auto add_free_blocks = [&json](const char* key, auto& regions) {
+        auto array = json.add_array(key);
+        for (size_t order = 0; order <= PhysicalRegion::max_order; order++) {
+            size_t free_blocks = 0;
+            for (auto& region : regions)
+                free_blocks += region.free_blocks_of_order(order);
+            array.add(free_blocks);
+        }
+        array.finish();
+    };
+    {
+        auto& page_cache = PageCache::the();
+        ScopedSpinLock lock(page_cache.lock());
+        json.add("page_cache_pages", page_cache.page_count());
+        json.add("page_cache_dirty_pages", page_cache.dirty_page_count());
+        json.add("page_cache_inode_hits", page_cache.inode_hits());
+        json.add("page_cache_inode_misses", page_cache.inode_misses());
+        json.add("page_cache_block_hits", page_cache.block_hits());
+        json.add("page_cache_block_misses", page_cache.block_misses());
+        json.add("page_cache_reclaimed", page_cache.reclaimed_pages());
+    }
+    auto& dentry_cache = DentryCache::the();
+    json.add("dentry_cache_entries", dentry_cache.entry_count());
+    json.add("dentry_cache_hits", dentry_cache.hits());
+    json.add("dentry_cache_negative_hits", dentry_cache.negative_hits());
+    json.add("dentry_cache_misses", dentry_cache.misses());
+    add_free_blocks("user_physical_free_blocks", MM.m_user_physical_regions);
+    add_free_blocks("super_physical_free_blocks", MM.m_super_physical_regions);
     json.finish();
     return builder.build();
 }
 
+OwnPtr<KBuffer> procfs$pagefaults(InodeIdentifier)
+{
+    InterruptDisabler disabler;
+
+    KBufferBuilder builder;
+    JsonObjectSerializer<KBufferBuilder> json { builder };
+    json.add("zeroed_page_pool_size", MM.m_zeroed_user_page_count);
+    json.add("zeroed_page_pool_hits", MM.m_zeroed_page_pool_hits.load());
+    json.add("zeroed_page_pool_misses", MM.m_zeroed_page_pool_misses.load());
+    json.add("inode_faults", MM.m_inode_faults);
+    json.add("inode_faults_resident", MM.m_inode_faults_resident);
+    json.add("fault_around_pages", MM.m_fault_around_pages);
+    json.add("readahead_requests", MM.m_readahead_requests);
+    json.add("readahead_pages", MM.m_readahead_pages);
+    auto add_histogram = [&json](const char* key, const PageFaultLatencyHistogram& histogram) {
+        auto object = json.add_object(key);
+        object.add("count", histogram.count);
+        object.add("first_bucket_cycles", 1u << PageFaultLatencyHistogram::first_bucket_shift);
+        auto buckets = object.add_array("buckets");
+        for (size_t i = 0; i < PageFaultLatencyHistogram::bucket_count; ++i)
+            buckets.add(histogram.buckets[i]);
+        buckets.finish();
+        object.finish();
+    };
+    add_histogram("all_faults", MM.m_page_fault_latency);
+    add_histogram("zero_faults", MM.m_zero_fault_latency);
+    json.finish();
+    return builder.build();
+}
+
+static OwnPtr<KBuffer> procfs$locks(InodeIdentifier)
+{
+    KBufferBuilder builder;
+    JsonArraySerializer array { builder };
+    Lock::for_each_statistics([&array](LockStatistics& statistics) {
+        u64 wait_cycles;
+        u64 max_wait_cycles;
+        {
+            ScopedSpinLock lock(statistics.wait_lock);
+            wait_cycles = statistics.wait_cycles;
+            max_wait_cycles = statistics.max_wait_cycles;
+        }
+        auto obj = array.add_object();
+        obj.add("name", statistics.name);
+        obj.add("acquisitions", statistics.acquisitions.load(AK::MemoryOrder::memory_order_relaxed));
+        obj.add("contended", statistics.contended.load(AK::MemoryOrder::memory_order_relaxed));
+        obj.add("spin_acquisitions", statistics.spin_acquisitions.load(AK::MemoryOrder::memory_order_relaxed));
+        obj.add("sleeps", statistics.sleeps.load(AK::MemoryOrder::memory_order_relaxed));
+        obj.add("wait_cycles", wait_cycles);
+        obj.add("max_wait_cycles", max_wait_cycles);
+    });
+    array.finish();
+    return builder.build();
+}
+
 static OwnPtr<KBuffer> procfs$all(InodeIdentifier)
 {
     KBufferBuilder builder;
@@ -1693,6 +1807,8 @@ ProcFS::ProcFS()
     m_entries[FI_Root_cmdline] = { "cmdline", FI_Root_cmdline, true, procfs$cmdline };
     m_entries[FI_Root_modules] = { "modules", FI_Root_modules, true, procfs$modules };
     m_entries[FI_Root_profile] = { "profile", FI_Root_profile, false, procfs$profile };
+    m_entries[FI_Root_pagefaults] = { "pagefaults", FI_Root_pagefaults, false, procfs$pagefaults };
+    m_entries[FI_Root_locks] = { "locks", FI_Root_locks, false, procfs$locks };
     m_entries[FI_Root_sys] = { "sys", FI_Root_sys, true };
     m_entries[FI_Root_net] = { "net", FI_Root_net, false };
 
@@ -29,6 +29,7 @@
 #include <AK/StringBuilder.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/FileSystem/Custody.h>
+#include <Kernel/FileSystem/DentryCache.h>
 #include <Kernel/FileSystem/FileBackedFileSystem.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/FileSystem/FileSystem.h>
@@ -81,6 +82,7 @@ KResult VFS::mount(FS& file_system, Custody& mount_point, int flags)
     // FIXME: check that this is not already a mount point
     Mount mount { file_system, &mount_point, flags };
     m_mounts.append(move(mount));
+    DentryCache::the().invalidate_all();
     return KSuccess;
 }
 
@@ -92,6 +94,7 @@ KResult VFS::bind_mount(Custody& source, Custody& mount_point, int flags)
     // FIXME: check that this is not already a mount point
     Mount mount { source.inode(), mount_point, flags };
     m_mounts.append(move(mount));
+    DentryCache::the().invalidate_all();
     return KSuccess;
 }
 
@@ -106,6 +109,7 @@ KResult VFS::remount(Custody& mount_point, int new_flags)
         return KResult(-ENODEV);
 
     mount->set_flags(new_flags);
+    DentryCache::the().invalidate_all();
     return KSuccess;
 }
 
@@ -117,6 +121,8 @@ KResult VFS::unmount(Inode& guest_inode)
     for (size_t i = 0; i < m_mounts.size(); ++i) {
         auto& mount = m_mounts.at(i);
         if (&mount.guest() == &guest_inode) {
+            // Cached custodies keep inodes on the guest filesystem busy.
+            DentryCache::the().invalidate_all();
             auto result = mount.guest_fs().prepare_to_unmount();
             if (result.is_error()) {
                 dbg() << "VFS: Failed to unmount!";
@@ -916,6 +922,35 @@ KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path(StringView path, Custody& ba
     return custody;
 }
 
+RefPtr<Custody> VFS::lookup_child(Custody& parent, const StringView& name)
+{
+    auto& dentry_cache = DentryCache::the();
+    bool use_dentry_cache = parent.inode().fs().supports_dentry_cache();
+
+    RefPtr<Custody> child;
+    if (use_dentry_cache && dentry_cache.lookup(parent, name, child))
+        return child;
+
+    u32 generation = dentry_cache.generation();
+    auto child_inode = parent.inode().lookup(name);
+    if (child_inode) {
+        int mount_flags_for_child = parent.mount_flags();
+
+        // See if there's something mounted on the child; in that case
+        // we would need to return the guest inode, not the host inode.
+        if (auto mount = find_mount_for_host(*child_inode)) {
+            child_inode = mount->guest();
+            mount_flags_for_child = mount->flags();
+        }
+
+        child = Custody::create(&parent, name, *child_inode, mount_flags_for_child);
+    }
+
+    if (use_dentry_cache)
+        dentry_cache.add(parent, name, child.ptr(), generation);
+    return child;
+}
+
 KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path_without_veil(StringView path, Custody& base, RefPtr<Custody>* out_parent, int options, int symlink_recursion_level)
 {
     if (symlink_recursion_level >= symlink_recursion_limit)
@@ -952,8 +987,8 @@ KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path_without_veil(StringView path
         }
 
         // Okay, let's look up this part.
-        auto child_inode = parent.inode().lookup(part);
-        if (!child_inode) {
+        auto child = lookup_child(parent, part);
+        if (!child) {
             if (out_parent) {
                 // ENOENT with a non-null parent custody signals to caller that
                 // we found the immediate parent of the file, but the file itself
@@ -963,25 +998,17 @@ KResultOr<NonnullRefPtr<Custody>> VFS::resolve_path_without_veil(StringView path
             return KResult(-ENOENT);
         }
 
-        int mount_flags_for_child = parent.mount_flags();
-
-        // See if there's something mounted on the child; in that case
-        // we would need to return the guest inode, not the host inode.
-        if (auto mount = find_mount_for_host(*child_inode)) {
-            child_inode = mount->guest();
-            mount_flags_for_child = mount->flags();
-        }
-
-        custody = Custody::create(&parent, part, *child_inode, mount_flags_for_child);
+        custody = child.release_nonnull();
+        auto& child_inode = custody->inode();
 
-        if (child_inode->metadata().is_symlink()) {
+        if (child_inode.metadata().is_symlink()) {
             if (!have_more_parts) {
                 if (options & O_NOFOLLOW)
                     return KResult(-ELOOP);
                 if (options & O_NOFOLLOW_NOERROR)
                     break;
             }
-            auto symlink_target = child_inode->resolve_as_link(parent, out_parent, options, symlink_recursion_level + 1);
+            auto symlink_target = child_inode.resolve_as_link(parent, out_parent, options, symlink_recursion_level + 1);
             if (symlink_target.is_error() || !have_more_parts)
                 return symlink_target;
 
@@ -129,6 +129,8 @@ private:
 
     KResult traverse_directory_inode(Inode&, Function<bool(const FS::DirectoryEntryView&)>);
 
+    RefPtr<Custody> lookup_child(Custody& parent, const StringView& name);
+
     Mount* find_mount_for_host(Inode&);
     Mount* find_mount_for_host(InodeIdentifier);
     Mount* find_mount_for_guest(Inode&);
@@ -33,10 +33,10 @@ class CharacterDevice;
 class CoreDump;
 class Custody;
 class Device;
-class DiskCache;
 class DoubleBuffer;
 class File;
 class FileDescription;
+class FutexQueue;
 class IPv4Socket;
 class Inode;
 class InodeIdentifier;
@@ -49,6 +49,7 @@ class Lock;
 class MappedROM;
 class MasterPTY;
 class PageDirectory;
+class PageRingBuffer;
 class PerformanceEventBuffer;
 class PhysicalPage;
 class PhysicalRegion;
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/NumericLimits.h>
+#include <Kernel/FutexQueue.h>
+#include <Kernel/Thread.h>
+#include <Kernel/UnixTypes.h>
+
+//#define FUTEXQUEUE_DEBUG
+
+namespace Kernel {
+
+FutexQueue::~FutexQueue()
+{
+}
+
+bool FutexQueue::should_add_blocker(Thread::Blocker& b, void* data)
+{
+    ASSERT(data != nullptr); // Thread that is requesting to be blocked
+    ASSERT(m_lock.is_locked());
+    ASSERT(b.blocker_type() == Thread::Blocker::Type::Futex);
+    ASSERT(m_imminent_waits > 0);
+    m_imminent_waits--;
+    if (m_pending_wakes > 0) {
+        m_pending_wakes--;
+#ifdef FUTEXQUEUE_DEBUG
+        dbg() << "FutexQueue @ " << this << ": do not block thread " << *static_cast<Thread*>(data) << ", was woken before blocking";
+#endif
+        return false;
+    }
+    return true;
+}
+
+void FutexQueue::queue_imminent_wait()
+{
+    ScopedSpinLock lock(m_lock);
+    m_imminent_waits++;
+}
+
+void FutexQueue::abort_imminent_wait()
+{
+    ScopedSpinLock lock(m_lock);
+    ASSERT(m_imminent_waits > 0);
+    m_imminent_waits--;
+    if (m_pending_wakes > m_imminent_waits)
+        m_pending_wakes = m_imminent_waits;
+}
+
+Thread::BlockResult FutexQueue::wait_on(const Thread::BlockTimeout& timeout, u32 bitset)
+{
+    return Thread::current()->block<Thread::FutexBlocker>(timeout, *this, bitset);
+}
+
+static u32 credit_imminent_waits(u32 imminent_waits, u32& pending_wakes, u32 budget)
+{
+    // Threads that are just about to block were there before this wake, so they
+    // must not miss it. Since we can't tell their bitset, they may wake up
+    // spuriously, which callers of futex() have to deal with anyway.
+    u32 credited = min(imminent_waits - pending_wakes, budget);
+    pending_wakes += credited;
+    return credited;
+}
+
+u32 FutexQueue::wake_n(u32 wake_count, u32 bitset)
+{
+    if (wake_count == 0)
+        return 0;
+    ScopedSpinLock lock(m_lock);
+#ifdef FUTEXQUEUE_DEBUG
+    dbg() << "FutexQueue @ " << this << ": wake_n(" << wake_count << ", " << String::format("%x", bitset) << ")";
+#endif
+    u32 did_wake = 0;
+    do_unblock_some([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
+        ASSERT(data);
+        ASSERT(b.blocker_type() == Thread::Blocker::Type::Futex);
+        auto& blocker = static_cast<Thread::FutexBlocker&>(b);
+        if (!(blocker.bitset() & bitset))
+            return false;
+        if (!blocker.unblock())
+            return false;
+        if (++did_wake == wake_count)
+            stop_iterating = true;
+        return true;
+    });
+    if (did_wake < wake_count)
+        did_wake += credit_imminent_waits(m_imminent_waits, m_pending_wakes, wake_count - did_wake);
+    return did_wake;
+}
+
+u32 FutexQueue::wake_all()
+{
+    return wake_n(NumericLimits<u32>::max(), FUTEX_BITSET_MATCH_ANY);
+}
+
+u32 FutexQueue::wake_n_requeue(u32 wake_count, FutexQueue& target, u32 requeue_count)
+{
+    if (&target == this)
+        return wake_n(wake_count + min(requeue_count, NumericLimits<u32>::max() - wake_count), FUTEX_BITSET_MATCH_ANY);
+
+    // Always take the two queue locks in the same order.
+    auto& first = this < &target ? *this : target;
+    auto& second = this < &target ? target : *this;
+    ScopedSpinLock first_lock(first.m_lock);
+    ScopedSpinLock second_lock(second.m_lock);
+
+#ifdef FUTEXQUEUE_DEBUG
+    dbg() << "FutexQueue @ " << this << ": wake_n_requeue(" << wake_count << ", " << &target << ", " << requeue_count << ")";
+#endif
+
+    u32 did_wake = 0;
+    if (wake_count > 0) {
+        do_unblock_some([&](Thread::Blocker& b, void* data, bool& stop_iterating) {
+            ASSERT(data);
+            ASSERT(b.blocker_type() == Thread::Blocker::Type::Futex);
+            auto& blocker = static_cast<Thread::FutexBlocker&>(b);
+            if (!blocker.unblock())
+                return false;
+            if (++did_wake == wake_count)
+                stop_iterating = true;
+            return true;
+        });
+    }
+    if (did_wake < wake_count)
+        did_wake += credit_imminent_waits(m_imminent_waits, m_pending_wakes, wake_count - did_wake);
+
+    u32 did_requeue = 0;
+    for (size_t i = 0; i < m_blockers.size() && did_requeue < requeue_count;) {
+        auto info = m_blockers[i];
+        ASSERT(info.blocker->blocker_type() == Thread::Blocker::Type::Futex);
+        auto& blocker = static_cast<Thread::FutexBlocker&>(*info.blocker);
+        blocker.move_to(target);
+        target.m_blockers.append(info);
+        m_blockers.remove(i);
+        did_requeue++;
+    }
+    // Whoever is about to block here would have been requeued, so wake them instead.
+    if (did_requeue < requeue_count)
+        did_wake += credit_imminent_waits(m_imminent_waits, m_pending_wakes, requeue_count - did_requeue);
+
+    return did_wake + did_requeue;
+}
+
+RefPtr<Thread> FutexQueue::wake_highest_priority(bool& has_more_waiters)
+{
+    ScopedSpinLock lock(m_lock);
+    RefPtr<Thread> woken_thread;
+    for (;;) {
+        Optional<size_t> best_index;
+        u32 best_priority = 0;
+        for (size_t i = 0; i < m_blockers.size(); ++i) {
+            auto& thread = *static_cast<Thread*>(m_blockers[i].data);
+            if (!best_index.has_value() || thread.effective_priority() > best_priority) {
+                best_index = i;
+                best_priority = thread.effective_priority();
+            }
+        }
+        if (!best_index.has_value())
+            break;
+
+        auto info = m_blockers[best_index.value()];
+        m_blockers.remove(best_index.value());
+        auto& blocker = static_cast<Thread::FutexBlocker&>(*info.blocker);
+        if (blocker.unblock()) {
+            woken_thread = static_cast<Thread*>(info.data);
+            break;
+        }
+    }
+    if (!woken_thread && m_imminent_waits > m_pending_wakes)
+        m_pending_wakes++;
+    has_more_waiters = !m_blockers.is_empty() || m_imminent_waits > m_pending_wakes;
+    return woken_thread;
+}
+
+bool FutexQueue::has_waiters()
+{
+    ScopedSpinLock lock(m_lock);
+    return !m_blockers.is_empty() || m_imminent_waits > 0;
+}
+
+u32 FutexQueue::highest_waiter_priority()
+{
+    ScopedSpinLock lock(m_lock);
+    u32 priority = 0;
+    for (auto& info : m_blockers)
+        priority = max(priority, static_cast<Thread*>(info.data)->effective_priority());
+    return priority;
+}
+
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Function.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/Thread.h>
+
+namespace Kernel {
+
+class FutexQueue : public Thread::BlockCondition {
+public:
+    FutexQueue() = default;
+    virtual ~FutexQueue();
+
+    // A thread that has checked the futex value and is about to block on
+    // this queue has to announce that first. A wake that happens in between
+    // is then credited to it instead of being lost.
+    void queue_imminent_wait();
+    void abort_imminent_wait();
+
+    Thread::BlockResult wait_on(const Thread::BlockTimeout&, u32 bitset);
+
+    u32 wake_n(u32 wake_count, u32 bitset);
+    u32 wake_all();
+
+    // Wakes up to wake_count waiters and moves up to requeue_count of the
+    // remaining ones to the target queue, without waking them.
+    u32 wake_n_requeue(u32 wake_count, FutexQueue& target, u32 requeue_count);
+
+    // Wakes the waiter with the highest priority.
+    RefPtr<Thread> wake_highest_priority(bool& has_more_waiters);
+    bool has_waiters();
+    u32 highest_waiter_priority();
+
+protected:
+    virtual bool should_add_blocker(Thread::Blocker&, void*) override;
+
+private:
+    u32 m_imminent_waits { 0 };
+    u32 m_pending_wakes { 0 };
+};
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Assertions.h>
+#include <AK/Types.h>
+
+namespace Kernel {
+
+// A magazine is a small stack of free objects owned by one processor,
+// sitting in front of a shared allocator (the "depot"). It is only ever
+// touched by its own processor inside a critical section, so pushing and
+// popping needs neither a lock nor atomic operations. Magazines exchange
+// objects with the depot in batches of half their capacity.
+template<size_t Capacity>
+class Magazine {
+public:
+    static constexpr size_t capacity() { return Capacity; }
+    static constexpr size_t batch_size() { return Capacity / 2; }
+
+    bool is_empty() const { return m_count == 0; }
+    bool is_full() const { return m_count == Capacity; }
+    size_t size() const { return m_count; }
+
+    void push(void* ptr)
+    {
+        ASSERT(!is_full());
+        m_rounds[m_count++] = ptr;
+    }
+
+    void* pop()
+    {
+        ASSERT(!is_empty());
+        return m_rounds[--m_count];
+    }
+
+private:
+    void* m_rounds[Capacity];
+    size_t m_count { 0 };
+};
+
+static constexpr size_t magazine_capacity = 32;
+
+// kmalloc() allocations of up to this many chunks are cached per processor.
+static constexpr size_t kmalloc_magazine_size_classes = 8;
+
+// One per SlabAllocator: 16, 32, 64 and 128 bytes.
+static constexpr size_t slab_magazine_size_classes = 4;
+
+struct MagazineStats {
+    size_t hits { 0 };
+    size_t misses { 0 };
+};
+
+struct HeapPerProcessorData {
+    Magazine<magazine_capacity> kmalloc_magazines[kmalloc_magazine_size_classes];
+    MagazineStats kmalloc_stats;
+    size_t kmalloc_call_count { 0 };
+    size_t kfree_call_count { 0 };
+
+    Magazine<magazine_capacity> slab_magazines[slab_magazine_size_classes];
+    MagazineStats slab_stats[slab_magazine_size_classes];
+};
+
+}
@@ -26,6 +26,8 @@
 
 #include <AK/Assertions.h>
 #include <AK/Memory.h>
+#include <Kernel/Arch/i386/CPU.h>
+#include <Kernel/Heap/Magazine.h>
 #include <Kernel/Heap/SlabAllocator.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/SpinLock.h>
@@ -63,19 +65,29 @@ public:
         {
             // We want to avoid being swapped out in the middle of this
             ScopedCritical critical;
-            FreeSlab* next_free;
-            free_slab = m_freelist.load(AK::memory_order_consume);
-            do {
+            auto* heap_data = Processor::current().heap_data();
+            if (!heap_data) {
+                free_slab = take_from_freelist();
                 if (!free_slab)
                     return kmalloc(slab_size());
-                // It's possible another processor is doing the same thing at
-                // the same time, so next_free *can* be a bogus pointer. However,
-                // in that case compare_exchange_strong would fail and we would
-                // try again.
-                next_free = free_slab->next;
-            } while (!m_freelist.compare_exchange_strong(free_slab, next_free, AK::memory_order_acq_rel));
-
-            m_num_allocated.fetch_add(1, AK::MemoryOrder::memory_order_acq_rel);
+            } else {
+                auto& magazine = heap_data->slab_magazines[magazine_index()];
+                auto& stats = heap_data->slab_stats[magazine_index()];
+                if (magazine.is_empty()) {
+                    stats.misses++;
+                    for (size_t i = 0; i < magazine.batch_size(); ++i) {
+                        auto* slab = take_from_freelist();
+                        if (!slab)
+                            break;
+                        magazine.push(slab);
+                    }
+                    if (magazine.is_empty())
+                        return kmalloc(slab_size());
+                } else {
+                    stats.hits++;
+                }
+                free_slab = (FreeSlab*)magazine.pop();
+            }
         }
 
 #ifdef SANITIZE_SLABS
@@ -99,23 +111,74 @@ public:
 
         // We want to avoid being swapped out in the middle of this
         ScopedCritical critical;
-        FreeSlab* next_free = m_freelist.load(AK::memory_order_consume);
-        do {
-            free_slab->next = next_free;
-        } while (!m_freelist.compare_exchange_strong(next_free, free_slab, AK::memory_order_acq_rel));
+        auto* heap_data = Processor::current().heap_data();
+        if (!heap_data) {
+            free_slab->next = nullptr;
+            return_to_freelist(free_slab, free_slab, 1);
+            return;
+        }
 
-        m_num_allocated.fetch_sub(1, AK::MemoryOrder::memory_order_acq_rel);
+        auto& magazine = heap_data->slab_magazines[magazine_index()];
+        if (magazine.is_full()) {
+            // Hand half of the magazine back to the shared freelist with a
+            // single compare-and-swap, no matter which processor allocated them.
+            FreeSlab* first = nullptr;
+            FreeSlab* last = nullptr;
+            for (size_t i = 0; i < magazine.batch_size(); ++i) {
+                auto* slab = (FreeSlab*)magazine.pop();
+                slab->next = first;
+                first = slab;
+                if (!last)
+                    last = slab;
+            }
+            return_to_freelist(first, last, magazine.batch_size());
+        }
+        magazine.push(free_slab);
     }
 
     size_t num_allocated() const { return m_num_allocated.load(AK::MemoryOrder::memory_order_consume); }
     size_t num_free() const { return m_slab_count - m_num_allocated.load(AK::MemoryOrder::memory_order_consume); }
 
+    size_t magazine_index() const
+    {
+        static_assert(templated_slab_size >= 16 && templated_slab_size <= 128);
+        return __builtin_ctz(templated_slab_size) - 4;
+    }
+
 private:
     struct FreeSlab {
         FreeSlab* next;
         char padding[templated_slab_size - sizeof(FreeSlab*)];
     };
 
+    FreeSlab* take_from_freelist()
+    {
+        FreeSlab* next_free;
+        FreeSlab* free_slab = m_freelist.load(AK::memory_order_consume);
+        do {
+            if (!free_slab)
+                return nullptr;
+            // It's possible another processor is doing the same thing at
+            // the same time, so next_free *can* be a bogus pointer. However,
+            // in that case compare_exchange_strong would fail and we would
+            // try again.
+            next_free = free_slab->next;
+        } while (!m_freelist.compare_exchange_strong(free_slab, next_free, AK::memory_order_acq_rel));
+
+        m_num_allocated.fetch_add(1, AK::MemoryOrder::memory_order_acq_rel);
+        return free_slab;
+    }
+
+    void return_to_freelist(FreeSlab* first, FreeSlab* last, size_t count)
+    {
+        FreeSlab* next_free = m_freelist.load(AK::memory_order_consume);
+        do {
+            last->next = next_free;
+        } while (!m_freelist.compare_exchange_strong(next_free, first, AK::memory_order_acq_rel));
+
+        m_num_allocated.fetch_sub(count, AK::MemoryOrder::memory_order_acq_rel);
+    }
+
     Atomic<FreeSlab*> m_freelist { nullptr };
     Atomic<ssize_t> m_num_allocated;
     size_t m_slab_count;
@@ -175,12 +238,24 @@ void slab_dealloc(void* ptr, size_t slab_size)
     ASSERT_NOT_REACHED();
 }
 
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)> callback)
+void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free, size_t cache_hits, size_t cache_misses)> callback)
 {
     for_each_allocator([&](auto& allocator) {
-        auto num_allocated = allocator.num_allocated();
+        // Slabs sitting in a processor's magazine count as free.
+        size_t num_cached = 0;
+        size_t cache_hits = 0;
+        size_t cache_misses = 0;
+        Processor::for_each([&](Processor& proc) {
+            if (auto* heap_data = proc.heap_data()) {
+                num_cached += heap_data->slab_magazines[allocator.magazine_index()].size();
+                cache_hits += heap_data->slab_stats[allocator.magazine_index()].hits;
+                cache_misses += heap_data->slab_stats[allocator.magazine_index()].misses;
+            }
+            return IterationDecision::Continue;
+        });
+        auto num_allocated = allocator.num_allocated() - num_cached;
         auto num_free = allocator.slab_count() - num_allocated;
-        callback(allocator.slab_size(), num_allocated, num_free);
+        callback(allocator.slab_size(), num_allocated, num_free, cache_hits, cache_misses);
     });
 }
 
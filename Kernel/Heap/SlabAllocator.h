@@ -37,7 +37,7 @@ namespace Kernel {
 void* slab_alloc(size_t slab_size);
 void slab_dealloc(void*, size_t slab_size);
 void slab_alloc_init();
-void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free)>);
+void slab_alloc_stats(Function<void(size_t slab_size, size_t allocated, size_t free, size_t cache_hits, size_t cache_misses)>);
 
 #define MAKE_SLAB_ALLOCATED(type)                                        \
 public:                                                                  \
@@ -36,6 +36,7 @@
 #include <AK/Types.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/Heap/Heap.h>
+#include <Kernel/Heap/Magazine.h>
 #include <Kernel/Heap/kmalloc.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Process.h>
@@ -225,8 +226,93 @@ void* kmalloc_eternal(size_t size)
     return ptr;
 }
 
+typedef KmallocGlobalHeap::HeapType::HeapType KmallocSubHeap;
+
+static Kernel::HeapPerProcessorData* heap_data_for_current_processor()
+{
+    auto& proc = Processor::current();
+    if (auto* heap_data = proc.heap_data())
+        return heap_data;
+    if (!g_kmalloc_global)
+        return nullptr;
+    ScopedSpinLock lock(s_lock);
+    auto* heap_data = new (kmalloc_eternal(sizeof(Kernel::HeapPerProcessorData))) Kernel::HeapPerProcessorData;
+    proc.set_heap_data(*heap_data);
+    return heap_data;
+}
+
+static void refill_magazine(Kernel::Magazine<Kernel::magazine_capacity>& magazine, size_t chunks)
+{
+    ScopedSpinLock lock(s_lock);
+    auto usable_size = KmallocSubHeap::usable_size_for(chunks);
+    for (size_t i = 0; i < magazine.batch_size(); ++i) {
+        void* ptr = g_kmalloc_global->m_heap.allocate(usable_size);
+        if (!ptr)
+            break;
+        magazine.push(ptr);
+    }
+}
+
+static void drain_magazine(Kernel::Magazine<Kernel::magazine_capacity>& magazine)
+{
+    ScopedSpinLock lock(s_lock);
+    for (size_t i = 0; i < magazine.batch_size(); ++i)
+        g_kmalloc_global->m_heap.deallocate(magazine.pop());
+}
+
+static void* kmalloc_from_magazine(size_t size)
+{
+    auto chunks = KmallocSubHeap::chunks_needed_for(size);
+    if (chunks > Kernel::kmalloc_magazine_size_classes)
+        return nullptr;
+
+    // The magazines belong to this processor, so all we need is to not
+    // get moved to another one while we're using them.
+    ScopedCritical critical;
+    auto* heap_data = heap_data_for_current_processor();
+    if (!heap_data)
+        return nullptr;
+    auto& magazine = heap_data->kmalloc_magazines[chunks - 1];
+    if (magazine.is_empty()) {
+        heap_data->kmalloc_stats.misses++;
+        refill_magazine(magazine, chunks);
+        if (magazine.is_empty())
+            return nullptr;
+    } else {
+        heap_data->kmalloc_stats.hits++;
+    }
+    heap_data->kmalloc_call_count++;
+    void* ptr = magazine.pop();
+    __builtin_memset(ptr, KMALLOC_SCRUB_BYTE, KmallocSubHeap::usable_size_for(chunks));
+    return ptr;
+}
+
+static bool kfree_to_magazine(void* ptr)
+{
+    auto chunks = KmallocSubHeap::allocation_size_in_chunks(ptr);
+    if (chunks == 0 || chunks > Kernel::kmalloc_magazine_size_classes)
+        return false;
+
+    ScopedCritical critical;
+    auto* heap_data = Processor::current().heap_data();
+    if (!heap_data)
+        return false;
+    auto& magazine = heap_data->kmalloc_magazines[chunks - 1];
+    if (magazine.is_full())
+        drain_magazine(magazine);
+    heap_data->kfree_call_count++;
+    __builtin_memset(ptr, KFREE_SCRUB_BYTE, KmallocSubHeap::usable_size_for(chunks));
+    magazine.push(ptr);
+    return true;
+}
+
 void* kmalloc_impl(size_t size)
 {
+    if (!g_dump_kmalloc_stacks) {
+        if (void* ptr = kmalloc_from_magazine(size))
+            return ptr;
+    }
+
     ScopedSpinLock lock(s_lock);
     ++g_kmalloc_call_count;
 
@@ -250,6 +336,9 @@ void kfree(void* ptr)
     if (!ptr)
         return;
 
+    if (kfree_to_magazine(ptr))
+        return;
+
     ScopedSpinLock lock(s_lock);
     ++g_kfree_call_count;
 
@@ -275,9 +364,24 @@ void* operator new[](size_t size)
 void get_kmalloc_stats(kmalloc_stats& stats)
 {
     ScopedSpinLock lock(s_lock);
-    stats.bytes_allocated = g_kmalloc_global->m_heap.allocated_bytes();
-    stats.bytes_free = g_kmalloc_global->m_heap.free_bytes() + g_kmalloc_global->backup_memory_bytes();
-    stats.bytes_eternal = g_kmalloc_bytes_eternal;
+    size_t bytes_cached = 0;
     stats.kmalloc_call_count = g_kmalloc_call_count;
     stats.kfree_call_count = g_kfree_call_count;
+    stats.cache_hits = 0;
+    stats.cache_misses = 0;
+    Processor::for_each([&](Processor& proc) {
+        auto* heap_data = proc.heap_data();
+        if (!heap_data)
+            return IterationDecision::Continue;
+        for (size_t i = 0; i < Kernel::kmalloc_magazine_size_classes; ++i)
+            bytes_cached += heap_data->kmalloc_magazines[i].size() * (i + 1) * CHUNK_SIZE;
+        stats.kmalloc_call_count += heap_data->kmalloc_call_count;
+        stats.kfree_call_count += heap_data->kfree_call_count;
+        stats.cache_hits += heap_data->kmalloc_stats.hits;
+        stats.cache_misses += heap_data->kmalloc_stats.misses;
+        return IterationDecision::Continue;
+    });
+    stats.bytes_allocated = g_kmalloc_global->m_heap.allocated_bytes() - bytes_cached;
+    stats.bytes_free = g_kmalloc_global->m_heap.free_bytes() + g_kmalloc_global->backup_memory_bytes() + bytes_cached;
+    stats.bytes_eternal = g_kmalloc_bytes_eternal;
 }
@@ -230,6 +230,11 @@ u8 APIC::spurious_interrupt_vector()
     return IRQ_APIC_SPURIOUS;
 }
 
+u8 APIC::ipi_interrupt_number()
+{
+    return IRQ_APIC_IPI;
+}
+
 #define APIC_INIT_VAR_PTR(tpe, vaddr, varname)                         \
     reinterpret_cast<volatile tpe*>(reinterpret_cast<ptrdiff_t>(vaddr) \
         + reinterpret_cast<ptrdiff_t>(&varname)                        \
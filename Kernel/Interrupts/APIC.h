@@ -52,6 +52,7 @@ public:
     void broadcast_ipi();
     void send_ipi(u32 cpu);
     static u8 spurious_interrupt_vector();
+    static u8 ipi_interrupt_number();
     Thread* get_idle_thread(u32 cpu) const;
     u32 enabled_processor_count() const { return m_processor_enabled_cnt; }
 
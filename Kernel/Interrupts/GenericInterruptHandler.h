@@ -37,7 +37,8 @@ enum class HandlerType : u8 {
     IRQHandler = 1,
     SharedIRQHandler = 2,
     UnhandledInterruptHandler = 3,
-    SpuriousInterruptHandler = 4
+    SpuriousInterruptHandler = 4,
+    MSIHandler = 5
 };
 
 class GenericInterruptHandler {
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Interrupts/APIC.h>
+#include <Kernel/Interrupts/InterruptManagement.h>
+#include <Kernel/Interrupts/MSIHandler.h>
+
+//#define MSI_DEBUG
+
+namespace Kernel {
+
+// Vectors 0x90-0xcf are above anything the IOAPIC redirects to and below the
+// APIC's own vectors, so they're free for us to hand out.
+static constexpr u8 first_msi_interrupt_number = 0x40;
+static constexpr u8 last_msi_interrupt_number = 0x7f;
+
+// Fixed delivery to the local APIC with ID 0, which is where the IOAPIC
+// sends everything else as well.
+static constexpr u32 msi_message_address = 0xfee00000;
+
+bool MSIHandler::is_supported(PCI::Address address)
+{
+    if (!InterruptManagement::the().smp_enabled() || !APIC::initialized())
+        return false;
+    return PCI::find_capability(address, PCI_CAPABILITY_MSI).has_value();
+}
+
+u8 MSIHandler::allocate_interrupt_number()
+{
+    for (u8 interrupt_number = first_msi_interrupt_number; interrupt_number <= last_msi_interrupt_number; interrupt_number++) {
+        if (get_interrupt_handler(interrupt_number).type() == HandlerType::UnhandledInterruptHandler)
+            return interrupt_number;
+    }
+    ASSERT_NOT_REACHED();
+}
+
+MSIHandler::MSIHandler(PCI::Address address)
+    : GenericInterruptHandler(allocate_interrupt_number(), true)
+    , m_pci_address(address)
+{
+    disable_irq();
+}
+
+MSIHandler::~MSIHandler()
+{
+}
+
+bool MSIHandler::eoi()
+{
+    APIC::the().eoi();
+    return true;
+}
+
+void MSIHandler::enable_irq()
+{
+#ifdef MSI_DEBUG
+    dbg() << "MSI: Enable vector " << String::format("%x", interrupt_number() + IRQ_VECTOR_BASE) << " for " << m_pci_address;
+#endif
+    m_enabled = true;
+    PCI::enable_message_signalled_interrupts(m_pci_address, msi_message_address, interrupt_number() + IRQ_VECTOR_BASE);
+}
+
+void MSIHandler::disable_irq()
+{
+#ifdef MSI_DEBUG
+    dbg() << "MSI: Disable vector " << String::format("%x", interrupt_number() + IRQ_VECTOR_BASE) << " for " << m_pci_address;
+#endif
+    m_enabled = false;
+    PCI::disable_message_signalled_interrupts(m_pci_address);
+}
+
+}
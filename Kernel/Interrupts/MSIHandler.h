@@ -33,27 +33,37 @@
 
 namespace Kernel {
 
-class MSIHandler final : public GenericInterruptHandler {
+class MSIHandler : public GenericInterruptHandler {
 public:
     virtual ~MSIHandler();
 
-    virtual void handle_interrupt(RegisterState&) override { }
+    // Messages go straight to the local APIC, so they can only be used if
+    // we're in APIC mode and the device has an MSI capability.
+    static bool is_supported(PCI::Address);
+
+    virtual void handle_interrupt(const RegisterState& regs) override { handle_msi(regs); }
+    virtual void handle_msi(const RegisterState&) = 0;
 
     void enable_irq();
     void disable_irq();
 
     virtual bool eoi() override;
 
+    virtual HandlerType type() const override { return HandlerType::MSIHandler; }
+    virtual const char* purpose() const override { return "MSI Handler"; }
+    virtual const char* controller() const override { return "APIC"; }
+
     virtual size_t sharing_devices_count() const override { return 0; }
     virtual bool is_shared_handler() const override { return false; }
-    virtual bool is_sharing_with_others() const override { return m_shared_with_others; }
+    virtual bool is_sharing_with_others() const override { return false; }
 
 protected:
-    void change_irq_number(u8 irq);
     explicit MSIHandler(PCI::Address);
 
 private:
-    bool m_shared_with_others;
-    bool m_enabled;
+    static u8 allocate_interrupt_number();
+
+    PCI::Address m_pci_address;
+    bool m_enabled { false };
 };
 }
@@ -24,9 +24,11 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/StringImpl.h>
 #include <AK/TemporaryChange.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Lock.h>
+#include <Kernel/StdLib.h>
 #include <Kernel/Thread.h>
 
 //#define LOCK_TRACE_DEBUG
@@ -34,6 +36,105 @@
 
 namespace Kernel {
 
+static constexpr size_t max_lock_statistics = 256;
+static constexpr size_t lock_statistics_hash_size = 512;
+
+// Cycles spent spinning on a lock whose holder is running, before going to sleep.
+static constexpr u64 max_spin_cycles = 20000;
+
+LockStatistics Lock::s_statistics[max_lock_statistics];
+Atomic<size_t> Lock::s_statistics_count;
+static u16 s_statistics_by_hash[lock_statistics_hash_size];
+static SpinLock<u8> s_statistics_lock;
+
+LockStatistics& Lock::statistics()
+{
+    if (auto* statistics = m_statistics)
+        return *statistics;
+
+    const char* name = m_name ? m_name : "unnamed";
+    size_t name_length = strnlen(name, LockStatistics::max_name_length - 1);
+    size_t index = string_hash(name, name_length) % lock_statistics_hash_size;
+
+    ScopedSpinLock lock(s_statistics_lock);
+    for (;;) {
+        u16 slot = s_statistics_by_hash[index];
+        if (!slot)
+            break;
+        auto& statistics = s_statistics[slot - 1];
+        if (!strncmp(statistics.name, name, name_length) && !statistics.name[name_length]) {
+            m_statistics = &statistics;
+            return statistics;
+        }
+        index = (index + 1) % lock_statistics_hash_size;
+    }
+
+    size_t count = s_statistics_count.load(AK::MemoryOrder::memory_order_relaxed);
+    if (count >= max_lock_statistics - 1) {
+        // Out of entries, lump everything else together.
+        auto& other = s_statistics[max_lock_statistics - 1];
+        if (count == max_lock_statistics - 1) {
+            memcpy(other.name, "(other)", sizeof("(other)"));
+            s_statistics_count.store(max_lock_statistics, AK::MemoryOrder::memory_order_release);
+        }
+        m_statistics = &other;
+        return other;
+    }
+    auto& statistics = s_statistics[count];
+    memcpy(statistics.name, name, name_length);
+    statistics.name[name_length] = '\0';
+    s_statistics_by_hash[index] = count + 1;
+    s_statistics_count.store(count + 1, AK::MemoryOrder::memory_order_release);
+    m_statistics = &statistics;
+    return statistics;
+}
+
+void Lock::did_acquire(u64 wait_start)
+{
+    auto& statistics = this->statistics();
+    statistics.acquisitions.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+    if (!wait_start)
+        return;
+    u64 waited = read_tsc() - wait_start;
+    ScopedSpinLock lock(statistics.wait_lock);
+    statistics.wait_cycles += waited;
+    if (waited > statistics.max_wait_cycles)
+        statistics.max_wait_cycles = waited;
+}
+
+bool Lock::spin_while_holder_is_running(const Thread* holder)
+{
+    if (Processor::count() == 1)
+        return false;
+
+    auto is_running_elsewhere = [&] {
+        auto& current_processor = Processor::current();
+        bool is_running = false;
+        Processor::for_each([&](Processor& processor) {
+            if (&processor != &current_processor && processor.current_thread() == holder) {
+                is_running = true;
+                return IterationDecision::Break;
+            }
+            return IterationDecision::Continue;
+        });
+        return is_running;
+    };
+
+    u64 spin_start = read_tsc();
+    while (is_running_elsewhere()) {
+        if (m_mode.load(AK::MemoryOrder::memory_order_relaxed) == Mode::Unlocked) {
+            statistics().spin_acquisitions.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+            return true;
+        }
+        if (read_tsc() - spin_start > max_spin_cycles)
+            return false;
+        Processor::wait_check();
+        asm volatile("pause");
+    }
+    // The holder went to sleep (or let go of the lock just as it did).
+    return m_mode.load(AK::MemoryOrder::memory_order_relaxed) == Mode::Unlocked;
+}
+
 #ifdef LOCK_DEBUG
 void Lock::lock(Mode mode)
 {
@@ -51,79 +152,102 @@ void Lock::lock(Mode mode)
     ASSERT(mode != Mode::Unlocked);
     auto current_thread = Thread::current();
     ScopedCritical critical; // in case we're not in a critical section already
+    u64 wait_start = 0;
+    bool did_spin = false;
     for (;;) {
         if (m_lock.exchange(true, AK::memory_order_acq_rel) == false) {
-            do {
-                // FIXME: Do not add new readers if writers are queued.
-                auto current_mode = m_mode.load(AK::MemoryOrder::memory_order_relaxed);
-                switch (current_mode) {
-                case Mode::Unlocked: {
+            // FIXME: Do not add new readers if writers are queued.
+            auto current_mode = m_mode.load(AK::MemoryOrder::memory_order_relaxed);
+            switch (current_mode) {
+            case Mode::Unlocked: {
 #ifdef LOCK_TRACE_DEBUG
-                    dbg() << "Lock::lock @ " << this << ": acquire " << mode_to_string(mode) << ", currently unlocked";
+                dbg() << "Lock::lock @ " << this << ": acquire " << mode_to_string(mode) << ", currently unlocked";
 #endif
-                    m_mode.store(mode, AK::MemoryOrder::memory_order_relaxed);
-                    ASSERT(!m_holder);
-                    ASSERT(m_shared_holders.is_empty());
-                    if (mode == Mode::Exclusive) {
-                        m_holder = current_thread;
-                    } else {
-                        ASSERT(mode == Mode::Shared);
-                        m_shared_holders.set(current_thread, 1);
-                    }
-                    ASSERT(m_times_locked == 0);
-                    m_times_locked++;
+                m_mode.store(mode, AK::MemoryOrder::memory_order_relaxed);
+                ASSERT(!m_holder);
+                ASSERT(m_shared_holders.is_empty());
+                if (mode == Mode::Exclusive) {
+                    m_holder = current_thread;
+                } else {
+                    ASSERT(mode == Mode::Shared);
+                    m_shared_holders.set(current_thread, 1);
+                }
+                ASSERT(m_times_locked == 0);
+                m_times_locked++;
 #ifdef LOCK_DEBUG
-                    current_thread->holding_lock(*this, 1, file, line);
+                current_thread->holding_lock(*this, 1, file, line);
 #endif
-                    m_lock.store(false, AK::memory_order_release);
-                    return;
-                }
-                case Mode::Exclusive: {
-                    ASSERT(m_holder);
-                    if (m_holder != current_thread)
-                        break;
-                    ASSERT(m_shared_holders.is_empty());
+                m_lock.store(false, AK::memory_order_release);
+                did_acquire(wait_start);
+                return;
+            }
+            case Mode::Exclusive: {
+                ASSERT(m_holder);
+                if (m_holder != current_thread)
+                    break;
+                ASSERT(m_shared_holders.is_empty());
 #ifdef LOCK_TRACE_DEBUG
-                    if (mode == Mode::Exclusive)
-                        dbg() << "Lock::lock @ " << this << ": acquire " << mode_to_string(mode) << ", currently exclusive, holding: " << m_times_locked;
-                    else
-                        dbg() << "Lock::lock @ " << this << ": acquire exclusive (requested " << mode_to_string(mode) << "), currently exclusive, holding " << m_times_locked;
+                if (mode == Mode::Exclusive)
+                    dbg() << "Lock::lock @ " << this << ": acquire " << mode_to_string(mode) << ", currently exclusive, holding: " << m_times_locked;
+                else
+                    dbg() << "Lock::lock @ " << this << ": acquire exclusive (requested " << mode_to_string(mode) << "), currently exclusive, holding " << m_times_locked;
 #endif
-                    ASSERT(mode == Mode::Exclusive || mode == Mode::Shared);
-                    ASSERT(m_times_locked > 0);
-                    m_times_locked++;
+                ASSERT(mode == Mode::Exclusive || mode == Mode::Shared);
+                ASSERT(m_times_locked > 0);
+                m_times_locked++;
 #ifdef LOCK_DEBUG
-                    current_thread->holding_lock(*this, 1, file, line);
+                current_thread->holding_lock(*this, 1, file, line);
 #endif
-                    m_lock.store(false, AK::memory_order_release);
-                    return;
-                }
-                case Mode::Shared: {
-                    ASSERT(!m_holder);
-                    if (mode != Mode::Shared)
-                        break;
+                m_lock.store(false, AK::memory_order_release);
+                did_acquire(wait_start);
+                return;
+            }
+            case Mode::Shared: {
+                ASSERT(!m_holder);
+                if (mode != Mode::Shared)
+                    break;
 #ifdef LOCK_TRACE_DEBUG
-                    dbg() << "Lock::lock @ " << this << ": acquire " << mode_to_string(mode) << ", currently shared, locks held: " << m_times_locked;
+                dbg() << "Lock::lock @ " << this << ": acquire " << mode_to_string(mode) << ", currently shared, locks held: " << m_times_locked;
 #endif
-                    ASSERT(m_times_locked > 0);
-                    m_times_locked++;
-                    ASSERT(!m_shared_holders.is_empty());
-                    auto it = m_shared_holders.find(current_thread);
-                    if (it != m_shared_holders.end())
-                        it->value++;
-                    else
-                        m_shared_holders.set(current_thread, 1);
+                ASSERT(m_times_locked > 0);
+                m_times_locked++;
+                ASSERT(!m_shared_holders.is_empty());
+                auto it = m_shared_holders.find(current_thread);
+                if (it != m_shared_holders.end())
+                    it->value++;
+                else
+                    m_shared_holders.set(current_thread, 1);
 #ifdef LOCK_DEBUG
-                    current_thread->holding_lock(*this, 1, file, line);
+                current_thread->holding_lock(*this, 1, file, line);
 #endif
-                    m_lock.store(false, AK::memory_order_release);
-                    return;
-                }
-                default:
-                    ASSERT_NOT_REACHED();
-                }
                 m_lock.store(false, AK::memory_order_release);
-            } while (m_queue.wait_on(nullptr, m_name) == Thread::BlockResult::NotBlocked);
+                did_acquire(wait_start);
+                return;
+            }
+            default:
+                ASSERT_NOT_REACHED();
+            }
+
+            // Someone else has it.
+            if (!wait_start) {
+                wait_start = read_tsc();
+                statistics().contended.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+            }
+            Thread* holder = current_mode == Mode::Exclusive ? m_holder.ptr() : nullptr;
+            m_lock.store(false, AK::memory_order_release);
+
+            // If the holder is running on another processor, it will probably
+            // release the lock before we'd even be done going to sleep.
+            if (!did_spin && holder) {
+                did_spin = true;
+                if (spin_while_holder_is_running(holder))
+                    continue;
+            }
+
+            statistics().sleeps.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+            m_queue.wait_on(nullptr, m_name);
+            // Once woken up, the holder may be back on a processor.
+            did_spin = false;
         } else {
             // I don't know *who* is using "m_lock", so just yield.
             Scheduler::yield_from_critical();
@@ -33,10 +33,29 @@
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/Forward.h>
 #include <Kernel/LockMode.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/WaitQueue.h>
 
 namespace Kernel {
 
+// Contention statistics, shared by all locks with the same name.
+struct LockStatistics {
+    static constexpr size_t max_name_length = 32;
+
+    char name[max_name_length];
+    Atomic<u32> acquisitions { 0 };
+    // Acquisitions that had to wait for another holder.
+    Atomic<u32> contended { 0 };
+    // Contended acquisitions that succeeded by spinning, without sleeping.
+    Atomic<u32> spin_acquisitions { 0 };
+    Atomic<u32> sleeps { 0 };
+
+    // Only updated on the contended path, so a spinlock is cheap enough here.
+    SpinLock<u8> wait_lock;
+    u64 wait_cycles { 0 };
+    u64 max_wait_cycles { 0 };
+};
+
 class Lock {
     AK_MAKE_NONCOPYABLE(Lock);
     AK_MAKE_NONMOVABLE(Lock);
@@ -63,6 +82,14 @@ public:
 
     const char* name() const { return m_name; }
 
+    template<typename Callback>
+    static void for_each_statistics(Callback callback)
+    {
+        size_t count = s_statistics_count.load(AK::MemoryOrder::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i)
+            callback(s_statistics[i]);
+    }
+
     static const char* mode_to_string(Mode mode)
     {
         switch (mode) {
@@ -78,6 +105,13 @@ public:
     }
 
 private:
+    LockStatistics& statistics();
+    void did_acquire(u64 wait_start);
+    bool spin_while_holder_is_running(const Thread* holder);
+
+    static LockStatistics s_statistics[];
+    static Atomic<size_t> s_statistics_count;
+
     Atomic<bool> m_lock { false };
     const char* m_name { nullptr };
     WaitQueue m_queue;
@@ -94,6 +128,8 @@ private:
     // lock.
     RefPtr<Thread> m_holder;
     HashMap<Thread*, u32> m_shared_holders;
+
+    LockStatistics* m_statistics { nullptr };
 };
 
 class Locker {
@@ -140,6 +140,14 @@ namespace Kernel {
 #define INTERRUPT_TXD_LOW (1 << 15)
 #define INTERRUPT_SRPD (1 << 16)
 
+#define INTERRUPT_RX (INTERRUPT_RXT0 | INTERRUPT_RXO | INTERRUPT_RXDMT0)
+
+// The interrupt throttling register counts in units of 256 nanoseconds.
+#define ITR_FOR_INTERRUPTS_PER_SECOND(rate) (1000000000 / (256 * (rate)))
+#define ITR_LOWEST_LATENCY ITR_FOR_INTERRUPTS_PER_SECOND(70000)
+#define ITR_LOW_LATENCY ITR_FOR_INTERRUPTS_PER_SECOND(20000)
+#define ITR_BULK_LATENCY ITR_FOR_INTERRUPTS_PER_SECOND(4000)
+
 void E1000NetworkAdapter::detect()
 {
     static const PCI::ID qemu_bochs_vbox_id = { 0x8086, 0x100e };
@@ -186,13 +194,14 @@ E1000NetworkAdapter::E1000NetworkAdapter(PCI::Address address, u8 irq)
 
     // FIXME: For some reason, this causes an MMIO fault on VirtualBox.
     //        Removing it allows the system to boot to desktop, but will be hit by an interrupt storm soon after.
-    out16(REG_INTERRUPT_RATE, 6000); // Interrupt rate of 1.536 milliseconds
+    // This is adjusted to the traffic we see later on, see update_interrupt_rate().
+    out32(REG_INTERRUPT_RATE, ITR_LOW_LATENCY);
 
     initialize_rx_descriptors();
     initialize_tx_descriptors();
 
-    out32(REG_INTERRUPT_MASK_SET, 0x1f6dc);
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0);
+    out32(REG_INTERRUPT_MASK_CLEAR, 0xffffffff);
+    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_TXDW | INTERRUPT_RX);
     in32(REG_INTERRUPT_CAUSE_READ);
 
     enable_irq();
@@ -204,26 +213,22 @@ E1000NetworkAdapter::~E1000NetworkAdapter()
 
 void E1000NetworkAdapter::handle_irq(const RegisterState&)
 {
-    out32(REG_INTERRUPT_MASK_CLEAR, 0xffffffff);
-
     u32 status = in32(REG_INTERRUPT_CAUSE_READ);
 
     m_entropy_source.add_random_event(status);
 
-    if (status & 4) {
+    if (status & INTERRUPT_LSC) {
         u32 flags = in32(REG_CTRL);
         out32(REG_CTRL, flags | ECTRL_SLU);
     }
-    if (status & 0x80) {
-        receive();
-    }
-    if (status & 0x10) {
-        // Threshold OK?
+    if (status & INTERRUPT_RX) {
+        // Leave the receive interrupts masked until the network task has
+        // drained the ring, see poll_receive().
+        out32(REG_INTERRUPT_MASK_CLEAR, INTERRUPT_RX);
+        schedule_receive_poll();
     }
-
-    m_wait_queue.wake_all();
-
-    out32(REG_INTERRUPT_MASK_SET, INTERRUPT_LSC | INTERRUPT_RXT0 | INTERRUPT_RXO);
+    if (status & INTERRUPT_TXDW)
+        m_wait_queue.wake_all();
 }
 
 void E1000NetworkAdapter::detect_eeprom()
@@ -282,15 +287,18 @@ bool E1000NetworkAdapter::link_up()
 
 void E1000NetworkAdapter::initialize_rx_descriptors()
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    // Buffers never cross a page boundary, so they don't need to be physically contiguous.
+    static_assert(PAGE_SIZE % rx_buffer_size == 0);
+    m_rx_buffers_region = MM.allocate_kernel_region(number_of_rx_descriptors * rx_buffer_size, "E1000 RX buffers", Region::Access::Read | Region::Access::Write);
+    ASSERT(m_rx_buffers_region);
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
     for (size_t i = 0; i < number_of_rx_descriptors; ++i) {
         auto& descriptor = rx_descriptors[i];
-        auto region = MM.allocate_contiguous_kernel_region(8192, "E1000 RX buffer", Region::Access::Read | Region::Access::Write);
-        ASSERT(region);
-        m_rx_buffers_regions.append(region.release_nonnull());
-        descriptor.addr = m_rx_buffers_regions[i].physical_page(0)->paddr().get();
+        size_t offset = i * rx_buffer_size;
+        descriptor.addr = m_rx_buffers_region->physical_page(offset / PAGE_SIZE)->paddr().offset(offset % PAGE_SIZE).get();
         descriptor.status = 0;
     }
+    m_rx_tail = number_of_rx_descriptors - 1;
 
     out32(REG_RXDESCLO, m_rx_descriptors_region->physical_page(0)->paddr().get());
     out32(REG_RXDESCHI, 0);
@@ -298,7 +306,7 @@ void E1000NetworkAdapter::initialize_rx_descriptors()
     out32(REG_RXDESCHEAD, 0);
     out32(REG_RXDESCTAIL, number_of_rx_descriptors - 1);
 
-    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_8192);
+    out32(REG_RCTRL, RCTL_EN | RCTL_SBP | RCTL_UPE | RCTL_MPE | RCTL_LBM_NONE | RTCL_RDMTS_HALF | RCTL_BAM | RCTL_SECRC | RCTL_BSIZE_2048);
 }
 
 void E1000NetworkAdapter::initialize_tx_descriptors()
@@ -426,27 +434,89 @@ void E1000NetworkAdapter::send_raw(ReadonlyBytes payload)
 #endif
 }
 
-void E1000NetworkAdapter::receive()
+size_t E1000NetworkAdapter::poll_receive(size_t budget)
 {
-    auto* rx_descriptors = (e1000_tx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
-    u32 rx_current;
-    for (;;) {
-        rx_current = in32(REG_RXDESCTAIL) % number_of_rx_descriptors;
-        if (rx_current == (in32(REG_RXDESCHEAD) % number_of_rx_descriptors))
-            return;
-        rx_current = (rx_current + 1) % number_of_rx_descriptors;
-        if (!(rx_descriptors[rx_current].status & 1))
+    auto* rx_descriptors = (e1000_rx_desc*)m_rx_descriptors_region->vaddr().as_ptr();
+    size_t packets = 0;
+    size_t bytes = 0;
+    u32 rx_current = m_rx_tail;
+    while (packets < budget) {
+        u32 rx_next = (rx_current + 1) % number_of_rx_descriptors;
+        auto& descriptor = rx_descriptors[rx_next];
+        if (!(descriptor.status & 1))
             break;
-        auto* buffer = m_rx_buffers_regions[rx_current].vaddr().as_ptr();
-        u16 length = rx_descriptors[rx_current].length;
-        ASSERT(length <= 8192);
+        auto* buffer = m_rx_buffers_region->vaddr().offset(rx_next * rx_buffer_size).as_ptr();
+        u16 length = descriptor.length;
+        ASSERT(length <= rx_buffer_size);
 #ifdef E1000_DEBUG
         klog() << "E1000: Received 1 packet @ " << buffer << " (" << length << ") bytes!";
 #endif
         did_receive({ buffer, length });
-        rx_descriptors[rx_current].status = 0;
-        out32(REG_RXDESCTAIL, rx_current);
+        descriptor.status = 0;
+        rx_current = rx_next;
+        packets++;
+        bytes += length;
+    }
+
+    // Hand the whole batch back to the hardware with a single register write.
+    if (rx_current != m_rx_tail) {
+        m_rx_tail = rx_current;
+        out32(REG_RXDESCTAIL, m_rx_tail);
+    }
+
+    if (packets < budget) {
+        update_interrupt_rate(packets, bytes);
+        // If another packet arrived in the meantime, its interrupt cause is
+        // still latched and fires as soon as we unmask it.
+        out32(REG_INTERRUPT_MASK_SET, INTERRUPT_RX);
+    }
+    return packets;
+}
+
+void E1000NetworkAdapter::update_interrupt_rate(size_t packets, size_t bytes)
+{
+    if (!packets)
+        return;
+
+    // Roughly the classification the e1000 driver in Linux does: a trickle of
+    // small packets is probably interactive and gets the lowest latency,
+    // while full-sized packets are better off with fewer interrupts.
+    auto latency_class = m_latency_class;
+    size_t average_size = bytes / packets;
+    switch (m_latency_class) {
+    case LatencyClass::Lowest:
+        if (bytes > 10000 || average_size > 1200)
+            latency_class = LatencyClass::Low;
+        break;
+    case LatencyClass::Low:
+        if (bytes > 10000 && (average_size > 1200 || packets > 35))
+            latency_class = LatencyClass::Bulk;
+        else if (bytes < 1500 && packets < 5)
+            latency_class = LatencyClass::Lowest;
+        break;
+    case LatencyClass::Bulk:
+        if (bytes < 6000)
+            latency_class = LatencyClass::Low;
+        break;
+    }
+
+    if (latency_class == m_latency_class)
+        return;
+    m_latency_class = latency_class;
+
+    u32 itr = 0;
+    switch (latency_class) {
+    case LatencyClass::Lowest:
+        itr = ITR_LOWEST_LATENCY;
+        break;
+    case LatencyClass::Low:
+        itr = ITR_LOW_LATENCY;
+        break;
+    case LatencyClass::Bulk:
+        itr = ITR_BULK_LATENCY;
+        break;
     }
+    out32(REG_INTERRUPT_RATE, itr);
 }
 
 }
@@ -53,6 +53,7 @@ public:
 private:
     virtual void handle_irq(const RegisterState&) override;
     virtual const char* class_name() const override { return "E1000NetworkAdapter"; }
+    virtual size_t poll_receive(size_t budget) override;
 
     struct [[gnu::packed]] e1000_rx_desc
     {
@@ -92,22 +93,30 @@ private:
     u16 in16(u16 address);
     u32 in32(u16 address);
 
-    void receive();
+    enum class LatencyClass {
+        Lowest,
+        Low,
+        Bulk,
+    };
+    void update_interrupt_rate(size_t packets, size_t bytes);
 
     IOAddress m_io_base;
     VirtualAddress m_mmio_base;
     OwnPtr<Region> m_rx_descriptors_region;
     OwnPtr<Region> m_tx_descriptors_region;
-    NonnullOwnPtrVector<Region> m_rx_buffers_regions;
+    OwnPtr<Region> m_rx_buffers_region;
     NonnullOwnPtrVector<Region> m_tx_buffers_regions;
     OwnPtr<Region> m_mmio_region;
     u8 m_interrupt_line { 0 };
     bool m_has_eeprom { false };
     bool m_use_mmio { false };
+    u32 m_rx_tail { 0 };
+    LatencyClass m_latency_class { LatencyClass::Low };
     EntropySource m_entropy_source;
 
-    static const size_t number_of_rx_descriptors = 32;
+    static const size_t number_of_rx_descriptors = 256;
     static const size_t number_of_tx_descriptors = 8;
+    static const size_t rx_buffer_size = 2048;
 
     WaitQueue m_wait_queue;
 };
@@ -64,8 +64,9 @@ KResultOr<NonnullRefPtr<Socket>> IPv4Socket::create(int type, int protocol)
     return KResult(-EINVAL);
 }
 
-IPv4Socket::IPv4Socket(int type, int protocol)
+IPv4Socket::IPv4Socket(int type, int protocol, size_t receive_buffer_size)
     : Socket(AF_INET, type, protocol)
+    , m_receive_buffer(receive_buffer_size)
 {
 #ifdef IPV4_SOCKET_DEBUG
     dbg() << "IPv4Socket{" << this << "} created with type=" << type << ", protocol=" << protocol;
@@ -203,9 +204,9 @@ int IPv4Socket::allocate_local_port_if_needed()
     return port;
 }
 
-KResultOr<size_t> IPv4Socket::sendto(FileDescription&, const UserOrKernelBuffer& data, size_t data_length, [[maybe_unused]] int flags, Userspace<const sockaddr*> addr, socklen_t addr_length)
+KResultOr<size_t> IPv4Socket::sendto(FileDescription& description, const UserOrKernelBuffer& data, size_t data_length, [[maybe_unused]] int flags, Userspace<const sockaddr*> addr, socklen_t addr_length)
 {
-    LOCKER(lock());
+    Locker locker(lock());
 
     if (addr && addr_length != sizeof(sockaddr_in))
         return KResult(-EINVAL);
@@ -246,6 +247,20 @@ KResultOr<size_t> IPv4Socket::sendto(FileDescription&, const UserOrKernelBuffer&
         return data_length;
     }
 
+    if (type() == SOCK_STREAM) {
+        // Stream protocols buffer what they send, so wait for some room.
+        while (is_connected() && !can_write(description, data_length)) {
+            if (!description.is_blocking())
+                return KResult(-EAGAIN);
+            locker.unlock();
+            auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+            auto result = Thread::current()->block<Thread::WriteBlocker>(nullptr, description, unblock_flags);
+            locker.lock();
+            if (result.was_interrupted())
+                return KResult(-EINTR);
+        }
+    }
+
     auto nsent_or_error = protocol_send(data, data_length);
     if (!nsent_or_error.is_error())
         Thread::current()->did_ipv4_socket_write(nsent_or_error.value());
@@ -281,6 +296,8 @@ KResultOr<size_t> IPv4Socket::receive_byte_buffered(FileDescription& description
         Thread::current()->did_ipv4_socket_read((size_t)nreceived);
 
     set_can_read(!m_receive_buffer.is_empty());
+    if (nreceived > 0)
+        protocol_did_read_bytes();
     return nreceived;
 }
 
@@ -432,6 +449,20 @@ bool IPv4Socket::did_receive(const IPv4Address& source_address, u16 source_port,
     return true;
 }
 
+size_t IPv4Socket::did_receive_bytes(ReadonlyBytes bytes)
+{
+    ASSERT(buffer_mode() == BufferMode::Bytes);
+    if (is_shut_down_for_reading() || bytes.is_empty())
+        return 0;
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(bytes.data()));
+    ssize_t nwritten = m_receive_buffer.write(buffer, bytes.size());
+    if (nwritten <= 0)
+        return 0;
+    m_bytes_received += nwritten;
+    set_can_read(true);
+    return nwritten;
+}
+
 String IPv4Socket::absolute_path(const FileDescription&) const
 {
     if (m_role == Role::None)
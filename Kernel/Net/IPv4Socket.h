@@ -89,7 +89,7 @@ public:
     BufferMode buffer_mode() const { return m_buffer_mode; }
 
 protected:
-    IPv4Socket(int type, int protocol);
+    IPv4Socket(int type, int protocol, size_t receive_buffer_size = 65536);
     virtual const char* class_name() const override { return "IPv4Socket"; }
 
     int allocate_local_port_if_needed();
@@ -101,12 +101,18 @@ protected:
     virtual KResult protocol_connect(FileDescription&, ShouldBlock) { return KSuccess; }
     virtual int protocol_allocate_local_port() { return 0; }
     virtual bool protocol_is_disconnected() const { return false; }
+    virtual void protocol_did_read_bytes() { }
 
     virtual void shut_down_for_reading() override;
 
     void set_local_address(IPv4Address address) { m_local_address = address; }
     void set_peer_address(IPv4Address address) { m_peer_address = address; }
 
+    // For byte-buffered protocols that reassemble the stream themselves.
+    // Returns how many bytes fit into the receive buffer.
+    size_t did_receive_bytes(ReadonlyBytes);
+    size_t receive_buffer_space() const { return m_receive_buffer.space_for_writing(); }
+
 private:
     virtual bool is_ipv4() const override { return true; }
 
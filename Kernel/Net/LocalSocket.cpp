@@ -292,7 +292,7 @@ KResultOr<size_t> LocalSocket::sendto(FileDescription& description, const UserOr
     return nwritten;
 }
 
-DoubleBuffer& LocalSocket::receive_buffer_for(FileDescription& description)
+PageRingBuffer& LocalSocket::receive_buffer_for(FileDescription& description)
 {
     auto role = this->role(description);
     if (role == Role::Accepted)
@@ -302,7 +302,7 @@ DoubleBuffer& LocalSocket::receive_buffer_for(FileDescription& description)
     ASSERT_NOT_REACHED();
 }
 
-DoubleBuffer& LocalSocket::send_buffer_for(FileDescription& description)
+PageRingBuffer& LocalSocket::send_buffer_for(FileDescription& description)
 {
     auto role = this->role(description);
     if (role == Role::Connected)
@@ -312,6 +312,41 @@ DoubleBuffer& LocalSocket::send_buffer_for(FileDescription& description)
     ASSERT_NOT_REACHED();
 }
 
+KResultOr<size_t> LocalSocket::buffer_capacity(const FileDescription&) const
+{
+    return max(m_for_client.capacity(), m_for_server.capacity());
+}
+
+KResult LocalSocket::set_buffer_capacity(FileDescription&, size_t capacity)
+{
+    // We resize both directions, so the capacity applies to whatever this socket is used for.
+    auto result = m_for_client.set_capacity(capacity);
+    if (result.is_error())
+        return result;
+    return m_for_server.set_capacity(capacity);
+}
+
+PageRingBuffer* LocalSocket::buffer_for_reading(FileDescription& description)
+{
+    auto role = this->role(description);
+    if (role != Role::Accepted && role != Role::Connected)
+        return nullptr;
+    auto& buffer = receive_buffer_for(description);
+    if (buffer.is_empty())
+        return nullptr;
+    return &buffer;
+}
+
+PageRingBuffer* LocalSocket::buffer_for_writing(FileDescription& description)
+{
+    auto role = this->role(description);
+    if (role != Role::Accepted && role != Role::Connected)
+        return nullptr;
+    if (!has_attached_peer(description))
+        return nullptr;
+    return &send_buffer_for(description);
+}
+
 KResultOr<size_t> LocalSocket::recvfrom(FileDescription& description, UserOrKernelBuffer& buffer, size_t buffer_size, int, Userspace<sockaddr*>, Userspace<socklen_t*>, timeval&)
 {
     auto& buffer_for_me = receive_buffer_for(description);
@@ -27,8 +27,8 @@
 #pragma once
 
 #include <AK/InlineLinkedList.h>
-#include <Kernel/DoubleBuffer.h>
 #include <Kernel/Net/Socket.h>
+#include <Kernel/PageRingBuffer.h>
 
 namespace Kernel {
 
@@ -65,6 +65,10 @@ public:
     virtual KResult getsockopt(FileDescription&, int level, int option, Userspace<void*>, Userspace<socklen_t*>) override;
     virtual KResult chown(FileDescription&, uid_t, gid_t) override;
     virtual KResult chmod(FileDescription&, mode_t) override;
+    virtual KResultOr<size_t> buffer_capacity(const FileDescription&) const override;
+    virtual KResult set_buffer_capacity(FileDescription&, size_t) override;
+    virtual PageRingBuffer* buffer_for_reading(FileDescription&) override;
+    virtual PageRingBuffer* buffer_for_writing(FileDescription&) override;
 
 private:
     explicit LocalSocket(int type);
@@ -72,8 +76,8 @@ private:
     virtual bool is_local() const override { return true; }
     bool has_attached_peer(const FileDescription&) const;
     static Lockable<InlineLinkedList<LocalSocket>>& all_sockets();
-    DoubleBuffer& receive_buffer_for(FileDescription&);
-    DoubleBuffer& send_buffer_for(FileDescription&);
+    PageRingBuffer& receive_buffer_for(FileDescription&);
+    PageRingBuffer& send_buffer_for(FileDescription&);
     NonnullRefPtrVector<FileDescription>& sendfd_queue_for(const FileDescription&);
     NonnullRefPtrVector<FileDescription>& recvfd_queue_for(const FileDescription&);
 
@@ -110,8 +114,12 @@ private:
     bool m_accept_side_fd_open { false };
     sockaddr_un m_address { 0, { 0 } };
 
-    DoubleBuffer m_for_client;
-    DoubleBuffer m_for_server;
+    // Buffer memory is only allocated while data is in flight, so we can afford a larger
+    // window than pipes get. This cuts down on block/wake round trips for big IPC messages.
+    static constexpr size_t default_buffer_capacity = 256 * KiB;
+
+    PageRingBuffer m_for_client { default_buffer_capacity };
+    PageRingBuffer m_for_server { default_buffer_capacity };
 
     NonnullRefPtrVector<FileDescription> m_fds_for_client;
     NonnullRefPtrVector<FileDescription> m_fds_for_server;
@@ -77,6 +77,7 @@ RefPtr<NetworkAdapter> NetworkAdapter::lookup_by_name(const StringView& name)
 
 NetworkAdapter::NetworkAdapter()
 {
+    m_unused_packet_buffers.ensure_capacity(max_unused_packet_buffers);
     // FIXME: I wanna lock :(
     all_adapters().resource().set(this);
 }
@@ -178,43 +179,82 @@ void NetworkAdapter::did_receive(ReadonlyBytes payload)
     m_packets_in++;
     m_bytes_in += payload.size();
 
-    Optional<KBuffer> buffer;
+    if (m_packet_queue.size() == max_queued_packets) {
+        m_packets_dropped++;
+        return;
+    }
 
-    if (m_unused_packet_buffers.is_empty()) {
-        buffer = KBuffer::copy(payload.data(), payload.size());
+    Optional<KBuffer> buffer;
+    if (!m_unused_packet_buffers.is_empty() && payload.size() <= m_unused_packet_buffers.last().capacity()) {
+        buffer = m_unused_packet_buffers.take_last();
+        memcpy(buffer.value().data(), payload.data(), payload.size());
+        buffer.value().set_size(payload.size());
     } else {
-        buffer = m_unused_packet_buffers.take_first();
-        --m_unused_packet_buffers_count;
-        if (payload.size() <= buffer.value().size()) {
-            memcpy(buffer.value().data(), payload.data(), payload.size());
-            buffer.value().set_size(payload.size());
-        } else {
-            buffer = KBuffer::copy(payload.data(), payload.size());
+        auto new_buffer = KBuffer::try_create_with_bytes(payload, Region::Access::Read | Region::Access::Write, "Packet Buffer");
+        if (!new_buffer) {
+            m_packets_dropped++;
+            return;
         }
+        buffer = *new_buffer;
     }
 
-    m_packet_queue.append({ buffer.value(), kgettimeofday() });
+    m_packet_queue.enqueue({ buffer.release_value(), kgettimeofday() });
 
     if (on_receive)
         on_receive();
 }
 
-size_t NetworkAdapter::dequeue_packet(u8* buffer, size_t buffer_size, timeval& packet_timestamp)
+void NetworkAdapter::schedule_receive_poll()
 {
-    InterruptDisabler disabler;
-    if (m_packet_queue.is_empty())
-        return 0;
-    auto packet_with_timestamp = m_packet_queue.take_first();
-    packet_timestamp = packet_with_timestamp.timestamp;
-    auto packet = move(packet_with_timestamp.packet);
-    size_t packet_size = packet.size();
-    ASSERT(packet_size <= buffer_size);
-    memcpy(buffer, packet.data(), packet_size);
-    if (m_unused_packet_buffers_count < 100) {
-        m_unused_packet_buffers.append(packet);
-        ++m_unused_packet_buffers_count;
+    m_receive_poll_scheduled.store(true, AK::MemoryOrder::memory_order_release);
+    if (on_receive)
+        on_receive();
+}
+
+bool NetworkAdapter::poll(size_t budget, Function<void(ReadonlyBytes, const timeval&)> callback)
+{
+    budget = min(budget, max_poll_batch);
+
+    if (m_receive_poll_scheduled.exchange(false, AK::MemoryOrder::memory_order_acq_rel)) {
+        // The driver keeps its interrupt masked for as long as it fills the
+        // budget, so nobody else is going to reschedule us.
+        if (poll_receive(budget) >= budget)
+            m_receive_poll_scheduled.store(true, AK::MemoryOrder::memory_order_release);
     }
-    return packet_size;
+
+    // Take the whole batch out of the queue at once, and give the buffers back
+    // at once, instead of disabling interrupts around every single packet.
+    Vector<PacketWithTimestamp, max_poll_batch> batch;
+    {
+        InterruptDisabler disabler;
+        while (batch.size() < budget && !m_packet_queue.is_empty())
+            batch.unchecked_append(m_packet_queue.dequeue());
+    }
+
+    for (auto& packet : batch)
+        callback({ packet.packet.data(), packet.packet.size() }, packet.timestamp);
+
+    {
+        InterruptDisabler disabler;
+        for (auto& packet : batch) {
+            if (m_unused_packet_buffers.size() == max_unused_packet_buffers)
+                break;
+            m_unused_packet_buffers.unchecked_append(move(packet.packet));
+        }
+        return m_receive_poll_scheduled.load(AK::MemoryOrder::memory_order_relaxed) || !m_packet_queue.is_empty();
+    }
+}
+
+void NetworkAdapter::update_packet_rates(u64 now_ms)
+{
+    if (now_ms - m_last_sample_ms < 1000)
+        return;
+    u64 elapsed_ms = now_ms - m_last_sample_ms;
+    m_packets_in_per_second = (u64)(m_packets_in - m_packets_in_at_last_sample) * 1000 / elapsed_ms;
+    m_packets_out_per_second = (u64)(m_packets_out - m_packets_out_at_last_sample) * 1000 / elapsed_ms;
+    m_packets_in_at_last_sample = m_packets_in;
+    m_packets_out_at_last_sample = m_packets_out;
+    m_last_sample_ms = now_ms;
 }
 
 void NetworkAdapter::set_ipv4_address(const IPv4Address& address)
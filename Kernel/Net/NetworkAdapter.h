@@ -26,11 +26,13 @@
 
 #pragma once
 
+#include <AK/Atomic.h>
 #include <AK/ByteBuffer.h>
+#include <AK/CircularQueue.h>
 #include <AK/Function.h>
 #include <AK/MACAddress.h>
-#include <AK/SinglyLinkedList.h>
 #include <AK/Types.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
 #include <AK/Weakable.h>
 #include <Kernel/KBuffer.h>
@@ -67,10 +69,15 @@ public:
     int send_ipv4(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
     int send_ipv4_fragmented(const MACAddress&, const IPv4Address&, IPv4Protocol, const UserOrKernelBuffer& payload, size_t payload_size, u8 ttl);
 
-    size_t dequeue_packet(u8* buffer, size_t buffer_size, timeval& packet_timestamp);
+    // Receives up to `budget` packets from the hardware and hands up to
+    // `budget` queued packets to the callback. Returns true if there's more
+    // work left, in which case the caller should poll again soon.
+    bool poll(size_t budget, Function<void(ReadonlyBytes, const timeval&)>);
 
     bool has_queued_packets() const { return !m_packet_queue.is_empty(); }
 
+    void update_packet_rates(u64 now_ms);
+
     u32 mtu() const { return m_mtu; }
     void set_mtu(u32 mtu) { m_mtu = mtu; }
 
@@ -78,6 +85,9 @@ public:
     u32 bytes_in() const { return m_bytes_in; }
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
+    u32 packets_dropped() const { return m_packets_dropped; }
+    u32 packets_in_per_second() const { return m_packets_in_per_second; }
+    u32 packets_out_per_second() const { return m_packets_out_per_second; }
 
     Function<void()> on_receive;
 
@@ -88,7 +98,18 @@ protected:
     virtual void send_raw(ReadonlyBytes) = 0;
     void did_receive(ReadonlyBytes);
 
+    // Drivers that support polling mask their receive interrupt and call
+    // schedule_receive_poll() from the interrupt handler. The network task
+    // then calls poll_receive() until it returns less than the budget, at
+    // which point the driver unmasks the interrupt again.
+    void schedule_receive_poll();
+    virtual size_t poll_receive(size_t) { return 0; }
+
 private:
+    static constexpr size_t max_queued_packets = 256;
+    static constexpr size_t max_unused_packet_buffers = 128;
+    static constexpr size_t max_poll_batch = 64;
+
     MACAddress m_mac_address;
     IPv4Address m_ipv4_address;
     IPv4Address m_ipv4_netmask;
@@ -99,14 +120,20 @@ private:
         timeval timestamp;
     };
 
-    SinglyLinkedList<PacketWithTimestamp> m_packet_queue;
-    SinglyLinkedList<KBuffer> m_unused_packet_buffers;
-    size_t m_unused_packet_buffers_count { 0 };
+    CircularQueue<PacketWithTimestamp, max_queued_packets> m_packet_queue;
+    Vector<KBuffer> m_unused_packet_buffers;
+    Atomic<bool> m_receive_poll_scheduled { false };
     String m_name;
     u32 m_packets_in { 0 };
     u32 m_bytes_in { 0 };
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
+    u32 m_packets_dropped { 0 };
+    u32 m_packets_in_per_second { 0 };
+    u32 m_packets_out_per_second { 0 };
+    u32 m_packets_in_at_last_sample { 0 };
+    u32 m_packets_out_at_last_sample { 0 };
+    u64 m_last_sample_ms { 0 };
     u32 m_mtu { 1500 };
 };
 
@@ -24,6 +24,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/NonnullRefPtrVector.h>
 #include <Kernel/Lock.h>
 #include <Kernel/Net/ARP.h>
 #include <Kernel/Net/EtherType.h>
@@ -39,6 +40,7 @@
 #include <Kernel/Net/UDP.h>
 #include <Kernel/Net/UDPSocket.h>
 #include <Kernel/Process.h>
+#include <Kernel/Time/TimeManagement.h>
 
 //#define NETWORK_TASK_DEBUG
 //#define ETHERNET_DEBUG
@@ -51,6 +53,10 @@
 
 namespace Kernel {
 
+// How many packets we take from an adapter before moving on to the next one.
+static constexpr size_t receive_budget = 64;
+
+static void handle_packet(ReadonlyBytes, const timeval& packet_timestamp);
 static void handle_arp(const EthernetFrameHeader&, size_t frame_size);
 static void handle_ipv4(const EthernetFrameHeader&, size_t frame_size, const timeval& packet_timestamp);
 static void handle_icmp(const EthernetFrameHeader&, const IPv4Packet&, const timeval& packet_timestamp);
@@ -69,7 +75,7 @@ void NetworkTask_main(void*)
 {
     WaitQueue packet_wait_queue;
     u8 octet = 15;
-    int pending_packets = 0;
+    NonnullRefPtrVector<NetworkAdapter> adapters;
     NetworkAdapter::for_each([&](auto& adapter) {
         if (String(adapter.class_name()) == "LoopbackAdapter") {
             adapter.set_ipv4_address({ 127, 0, 0, 1 });
@@ -84,82 +90,86 @@ void NetworkTask_main(void*)
         klog() << "NetworkTask: " << adapter.class_name() << " network adapter found: hw=" << adapter.mac_address().to_string().characters() << " address=" << adapter.ipv4_address().to_string().characters() << " netmask=" << adapter.ipv4_netmask().to_string().characters() << " gateway=" << adapter.ipv4_gateway().to_string().characters();
 
         adapter.on_receive = [&]() {
-            pending_packets++;
             packet_wait_queue.wake_all();
         };
+        adapters.append(adapter);
     });
 
-    auto dequeue_packet = [&pending_packets](u8* buffer, size_t buffer_size, timeval& packet_timestamp) -> size_t {
-        if (pending_packets == 0)
-            return 0;
-        size_t packet_size = 0;
-        NetworkAdapter::for_each([&](auto& adapter) {
-            if (packet_size || !adapter.has_queued_packets())
-                return;
-            packet_size = adapter.dequeue_packet(buffer, buffer_size, packet_timestamp);
-            pending_packets--;
-#ifdef NETWORK_TASK_DEBUG
-            klog() << "NetworkTask: Dequeued packet from " << adapter.name().characters() << " (" << packet_size << " bytes)";
-#endif
-        });
-        return packet_size;
-    };
-
-    size_t buffer_size = 64 * KiB;
-    auto buffer_region = MM.allocate_kernel_region(buffer_size, "Kernel Packet Buffer", Region::Access::Read | Region::Access::Write, false, true);
-    auto buffer = (u8*)buffer_region->vaddr().get();
-    timeval packet_timestamp;
+    // Wake up regularly to drive the TCP timers and sample the packet rates.
+    timeval timer_interval { 0, TCPSocket::tcp_timer_interval_ms * 1000 };
+    u64 last_timer_ms = 0;
+    u64 last_rate_sample_ms = 0;
 
     klog() << "NetworkTask: Enter main loop.";
     for (;;) {
-        size_t packet_size = dequeue_packet(buffer, buffer_size, packet_timestamp);
-        if (!packet_size) {
-            packet_wait_queue.wait_on(nullptr, "NetworkTask");
-            continue;
+        bool has_more_work = false;
+        for (auto& adapter : adapters) {
+            if (adapter.poll(receive_budget, handle_packet))
+                has_more_work = true;
+        }
+
+        auto now_ms = TimeManagement::the().uptime_ms();
+        if (now_ms - last_timer_ms >= TCPSocket::tcp_timer_interval_ms) {
+            TCPSocket::process_timers(now_ms);
+            last_timer_ms = now_ms;
         }
-        if (packet_size < sizeof(EthernetFrameHeader)) {
-            klog() << "NetworkTask: Packet is too small to be an Ethernet packet! (" << packet_size << ")";
-            continue;
+        if (now_ms - last_rate_sample_ms >= 1000) {
+            for (auto& adapter : adapters)
+                adapter.update_packet_rates(now_ms);
+            last_rate_sample_ms = now_ms;
         }
-        auto& eth = *(const EthernetFrameHeader*)buffer;
+
+        if (!has_more_work)
+            packet_wait_queue.wait_on(Thread::BlockTimeout(false, &timer_interval), "NetworkTask");
+    }
+}
+
+void handle_packet(ReadonlyBytes packet, const timeval& packet_timestamp)
+{
+    auto* buffer = packet.data();
+    size_t packet_size = packet.size();
+    if (packet_size < sizeof(EthernetFrameHeader)) {
+        klog() << "NetworkTask: Packet is too small to be an Ethernet packet! (" << packet_size << ")";
+        return;
+    }
+    auto& eth = *(const EthernetFrameHeader*)buffer;
 #ifdef ETHERNET_DEBUG
-        klog() << "NetworkTask: From " << eth.source().to_string().characters() << " to " << eth.destination().to_string().characters() << ", ether_type=" << String::format("%w", eth.ether_type()) << ", packet_length=" << packet_size;
+    klog() << "NetworkTask: From " << eth.source().to_string().characters() << " to " << eth.destination().to_string().characters() << ", ether_type=" << String::format("%w", eth.ether_type()) << ", packet_length=" << packet_size;
 #endif
 
 #ifdef ETHERNET_VERY_DEBUG
-        for (size_t i = 0; i < packet_size; i++) {
-            klog() << String::format("%b", buffer[i]);
-
-            switch (i % 16) {
-            case 7:
-                klog() << "  ";
-                break;
-            case 15:
-                klog() << "";
-                break;
-            default:
-                klog() << " ";
-                break;
-            }
-        }
-
-        klog() << "";
-#endif
+    for (size_t i = 0; i < packet_size; i++) {
+        klog() << String::format("%b", buffer[i]);
 
-        switch (eth.ether_type()) {
-        case EtherType::ARP:
-            handle_arp(eth, packet_size);
+        switch (i % 16) {
+        case 7:
+            klog() << "  ";
             break;
-        case EtherType::IPv4:
-            handle_ipv4(eth, packet_size, packet_timestamp);
-            break;
-        case EtherType::IPv6:
-            // ignore
+        case 15:
+            klog() << "";
             break;
         default:
-            klog() << "NetworkTask: Unknown ethernet type 0x" << String::format("%x", eth.ether_type());
+            klog() << " ";
+            break;
         }
     }
+
+    klog() << "";
+#endif
+
+    switch (eth.ether_type()) {
+    case EtherType::ARP:
+        handle_arp(eth, packet_size);
+        break;
+    case EtherType::IPv4:
+        handle_ipv4(eth, packet_size, packet_timestamp);
+        break;
+    case EtherType::IPv6:
+        // ignore
+        break;
+    default:
+        klog() << "NetworkTask: Unknown ethernet type 0x" << String::format("%x", eth.ether_type());
+    }
 }
 
 void handle_arp(const EthernetFrameHeader& eth, size_t frame_size)
@@ -318,7 +328,7 @@ void handle_udp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
     socket->did_receive(ipv4_packet.source(), udp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
 }
 
-void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
+void handle_tcp(const IPv4Packet& ipv4_packet, [[maybe_unused]] const timeval& packet_timestamp)
 {
     if (ipv4_packet.payload_size() < sizeof(TCPPacket)) {
         klog() << "handle_tcp: IPv4 payload is too small to be a TCP packet (" << ipv4_packet.payload_size() << ", need " << sizeof(TCPPacket) << ")";
@@ -331,6 +341,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
     size_t maximum_tcp_header_size = 15 * sizeof(u32);
     if (tcp_packet.header_size() < minimum_tcp_header_size || tcp_packet.header_size() > maximum_tcp_header_size) {
         klog() << "handle_tcp: TCP packet header has invalid size " << tcp_packet.header_size();
+        return;
     }
 
     if (ipv4_packet.payload_size() < tcp_packet.header_size()) {
@@ -404,6 +415,7 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
 #endif
             client->set_sequence_number(1000);
             client->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+            client->process_syn_options(tcp_packet);
             [[maybe_unused]] auto rc2 = client->send_tcp_packet(TCPFlags::SYN | TCPFlags::ACK);
             client->set_state(TCPSocket::State::SynReceived);
             return;
@@ -488,6 +500,9 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         }
     case TCPSocket::State::CloseWait:
         switch (tcp_packet.flags()) {
+        case TCPFlags::ACK:
+            // We may still be sending; the ACK has already been processed.
+            return;
         default:
             klog() << "handle_tcp: unexpected flags in CloseWait state";
             unused_rc = socket->send_tcp_packet(TCPFlags::RST);
@@ -498,7 +513,9 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-            socket->set_state(TCPSocket::State::Closed);
+            // The FIN may still be queued behind unacknowledged data.
+            if (socket->is_fin_acknowledged())
+                socket->set_state(TCPSocket::State::Closed);
             return;
         default:
             klog() << "handle_tcp: unexpected flags in LastAck state";
@@ -509,10 +526,17 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
     case TCPSocket::State::FinWait1:
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-            socket->set_state(TCPSocket::State::FinWait2);
+        case TCPFlags::ACK | TCPFlags::PUSH:
+            if (payload_size) {
+                socket->receive_segment_data(tcp_packet, payload_size);
+                unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            }
+            // Data queued before the FIN may still be in flight.
+            if (socket->is_fin_acknowledged())
+                socket->set_state(TCPSocket::State::FinWait2);
             return;
         case TCPFlags::FIN:
+        case TCPFlags::FIN | TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             socket->set_state(TCPSocket::State::Closing);
             return;
@@ -524,7 +548,15 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         }
     case TCPSocket::State::FinWait2:
         switch (tcp_packet.flags()) {
+        case TCPFlags::ACK:
+        case TCPFlags::ACK | TCPFlags::PUSH:
+            if (payload_size) {
+                socket->receive_segment_data(tcp_packet, payload_size);
+                unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+            }
+            return;
         case TCPFlags::FIN:
+        case TCPFlags::FIN | TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
             socket->set_state(TCPSocket::State::TimeWait);
             return;
@@ -541,7 +573,8 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
         switch (tcp_packet.flags()) {
         case TCPFlags::ACK:
             socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-            socket->set_state(TCPSocket::State::TimeWait);
+            if (socket->is_fin_acknowledged())
+                socket->set_state(TCPSocket::State::TimeWait);
             return;
         default:
             klog() << "handle_tcp: unexpected flags in Closing state";
@@ -549,28 +582,26 @@ void handle_tcp(const IPv4Packet& ipv4_packet, const timeval& packet_timestamp)
             socket->set_state(TCPSocket::State::Closed);
             return;
         }
-    case TCPSocket::State::Established:
-        if (tcp_packet.has_fin()) {
-            if (payload_size != 0)
-                socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp);
+    case TCPSocket::State::Established: {
+        // Out-of-order data is held by the socket until the hole is filled,
+        // and a FIN only counts once everything before it has arrived.
+        bool is_in_sequence = socket->receive_segment_data(tcp_packet, payload_size);
 
-            socket->set_ack_number(tcp_packet.sequence_number() + payload_size + 1);
+        if (tcp_packet.has_fin() && is_in_sequence) {
+            socket->set_ack_number(socket->ack_number() + 1);
             unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
             socket->set_state(TCPSocket::State::CloseWait);
             socket->set_connected(false);
             return;
         }
 
-        socket->set_ack_number(tcp_packet.sequence_number() + payload_size);
-
 #ifdef TCP_DEBUG
         klog() << "Got packet with ack_no=" << tcp_packet.ack_number() << ", seq_no=" << tcp_packet.sequence_number() << ", payload_size=" << payload_size << ", acking it with new ack_no=" << socket->ack_number() << ", seq_no=" << socket->sequence_number();
 #endif
 
-        if (payload_size) {
-            if (socket->did_receive(ipv4_packet.source(), tcp_packet.source_port(), KBuffer::copy(&ipv4_packet, sizeof(IPv4Packet) + ipv4_packet.payload_size()), packet_timestamp))
-                unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
-        }
+        if (payload_size || tcp_packet.has_fin())
+            unused_rc = socket->send_tcp_packet(TCPFlags::ACK);
+    }
     }
 }
 
@@ -41,6 +41,21 @@ struct TCPFlags {
     };
 };
 
+enum class TCPOptionKind : u8 {
+    End = 0,
+    NoOperation = 1,
+    MaximumSegmentSize = 2,
+    WindowScale = 3,
+    SACKPermitted = 4,
+    SACK = 5,
+};
+
+// RFC 7323 caps the window scale shift at 14.
+static constexpr u8 max_tcp_window_scale = 14;
+
+// Every SACK block takes 8 bytes, and there are 40 bytes for all options.
+static constexpr size_t max_tcp_sack_blocks = 4;
+
 class [[gnu::packed]] TCPPacket
 {
 public:
@@ -84,6 +99,34 @@ public:
     const void* payload() const { return ((const u8*)this) + header_size(); }
     void* payload() { return ((u8*)this) + header_size(); }
 
+    size_t options_size() const { return header_size() > sizeof(TCPPacket) ? header_size() - sizeof(TCPPacket) : 0; }
+    const u8* options() const { return ((const u8*)this) + sizeof(TCPPacket); }
+    u8* options() { return ((u8*)this) + sizeof(TCPPacket); }
+
+    // Calls callback(kind, data, length) for every option, skipping padding.
+    template<typename Callback>
+    void for_each_option(Callback callback) const
+    {
+        auto* options = this->options();
+        size_t size = options_size();
+        for (size_t i = 0; i < size;) {
+            auto kind = (TCPOptionKind)options[i];
+            if (kind == TCPOptionKind::End)
+                return;
+            if (kind == TCPOptionKind::NoOperation) {
+                ++i;
+                continue;
+            }
+            if (i + 1 >= size)
+                return;
+            u8 length = options[i + 1];
+            if (length < 2 || i + length > size)
+                return;
+            callback(kind, options + i + 2, length - 2);
+            i += length;
+        }
+    }
+
 private:
     NetworkOrdered<u16> m_source_port;
     NetworkOrdered<u16> m_destination_port;
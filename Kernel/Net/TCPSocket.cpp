@@ -34,11 +34,44 @@
 #include <Kernel/Net/TCPSocket.h>
 #include <Kernel/Process.h>
 #include <Kernel/Random.h>
+#include <Kernel/Time/TimeManagement.h>
 
 //#define TCP_SOCKET_DEBUG
 
 namespace Kernel {
 
+static constexpr u32 min_retransmission_timeout_ms = 200;
+static constexpr u32 max_retransmission_timeout_ms = 60000;
+
+// Sequence numbers wrap around, so compare them in serial number arithmetic.
+static inline bool sequence_before(u32 a, u32 b)
+{
+    return (i32)(a - b) < 0;
+}
+
+static inline bool sequence_after(u32 a, u32 b)
+{
+    return (i32)(a - b) > 0;
+}
+
+static inline u32 read_u32_from_network(const u8* data)
+{
+    return ((u32)data[0] << 24) | ((u32)data[1] << 16) | ((u32)data[2] << 8) | data[3];
+}
+
+static inline void write_u32_to_network(u8* data, u32 value)
+{
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+static inline u64 now_ms()
+{
+    return TimeManagement::the().uptime_ms();
+}
+
 void TCPSocket::for_each(Function<void(const TCPSocket&)> callback)
 {
     LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
@@ -148,8 +181,10 @@ void TCPSocket::release_for_accept(RefPtr<TCPSocket> socket)
 }
 
 TCPSocket::TCPSocket(int protocol)
-    : IPv4Socket(SOCK_STREAM, protocol)
+    : IPv4Socket(SOCK_STREAM, protocol, receive_buffer_size)
 {
+    while ((receive_buffer_size >> m_receive_window_scale) > 0xffff)
+        ++m_receive_window_scale;
 }
 
 TCPSocket::~TCPSocket()
@@ -181,30 +216,152 @@ KResultOr<size_t> TCPSocket::protocol_receive(ReadonlyBytes raw_ipv4_packet, Use
     return payload_size;
 }
 
+bool TCPSocket::can_write(const FileDescription&, size_t) const
+{
+    return is_connected() && m_send_buffer_used < send_buffer_size;
+}
+
 KResultOr<size_t> TCPSocket::protocol_send(const UserOrKernelBuffer& data, size_t data_length)
 {
-    int err = send_tcp_packet(TCPFlags::PUSH | TCPFlags::ACK, &data, data_length);
-    if (err < 0)
-        return KResult(err);
-    return data_length;
+    if (m_state != State::Established && m_state != State::CloseWait)
+        return KResult(-ENOTCONN);
+    if (m_fin_pending || m_fin_sent)
+        return KResult(-EPIPE);
+
+    if (!m_send_buffer) {
+        m_send_buffer = KBuffer::try_create_with_size(send_buffer_size, Region::Access::Read | Region::Access::Write, "TCPSocket send buffer");
+        if (!m_send_buffer)
+            return KResult(-ENOMEM);
+    }
+
+    if (!m_send_buffer_used) {
+        m_send_buffer_sequence = m_sequence_number;
+        m_send_buffer_head = 0;
+    }
+
+    size_t nqueued = min(data_length, send_buffer_size - m_send_buffer_used);
+    if (!nqueued)
+        return KResult(-EAGAIN);
+
+    size_t tail = (m_send_buffer_head + m_send_buffer_used) % send_buffer_size;
+    size_t first_chunk = min(nqueued, send_buffer_size - tail);
+    if (!data.read(m_send_buffer->data() + tail, first_chunk))
+        return KResult(-EFAULT);
+    if (first_chunk < nqueued && !data.read(m_send_buffer->data(), first_chunk, nqueued - first_chunk))
+        return KResult(-EFAULT);
+    m_send_buffer_used += nqueued;
+
+    send_pending_data();
+    return nqueued;
 }
 
-int TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, size_t payload_size)
+u16 TCPSocket::local_mss()
+{
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return 536;
+    return min(routing_decision.adapter->mtu() - sizeof(IPv4Packet) - sizeof(TCPPacket), (size_t)0xffff);
+}
+
+u16 TCPSocket::window_to_advertise()
+{
+    size_t space = receive_buffer_space();
+    size_t buffered = m_out_of_order_bytes;
+    space = space > buffered ? space - buffered : 0;
+    u32 window = min(space >> m_receive_window_scale, (size_t)0xffff);
+    m_advertised_window = window << m_receive_window_scale;
+    return window;
+}
+
+size_t TCPSocket::write_options(u8* options, u16 flags)
+{
+    size_t size = 0;
+    if (flags & TCPFlags::SYN) {
+        // On a SYN|ACK we may only answer what the peer offered.
+        bool is_reply = flags & TCPFlags::ACK;
+        u16 mss = local_mss();
+        options[size++] = (u8)TCPOptionKind::MaximumSegmentSize;
+        options[size++] = 4;
+        options[size++] = mss >> 8;
+        options[size++] = mss & 0xff;
+        if (!is_reply || m_window_scaling_enabled) {
+            options[size++] = (u8)TCPOptionKind::NoOperation;
+            options[size++] = (u8)TCPOptionKind::WindowScale;
+            options[size++] = 3;
+            options[size++] = m_receive_window_scale;
+        }
+        if (!is_reply || m_sack_permitted) {
+            options[size++] = (u8)TCPOptionKind::NoOperation;
+            options[size++] = (u8)TCPOptionKind::NoOperation;
+            options[size++] = (u8)TCPOptionKind::SACKPermitted;
+            options[size++] = 2;
+        }
+        return size;
+    }
+
+    if (!(flags & TCPFlags::ACK) || !m_sack_permitted || m_out_of_order_segments.is_empty())
+        return 0;
+
+    // Tell the peer which blocks past the hole we already have.
+    Vector<SequenceRange, max_tcp_sack_blocks> blocks;
+    for (auto& segment : m_out_of_order_segments) {
+        u32 start = segment.sequence_number;
+        u32 end = start + segment.data.size();
+        if (!blocks.is_empty() && !sequence_after(start, blocks.last().end)) {
+            if (sequence_after(end, blocks.last().end))
+                blocks.last().end = end;
+            continue;
+        }
+        if (blocks.size() == max_tcp_sack_blocks)
+            break;
+        blocks.append({ start, end });
+    }
+    options[size++] = (u8)TCPOptionKind::NoOperation;
+    options[size++] = (u8)TCPOptionKind::NoOperation;
+    options[size++] = (u8)TCPOptionKind::SACK;
+    options[size++] = 2 + blocks.size() * 8;
+    for (auto& block : blocks) {
+        write_u32_to_network(options + size, block.start);
+        write_u32_to_network(options + size + 4, block.end);
+        size += 8;
+    }
+    return size;
+}
+
+size_t TCPSocket::build_tcp_header(u8* buffer, u16 flags, u32 sequence_number)
 {
-    const size_t buffer_size = sizeof(TCPPacket) + payload_size;
-    alignas(TCPPacket) u8 buffer[buffer_size];
     new (buffer) TCPPacket;
     auto& tcp_packet = *(TCPPacket*)(buffer);
     ASSERT(local_port());
     tcp_packet.set_source_port(local_port());
     tcp_packet.set_destination_port(peer_port());
-    tcp_packet.set_window_size(1024);
-    tcp_packet.set_sequence_number(m_sequence_number);
-    tcp_packet.set_data_offset(sizeof(TCPPacket) / sizeof(u32));
+    tcp_packet.set_sequence_number(sequence_number);
     tcp_packet.set_flags(flags);
 
+    size_t options_size = write_options(tcp_packet.options(), flags);
+    ASSERT(options_size % sizeof(u32) == 0);
+    tcp_packet.set_data_offset((sizeof(TCPPacket) + options_size) / sizeof(u32));
+
+    // The window in a SYN is never scaled.
+    if (flags & TCPFlags::SYN) {
+        tcp_packet.set_window_size(min(receive_buffer_space(), (size_t)0xffff));
+    } else {
+        tcp_packet.set_window_size(window_to_advertise());
+    }
+
     if (flags & TCPFlags::ACK)
         tcp_packet.set_ack_number(m_ack_number);
+    return tcp_packet.header_size();
+}
+
+int TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, size_t payload_size)
+{
+    const size_t max_header_size = 15 * sizeof(u32);
+    const size_t buffer_size = max_header_size + payload_size;
+    alignas(TCPPacket) u8 buffer[buffer_size];
+    size_t header_size = build_tcp_header(buffer, flags, m_sequence_number);
+    auto& tcp_packet = *(TCPPacket*)(buffer);
+    size_t packet_size = header_size + payload_size;
 
     if (payload && !payload->read(tcp_packet.payload(), payload_size))
         return -EFAULT;
@@ -214,12 +371,17 @@ int TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, siz
     } else {
         m_sequence_number += payload_size;
     }
+    if (flags & TCPFlags::FIN) {
+        m_fin_sent = true;
+        m_fin_sequence = m_sequence_number;
+        ++m_sequence_number;
+    }
 
     tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, payload_size));
 
-    if (tcp_packet.has_syn() || payload_size > 0) {
+    if (tcp_packet.has_syn() || tcp_packet.has_fin() || payload_size > 0) {
         LOCKER(m_not_acked_lock);
-        m_not_acked.append({ m_sequence_number, ByteBuffer::copy(buffer, buffer_size) });
+        m_not_acked.append({ m_sequence_number, ByteBuffer::copy(buffer, packet_size) });
         send_outgoing_packets();
         return 0;
     }
@@ -230,12 +392,12 @@ int TCPSocket::send_tcp_packet(u16 flags, const UserOrKernelBuffer* payload, siz
     auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer);
     int err = routing_decision.adapter->send_ipv4(
         routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
-        packet_buffer, buffer_size, ttl());
+        packet_buffer, packet_size, ttl());
     if (err < 0)
         return err;
 
     m_packets_out++;
-    m_bytes_out += buffer_size;
+    m_bytes_out += packet_size;
     return 0;
 }
 
@@ -244,15 +406,13 @@ void TCPSocket::send_outgoing_packets()
     auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
     ASSERT(!routing_decision.is_zero());
 
-    auto now = kgettimeofday();
+    auto now = now_ms();
 
     LOCKER(m_not_acked_lock, Lock::Mode::Shared);
     for (auto& packet : m_not_acked) {
-        timeval diff;
-        timeval_sub(packet.tx_time, now, diff);
-        if (diff.tv_sec == 0 && diff.tv_usec <= 500000)
+        if (packet.tx_counter && now - packet.tx_time_ms < m_retransmission_timeout_ms)
             continue;
-        packet.tx_time = now;
+        packet.tx_time_ms = now;
         packet.tx_counter++;
 
 #ifdef TCP_SOCKET_DEBUG
@@ -269,19 +429,258 @@ void TCPSocket::send_outgoing_packets()
         } else {
             m_packets_out++;
             m_bytes_out += packet.buffer.size();
+            if (packet.tx_counter > 1)
+                m_retransmitted_segments++;
         }
     }
 }
 
-void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
+u32 TCPSocket::unsent_bytes() const
+{
+    if (!m_send_buffer_used || m_fin_sent)
+        return 0;
+    return send_buffer_end() - m_sequence_number;
+}
+
+void TCPSocket::send_fin()
+{
+    if (unsent_bytes()) {
+        // The FIN goes out right behind the last byte of data.
+        m_fin_pending = true;
+        return;
+    }
+    [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::FIN | TCPFlags::ACK);
+}
+
+void TCPSocket::transmit_segment(u32 sequence_number, size_t size, bool is_retransmission)
+{
+    ASSERT(size > 0 && size <= m_send_mss);
+    ASSERT(!sequence_before(sequence_number, m_send_buffer_sequence));
+    ASSERT(!sequence_after(sequence_number + size, send_buffer_end()));
+
+    const size_t max_header_size = 15 * sizeof(u32);
+    if (!m_segment_buffer || m_segment_buffer->capacity() < max_header_size + m_send_mss) {
+        m_segment_buffer = KBuffer::try_create_with_size(max_header_size + m_send_mss, Region::Access::Read | Region::Access::Write, "TCPSocket segment");
+        if (!m_segment_buffer)
+            return;
+    }
+
+    u8* buffer = m_segment_buffer->data();
+    u16 flags = TCPFlags::ACK;
+    if (sequence_number + size == send_buffer_end())
+        flags |= TCPFlags::PUSH;
+    size_t header_size = build_tcp_header(buffer, flags, sequence_number);
+    auto& tcp_packet = *(TCPPacket*)buffer;
+
+    size_t offset = (m_send_buffer_head + (sequence_number - m_send_buffer_sequence)) % send_buffer_size;
+    size_t first_chunk = min(size, send_buffer_size - offset);
+    memcpy(tcp_packet.payload(), m_send_buffer->data() + offset, first_chunk);
+    if (first_chunk < size)
+        memcpy((u8*)tcp_packet.payload() + first_chunk, m_send_buffer->data(), size - first_chunk);
+
+    tcp_packet.set_checksum(compute_tcp_checksum(local_address(), peer_address(), tcp_packet, size));
+
+    auto routing_decision = route_to(peer_address(), local_address(), bound_interface());
+    if (routing_decision.is_zero())
+        return;
+    auto packet_buffer = UserOrKernelBuffer::for_kernel_buffer(buffer);
+    int err = routing_decision.adapter->send_ipv4(
+        routing_decision.next_hop, peer_address(), IPv4Protocol::TCP,
+        packet_buffer, header_size + size, ttl());
+    if (err < 0)
+        return;
+
+    m_packets_out++;
+    m_bytes_out += header_size + size;
+
+    if (is_retransmission) {
+        m_retransmitted_segments++;
+        // Karn's algorithm: we can't tell which transmission an ACK is for.
+        m_rtt_measurement_active = false;
+    } else if (!m_rtt_measurement_active) {
+        m_rtt_measurement_active = true;
+        m_rtt_sequence = sequence_number + size;
+        m_rtt_start_ms = now_ms();
+    }
+    if (!m_retransmission_deadline_ms)
+        arm_retransmission_timer();
+}
+
+void TCPSocket::arm_retransmission_timer()
+{
+    m_retransmission_deadline_ms = now_ms() + m_retransmission_timeout_ms;
+}
+
+void TCPSocket::send_pending_data()
+{
+    while (u32 unsent = unsent_bytes()) {
+        u32 window = min(m_congestion_window, m_send_window);
+        u32 in_flight = bytes_in_flight();
+        if (in_flight >= window) {
+            // The peer has closed its window. Make sure the persist timer
+            // probes it, in case we miss the window update.
+            if (!in_flight && !m_retransmission_deadline_ms)
+                arm_retransmission_timer();
+            break;
+        }
+        u32 size = min(min(unsent, window - in_flight), (u32)m_send_mss);
+        // Avoid silly window syndrome: rather wait for the window to open
+        // than send a tiny segment while there is still data in flight.
+        if (size < unsent && size < m_send_mss && in_flight)
+            break;
+        transmit_segment(m_sequence_number, size, false);
+        m_sequence_number += size;
+    }
+
+    if (m_fin_pending && !unsent_bytes()) {
+        m_fin_pending = false;
+        [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::FIN | TCPFlags::ACK);
+    }
+}
+
+bool TCPSocket::retransmit_next_hole()
 {
-    if (packet.has_ack()) {
-        u32 ack_number = packet.ack_number();
+    u32 start = m_retransmit_next;
+    if (sequence_before(start, m_send_unacknowledged))
+        start = m_send_unacknowledged;
+    if (sequence_before(start, m_send_buffer_sequence))
+        start = m_send_buffer_sequence;
+
+    for (auto& range : m_sacked_ranges) {
+        if (!sequence_before(start, range.start) && sequence_before(start, range.end))
+            start = range.end;
+    }
+
+    // Without SACK information, all we know is that the first segment is lost.
+    // After a timeout we assume everything that was in flight is.
+    u32 limit = m_sequence_number;
+    if (m_recovery_mode == RecoveryMode::FastRecovery) {
+        if (m_sacked_ranges.is_empty())
+            limit = m_send_unacknowledged + m_send_mss;
+        else
+            limit = m_sacked_ranges.last().end;
+    }
+    u32 data_end = m_fin_sent ? m_fin_sequence : send_buffer_end();
+    if (sequence_after(limit, data_end))
+        limit = data_end;
+    if (!sequence_before(start, limit))
+        return false;
+
+    u32 end = limit;
+    for (auto& range : m_sacked_ranges) {
+        if (sequence_after(range.start, start) && sequence_before(range.start, end)) {
+            end = range.start;
+            break;
+        }
+    }
+
+    u32 size = min(end - start, (u32)m_send_mss);
+    transmit_segment(start, size, true);
+    m_retransmit_next = start + size;
+    return true;
+}
+
+void TCPSocket::add_sacked_range(u32 start, u32 end)
+{
+    if (!sequence_before(start, end))
+        return;
+    if (sequence_before(start, m_send_unacknowledged))
+        start = m_send_unacknowledged;
+    if (sequence_after(end, m_sequence_number) || !sequence_before(start, end))
+        return;
+
+    size_t index = 0;
+    while (index < m_sacked_ranges.size() && sequence_before(m_sacked_ranges[index].start, start))
+        ++index;
+    m_sacked_ranges.insert(index, { start, end });
+
+    // Merge anything that now overlaps or touches.
+    for (size_t i = 0; i + 1 < m_sacked_ranges.size();) {
+        auto& range = m_sacked_ranges[i];
+        auto& next = m_sacked_ranges[i + 1];
+        if (sequence_before(range.end, next.start)) {
+            ++i;
+            continue;
+        }
+        if (sequence_after(next.end, range.end))
+            range.end = next.end;
+        m_sacked_ranges.remove(i + 1);
+    }
+
+    // The peer only tells us about a few blocks at a time, so that's all we keep track of.
+    while (m_sacked_ranges.size() > max_tcp_sack_blocks * 2)
+        m_sacked_ranges.take_last();
+}
+
+void TCPSocket::update_rtt(u32 sample_ms)
+{
+    if (!m_smoothed_rtt_ms && !m_rtt_variance_ms) {
+        m_smoothed_rtt_ms = sample_ms;
+        m_rtt_variance_ms = sample_ms / 2;
+    } else {
+        u32 deviation = sample_ms > m_smoothed_rtt_ms ? sample_ms - m_smoothed_rtt_ms : m_smoothed_rtt_ms - sample_ms;
+        m_rtt_variance_ms = (3 * m_rtt_variance_ms + deviation) / 4;
+        m_smoothed_rtt_ms = (7 * m_smoothed_rtt_ms + sample_ms) / 8;
+    }
+    u32 timeout = m_smoothed_rtt_ms + max(tcp_timer_interval_ms, 4 * m_rtt_variance_ms);
+    m_retransmission_timeout_ms = min(max(timeout, min_retransmission_timeout_ms), max_retransmission_timeout_ms);
+}
+
+void TCPSocket::process_syn_options(const TCPPacket& packet)
+{
+    u16 peer_mss = 536;
+    bool window_scale_seen = false;
+    m_sack_permitted = false;
+    packet.for_each_option([&](TCPOptionKind kind, const u8* data, size_t length) {
+        switch (kind) {
+        case TCPOptionKind::MaximumSegmentSize:
+            if (length == 2)
+                peer_mss = ((u16)data[0] << 8) | data[1];
+            break;
+        case TCPOptionKind::WindowScale:
+            if (length == 1) {
+                window_scale_seen = true;
+                m_send_window_scale = min(data[0], max_tcp_window_scale);
+            }
+            break;
+        case TCPOptionKind::SACKPermitted:
+            m_sack_permitted = true;
+            break;
+        default:
+            break;
+        }
+    });
+
+    m_window_scaling_enabled = window_scale_seen;
+    if (!window_scale_seen) {
+        m_send_window_scale = 0;
+        m_receive_window_scale = 0;
+    }
+    m_send_mss = max(min(peer_mss, local_mss()), (u16)64);
+    m_send_window = packet.window_size();
+
+    // RFC 6928 initial window.
+    m_congestion_window = min(10u * m_send_mss, max(2u * m_send_mss, 14600u));
+
+#ifdef TCP_SOCKET_DEBUG
+    dbg() << "TCPSocket: Negotiated mss=" << m_send_mss << " window_scale=" << m_send_window_scale << "/" << m_receive_window_scale << " sack=" << m_sack_permitted;
+#endif
+}
+
+bool TCPSocket::is_fin_acknowledged() const
+{
+    return m_fin_sent && sequence_after(m_send_unacknowledged, m_fin_sequence);
+}
+
+void TCPSocket::process_ack(const TCPPacket& packet, size_t payload_size)
+{
+    u32 ack_number = packet.ack_number();
 
 #ifdef TCP_SOCKET_DEBUG
-        dbg() << "TCPSocket: receive_tcp_packet: " << ack_number;
+    dbg() << "TCPSocket: receive_tcp_packet: " << ack_number;
 #endif
 
+    {
         int removed = 0;
         LOCKER(m_not_acked_lock);
         while (!m_not_acked.is_empty()) {
@@ -291,7 +690,7 @@ void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
             dbg() << "TCPSocket: iterate: " << packet.ack_number;
 #endif
 
-            if (packet.ack_number <= ack_number) {
+            if (!sequence_after(packet.ack_number, ack_number)) {
                 m_not_acked.take_first();
                 removed++;
             } else {
@@ -304,10 +703,257 @@ void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
 #endif
     }
 
+    // Ignore ACKs for data we haven't sent (yet).
+    if (sequence_after(ack_number, m_sequence_number) || sequence_before(ack_number, m_send_unacknowledged))
+        return;
+
+    u32 window = (u32)packet.window_size() << (packet.has_syn() ? 0 : m_send_window_scale);
+    bool window_changed = window != m_send_window;
+    m_send_window = window;
+
+    if (m_sack_permitted) {
+        packet.for_each_option([&](TCPOptionKind kind, const u8* data, size_t length) {
+            if (kind != TCPOptionKind::SACK)
+                return;
+            for (size_t i = 0; i + 8 <= length; i += 8)
+                add_sacked_range(read_u32_from_network(data + i), read_u32_from_network(data + i + 4));
+        });
+    }
+
+    if (sequence_after(ack_number, m_send_unacknowledged)) {
+        u32 acked = ack_number - m_send_unacknowledged;
+        m_send_unacknowledged = ack_number;
+        m_duplicate_acks = 0;
+
+        if (m_send_buffer_used && sequence_after(ack_number, m_send_buffer_sequence)) {
+            u32 dropped = min(ack_number - m_send_buffer_sequence, (u32)m_send_buffer_used);
+            m_send_buffer_sequence += dropped;
+            m_send_buffer_head = (m_send_buffer_head + dropped) % send_buffer_size;
+            m_send_buffer_used -= dropped;
+        }
+
+        while (!m_sacked_ranges.is_empty() && !sequence_after(m_sacked_ranges.first().end, ack_number))
+            m_sacked_ranges.take_first();
+        if (!m_sacked_ranges.is_empty() && sequence_before(m_sacked_ranges.first().start, ack_number))
+            m_sacked_ranges.first().start = ack_number;
+
+        if (m_rtt_measurement_active && !sequence_before(ack_number, m_rtt_sequence)) {
+            m_rtt_measurement_active = false;
+            update_rtt(now_ms() - m_rtt_start_ms);
+        }
+
+        if (m_recovery_mode != RecoveryMode::None && !sequence_before(ack_number, m_recovery_point)) {
+            // Full ACK, we're done recovering.
+            if (m_recovery_mode == RecoveryMode::FastRecovery)
+                m_congestion_window = m_slow_start_threshold;
+            m_recovery_mode = RecoveryMode::None;
+        } else if (m_recovery_mode == RecoveryMode::FastRecovery) {
+            // Partial ACK: the next hole is lost as well.
+            m_congestion_window = (m_congestion_window > acked ? m_congestion_window - acked : 0) + m_send_mss;
+            retransmit_next_hole();
+        } else {
+            if (m_congestion_window < m_slow_start_threshold)
+                m_congestion_window += min(acked, (u32)m_send_mss);
+            else
+                m_congestion_window += max(1u, (u32)m_send_mss * m_send_mss / m_congestion_window);
+
+            // After a timeout, go back over everything that was in flight.
+            if (m_recovery_mode == RecoveryMode::Timeout) {
+                while (m_retransmit_next - m_send_unacknowledged < m_congestion_window) {
+                    if (!retransmit_next_hole())
+                        break;
+                }
+            }
+        }
+
+        if (bytes_in_flight())
+            arm_retransmission_timer();
+        else
+            m_retransmission_deadline_ms = 0;
+
+        evaluate_block_conditions();
+    } else if (!payload_size && !packet.has_syn() && !packet.has_fin() && !window_changed && bytes_in_flight()) {
+        ++m_duplicate_acks;
+        if (m_recovery_mode == RecoveryMode::None) {
+            size_t sacked_bytes = 0;
+            for (auto& range : m_sacked_ranges)
+                sacked_bytes += range.end - range.start;
+            if (m_duplicate_acks >= 3 || sacked_bytes > 2u * m_send_mss) {
+#ifdef TCP_SOCKET_DEBUG
+                dbg() << "TCPSocket: Fast retransmit at " << m_send_unacknowledged << ", " << sacked_bytes << " bytes SACKed";
+#endif
+                m_slow_start_threshold = max(bytes_in_flight() / 2, 2u * m_send_mss);
+                m_congestion_window = m_slow_start_threshold + 3 * m_send_mss;
+                m_recovery_mode = RecoveryMode::FastRecovery;
+                m_recovery_point = m_sequence_number;
+                m_retransmit_next = m_send_unacknowledged;
+                retransmit_next_hole();
+            }
+        } else if (m_recovery_mode == RecoveryMode::FastRecovery) {
+            // Every duplicate ACK means a segment has left the network.
+            m_congestion_window += m_send_mss;
+            retransmit_next_hole();
+        }
+    }
+
+    send_pending_data();
+}
+
+void TCPSocket::receive_tcp_packet(const TCPPacket& packet, u16 size)
+{
+    size_t payload_size = size > packet.header_size() ? size - packet.header_size() : 0;
+
+    if (packet.has_syn() && m_state == State::SynSent)
+        process_syn_options(packet);
+
+    if (packet.has_ack() && m_state != State::Listen)
+        process_ack(packet, payload_size);
+
     m_packets_in++;
     m_bytes_in += packet.header_size() + size;
 }
 
+bool TCPSocket::receive_segment_data(const TCPPacket& packet, size_t payload_size)
+{
+    u32 sequence_number = packet.sequence_number();
+    auto* payload = (const u8*)packet.payload();
+
+    // Drop whatever we already have.
+    if (sequence_before(sequence_number, m_ack_number)) {
+        u32 duplicate = m_ack_number - sequence_number;
+        if (duplicate >= payload_size)
+            return sequence_number + payload_size == m_ack_number;
+        sequence_number += duplicate;
+        payload += duplicate;
+        payload_size -= duplicate;
+    }
+
+    if (!payload_size)
+        return sequence_number == m_ack_number;
+
+    if (sequence_number != m_ack_number) {
+        // Out of order. Hang on to it (as long as it fits into the window) so
+        // the peer only needs to fill the hole, and SACK it.
+        if (m_out_of_order_bytes + payload_size > receive_buffer_space())
+            return false;
+        size_t index = 0;
+        while (index < m_out_of_order_segments.size() && sequence_before(m_out_of_order_segments[index].sequence_number, sequence_number))
+            ++index;
+        if (index < m_out_of_order_segments.size() && m_out_of_order_segments[index].sequence_number == sequence_number)
+            return false;
+        m_out_of_order_segments.insert(index, { sequence_number, ByteBuffer::copy(payload, payload_size) });
+        m_out_of_order_bytes += payload_size;
+        return false;
+    }
+
+    size_t accepted = did_receive_bytes({ payload, payload_size });
+    m_ack_number += accepted;
+    if (accepted < payload_size)
+        return false;
+
+    deliver_out_of_order_segments();
+    return true;
+}
+
+void TCPSocket::deliver_out_of_order_segments()
+{
+    while (!m_out_of_order_segments.is_empty()) {
+        auto& segment = m_out_of_order_segments.first();
+        if (sequence_after(segment.sequence_number, m_ack_number))
+            return;
+        u32 end = segment.sequence_number + segment.data.size();
+        if (sequence_after(end, m_ack_number)) {
+            u32 skip = m_ack_number - segment.sequence_number;
+            size_t accepted = did_receive_bytes({ segment.data.data() + skip, segment.data.size() - skip });
+            m_ack_number += accepted;
+            if (accepted < segment.data.size() - skip)
+                return;
+        }
+        m_out_of_order_bytes -= segment.data.size();
+        m_out_of_order_segments.take_first();
+    }
+}
+
+void TCPSocket::protocol_did_read_bytes()
+{
+    switch (m_state) {
+    case State::Established:
+    case State::FinWait1:
+    case State::FinWait2:
+        break;
+    default:
+        return;
+    }
+    // Let the peer know once a meaningful part of the window has opened up
+    // again, so it doesn't have to wait for its persist timer.
+    size_t space = receive_buffer_space();
+    if (m_advertised_window < receive_buffer_size / 2 && space >= receive_buffer_size / 2)
+        [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::ACK);
+}
+
+void TCPSocket::handle_timer(u64 now)
+{
+    if (!m_not_acked.is_empty()) {
+        LOCKER(m_not_acked_lock);
+        bool timed_out = false;
+        for (auto& packet : m_not_acked) {
+            if (now - packet.tx_time_ms >= m_retransmission_timeout_ms)
+                timed_out = true;
+        }
+        if (timed_out) {
+            send_outgoing_packets();
+            m_retransmission_timeout_ms = min(m_retransmission_timeout_ms * 2, max_retransmission_timeout_ms);
+        }
+    }
+
+    if (!m_retransmission_deadline_ms || now < m_retransmission_deadline_ms)
+        return;
+    m_retransmission_deadline_ms = 0;
+
+    if (!bytes_in_flight()) {
+        // Persist timer: probe the closed window with a single byte.
+        if (unsent_bytes() && !m_send_window) {
+            transmit_segment(m_sequence_number, 1, false);
+            m_sequence_number += 1;
+        }
+        return;
+    }
+
+#ifdef TCP_SOCKET_DEBUG
+    dbg() << "TCPSocket: Retransmission timeout at " << m_send_unacknowledged << ", rto=" << m_retransmission_timeout_ms;
+#endif
+
+    m_slow_start_threshold = max(bytes_in_flight() / 2, 2u * m_send_mss);
+    m_congestion_window = m_send_mss;
+    m_recovery_mode = RecoveryMode::Timeout;
+    m_recovery_point = m_sequence_number;
+    m_retransmit_next = m_send_unacknowledged;
+    m_duplicate_acks = 0;
+    // The receiver is allowed to discard data it has SACKed.
+    m_sacked_ranges.clear();
+    m_retransmission_timeout_ms = min(m_retransmission_timeout_ms * 2, max_retransmission_timeout_ms);
+
+    retransmit_next_hole();
+    arm_retransmission_timer();
+}
+
+void TCPSocket::process_timers(u64 now)
+{
+    Vector<RefPtr<TCPSocket>> sockets;
+    {
+        LOCKER(sockets_by_tuple().lock(), Lock::Mode::Shared);
+        for (auto& it : sockets_by_tuple().resource()) {
+            auto& socket = *it.value;
+            if (socket.m_retransmission_deadline_ms || !socket.m_not_acked.is_empty())
+                sockets.append(socket);
+        }
+    }
+    for (auto& socket : sockets) {
+        LOCKER(socket->lock());
+        socket->handle_timer(now);
+    }
+}
+
 NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket& packet, u16 payload_size)
 {
     struct [[gnu::packed]] PseudoHeader
@@ -319,7 +965,7 @@ NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, c
         NetworkOrdered<u16> payload_size;
     };
 
-    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, sizeof(TCPPacket) + payload_size };
+    PseudoHeader pseudo_header { source, destination, 0, (u8)IPv4Protocol::TCP, (u16)(packet.header_size() + payload_size) };
 
     u32 checksum = 0;
     auto* w = (const NetworkOrdered<u16>*)&pseudo_header;
@@ -329,12 +975,11 @@ NetworkOrdered<u16> TCPSocket::compute_tcp_checksum(const IPv4Address& source, c
             checksum = (checksum >> 16) + (checksum & 0xffff);
     }
     w = (const NetworkOrdered<u16>*)&packet;
-    for (size_t i = 0; i < sizeof(packet) / sizeof(u16); ++i) {
+    for (size_t i = 0; i < packet.header_size() / sizeof(u16); ++i) {
         checksum += w[i];
         if (checksum > 0xffff)
             checksum = (checksum >> 16) + (checksum & 0xffff);
     }
-    ASSERT(packet.data_offset() * 4 == sizeof(TCPPacket));
     w = (const NetworkOrdered<u16>*)packet.payload();
     for (size_t i = 0; i < payload_size / sizeof(u16); ++i) {
         checksum += w[i];
@@ -385,7 +1030,7 @@ KResult TCPSocket::protocol_connect(FileDescription& description, ShouldBlock sh
 
     allocate_local_port_if_needed();
 
-    m_sequence_number = get_good_random<u32>();
+    set_sequence_number(get_good_random<u32>());
     m_ack_number = 0;
 
     set_setup_state(SetupState::InProgress);
@@ -463,7 +1108,7 @@ void TCPSocket::shut_down_for_writing()
 #ifdef TCP_SOCKET_DEBUG
         dbg() << " Sending FIN/ACK from Established and moving into FinWait1";
 #endif
-        [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::FIN | TCPFlags::ACK);
+        send_fin();
         set_state(State::FinWait1);
     } else {
         dbg() << " Shutting down TCPSocket for writing but not moving to FinWait1 since state is " << to_string(state());
@@ -478,7 +1123,7 @@ KResult TCPSocket::close()
 #ifdef TCP_SOCKET_DEBUG
         dbg() << " Sending FIN from CloseWait and moving into LastAck";
 #endif
-        [[maybe_unused]] auto rc = send_tcp_packet(TCPFlags::FIN | TCPFlags::ACK);
+        send_fin();
         set_state(State::LastAck);
     }
 
@@ -29,8 +29,10 @@
 #include <AK/Function.h>
 #include <AK/HashMap.h>
 #include <AK/SinglyLinkedList.h>
+#include <AK/Vector.h>
 #include <AK/WeakPtr.h>
 #include <Kernel/Net/IPv4Socket.h>
+#include <Kernel/Net/TCP.h>
 
 namespace Kernel {
 
@@ -140,18 +142,45 @@ public:
     void set_error(Error error) { m_error = error; }
 
     void set_ack_number(u32 n) { m_ack_number = n; }
-    void set_sequence_number(u32 n) { m_sequence_number = n; }
+    void set_sequence_number(u32 n)
+    {
+        m_sequence_number = n;
+        m_send_unacknowledged = n;
+    }
     u32 ack_number() const { return m_ack_number; }
     u32 sequence_number() const { return m_sequence_number; }
     u32 packets_in() const { return m_packets_in; }
     u32 bytes_in() const { return m_bytes_in; }
     u32 packets_out() const { return m_packets_out; }
     u32 bytes_out() const { return m_bytes_out; }
+    u32 retransmitted_segments() const { return m_retransmitted_segments; }
+    u32 congestion_window() const { return m_congestion_window; }
+    u32 slow_start_threshold() const { return m_slow_start_threshold; }
+    u32 send_window() const { return m_send_window; }
+    u32 smoothed_rtt_ms() const { return m_smoothed_rtt_ms; }
+    u32 retransmission_timeout_ms() const { return m_retransmission_timeout_ms; }
+    u16 send_mss() const { return m_send_mss; }
+
+    virtual bool can_write(const FileDescription&, size_t) const override;
 
     [[nodiscard]] int send_tcp_packet(u16 flags, const UserOrKernelBuffer* = nullptr, size_t = 0);
     void send_outgoing_packets();
     void receive_tcp_packet(const TCPPacket&, u16 size);
 
+    // Negotiates the MSS, window scaling and SACK from a SYN.
+    void process_syn_options(const TCPPacket&);
+
+    // Takes the payload of a segment in Established (or a closing state).
+    // Returns true if everything up to the end of this segment has been
+    // received, i.e. a FIN on it may be accepted.
+    bool receive_segment_data(const TCPPacket&, size_t payload_size);
+
+    bool is_fin_acknowledged() const;
+
+    // Driven by the network task, which calls this every tcp_timer_interval_ms.
+    static constexpr u32 tcp_timer_interval_ms = 100;
+    static void process_timers(u64 now_ms);
+
     static Lockable<HashMap<IPv4SocketTuple, TCPSocket*>>& sockets_by_tuple();
     static RefPtr<TCPSocket> from_tuple(const IPv4SocketTuple& tuple);
     static RefPtr<TCPSocket> from_endpoints(const IPv4Address& local_address, u16 local_port, const IPv4Address& peer_address, u16 peer_port);
@@ -176,6 +205,7 @@ private:
     static NetworkOrdered<u16> compute_tcp_checksum(const IPv4Address& source, const IPv4Address& destination, const TCPPacket&, u16 payload_size);
 
     virtual void shut_down_for_writing() override;
+    virtual void protocol_did_read_bytes() override;
 
     virtual KResultOr<size_t> protocol_receive(ReadonlyBytes raw_ipv4_packet, UserOrKernelBuffer& buffer, size_t buffer_size, int flags) override;
     virtual KResultOr<size_t> protocol_send(const UserOrKernelBuffer&, size_t) override;
@@ -185,6 +215,32 @@ private:
     virtual KResult protocol_bind() override;
     virtual KResult protocol_listen() override;
 
+    struct SequenceRange {
+        u32 start;
+        u32 end;
+    };
+
+    size_t build_tcp_header(u8* buffer, u16 flags, u32 sequence_number);
+    size_t write_options(u8* options, u16 flags);
+    u16 local_mss();
+    u16 window_to_advertise();
+
+    void send_fin();
+    void send_pending_data();
+    void transmit_segment(u32 sequence_number, size_t size, bool is_retransmission);
+    bool retransmit_next_hole();
+    void process_ack(const TCPPacket&, size_t payload_size);
+    void add_sacked_range(u32 start, u32 end);
+    void update_rtt(u32 sample_ms);
+    void handle_timer(u64 now_ms);
+    void arm_retransmission_timer();
+
+    u32 bytes_in_flight() const { return m_sequence_number - m_send_unacknowledged; }
+    u32 send_buffer_end() const { return m_send_buffer_sequence + m_send_buffer_used; }
+    u32 unsent_bytes() const;
+
+    void deliver_out_of_order_segments();
+
     WeakPtr<TCPSocket> m_originator;
     HashMap<IPv4SocketTuple, NonnullRefPtr<TCPSocket>> m_pending_release_for_accept;
     Direction m_direction { Direction::Unspecified };
@@ -198,15 +254,73 @@ private:
     u32 m_packets_out { 0 };
     u32 m_bytes_out { 0 };
 
+    u32 m_retransmitted_segments { 0 };
+
+    // Only control segments (SYN and FIN) go here. Data is retransmitted
+    // straight out of the send buffer.
     struct OutgoingPacket {
         u32 ack_number { 0 };
         ByteBuffer buffer;
         int tx_counter { 0 };
-        timeval tx_time { 0, 0 };
+        u64 tx_time_ms { 0 };
     };
 
     Lock m_not_acked_lock { "TCPSocket unacked packets" };
     SinglyLinkedList<OutgoingPacket> m_not_acked;
+
+    // The send buffer is a ring holding everything from SND.UNA onwards,
+    // both in flight and not yet sent.
+    static constexpr size_t send_buffer_size = 128 * KiB;
+    static constexpr size_t receive_buffer_size = 128 * KiB;
+    OwnPtr<KBuffer> m_send_buffer;
+    size_t m_send_buffer_head { 0 };
+    size_t m_send_buffer_used { 0 };
+    u32 m_send_buffer_sequence { 0 };
+    OwnPtr<KBuffer> m_segment_buffer;
+
+    u32 m_send_unacknowledged { 0 };
+    u32 m_send_window { 0 };
+    u16 m_send_mss { 536 };
+    u8 m_send_window_scale { 0 };
+    u8 m_receive_window_scale { 0 };
+    bool m_window_scaling_enabled { true };
+    bool m_sack_permitted { false };
+    bool m_fin_pending { false };
+    bool m_fin_sent { false };
+    u32 m_fin_sequence { 0 };
+    u32 m_advertised_window { 0 };
+
+    // Congestion control, RFC 5681 with the NewReno modification from RFC 6582.
+    // While we have SACK information, recovery retransmits the holes below
+    // the highest SACKed sequence number instead of just the first one.
+    enum class RecoveryMode {
+        None,
+        FastRecovery,
+        Timeout,
+    };
+    u32 m_congestion_window { 0 };
+    u32 m_slow_start_threshold { 0xffffffff };
+    u32 m_duplicate_acks { 0 };
+    RecoveryMode m_recovery_mode { RecoveryMode::None };
+    u32 m_recovery_point { 0 };
+    u32 m_retransmit_next { 0 };
+    Vector<SequenceRange, max_tcp_sack_blocks * 2> m_sacked_ranges;
+
+    // RTT estimation and retransmission timer, RFC 6298.
+    u32 m_smoothed_rtt_ms { 0 };
+    u32 m_rtt_variance_ms { 0 };
+    u32 m_retransmission_timeout_ms { 1000 };
+    bool m_rtt_measurement_active { false };
+    u32 m_rtt_sequence { 0 };
+    u64 m_rtt_start_ms { 0 };
+    u64 m_retransmission_deadline_ms { 0 };
+
+    struct OutOfOrderSegment {
+        u32 sequence_number;
+        ByteBuffer data;
+    };
+    Vector<OutOfOrderSegment> m_out_of_order_segments;
+    size_t m_out_of_order_bytes { 0 };
 };
 
 }
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/MACAddress.h>
+#include <AK/Memory.h>
+#include <Kernel/Net/VirtIONetworkAdapter.h>
+#include <Kernel/VM/MemoryManager.h>
+
+//#define VIRTIO_NET_DEBUG
+
+namespace Kernel {
+
+#define VIRTIO_NET_F_MAC (1u << 5)
+#define VIRTIO_NET_F_STATUS (1u << 16)
+
+#define VIRTIO_NET_S_LINK_UP 1
+
+#define RECEIVE_QUEUE 0
+#define TRANSMIT_QUEUE 1
+
+// Without VIRTIO_NET_F_MRG_RXBUF the legacy header is 10 bytes, and it gets
+// a descriptor of its own. We keep the packet 16-byte aligned after it.
+static constexpr size_t virtio_net_header_size = 10;
+static constexpr size_t packet_offset = 16;
+
+void VirtIONetworkAdapter::detect()
+{
+    PCI::enumerate([&](const PCI::Address& address, PCI::ID) {
+        if (address.is_null())
+            return;
+        if (!VirtIODevice::is_virtio_device(address, VIRTIO_PCI_NETWORK_DEVICE_ID))
+            return;
+        [[maybe_unused]] auto& unused = adopt(*new VirtIONetworkAdapter(address)).leak_ref();
+    });
+}
+
+VirtIONetworkAdapter::VirtIONetworkAdapter(PCI::Address address)
+    : VirtIODevice(address, "VirtIONetworkAdapter")
+{
+    set_interface_name("virtio");
+    if (!initialize())
+        fail_initialization();
+}
+
+VirtIONetworkAdapter::~VirtIONetworkAdapter()
+{
+}
+
+bool VirtIONetworkAdapter::initialize()
+{
+    negotiate_features(VIRTIO_NET_F_MAC | VIRTIO_NET_F_STATUS | VIRTIO_F_RING_EVENT_IDX);
+    if (!setup_queues(2))
+        return false;
+
+    if (is_feature_accepted(VIRTIO_NET_F_MAC)) {
+        MACAddress mac;
+        for (size_t i = 0; i < 6; i++)
+            mac[i] = config_read8(i);
+        set_mac_address(mac);
+    } else {
+        // The device will accept whatever we pick.
+        MACAddress mac(0x52, 0x54, 0x00, get_good_random<u8>(), get_good_random<u8>(), get_good_random<u8>());
+        set_mac_address(mac);
+    }
+    const auto& mac = mac_address();
+    klog() << "VirtIONetworkAdapter: MAC address: " << String::format("%b", mac[0]) << ":" << String::format("%b", mac[1]) << ":" << String::format("%b", mac[2]) << ":" << String::format("%b", mac[3]) << ":" << String::format("%b", mac[4]) << ":" << String::format("%b", mac[5]);
+
+    // Every packet takes two descriptors, one for the header and one for the data.
+    m_rx_buffer_count = min(max_rx_buffers, (size_t)queue(RECEIVE_QUEUE).size() / 2);
+    m_tx_buffer_count = min(max_tx_buffers, (size_t)queue(TRANSMIT_QUEUE).size() / 2);
+    m_rx_buffers_region = MM.allocate_kernel_region(PAGE_ROUND_UP(m_rx_buffer_count * buffer_size), "VirtIONetworkAdapter RX", Region::Access::Read | Region::Access::Write);
+    m_tx_buffers_region = MM.allocate_kernel_region(PAGE_ROUND_UP(m_tx_buffer_count * buffer_size), "VirtIONetworkAdapter TX", Region::Access::Read | Region::Access::Write);
+    if (!m_rx_buffers_region || !m_tx_buffers_region)
+        return false;
+    memset(m_tx_buffers_region->vaddr().as_ptr(), 0, m_tx_buffers_region->size());
+
+    {
+        ScopedSpinLock lock(queue(RECEIVE_QUEUE).lock());
+        for (u16 i = 0; i < m_rx_buffer_count; i++)
+            supply_receive_buffer(i);
+    }
+    for (u16 i = 0; i < m_tx_buffer_count; i++)
+        m_free_tx_buffers.append(i);
+
+    update_link_status();
+    finish_initialization();
+
+    // The device only starts looking at the receive queue once it's told to.
+    ScopedSpinLock lock(queue(RECEIVE_QUEUE).lock());
+    notify_queue(RECEIVE_QUEUE);
+    return true;
+}
+
+void VirtIONetworkAdapter::update_link_status()
+{
+    if (is_feature_accepted(VIRTIO_NET_F_STATUS))
+        m_link_up = config_read16(6) & VIRTIO_NET_S_LINK_UP;
+    else
+        m_link_up = true;
+}
+
+u8* VirtIONetworkAdapter::buffer(Region& region, u16 index)
+{
+    return region.vaddr().offset(index * buffer_size).as_ptr();
+}
+
+PhysicalAddress VirtIONetworkAdapter::buffer_address(Region& region, u16 index)
+{
+    // Buffers never straddle a page, so only the page needs to be contiguous.
+    size_t offset = index * buffer_size;
+    return region.physical_page(offset / PAGE_SIZE)->paddr().offset(offset % PAGE_SIZE);
+}
+
+void VirtIONetworkAdapter::supply_receive_buffer(u16 index)
+{
+    auto address = buffer_address(*m_rx_buffers_region, index);
+    VirtIOQueue::Buffer buffers[] = {
+        { address, virtio_net_header_size, true },
+        { address.offset(packet_offset), buffer_size - packet_offset, true },
+    };
+    bool supplied = queue(RECEIVE_QUEUE).supply_buffers(buffers, 2, (void*)(FlatPtr)index);
+    ASSERT(supplied);
+}
+
+void VirtIONetworkAdapter::handle_queue_update(u16 queue_index)
+{
+    if (queue_index == RECEIVE_QUEUE) {
+        receive();
+        return;
+    }
+    ASSERT(queue_index == TRANSMIT_QUEUE);
+    {
+        ScopedSpinLock lock(queue(TRANSMIT_QUEUE).lock());
+        reclaim_transmit_buffers();
+    }
+    m_wait_queue.wake_one();
+}
+
+void VirtIONetworkAdapter::handle_config_change()
+{
+    update_link_status();
+    klog() << "VirtIONetworkAdapter: Link is " << (m_link_up ? "up" : "down");
+}
+
+void VirtIONetworkAdapter::receive()
+{
+    auto& receive_queue = queue(RECEIVE_QUEUE);
+    Vector<u16, max_rx_buffers> received;
+    Vector<u32, max_rx_buffers> lengths;
+    {
+        ScopedSpinLock lock(receive_queue.lock());
+        void* token;
+        u32 length;
+        while (receive_queue.take_used_buffers(token, length)) {
+            received.append((FlatPtr)token);
+            lengths.append(length);
+        }
+    }
+    if (received.is_empty())
+        return;
+
+    for (size_t i = 0; i < received.size(); i++) {
+        if (lengths[i] <= virtio_net_header_size)
+            continue;
+        size_t length = lengths[i] - virtio_net_header_size;
+        ASSERT(length <= buffer_size - packet_offset);
+        auto* packet = buffer(*m_rx_buffers_region, received[i]) + packet_offset;
+        m_entropy_source.add_random_event(length);
+#ifdef VIRTIO_NET_DEBUG
+        klog() << "VirtIONetworkAdapter: Received packet (" << length << " bytes) in buffer " << received[i];
+#endif
+        did_receive({ packet, length });
+    }
+
+    // Hand the whole batch back with a single notification.
+    ScopedSpinLock lock(receive_queue.lock());
+    for (auto index : received)
+        supply_receive_buffer(index);
+    notify_queue(RECEIVE_QUEUE);
+}
+
+void VirtIONetworkAdapter::reclaim_transmit_buffers()
+{
+    auto& transmit_queue = queue(TRANSMIT_QUEUE);
+    ASSERT(transmit_queue.lock().is_locked());
+    void* token;
+    u32 length;
+    while (transmit_queue.take_used_buffers(token, length))
+        m_free_tx_buffers.append((FlatPtr)token);
+}
+
+void VirtIONetworkAdapter::send_raw(ReadonlyBytes payload)
+{
+    ASSERT(payload.size() <= buffer_size - packet_offset);
+    auto& transmit_queue = queue(TRANSMIT_QUEUE);
+    for (;;) {
+        {
+            ScopedSpinLock lock(transmit_queue.lock());
+            reclaim_transmit_buffers();
+            if (!m_free_tx_buffers.is_empty()) {
+                u16 index = m_free_tx_buffers.take_last();
+                // The header stays all zeroes: no checksum offload, no GSO.
+                memcpy(buffer(*m_tx_buffers_region, index) + packet_offset, payload.data(), payload.size());
+                auto address = buffer_address(*m_tx_buffers_region, index);
+                VirtIOQueue::Buffer buffers[] = {
+                    { address, virtio_net_header_size, false },
+                    { address.offset(packet_offset), (u32)payload.size(), false },
+                };
+                bool supplied = transmit_queue.supply_buffers(buffers, 2, (void*)(FlatPtr)index);
+                ASSERT(supplied);
+                // With the event index the device tells us when it actually
+                // needs a kick, which it doesn't while it is still busy with
+                // earlier packets.
+                notify_queue(TRANSMIT_QUEUE);
+#ifdef VIRTIO_NET_DEBUG
+                klog() << "VirtIONetworkAdapter: Sending packet (" << payload.size() << " bytes) from buffer " << index;
+#endif
+                return;
+            }
+        }
+        m_wait_queue.wait_on(nullptr, "VirtIONetworkAdapter");
+    }
+}
+
+}
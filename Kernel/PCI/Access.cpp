@@ -171,6 +171,50 @@ Vector<Capability> get_capabilities(Address address)
     return capabilities;
 }
 
+Optional<u8> find_capability(Address address, u8 id)
+{
+    auto capabilities_pointer = PCI::get_capabilities_pointer(address);
+    if (!capabilities_pointer.has_value())
+        return {};
+    u8 capability_pointer = capabilities_pointer.value() & 0xfc;
+    while (capability_pointer != 0) {
+        u16 capability_header = PCI::read16(address, capability_pointer);
+        if ((capability_header & 0xff) == id)
+            return capability_pointer;
+        capability_pointer = (capability_header >> 8) & 0xfc;
+    }
+    return {};
+}
+
+void enable_message_signalled_interrupts(Address address, u32 message_address, u16 message_data)
+{
+    auto capability = find_capability(address, PCI_CAPABILITY_MSI);
+    ASSERT(capability.has_value());
+    u8 offset = capability.value();
+    u16 control = read16(address, offset + 2);
+    write32(address, offset + 4, message_address);
+    if (control & (1 << 7)) {
+        // 64-bit message address
+        write32(address, offset + 8, 0);
+        write16(address, offset + 12, message_data);
+    } else {
+        write16(address, offset + 8, message_data);
+    }
+    // We only ever hand out a single vector.
+    control &= ~(0x7 << 4);
+    control |= 1;
+    write16(address, offset + 2, control);
+    disable_interrupt_line(address);
+}
+
+void disable_message_signalled_interrupts(Address address)
+{
+    auto capability = find_capability(address, PCI_CAPABILITY_MSI);
+    ASSERT(capability.has_value());
+    u8 offset = capability.value();
+    write16(address, offset + 2, read16(address, offset + 2) & ~1);
+}
+
 void raw_access(Address address, u32 field, size_t access_size, u32 value)
 {
     ASSERT(access_size != 0);
@@ -66,6 +66,7 @@ namespace Kernel {
 #define PCI_MAX_DEVICES_PER_BUS 32
 #define PCI_MAX_BUSES 256
 #define PCI_MAX_FUNCTIONS_PER_DEVICE 8
+#define PCI_CAPABILITY_MSI 0x05
 
 //#define PCI_DEBUG 1
 
@@ -231,6 +232,9 @@ u16 get_subsystem_vendor_id(Address);
 size_t get_BAR_space_size(Address, u8);
 Optional<u8> get_capabilities_pointer(Address);
 Vector<Capability> get_capabilities(Address);
+Optional<u8> find_capability(Address, u8 id);
+void enable_message_signalled_interrupts(Address, u32 message_address, u16 message_data);
+void disable_message_signalled_interrupts(Address);
 void enable_bus_mastering(Address);
 void disable_bus_mastering(Address);
 PhysicalID get_physical_id(Address address);
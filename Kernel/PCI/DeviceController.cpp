@@ -37,7 +37,7 @@ DeviceController::DeviceController(Address address)
 bool DeviceController::is_msi_capable() const
 {
     for (auto capability : PCI::get_physical_id(pci_address()).capabilities()) {
-        if (capability.m_id == 0x5)
+        if (capability.m_id == PCI_CAPABILITY_MSI)
             return true;
     }
     return false;
@@ -60,13 +60,13 @@ void DeviceController::disable_pin_based_interrupts() const
     PCI::disable_interrupt_line(pci_address());
 }
 
-void DeviceController::enable_message_signalled_interrupts()
+void DeviceController::enable_message_signalled_interrupts(u32 message_address, u16 message_data)
 {
-    TODO();
+    PCI::enable_message_signalled_interrupts(pci_address(), message_address, message_data);
 }
 void DeviceController::disable_message_signalled_interrupts()
 {
-    TODO();
+    PCI::disable_message_signalled_interrupts(pci_address());
 }
 void DeviceController::enable_extended_message_signalled_interrupts()
 {
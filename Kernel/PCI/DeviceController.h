@@ -41,7 +41,7 @@ public:
     bool is_msi_capable() const;
     bool is_msix_capable() const;
 
-    void enable_message_signalled_interrupts();
+    void enable_message_signalled_interrupts(u32 message_address, u16 message_data);
     void disable_message_signalled_interrupts();
 
     void enable_extended_message_signalled_interrupts();
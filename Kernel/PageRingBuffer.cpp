@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <Kernel/Arch/i386/CPU.h>
+#include <Kernel/PageRingBuffer.h>
+
+namespace Kernel {
+
+inline void PageRingBuffer::compute_lockfree_metadata()
+{
+    InterruptDisabler disabler;
+    m_empty = m_size == 0;
+    m_space_for_writing = m_capacity - m_size;
+}
+
+PageRingBuffer::PageRingBuffer(size_t capacity)
+    : m_capacity(capacity)
+{
+    m_space_for_writing = capacity;
+}
+
+PageRingBuffer::~PageRingBuffer()
+{
+    while (auto* segment = m_segments.remove_head())
+        delete segment;
+}
+
+KResult PageRingBuffer::set_capacity(size_t capacity)
+{
+    LOCKER(m_lock);
+    if (capacity < m_size)
+        return KResult(-EBUSY);
+    m_capacity = capacity;
+    compute_lockfree_metadata();
+    if (m_unblock_callback && m_space_for_writing > 0)
+        m_unblock_callback();
+    return KSuccess;
+}
+
+PageRingBuffer::Segment* PageRingBuffer::segment_for_writing()
+{
+    auto* tail = m_segments.tail();
+    if (tail && tail->space() > 0)
+        return tail;
+
+    Segment* segment = nullptr;
+    if (m_spare_segment) {
+        segment = m_spare_segment.leak_ptr();
+    } else {
+        auto storage = KBuffer::try_create_with_size(segment_size, Region::Access::Read | Region::Access::Write, "PageRingBuffer");
+        if (!storage)
+            return nullptr;
+        segment = new Segment(storage.release_nonnull());
+    }
+    m_segments.append(segment);
+    return segment;
+}
+
+void PageRingBuffer::recycle_segment(Segment& segment)
+{
+    m_segments.remove(&segment);
+    segment.read_offset = 0;
+    segment.write_offset = 0;
+    if (!m_spare_segment)
+        m_spare_segment = adopt_own(segment);
+    else
+        delete &segment;
+}
+
+void PageRingBuffer::release_drained_head()
+{
+    auto* head = m_segments.head();
+    if (!head || head->unread() > 0)
+        return;
+    if (head == m_segments.tail()) {
+        // Keep the last segment around for the next write, we're likely to need it.
+        head->read_offset = 0;
+        head->write_offset = 0;
+        return;
+    }
+    recycle_segment(*head);
+}
+
+PageRingBuffer::Segment* PageRingBuffer::first_unread_segment()
+{
+    // Drained segments may be left in front of ones that were relinked in behind them.
+    while (auto* head = m_segments.head()) {
+        if (head->unread() > 0)
+            return head;
+        if (head == m_segments.tail())
+            return nullptr;
+        recycle_segment(*head);
+    }
+    return nullptr;
+}
+
+void PageRingBuffer::append_segment(Segment& segment)
+{
+    // Don't leave an empty segment in front of the data, nor one we'd write to after it.
+    auto* tail = m_segments.tail();
+    if (tail && tail->unread() == 0)
+        recycle_segment(*tail);
+    m_segments.append(&segment);
+}
+
+ssize_t PageRingBuffer::write_locked(const UserOrKernelBuffer& data, size_t size)
+{
+    size_t bytes_to_write = min(size, m_capacity - m_size);
+    size_t nwritten = 0;
+    while (nwritten < bytes_to_write) {
+        auto* segment = segment_for_writing();
+        if (!segment)
+            break;
+        size_t chunk_size = min(bytes_to_write - nwritten, segment->space());
+        if (!data.read(segment->data() + segment->write_offset, nwritten, chunk_size)) {
+            if (nwritten == 0)
+                return -EFAULT;
+            break;
+        }
+        segment->write_offset += chunk_size;
+        m_size += chunk_size;
+        nwritten += chunk_size;
+    }
+    if (nwritten == 0 && bytes_to_write > 0)
+        return -ENOMEM;
+    return (ssize_t)nwritten;
+}
+
+ssize_t PageRingBuffer::write(const UserOrKernelBuffer& data, size_t size)
+{
+    if (!size)
+        return 0;
+    LOCKER(m_lock);
+    ssize_t nwritten = write_locked(data, size);
+    compute_lockfree_metadata();
+    if (m_unblock_callback && !m_empty)
+        m_unblock_callback();
+    return nwritten;
+}
+
+ssize_t PageRingBuffer::read(UserOrKernelBuffer& data, size_t size)
+{
+    if (!size)
+        return 0;
+    LOCKER(m_lock);
+    size_t nread = 0;
+    while (nread < size) {
+        auto* segment = first_unread_segment();
+        if (!segment)
+            break;
+        size_t chunk_size = min(size - nread, segment->unread());
+        if (!data.write(segment->data() + segment->read_offset, nread, chunk_size)) {
+            if (nread == 0)
+                return -EFAULT;
+            break;
+        }
+        segment->read_offset += chunk_size;
+        m_size -= chunk_size;
+        nread += chunk_size;
+        release_drained_head();
+    }
+    compute_lockfree_metadata();
+    if (m_unblock_callback && nread > 0 && m_space_for_writing > 0)
+        m_unblock_callback();
+    return (ssize_t)nread;
+}
+
+size_t PageRingBuffer::move_to(PageRingBuffer& destination, size_t max_size)
+{
+    ASSERT(this != &destination);
+    Locker first_locker(this < &destination ? m_lock : destination.m_lock);
+    Locker second_locker(this < &destination ? destination.m_lock : m_lock);
+
+    size_t moved = 0;
+    while (moved < max_size) {
+        auto* segment = first_unread_segment();
+        if (!segment)
+            break;
+        size_t wanted = min(max_size - moved, destination.m_capacity - destination.m_size);
+        if (wanted == 0)
+            break;
+
+        size_t unread = segment->unread();
+        if (unread <= wanted && unread >= segment_size / 2) {
+            // Relinking is cheaper than copying, even if it leaves some slack in either chain.
+            m_segments.remove(segment);
+            m_size -= unread;
+            destination.append_segment(*segment);
+            destination.m_size += unread;
+            moved += unread;
+            continue;
+        }
+
+        auto data = UserOrKernelBuffer::for_kernel_buffer(segment->data() + segment->read_offset);
+        ssize_t nwritten = destination.write_locked(data, min(wanted, unread));
+        if (nwritten <= 0)
+            break;
+        segment->read_offset += nwritten;
+        m_size -= nwritten;
+        moved += nwritten;
+        release_drained_head();
+    }
+
+    compute_lockfree_metadata();
+    destination.compute_lockfree_metadata();
+    if (moved > 0) {
+        if (m_unblock_callback)
+            m_unblock_callback();
+        if (destination.m_unblock_callback)
+            destination.m_unblock_callback();
+    }
+    return moved;
+}
+
+}
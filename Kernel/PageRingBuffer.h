@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <AK/InlineLinkedList.h>
+#include <AK/OwnPtr.h>
+#include <AK/Types.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/KResult.h>
+#include <Kernel/Lock.h>
+#include <Kernel/UserOrKernelBuffer.h>
+
+namespace Kernel {
+
+// A byte FIFO kept in a chain of page-backed segments. Memory is only allocated while there
+// is data in flight, so the capacity is just an upper bound and can be changed at runtime.
+// Whole segments can be handed over to another PageRingBuffer without copying their contents.
+class PageRingBuffer {
+public:
+    static constexpr size_t segment_size = 4 * PAGE_SIZE;
+    static constexpr size_t default_capacity = 64 * KiB;
+    static constexpr size_t max_unprivileged_capacity = 1 * MiB;
+    static constexpr size_t max_capacity = 16 * MiB;
+
+    explicit PageRingBuffer(size_t capacity = default_capacity);
+    ~PageRingBuffer();
+
+    [[nodiscard]] ssize_t write(const UserOrKernelBuffer&, size_t);
+    [[nodiscard]] ssize_t write(const u8* data, size_t size)
+    {
+        return write(UserOrKernelBuffer::for_kernel_buffer(const_cast<u8*>(data)), size);
+    }
+    [[nodiscard]] ssize_t read(UserOrKernelBuffer&, size_t);
+    [[nodiscard]] ssize_t read(u8* data, size_t size)
+    {
+        auto buffer = UserOrKernelBuffer::for_kernel_buffer(data);
+        return read(buffer, size);
+    }
+
+    // Moves up to `max_size` bytes into `destination`. Segments that fit are relinked as a
+    // whole, anything else is copied. Returns the number of bytes moved.
+    size_t move_to(PageRingBuffer& destination, size_t max_size);
+
+    bool is_empty() const { return m_empty; }
+    size_t space_for_writing() const { return m_space_for_writing; }
+
+    size_t capacity() const { return m_capacity; }
+    KResult set_capacity(size_t);
+
+    void set_unblock_callback(Function<void()> callback)
+    {
+        ASSERT(!m_unblock_callback);
+        m_unblock_callback = move(callback);
+    }
+
+private:
+    class Segment : public InlineLinkedListNode<Segment> {
+        friend class InlineLinkedListNode<Segment>;
+
+    public:
+        explicit Segment(NonnullOwnPtr<KBuffer>&& storage)
+            : m_storage(move(storage))
+        {
+        }
+
+        u8* data() { return m_storage->data(); }
+        size_t unread() const { return write_offset - read_offset; }
+        size_t space() const { return m_storage->capacity() - write_offset; }
+
+        size_t read_offset { 0 };
+        size_t write_offset { 0 };
+
+    private:
+        NonnullOwnPtr<KBuffer> m_storage;
+        Segment* m_next { nullptr };
+        Segment* m_prev { nullptr };
+    };
+
+    ssize_t write_locked(const UserOrKernelBuffer&, size_t);
+    Segment* segment_for_writing();
+    void recycle_segment(Segment&);
+    void release_drained_head();
+    Segment* first_unread_segment();
+    void append_segment(Segment&);
+    void compute_lockfree_metadata();
+
+    InlineLinkedList<Segment> m_segments;
+    OwnPtr<Segment> m_spare_segment;
+    Function<void()> m_unblock_callback;
+    size_t m_capacity { 0 };
+    size_t m_size { 0 };
+    size_t m_space_for_writing { 0 };
+    bool m_empty { true };
+    mutable Lock m_lock { "PageRingBuffer" };
+};
+
+}
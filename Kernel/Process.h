@@ -38,6 +38,7 @@
 #include <Kernel/API/Syscall.h>
 #include <Kernel/FileSystem/InodeMetadata.h>
 #include <Kernel/Forward.h>
+#include <Kernel/FutexQueue.h>
 #include <Kernel/Lock.h>
 #include <Kernel/ProcessGroup.h>
 #include <Kernel/StdLib.h>
@@ -257,6 +258,11 @@ public:
     ssize_t sys$read(int fd, Userspace<u8*>, ssize_t);
     ssize_t sys$write(int fd, const u8*, ssize_t);
     ssize_t sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count);
+    ssize_t sys$readv(int fd, Userspace<const struct iovec*> iov, int iov_count);
+    ssize_t sys$pread(Userspace<const Syscall::SC_pread_params*>);
+    ssize_t sys$pwrite(Userspace<const Syscall::SC_pwrite_params*>);
+    ssize_t sys$preadv(Userspace<const Syscall::SC_preadv_params*>);
+    ssize_t sys$pwritev(Userspace<const Syscall::SC_preadv_params*>);
     int sys$fstat(int fd, Userspace<stat*>);
     int sys$stat(Userspace<const Syscall::SC_stat_params*>);
     int sys$lseek(int fd, off_t, int whence);
@@ -270,9 +276,15 @@ public:
     int sys$mprotect(void*, size_t, int prot);
     int sys$madvise(void*, size_t, int advice);
     int sys$minherit(void*, size_t, int inherit);
+    int sys$anon_create(size_t, int options);
     int sys$purge(int mode);
     int sys$select(const Syscall::SC_select_params*);
     int sys$poll(Userspace<const Syscall::SC_poll_params*>);
+    int sys$epoll_create(int flags);
+    int sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*>);
+    int sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*>);
+    ssize_t sys$sendfile(Userspace<const Syscall::SC_sendfile_params*>);
+    ssize_t sys$splice(Userspace<const Syscall::SC_splice_params*>);
     ssize_t sys$get_dir_entries(int fd, void*, ssize_t);
     int sys$getcwd(Userspace<char*>, ssize_t);
     int sys$chdir(Userspace<const char*>, size_t);
@@ -542,6 +554,8 @@ private:
 
     int do_exec(NonnullRefPtr<FileDescription> main_program_description, Vector<String> arguments, Vector<String> environment, RefPtr<FileDescription> interpreter_description, Thread*& new_main_thread, u32& prev_flags);
     ssize_t do_write(FileDescription&, const UserOrKernelBuffer&, size_t);
+    ssize_t do_pwrite(FileDescription&, const UserOrKernelBuffer&, off_t, size_t);
+    KResult copy_iovecs_from_user(Vector<iovec, 32>&, Userspace<const struct iovec*>, int iov_count, size_t& total_length);
 
     KResultOr<NonnullRefPtr<FileDescription>> find_elf_interpreter_for_executable(const String& path, char (&first_page)[PAGE_SIZE], int nread, size_t file_size);
     Vector<AuxiliaryValue> generate_auxiliary_vector() const;
@@ -662,8 +676,11 @@ private:
     VeilState m_veil_state { VeilState::None };
     Vector<UnveiledPath> m_unveiled_paths;
 
-    WaitQueue& futex_queue(Userspace<const i32*>);
-    HashMap<u32, OwnPtr<WaitQueue>> m_futex_queues;
+    FutexQueue& futex_queue(Userspace<const i32*>);
+    int futex_lock_pi(Userspace<const i32*>, const Thread::BlockTimeout&, bool try_only);
+    int futex_unlock_pi(Userspace<const i32*>);
+    Lock m_futex_lock { "Futex" };
+    HashMap<FlatPtr, OwnPtr<FutexQueue>> m_futex_queues;
 
     OwnPtr<PerformanceEventBuffer> m_perf_event_buffer;
 
@@ -775,7 +792,7 @@ inline const LogStream& operator<<(const LogStream& stream, const Process& proce
 
 inline u32 Thread::effective_priority() const
 {
-    return m_priority + m_process->priority_boost() + m_priority_boost + m_extra_priority;
+    return max(m_priority + m_process->priority_boost() + m_priority_boost, inherited_priority());
 }
 
 #define REQUIRE_NO_PROMISES                        \
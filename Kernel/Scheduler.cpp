@@ -24,7 +24,6 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <AK/QuickSort.h>
 #include <AK/ScopeGuard.h>
 #include <AK/TemporaryChange.h>
 #include <AK/Time.h>
@@ -41,6 +40,13 @@
 
 namespace Kernel {
 
+static constexpr u32 g_ready_queues_count = 32;
+
+// Every this many times a bucket is passed over, it competes as if it were
+// one bucket more important. This keeps busy high priority threads from
+// starving everyone else, the same way m_extra_priority used to.
+static constexpr u32 g_ready_queue_aging_passes = 4;
+
 class SchedulerPerProcessorData {
     AK_MAKE_NONCOPYABLE(SchedulerPerProcessorData);
     AK_MAKE_NONMOVABLE(SchedulerPerProcessorData);
@@ -51,6 +57,24 @@ public:
     WeakPtr<Thread> m_pending_beneficiary;
     const char* m_pending_donate_reason { nullptr };
     bool m_in_scheduler { true };
+
+    // Runnable threads waiting for this processor, bucketed by priority.
+    // Bucket 0 holds the highest priorities, and bit N of the mask is set
+    // whenever bucket N is non-empty, so picking the next thread doesn't
+    // have to look at every runnable thread in the system.
+    SchedulerData::ReadyQueueList m_ready_queues[g_ready_queues_count];
+    u32 m_ready_queues_mask { 0 };
+    size_t m_ready_count { 0 };
+
+    // How many times each non-empty bucket has been passed over.
+    u32 m_ready_queue_passes[g_ready_queues_count] {};
+};
+
+struct ReadyQueuePick {
+    Thread* thread { nullptr };
+    SchedulerPerProcessorData* scheduler_data { nullptr };
+    u32 index { 0 };
+    u32 aged_index { 0 };
 };
 
 SchedulerData* g_scheduler_data;
@@ -62,6 +86,177 @@ void Scheduler::init_thread(Thread& thread)
     g_scheduler_data->m_nonrunnable_threads.append(thread);
 }
 
+static u32 ready_queue_index_for(const Thread& thread)
+{
+    auto priority = min<u32>(max<u32>(thread.effective_priority(), THREAD_PRIORITY_MIN), THREAD_PRIORITY_MAX);
+    return (THREAD_PRIORITY_MAX - priority) * g_ready_queues_count / (THREAD_PRIORITY_MAX - THREAD_PRIORITY_MIN + 1);
+}
+
+static Processor& processor_for_runnable_thread(const Thread& thread)
+{
+    // Prefer the processor the thread last ran on, then the current one.
+    auto can_queue_on = [&](Processor& proc) {
+        return proc.has_scheduler_data() && (thread.affinity() & (1u << proc.id()));
+    };
+    Processor* target = nullptr;
+    if (thread.cpu() < Processor::processor_count()) {
+        auto& last_proc = Processor::by_id(thread.cpu());
+        if (can_queue_on(last_proc))
+            target = &last_proc;
+    }
+    if (!target && can_queue_on(Processor::current()))
+        target = &Processor::current();
+    if (!target) {
+        Processor::for_each([&](Processor& proc) {
+            if (!can_queue_on(proc))
+                return IterationDecision::Continue;
+            target = &proc;
+            return IterationDecision::Break;
+        });
+    }
+    if (!target) {
+        // The thread may only run on processors that haven't entered the
+        // scheduler yet. Park it on one that has; nobody there will pick it
+        // up, and it waits until one of the processors it may run on steals it.
+        Processor::for_each([&](Processor& proc) {
+            if (!proc.has_scheduler_data())
+                return IterationDecision::Continue;
+            target = &proc;
+            return IterationDecision::Break;
+        });
+    }
+    ASSERT(target);
+    return *target;
+}
+
+void Scheduler::queue_runnable_thread(Thread& thread)
+{
+    ASSERT(g_scheduler_lock.own_lock());
+    ASSERT(thread.m_runnable_priority < 0);
+    auto& proc = processor_for_runnable_thread(thread);
+    auto& scheduler_data = proc.get_scheduler_data();
+    auto index = ready_queue_index_for(thread);
+    thread.m_runnable_priority = (int)index;
+    thread.m_ready_queue_cpu = proc.id();
+    scheduler_data.m_ready_queues[index].append(thread);
+    scheduler_data.m_ready_queues_mask |= 1u << index;
+    scheduler_data.m_ready_count++;
+}
+
+void Scheduler::dequeue_runnable_thread(Thread& thread)
+{
+    ASSERT(g_scheduler_lock.own_lock());
+    if (thread.m_runnable_priority < 0)
+        return;
+    auto& scheduler_data = Processor::by_id(thread.m_ready_queue_cpu).get_scheduler_data();
+    auto index = (u32)thread.m_runnable_priority;
+    auto& ready_queue = scheduler_data.m_ready_queues[index];
+    ready_queue.remove(thread);
+    if (ready_queue.is_empty()) {
+        scheduler_data.m_ready_queues_mask &= ~(1u << index);
+        scheduler_data.m_ready_queue_passes[index] = 0;
+    }
+    ASSERT(scheduler_data.m_ready_count > 0);
+    scheduler_data.m_ready_count--;
+    thread.m_runnable_priority = -1;
+}
+
+void Scheduler::requeue_runnable_thread(Thread& thread)
+{
+    ASSERT(g_scheduler_lock.own_lock());
+    // The bucket is picked when the thread is queued, so a thread whose
+    // priority changed while it was waiting has to be moved to its new one.
+    if (thread.m_runnable_priority < 0 || (u32)thread.m_runnable_priority == ready_queue_index_for(thread))
+        return;
+    dequeue_runnable_thread(thread);
+    queue_runnable_thread(thread);
+}
+
+static u32 aged_ready_queue_index(const SchedulerPerProcessorData& scheduler_data, u32 index)
+{
+    auto bump = scheduler_data.m_ready_queue_passes[index] / g_ready_queue_aging_passes;
+    return bump < index ? index - bump : 0;
+}
+
+static void note_ready_queue_pick(SchedulerPerProcessorData& scheduler_data, u32 picked_index)
+{
+    auto priority_mask = scheduler_data.m_ready_queues_mask & ~(1u << picked_index);
+    while (priority_mask != 0) {
+        auto index = __builtin_ffs(priority_mask) - 1;
+        scheduler_data.m_ready_queue_passes[index]++;
+        priority_mask &= ~(1u << index);
+    }
+    scheduler_data.m_ready_queue_passes[picked_index] = 0;
+}
+
+static Thread* first_runnable_thread_in(SchedulerData::ReadyQueueList& ready_queue, u32 cpu_mask)
+{
+    for (auto& thread : ready_queue) {
+        if (!(thread.affinity() & cpu_mask))
+            continue;
+        // A thread that was just switched away from may still be on
+        // its old processor's stack until that switch completes.
+        if (thread.is_active())
+            continue;
+        if (thread.process().exec_tid() && thread.process().exec_tid() != thread.tid())
+            continue;
+        return &thread;
+    }
+    return nullptr;
+}
+
+static ReadyQueuePick peek_next_runnable_thread(SchedulerPerProcessorData& scheduler_data, u32 cpu_mask)
+{
+    ReadyQueuePick pick;
+    auto priority_mask = scheduler_data.m_ready_queues_mask;
+    while (priority_mask != 0) {
+        u32 index = __builtin_ffs(priority_mask) - 1;
+        priority_mask &= ~(1u << index);
+        // Ties go to the bucket that is more important without aging.
+        auto aged_index = aged_ready_queue_index(scheduler_data, index);
+        if (pick.thread && aged_index >= pick.aged_index)
+            continue;
+        if (auto* thread = first_runnable_thread_in(scheduler_data.m_ready_queues[index], cpu_mask)) {
+            pick.thread = thread;
+            pick.scheduler_data = &scheduler_data;
+            pick.index = index;
+            pick.aged_index = aged_index;
+        }
+    }
+    return pick;
+}
+
+static ReadyQueuePick find_next_runnable_thread()
+{
+    auto& proc = Processor::current();
+    auto cpu_mask = 1u << proc.id();
+    auto pick = peek_next_runnable_thread(proc.get_scheduler_data(), cpu_mask);
+    if (pick.thread)
+        return pick;
+
+    // Nothing to do locally, steal the best candidate from the busiest
+    // processor that has work we're allowed to run.
+    size_t busiest_count = 0;
+    Processor::for_each([&](Processor& other_proc) {
+        if (&other_proc == &proc || !other_proc.has_scheduler_data())
+            return IterationDecision::Continue;
+        auto& other_data = other_proc.get_scheduler_data();
+        if (other_data.m_ready_count <= busiest_count)
+            return IterationDecision::Continue;
+        auto other_pick = peek_next_runnable_thread(other_data, cpu_mask);
+        if (other_pick.thread) {
+            pick = other_pick;
+            busiest_count = other_data.m_ready_count;
+        }
+        return IterationDecision::Continue;
+    });
+#ifdef SCHEDULER_DEBUG
+    if (pick.thread)
+        dbg() << "Scheduler[" << proc.id() << "]: Stealing " << *pick.thread << " from CPU #" << pick.thread->cpu();
+#endif
+    return pick;
+}
+
 static u32 time_slice_for(const Thread& thread)
 {
     // One time slice unit == 1ms
@@ -84,7 +279,8 @@ void Scheduler::start()
     g_scheduler_lock.lock();
 
     auto& processor = Processor::current();
-    processor.set_scheduler_data(*new SchedulerPerProcessorData());
+    if (!processor.has_scheduler_data())
+        processor.set_scheduler_data(*new SchedulerPerProcessorData());
     ASSERT(processor.is_initialized());
     auto& idle_thread = *processor.idle_thread();
     ASSERT(processor.current_thread() == &idle_thread);
@@ -157,19 +353,10 @@ bool Scheduler::pick_next()
     Thread* thread_to_schedule = nullptr;
 
     auto pending_beneficiary = scheduler_data.m_pending_beneficiary.strong_ref();
-    Vector<Thread*, 128> sorted_runnables;
-    for_each_runnable([&](auto& thread) {
-        if ((thread.affinity() & (1u << Processor::current().id())) == 0)
-            return IterationDecision::Continue;
-        if (thread.state() == Thread::Running && &thread != current_thread)
-            return IterationDecision::Continue;
-        sorted_runnables.append(&thread);
-        if (&thread == pending_beneficiary) {
-            thread_to_schedule = &thread;
-            return IterationDecision::Break;
-        }
-        return IterationDecision::Continue;
-    });
+    if (pending_beneficiary && (pending_beneficiary->affinity() & (1u << Processor::current().id()))) {
+        if (pending_beneficiary->state() == Thread::Runnable || pending_beneficiary == current_thread)
+            thread_to_schedule = pending_beneficiary.ptr();
+    }
 
     if (thread_to_schedule) {
         // The thread we're supposed to donate to still exists
@@ -192,21 +379,23 @@ bool Scheduler::pick_next()
     scheduler_data.m_pending_beneficiary = nullptr;
     scheduler_data.m_pending_donate_reason = nullptr;
 
-    quick_sort(sorted_runnables, [](auto& a, auto& b) { return a->effective_priority() >= b->effective_priority(); });
-
-    for (auto* thread : sorted_runnables) {
-        if (thread->process().exec_tid() && thread->process().exec_tid() != thread->tid())
-            continue;
-
-        ASSERT(thread->state() == Thread::Runnable || thread->state() == Thread::Running);
-
-        if (!thread_to_schedule) {
-            thread->m_extra_priority = 0;
-            thread_to_schedule = thread;
-        } else {
-            thread->m_extra_priority++;
+    auto pick = find_next_runnable_thread();
+    thread_to_schedule = pick.thread;
+
+    // Let the current thread keep running unless a thread of at least its
+    // priority is waiting. Threads of the same priority take turns, and
+    // waiting threads age until they get their turn too.
+    if (current_thread->state() == Thread::Running && current_thread != Processor::current().idle_thread()) {
+        if (!current_thread->process().exec_tid() || current_thread->process().exec_tid() == current_thread->tid()) {
+            auto current_index = ready_queue_index_for(*current_thread);
+            if (!thread_to_schedule || pick.aged_index > current_index) {
+                thread_to_schedule = current_thread;
+                note_ready_queue_pick(scheduler_data, current_index);
+            }
         }
     }
+    if (thread_to_schedule && thread_to_schedule == pick.thread)
+        note_ready_queue_pick(*pick.scheduler_data, pick.index);
 
     if (!thread_to_schedule)
         thread_to_schedule = Processor::current().idle_thread();
@@ -426,6 +615,7 @@ void Scheduler::initialize()
 
     RefPtr<Thread> idle_thread;
     g_scheduler_data = new SchedulerData;
+    Processor::current().set_scheduler_data(*new SchedulerPerProcessorData());
     g_finalizer_wait_queue = new WaitQueue;
 
     g_finalizer_has_work.store(false, AK::MemoryOrder::memory_order_release);
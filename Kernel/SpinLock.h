@@ -96,6 +96,20 @@ public:
         return prev_flags;
     }
 
+    ALWAYS_INLINE bool try_lock(u32& prev_flags)
+    {
+        auto& proc = Processor::current();
+        FlatPtr cpu = FlatPtr(&proc);
+        proc.enter_critical(prev_flags);
+        FlatPtr expected = 0;
+        if (!m_lock.compare_exchange_strong(expected, cpu, AK::memory_order_acq_rel) && expected != cpu) {
+            proc.leave_critical(prev_flags);
+            return false;
+        }
+        m_recursions++;
+        return true;
+    }
+
     ALWAYS_INLINE void unlock(u32 prev_flags)
     {
         ASSERT(m_recursions > 0);
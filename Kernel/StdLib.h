@@ -28,6 +28,7 @@
 
 #include <AK/Checked.h>
 #include <AK/Forward.h>
+#include <AK/Optional.h>
 #include <AK/Userspace.h>
 
 namespace Syscall {
@@ -37,6 +38,9 @@ struct StringArgument;
 String copy_string_from_user(const char*, size_t);
 String copy_string_from_user(Userspace<const char*>, size_t);
 
+// Returns an empty Optional if var isn't accessible, otherwise whether the exchange happened.
+[[nodiscard]] Optional<bool> user_atomic_compare_exchange_relaxed(volatile u32* var, u32& expected, u32 desired);
+
 extern "C" {
 
 [[nodiscard]] bool copy_to_user(void*, const void*, size_t);
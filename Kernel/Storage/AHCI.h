@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/Types.h>
+
+// See the Serial ATA AHCI 1.3.1 specification.
+
+namespace Kernel {
+namespace AHCI {
+
+struct [[gnu::packed]] PortRegisters {
+    u32 clb;  // Command list base address
+    u32 clbu; // Command list base address, upper 32 bits
+    u32 fb;   // FIS base address
+    u32 fbu;  // FIS base address, upper 32 bits
+    u32 is;   // Interrupt status
+    u32 ie;   // Interrupt enable
+    u32 cmd;  // Command and status
+    u32 reserved0;
+    u32 tfd;  // Task file data
+    u32 sig;  // Signature
+    u32 ssts; // SATA status (SStatus)
+    u32 sctl; // SATA control (SControl)
+    u32 serr; // SATA error (SError)
+    u32 sact; // SATA active (SActive)
+    u32 ci;   // Command issue
+    u32 sntf; // SATA notification
+    u32 fbs;  // FIS-based switching control
+    u32 reserved1[11];
+    u32 vendor[4];
+};
+
+static_assert(sizeof(PortRegisters) == 0x80);
+
+struct [[gnu::packed]] HBARegisters {
+    u32 cap;       // Host capabilities
+    u32 ghc;       // Global host control
+    u32 is;        // Interrupt status
+    u32 pi;        // Ports implemented
+    u32 vs;        // Version
+    u32 ccc_ctl;   // Command completion coalescing control
+    u32 ccc_ports; // Command completion coalescing ports
+    u32 em_loc;    // Enclosure management location
+    u32 em_ctl;    // Enclosure management control
+    u32 cap2;      // Host capabilities extended
+    u32 bohc;      // BIOS/OS handoff control and status
+    u8 reserved[0xa0 - 0x2c];
+    u8 vendor[0x100 - 0xa0];
+    PortRegisters ports[32];
+};
+
+static_assert(sizeof(HBARegisters) == 0x1100);
+
+enum HBACapabilities : u32 {
+    NumberOfCommandSlotsShift = 8,
+    NumberOfCommandSlotsMask = 0x1f,
+    SupportsNativeCommandQueuing = 1u << 30,
+};
+
+enum GlobalHostControl : u32 {
+    HBAReset = 1u << 0,
+    InterruptEnable = 1u << 1,
+    AHCIEnable = 1u << 31,
+};
+
+enum PortCommand : u32 {
+    Start = 1u << 0,
+    SpinUpDevice = 1u << 1,
+    PowerOnDevice = 1u << 2,
+    FISReceiveEnable = 1u << 4,
+    FISReceiveRunning = 1u << 14,
+    CommandListRunning = 1u << 15,
+};
+
+enum PortInterrupt : u32 {
+    DeviceToHostRegisterFIS = 1u << 0,
+    PIOSetupFIS = 1u << 1,
+    DMASetupFIS = 1u << 2,
+    SetDeviceBitsFIS = 1u << 3,
+    DescriptorProcessed = 1u << 5,
+    InterfaceFatalError = 1u << 27,
+    HostBusDataError = 1u << 28,
+    HostBusFatalError = 1u << 29,
+    TaskFileError = 1u << 30,
+
+    Completions = DeviceToHostRegisterFIS | PIOSetupFIS | DMASetupFIS | SetDeviceBitsFIS | DescriptorProcessed,
+    Errors = InterfaceFatalError | HostBusDataError | HostBusFatalError | TaskFileError,
+};
+
+enum TaskFileStatus : u32 {
+    Error = 1u << 0,
+    DataRequest = 1u << 3,
+    Busy = 1u << 7,
+};
+
+// SStatus device detection: a device is present and communication is up.
+static constexpr u32 device_detection_mask = 0xf;
+static constexpr u32 device_present = 0x3;
+
+static constexpr u32 sata_drive_signature = 0x00000101;
+
+static constexpr size_t max_command_slots = 32;
+
+enum class FISType : u8 {
+    RegisterHostToDevice = 0x27,
+    RegisterDeviceToHost = 0x34,
+    DMAActivate = 0x39,
+    DMASetup = 0x41,
+    Data = 0x46,
+    BISTActivate = 0x58,
+    PIOSetup = 0x5f,
+    SetDeviceBits = 0xa1,
+};
+
+struct [[gnu::packed]] RegisterHostToDeviceFIS {
+    FISType type;
+    u8 flags; // Bit 7 set for a command, clear for a control register update
+    u8 command;
+    u8 features_low;
+    u8 lba0;
+    u8 lba1;
+    u8 lba2;
+    u8 device;
+    u8 lba3;
+    u8 lba4;
+    u8 lba5;
+    u8 features_high;
+    u8 count_low;
+    u8 count_high;
+    u8 icc;
+    u8 control;
+    u8 reserved[4];
+};
+
+static_assert(sizeof(RegisterHostToDeviceFIS) == 20);
+
+struct [[gnu::packed]] CommandHeader {
+    u16 flags; // FIS length in dwords, ATAPI, write, prefetchable, ...
+    u16 prdt_length;
+    u32 prd_byte_count;
+    u32 command_table_base;
+    u32 command_table_base_upper;
+    u32 reserved[4];
+};
+
+static_assert(sizeof(CommandHeader) == 32);
+
+enum CommandHeaderFlags : u16 {
+    Write = 1u << 6,
+    Prefetchable = 1u << 7,
+    ClearBusyUponOk = 1u << 10,
+};
+
+struct [[gnu::packed]] PhysicalRegionDescriptor {
+    u32 data_base;
+    u32 data_base_upper;
+    u32 reserved;
+    u32 byte_count; // Byte count - 1 in bits 0-21, interrupt on completion in bit 31
+};
+
+static_assert(sizeof(PhysicalRegionDescriptor) == 16);
+
+// Each command table must be 128-byte aligned.
+static constexpr size_t command_table_size = 512;
+static constexpr size_t max_prdt_entries = (command_table_size - 0x80) / sizeof(PhysicalRegionDescriptor);
+
+struct [[gnu::packed]] CommandTable {
+    u8 command_fis[64];
+    u8 atapi_command[16];
+    u8 reserved[48];
+    PhysicalRegionDescriptor prdt[max_prdt_entries];
+};
+
+static_assert(sizeof(CommandTable) == command_table_size);
+
+enum ATACommand : u8 {
+    ReadDMAExt = 0x25,
+    WriteDMAExt = 0x35,
+    ReadFPDMAQueued = 0x60,
+    WriteFPDMAQueued = 0x61,
+    IdentifyDevice = 0xec,
+};
+
+}
+}
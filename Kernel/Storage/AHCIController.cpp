@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/OwnPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/Types.h>
+#include <Kernel/Interrupts/IRQHandler.h>
+#include <Kernel/Interrupts/MSIHandler.h>
+#include <Kernel/Storage/AHCIController.h>
+#include <Kernel/Storage/SATADiskDevice.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+class AHCIPinInterruptHandler final : public IRQHandler {
+public:
+    AHCIPinInterruptHandler(AHCIController& controller, u8 irq)
+        : IRQHandler(irq)
+        , m_controller(controller)
+    {
+    }
+
+    virtual const char* purpose() const override { return "AHCIController"; }
+
+private:
+    virtual void handle_irq(const RegisterState&) override { m_controller.handle_interrupt(); }
+
+    AHCIController& m_controller;
+};
+
+class AHCIMSIHandler final : public MSIHandler {
+public:
+    explicit AHCIMSIHandler(AHCIController& controller)
+        : MSIHandler(controller.pci_address())
+        , m_controller(controller)
+    {
+    }
+
+    virtual const char* purpose() const override { return "AHCIController"; }
+
+private:
+    virtual void handle_msi(const RegisterState&) override { m_controller.handle_interrupt(); }
+
+    AHCIController& m_controller;
+};
+
+NonnullRefPtr<AHCIController> AHCIController::initialize(PCI::Address address)
+{
+    return adopt(*new AHCIController(address));
+}
+
+bool AHCIController::reset()
+{
+    TODO();
+}
+
+bool AHCIController::shutdown()
+{
+    TODO();
+}
+
+size_t AHCIController::devices_count() const
+{
+    return m_ports.size();
+}
+
+void AHCIController::start_request(const StorageDevice&, AsyncBlockDeviceRequest&)
+{
+    ASSERT_NOT_REACHED();
+}
+
+void AHCIController::complete_current_request(AsyncDeviceRequest::RequestResult)
+{
+    ASSERT_NOT_REACHED();
+}
+
+AHCIController::AHCIController(PCI::Address address)
+    : StorageController(address)
+{
+    initialize();
+}
+
+AHCIController::~AHCIController()
+{
+}
+
+void AHCIController::initialize()
+{
+    auto abar = PhysicalAddress(PCI::get_BAR5(pci_address()) & 0xfffffff0);
+    m_registers_region = MM.allocate_kernel_region(abar.page_base(), PAGE_ROUND_UP(abar.offset_in_page() + sizeof(AHCI::HBARegisters)), "AHCI ABAR", Region::Access::Read | Region::Access::Write, false, false);
+    if (!m_registers_region) {
+        klog() << "AHCIController: Failed to map registers at " << abar;
+        return;
+    }
+    PCI::enable_bus_mastering(pci_address());
+
+    auto& hba = registers();
+    hba.ghc = hba.ghc | AHCI::AHCIEnable;
+    // Keep the controller quiet until the ports are set up.
+    hba.ghc = hba.ghc & ~AHCI::InterruptEnable;
+
+    u32 capabilities = hba.cap;
+    size_t command_slots = ((capabilities >> AHCI::NumberOfCommandSlotsShift) & AHCI::NumberOfCommandSlotsMask) + 1;
+    bool supports_ncq = capabilities & AHCI::SupportsNativeCommandQueuing;
+    u32 ports_implemented = hba.pi;
+    klog() << "AHCIController: Version " << String::format("%x", hba.vs) << " @ " << abar << ", " << command_slots << " command slots" << (supports_ncq ? ", NCQ" : "") << ", ports " << String::format("%08x", ports_implemented);
+
+    for (u32 port_index = 0; port_index < 32; port_index++) {
+        if (!(ports_implemented & (1u << port_index)))
+            continue;
+        auto port = AHCIPort::create(*this, hba.ports[port_index], port_index, command_slots, supports_ncq);
+        if (!port)
+            continue;
+        m_port_by_index[port_index] = port.ptr();
+        m_ports.append(port.release_nonnull());
+    }
+
+    if (!m_ports.is_empty())
+        enable_interrupts();
+}
+
+void AHCIController::enable_interrupts()
+{
+    auto& hba = registers();
+    hba.is = 0xffffffff;
+
+    if (MSIHandler::is_supported(pci_address())) {
+        auto handler = make<AHCIMSIHandler>(*this);
+        handler->enable_irq();
+        m_interrupt_handler = move(handler);
+        klog() << "AHCIController: Using MSI vector " << String::format("%x", m_interrupt_handler->interrupt_number() + IRQ_VECTOR_BASE);
+    } else {
+        auto handler = make<AHCIPinInterruptHandler>(*this, PCI::get_interrupt_line(pci_address()));
+        enable_pin_based_interrupts();
+        handler->enable_irq();
+        m_interrupt_handler = move(handler);
+        klog() << "AHCIController: Using IRQ " << m_interrupt_handler->interrupt_number();
+    }
+
+    hba.ghc = hba.ghc | AHCI::InterruptEnable;
+}
+
+void AHCIController::handle_interrupt()
+{
+    auto& hba = registers();
+    u32 pending_ports = hba.is;
+    if (!pending_ports)
+        return;
+    for (u32 port_index = 0; port_index < 32; port_index++) {
+        if (!(pending_ports & (1u << port_index)))
+            continue;
+        if (auto* port = m_port_by_index[port_index])
+            port->handle_interrupt();
+        else
+            hba.ports[port_index].is = 0xffffffff;
+    }
+    hba.is = pending_ports;
+}
+
+RefPtr<StorageDevice> AHCIController::device(u32 index) const
+{
+    if (index >= m_ports.size())
+        return nullptr;
+    return m_ports[index].device();
+}
+
+}
@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define AHCI_DEBUG
+
+#include <AK/Memory.h>
+#include <AK/NumericLimits.h>
+#include <Kernel/Process.h>
+#include <Kernel/Storage/AHCIController.h>
+#include <Kernel/Storage/AHCIPort.h>
+#include <Kernel/Storage/SATADiskDevice.h>
+#include <Kernel/Storage/StorageManagement.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+static constexpr size_t command_buffer_size = AHCIPort::max_sectors_per_command * 512;
+static_assert(command_buffer_size / PAGE_SIZE <= AHCI::max_prdt_entries);
+
+// The received FIS area shares a page with the command list.
+static constexpr size_t received_fis_offset = 1024;
+
+// Only ever called from threads, so we sleep rather than spin while the hardware gets there.
+template<typename Condition>
+static bool wait_for(size_t milliseconds, Condition condition)
+{
+    for (size_t i = 0; i < milliseconds; i++) {
+        if (condition())
+            return true;
+        Thread::current()->sleep({ 0, 1'000'000 });
+    }
+    return condition();
+}
+
+static u32 slot_mask(size_t slots)
+{
+    return slots >= 32 ? 0xffffffff : (1u << slots) - 1;
+}
+
+OwnPtr<AHCIPort> AHCIPort::create(AHCIController& controller, volatile AHCI::PortRegisters& registers, u32 port_index, size_t command_slots, bool supports_ncq)
+{
+    if ((registers.ssts & AHCI::device_detection_mask) != AHCI::device_present)
+        return nullptr;
+    if (registers.sig != AHCI::sata_drive_signature) {
+        klog() << "AHCIPort: Ignoring device with signature " << String::format("%08x", registers.sig) << " on port " << port_index;
+        return nullptr;
+    }
+    auto port = adopt_own(*new AHCIPort(controller, registers, port_index, command_slots));
+    if (!port->initialize(supports_ncq))
+        return nullptr;
+    return port;
+}
+
+AHCIPort::AHCIPort(AHCIController& controller, volatile AHCI::PortRegisters& registers, u32 port_index, size_t command_slots)
+    : m_controller(controller)
+    , m_registers(registers)
+    , m_port_index(port_index)
+    , m_command_slots(command_slots)
+{
+}
+
+AHCIPort::~AHCIPort()
+{
+}
+
+bool AHCIPort::stop_command_engine()
+{
+    m_registers.cmd = m_registers.cmd & ~AHCI::Start;
+    if (!wait_for(500, [this] { return !(m_registers.cmd & AHCI::CommandListRunning); }))
+        return false;
+    m_registers.cmd = m_registers.cmd & ~AHCI::FISReceiveEnable;
+    return wait_for(500, [this] { return !(m_registers.cmd & AHCI::FISReceiveRunning); });
+}
+
+void AHCIPort::start_command_engine()
+{
+    m_registers.cmd = m_registers.cmd | AHCI::FISReceiveEnable;
+    m_registers.cmd = m_registers.cmd | AHCI::Start;
+}
+
+bool AHCIPort::wait_while_busy()
+{
+    return wait_for(1000, [this] { return !(m_registers.tfd & (AHCI::Busy | AHCI::DataRequest)); });
+}
+
+bool AHCIPort::initialize(bool supports_ncq)
+{
+    if (!stop_command_engine()) {
+        klog() << "AHCIPort: Port " << m_port_index << " didn't stop, ignoring it";
+        return false;
+    }
+
+    m_command_list_region = MM.allocate_contiguous_kernel_region(PAGE_SIZE, "AHCI Command List", Region::Access::Read | Region::Access::Write);
+    m_command_tables_region = MM.allocate_contiguous_kernel_region(PAGE_ROUND_UP(m_command_slots * AHCI::command_table_size), "AHCI Command Tables", Region::Access::Read | Region::Access::Write);
+    // The bounce buffers don't need to be contiguous, every command gets a
+    // scatter/gather list of the pages backing its buffer.
+    m_buffers_region = MM.allocate_kernel_region(m_command_slots * command_buffer_size, "AHCI Buffers", Region::Access::Read | Region::Access::Write);
+    if (!m_command_list_region || !m_command_tables_region || !m_buffers_region) {
+        klog() << "AHCIPort: Failed to allocate memory for port " << m_port_index;
+        return false;
+    }
+    memset(m_command_list_region->vaddr().as_ptr(), 0, m_command_list_region->size());
+    memset(m_command_tables_region->vaddr().as_ptr(), 0, m_command_tables_region->size());
+
+    auto command_list = m_command_list_region->physical_page(0)->paddr();
+    m_registers.clb = command_list.get();
+    m_registers.clbu = 0;
+    m_registers.fb = command_list.offset(received_fis_offset).get();
+    m_registers.fbu = 0;
+    m_registers.serr = 0xffffffff;
+    m_registers.is = 0xffffffff;
+    m_registers.ie = 0;
+
+    if (!wait_while_busy()) {
+        klog() << "AHCIPort: Device on port " << m_port_index << " stays busy, ignoring it";
+        return false;
+    }
+    start_command_engine();
+
+    if (!identify_device(supports_ncq))
+        return false;
+
+    RefPtr<Thread> recovery_thread;
+    Process::create_kernel_process(recovery_thread, String::format("AHCIPort %u recovery", m_port_index), [this] {
+        recovery_main();
+    });
+    if (!recovery_thread) {
+        klog() << "AHCIPort: Failed to create recovery thread for port " << m_port_index;
+        return false;
+    }
+
+    m_free_slots = slot_mask(m_max_outstanding_commands);
+    m_registers.is = 0xffffffff;
+    m_registers.ie = AHCI::Completions | AHCI::Errors;
+    return true;
+}
+
+AHCI::CommandTable& AHCIPort::command_table(u8 slot)
+{
+    return *(AHCI::CommandTable*)(m_command_tables_region->vaddr().as_ptr() + slot * AHCI::command_table_size);
+}
+
+u8* AHCIPort::command_buffer(u8 slot)
+{
+    return m_buffers_region->vaddr().offset(slot * command_buffer_size).as_ptr();
+}
+
+void AHCIPort::prepare_command(u8 slot, const AHCI::RegisterHostToDeviceFIS& fis, size_t byte_count, bool is_write)
+{
+    ASSERT(byte_count <= command_buffer_size);
+    auto& table = command_table(slot);
+    memcpy(table.command_fis, &fis, sizeof(fis));
+
+    size_t entries = 0;
+    size_t first_page = slot * (command_buffer_size / PAGE_SIZE);
+    for (size_t offset = 0; offset < byte_count; offset += PAGE_SIZE) {
+        auto paddr = m_buffers_region->physical_page(first_page + offset / PAGE_SIZE)->paddr().get();
+        size_t length = min((size_t)PAGE_SIZE, byte_count - offset);
+        if (entries > 0) {
+            auto& previous = table.prdt[entries - 1];
+            if (previous.data_base + previous.byte_count + 1 == paddr) {
+                previous.byte_count += length;
+                continue;
+            }
+        }
+        auto& entry = table.prdt[entries++];
+        entry.data_base = paddr;
+        entry.data_base_upper = 0;
+        entry.reserved = 0;
+        entry.byte_count = length - 1;
+    }
+
+    auto& header = ((AHCI::CommandHeader*)m_command_list_region->vaddr().as_ptr())[slot];
+    header.flags = (sizeof(fis) / sizeof(u32)) | (is_write ? AHCI::Write : 0);
+    header.prdt_length = entries;
+    header.prd_byte_count = 0;
+    header.command_table_base = m_command_tables_region->physical_page(0)->paddr().offset(slot * AHCI::command_table_size).get();
+    header.command_table_base_upper = 0;
+}
+
+static AHCI::RegisterHostToDeviceFIS make_command_fis(u8 command)
+{
+    AHCI::RegisterHostToDeviceFIS fis {};
+    fis.type = AHCI::FISType::RegisterHostToDevice;
+    fis.flags = 0x80;
+    fis.command = command;
+    return fis;
+}
+
+bool AHCIPort::identify_device(bool supports_ncq)
+{
+    auto fis = make_command_fis(AHCI::IdentifyDevice);
+    prepare_command(0, fis, 512, false);
+    m_registers.ci = 1;
+    bool completed = wait_for(1000, [this] { return !(m_registers.ci & 1) || (m_registers.is & AHCI::Errors); });
+    if (!completed || (m_registers.is & AHCI::Errors) || (m_registers.tfd & AHCI::Error)) {
+        klog() << "AHCIPort: IDENTIFY DEVICE failed on port " << m_port_index;
+        return false;
+    }
+
+    auto* identify = (const u16*)command_buffer(0);
+    char model[41];
+    for (size_t i = 0; i < 20; i++) {
+        model[i * 2] = identify[27 + i] >> 8;
+        model[i * 2 + 1] = identify[27 + i] & 0xff;
+    }
+    model[40] = 0;
+    for (size_t i = 40; i > 0 && model[i - 1] == ' '; i--)
+        model[i - 1] = 0;
+
+    if (!(identify[83] & (1 << 10))) {
+        klog() << "AHCIPort: " << model << " on port " << m_port_index << " doesn't support 48-bit addressing, ignoring it";
+        return false;
+    }
+    u64 sectors = identify[100] | ((u64)identify[101] << 16) | ((u64)identify[102] << 32) | ((u64)identify[103] << 48);
+
+    bool drive_supports_ncq = identify[76] & (1 << 8);
+    if (supports_ncq && drive_supports_ncq) {
+        // Tags are handed out by slot, so stay within the drive's queue depth.
+        m_uses_ncq = true;
+        m_max_outstanding_commands = min(m_command_slots, (size_t)(identify[75] & 0x1f) + 1);
+    }
+
+    klog() << "AHCIPort: Port " << m_port_index << ": Name=" << model << ", sectors=" << sectors << ", queue depth=" << m_max_outstanding_commands << (m_uses_ncq ? " (NCQ)" : "");
+    m_device = SATADiskDevice::create(m_controller, *this, min(sectors, (u64)NumericLimits<u32>::max()), 3, StorageManagement::allocate_disk_minor());
+    return true;
+}
+
+void AHCIPort::start_run(const StorageDevice::RequestRun& run)
+{
+    auto& first_request = *run[0];
+    bool is_write = first_request.request_type() == AsyncBlockDeviceRequest::Write;
+    size_t block_count = 0;
+    for (auto* request : run)
+        block_count += request->block_count();
+    ASSERT(block_count <= max_sectors_per_command);
+
+    u8 slot;
+    {
+        ScopedSpinLock lock(m_lock);
+        // The disk never has more requests outstanding than we have slots.
+        ASSERT(m_free_slots != 0);
+        slot = __builtin_ctz(m_free_slots);
+        m_free_slots &= ~(1u << slot);
+    }
+
+    if (is_write) {
+        for (auto* request : run) {
+            auto* data = command_buffer(slot) + (request->block_index() - first_request.block_index()) * 512;
+            if (!request->read_from_buffer(request->buffer(), data, request->block_count() * 512)) {
+                {
+                    ScopedSpinLock lock(m_lock);
+                    m_free_slots |= 1u << slot;
+                }
+                for (auto* request : run)
+                    request->complete(AsyncDeviceRequest::MemoryFault);
+                return;
+            }
+        }
+    }
+
+    auto& command = m_commands[slot];
+    command.run = run;
+    command.block_index = first_request.block_index();
+    command.block_count = block_count;
+    command.is_write = is_write;
+    command.retries = 0;
+
+#ifdef AHCI_DEBUG
+    dbg() << "AHCIPort: Port " << m_port_index << " slot " << slot << (is_write ? " write " : " read ") << block_count << " blocks @ " << command.block_index;
+#endif
+
+    u64 lba = command.block_index;
+    AHCI::RegisterHostToDeviceFIS fis;
+    if (m_uses_ncq) {
+        fis = make_command_fis(is_write ? AHCI::WriteFPDMAQueued : AHCI::ReadFPDMAQueued);
+        fis.features_low = block_count & 0xff;
+        fis.features_high = (block_count >> 8) & 0xff;
+        fis.count_low = slot << 3;
+    } else {
+        fis = make_command_fis(is_write ? AHCI::WriteDMAExt : AHCI::ReadDMAExt);
+        fis.count_low = block_count & 0xff;
+        fis.count_high = (block_count >> 8) & 0xff;
+    }
+    fis.lba0 = lba & 0xff;
+    fis.lba1 = (lba >> 8) & 0xff;
+    fis.lba2 = (lba >> 16) & 0xff;
+    fis.lba3 = (lba >> 24) & 0xff;
+    fis.lba4 = (lba >> 32) & 0xff;
+    fis.lba5 = (lba >> 40) & 0xff;
+    fis.device = 1 << 6;
+    prepare_command(slot, fis, block_count * 512, is_write);
+
+    ScopedSpinLock lock(m_lock);
+    if (m_recovering) {
+        m_pending_slots |= 1u << slot;
+        return;
+    }
+    issue_commands(1u << slot);
+}
+
+void AHCIPort::issue_commands(u32 slots)
+{
+    ASSERT(m_lock.is_locked());
+    m_issued_slots |= slots;
+    if (m_uses_ncq)
+        m_registers.sact = slots;
+    m_registers.ci = slots;
+}
+
+void AHCIPort::recover_from_error()
+{
+    stop_command_engine();
+
+    // A drive keeps reporting an NCQ error until the error log is read or it
+    // is reset, and everything it had queued is gone either way, so just
+    // reset the link.
+    m_registers.sctl = (m_registers.sctl & ~AHCI::device_detection_mask) | 1;
+    Thread::current()->sleep({ 0, 1'000'000 });
+    m_registers.sctl = m_registers.sctl & ~AHCI::device_detection_mask;
+    if (!wait_for(100, [this] { return (m_registers.ssts & AHCI::device_detection_mask) == AHCI::device_present; }))
+        klog() << "AHCIPort: Link on port " << m_port_index << " didn't come back after reset";
+
+    m_registers.serr = 0xffffffff;
+    m_registers.is = 0xffffffff;
+    wait_while_busy();
+    start_command_engine();
+}
+
+void AHCIPort::recovery_main()
+{
+    for (;;) {
+        m_recovery_wait_queue.wait_on(nullptr, "AHCIPort");
+        {
+            ScopedSpinLock lock(m_lock);
+            if (!m_recovering)
+                continue;
+        }
+
+        // Nothing is issued while we're recovering, so the registers are all ours.
+        recover_from_error();
+
+        ScopedSpinLock lock(m_lock);
+        m_registers.is = 0xffffffff;
+        m_registers.ie = AHCI::Completions | AHCI::Errors;
+        m_recovering = false;
+        if (m_pending_slots) {
+#ifdef AHCI_DEBUG
+            dbg() << "AHCIPort: Port " << m_port_index << " reissuing slots " << String::format("%08x", m_pending_slots);
+#endif
+            issue_commands(m_pending_slots);
+            m_pending_slots = 0;
+        }
+    }
+}
+
+u32 AHCIPort::faulty_slots(u32 status, u32 aborted_slots) const
+{
+    // The link or the host failing isn't the fault of any command.
+    if (!(status & AHCI::TaskFileError))
+        return 0;
+    // The drive tells us which queued command it failed in its NCQ error log,
+    // but reading that takes another command. If there was only one, it's that.
+    if (!m_uses_ncq || __builtin_popcount(aborted_slots) == 1)
+        return aborted_slots;
+    return 0;
+}
+
+void AHCIPort::handle_interrupt()
+{
+    u32 status = m_registers.is;
+    m_registers.is = status;
+
+    u32 finished_slots;
+    u32 failed_slots = 0;
+    bool needs_recovery = false;
+    {
+        ScopedSpinLock lock(m_lock);
+        if (m_recovering)
+            return;
+        finished_slots = m_issued_slots & ~(m_registers.sact | m_registers.ci);
+        m_issued_slots &= ~finished_slots;
+        if (status & AHCI::Errors) {
+            klog() << "AHCIPort: Error on port " << m_port_index << ", status=" << String::format("%08x", status) << ", tfd=" << String::format("%08x", m_registers.tfd) << ", serr=" << String::format("%08x", m_registers.serr);
+            // Whatever the drive hadn't finished yet is lost. The failed command
+            // fails, the others are issued again once the port has been reset.
+            u32 aborted_slots = m_issued_slots;
+            m_issued_slots = 0;
+            failed_slots = faulty_slots(status, aborted_slots);
+            for (u8 slot = 0; slot < m_command_slots; slot++) {
+                u32 slot_bit = 1u << slot;
+                if ((aborted_slots & ~failed_slots & slot_bit) && ++m_commands[slot].retries > max_command_retries)
+                    failed_slots |= slot_bit;
+            }
+            m_pending_slots |= aborted_slots & ~failed_slots;
+            m_recovering = true;
+            m_registers.ie = 0;
+            needs_recovery = true;
+        }
+    }
+
+    if (!finished_slots && !failed_slots && !needs_recovery)
+        return;
+
+    // Copying the data out may page fault, so leave that until we're out of
+    // the interrupt handler.
+    Processor::deferred_call_queue([this, finished_slots, failed_slots, needs_recovery]() {
+        if (needs_recovery)
+            m_recovery_wait_queue.wake_all();
+        finish_commands(finished_slots, failed_slots);
+    });
+}
+
+void AHCIPort::finish_commands(u32 finished_slots, u32 failed_slots)
+{
+    for (u8 slot = 0; slot < m_command_slots; slot++) {
+        u32 slot_bit = 1u << slot;
+        if (!((finished_slots | failed_slots) & slot_bit))
+            continue;
+
+        auto& command = m_commands[slot];
+        auto run = command.run;
+        Vector<AsyncDeviceRequest::RequestResult, StorageDevice::max_merged_requests> results;
+        for (auto* request : run) {
+            auto result = (failed_slots & slot_bit) ? AsyncDeviceRequest::Failure : AsyncDeviceRequest::Success;
+            if (result == AsyncDeviceRequest::Success && !command.is_write) {
+                auto* data = command_buffer(slot) + (request->block_index() - command.block_index) * 512;
+                if (!request->write_to_buffer(request->buffer(), data, request->block_count() * 512))
+                    result = AsyncDeviceRequest::MemoryFault;
+            }
+            results.append(result);
+        }
+
+        // Free the slot before completing anything, completing a request
+        // may start the next one right away.
+        {
+            ScopedSpinLock lock(m_lock);
+            m_free_slots |= slot_bit;
+        }
+        for (size_t i = 0; i < run.size(); i++)
+            run[i]->complete(results[i]);
+    }
+}
+
+}
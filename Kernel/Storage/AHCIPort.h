@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/OwnPtr.h>
+#include <AK/RefPtr.h>
+#include <AK/Types.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/Storage/AHCI.h>
+#include <Kernel/Storage/StorageDevice.h>
+#include <Kernel/VM/Region.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+class AHCIController;
+
+class AHCIPort {
+    AK_MAKE_NONCOPYABLE(AHCIPort);
+    AK_MAKE_NONMOVABLE(AHCIPort);
+
+public:
+    // Every command slot has a bounce buffer this large.
+    static constexpr size_t max_sectors_per_command = 128;
+
+    // How often a command is reissued after being aborted by an error, if we
+    // can't tell whether it was the one that failed.
+    static constexpr u8 max_command_retries = 3;
+
+    // Returns null if there's no SATA drive we can use on this port.
+    static OwnPtr<AHCIPort> create(AHCIController&, volatile AHCI::PortRegisters&, u32 port_index, size_t command_slots, bool supports_ncq);
+    ~AHCIPort();
+
+    RefPtr<StorageDevice> device() const { return m_device; }
+    u32 port_index() const { return m_port_index; }
+
+    // How many commands we let the drive work on at once.
+    size_t max_outstanding_commands() const { return m_max_outstanding_commands; }
+
+    void start_run(const StorageDevice::RequestRun&);
+
+    // Called from the controller's interrupt handler.
+    void handle_interrupt();
+
+private:
+    AHCIPort(AHCIController&, volatile AHCI::PortRegisters&, u32 port_index, size_t command_slots);
+
+    struct Command {
+        StorageDevice::RequestRun run;
+        u32 block_index { 0 };
+        size_t block_count { 0 };
+        bool is_write { false };
+        u8 retries { 0 };
+    };
+
+    bool initialize(bool supports_ncq);
+    bool stop_command_engine();
+    void start_command_engine();
+    bool wait_while_busy();
+    void recover_from_error();
+    void recovery_main();
+    u32 faulty_slots(u32 status, u32 aborted_slots) const;
+    void issue_commands(u32 slots);
+
+    AHCI::CommandTable& command_table(u8 slot);
+    u8* command_buffer(u8 slot);
+    void prepare_command(u8 slot, const AHCI::RegisterHostToDeviceFIS&, size_t byte_count, bool is_write);
+    bool identify_device(bool supports_ncq);
+
+    void finish_commands(u32 finished_slots, u32 failed_slots);
+
+    AHCIController& m_controller;
+    volatile AHCI::PortRegisters& m_registers;
+    u32 m_port_index { 0 };
+    size_t m_command_slots { 0 };
+    size_t m_max_outstanding_commands { 1 };
+    bool m_uses_ncq { false };
+
+    OwnPtr<Region> m_command_list_region;
+    OwnPtr<Region> m_command_tables_region;
+    OwnPtr<Region> m_buffers_region;
+
+    SpinLock<u8> m_lock;
+    u32 m_free_slots { 0 };
+    u32 m_issued_slots { 0 };
+    Command m_commands[AHCI::max_command_slots];
+
+    // Resetting the port takes far too long for the interrupt handler, so a
+    // thread does it. Commands started meanwhile wait until it's done.
+    WaitQueue m_recovery_wait_queue;
+    bool m_recovering { false };
+    u32 m_pending_slots { 0 };
+
+    RefPtr<StorageDevice> m_device;
+};
+
+}
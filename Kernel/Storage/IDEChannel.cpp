@@ -143,13 +143,25 @@ IDEChannel::~IDEChannel()
 {
 }
 
-void IDEChannel::start_request(AsyncBlockDeviceRequest& request, bool use_dma, bool is_slave)
+bool IDEChannel::can_use_dma()
+{
+    return !m_io_group.bus_master_base().is_null() && m_dma_buffer_region && m_dma_enabled.resource();
+}
+
+void IDEChannel::start_request(const StorageDevice::RequestRun& run, bool use_dma, bool is_slave)
 {
     ScopedSpinLock lock(m_request_lock);
 #ifdef PATA_DEBUG
-    dbg() << "IDEChannel::start_request";
+    dbg() << "IDEChannel::start_request (" << run.size() << " request(s))";
 #endif
+    ASSERT(!run.is_empty());
+    auto& request = *run[0];
     m_current_request = &request;
+    m_current_run = run;
+    m_current_run_block_count = 0;
+    for (auto* run_request : run)
+        m_current_run_block_count += run_request->block_count();
+    ASSERT(m_current_run_block_count <= max_sectors_per_command);
     m_current_request_block_index = 0;
     m_current_request_uses_dma = use_dma;
     m_current_request_flushing_cache = false;
@@ -182,24 +194,28 @@ void IDEChannel::complete_current_request(AsyncDeviceRequest::RequestResult resu
         dbg() << "IDEChannel::complete_current_request result: " << result;
 #endif
         ASSERT(m_current_request);
-        auto& request = *m_current_request;
+        auto run = m_current_run;
         m_current_request = nullptr;
+        m_current_run.clear();
 
-        if (m_current_request_uses_dma) {
-            if (result == AsyncDeviceRequest::Success) {
-                if (request.request_type() == AsyncBlockDeviceRequest::Read) {
-                    if (!request.write_to_buffer(request.buffer(), m_dma_buffer_page->paddr().offset(0xc0000000).as_ptr(), 512 * request.block_count())) {
-                        request.complete(AsyncDeviceRequest::MemoryFault);
-                        return;
-                    }
-                }
+        if (m_current_request_uses_dma && result == AsyncDeviceRequest::Success) {
+            // I read somewhere that this may trigger a cache flush so let's do it.
+            m_io_group.bus_master_base().offset(2).out<u8>(m_io_group.bus_master_base().offset(2).in<u8>() | 0x6);
+        }
 
-                // I read somewhere that this may trigger a cache flush so let's do it.
-                m_io_group.bus_master_base().offset(2).out<u8>(m_io_group.bus_master_base().offset(2).in<u8>() | 0x6);
+        // Completing the first request lets the device start the next one,
+        // which may reuse the DMA buffer, so it has to go last.
+        u32 run_block_index = run[0]->block_index();
+        for (size_t i = run.size(); i-- > 0;) {
+            auto& request = *run[i];
+            auto request_result = result;
+            if (m_current_request_uses_dma && result == AsyncDeviceRequest::Success && request.request_type() == AsyncBlockDeviceRequest::Read) {
+                auto* data = m_dma_buffer_region->vaddr().offset((request.block_index() - run_block_index) * 512).as_ptr();
+                if (!request.write_to_buffer(request.buffer(), data, 512 * request.block_count()))
+                    request_result = AsyncDeviceRequest::MemoryFault;
             }
+            request.complete(request_result);
         }
-
-        request.complete(result);
     });
 }
 
@@ -214,8 +230,14 @@ void IDEChannel::initialize(bool force_pio)
     // Let's try to set up DMA transfers.
     PCI::enable_bus_mastering(m_parent_controller->pci_address());
     m_prdt_page = MM.allocate_supervisor_physical_page();
-    prdt().end_of_table = 0x8000;
-    m_dma_buffer_page = MM.allocate_supervisor_physical_page();
+    // The pages backing this don't need to be contiguous, build_prdt() hands
+    // them to the controller as a scatter/gather list.
+    m_dma_buffer_region = MM.allocate_kernel_region(max_sectors_per_command * 512, "IDE DMA buffer", Region::Access::Read | Region::Access::Write);
+    if (!m_prdt_page || !m_dma_buffer_region) {
+        klog() << "IDEChannel: Failed to allocate DMA buffers; using PIO mode";
+        m_dma_buffer_region = nullptr;
+        return;
+    }
     klog() << "IDEChannel: Bus master IDE: " << m_io_group.bus_master_base();
 }
 
@@ -364,30 +386,53 @@ void IDEChannel::detect_disks()
     }
 }
 
-void IDEChannel::ata_read_sectors_with_dma(bool slave_request)
+size_t IDEChannel::build_prdt(size_t byte_count)
 {
-    auto& request = *m_current_request;
-    u32 lba = request.block_index();
+    // Physically contiguous pages share one entry. An entry must not cross a
+    // 64 KiB boundary, and a size of 0 stands for 64 KiB.
+    auto* entries = prdt();
+    size_t entry_count = 0;
+    for (size_t offset = 0; offset < byte_count; offset += PAGE_SIZE) {
+        auto paddr = m_dma_buffer_region->physical_page(offset / PAGE_SIZE)->paddr();
+        size_t size = min(byte_count - offset, (size_t)PAGE_SIZE);
+        if (entry_count > 0) {
+            auto& last = entries[entry_count - 1];
+            if (last.offset.offset(last.size) == paddr && (paddr.get() & 0xffff)) {
+                last.size = static_cast<u16>(last.size + size);
+                continue;
+            }
+        }
+        auto& entry = entries[entry_count++];
+        entry.offset = paddr;
+        entry.size = static_cast<u16>(size);
+        entry.end_of_table = 0;
+    }
+    ASSERT(entry_count > 0);
+    entries[entry_count - 1].end_of_table = 0x8000;
+    return entry_count;
+}
+
+void IDEChannel::ata_issue_dma_command(bool slave_request, bool is_write)
+{
+    u32 lba = m_current_request->block_index();
+    u32 count = m_current_run_block_count;
+    [[maybe_unused]] auto entry_count = build_prdt(count * 512);
 #ifdef PATA_DEBUG
-    dbg() << "IDEChannel::ata_read_sectors_with_dma (" << lba << " x" << request.block_count() << ")";
+    dbg() << "IDEChannel: DMA " << (is_write ? "write" : "read") << " of " << count << " sector(s) @ LBA " << lba << " using " << entry_count << " PRD(s)";
 #endif
 
-    prdt().offset = m_dma_buffer_page->paddr();
-    prdt().size = 512 * request.block_count();
-
-    ASSERT(prdt().size <= PAGE_SIZE);
-
     // Stop bus master
     m_io_group.bus_master_base().out<u8>(0);
 
     // Write the PRDT location
-    m_io_group.bus_master_base().offset(4).out(m_prdt_page->paddr().get());
+    m_io_group.bus_master_base().offset(4).out<u32>(m_prdt_page->paddr().get());
 
     // Turn on "Interrupt" and "Error" flag. The error flag should be cleared by hardware.
     m_io_group.bus_master_base().offset(2).out<u8>(m_io_group.bus_master_base().offset(2).in<u8>() | 0x6);
 
     // Set transfer direction
-    m_io_group.bus_master_base().out<u8>(0x8);
+    if (!is_write)
+        m_io_group.bus_master_base().out<u8>(0x8);
 
     while (m_io_group.io_base().offset(ATA_REG_STATUS).in<u8>() & ATA_SR_BSY)
         ;
@@ -398,12 +443,13 @@ void IDEChannel::ata_read_sectors_with_dma(bool slave_request)
 
     m_io_group.io_base().offset(ATA_REG_FEATURES).out<u16>(0);
 
-    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(0);
-    m_io_group.io_base().offset(ATA_REG_LBA0).out<u8>(0);
+    // LBA48 registers take the high order bytes first.
+    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>((count >> 8) & 0xff);
+    m_io_group.io_base().offset(ATA_REG_LBA0).out<u8>((lba & 0xff000000) >> 24);
     m_io_group.io_base().offset(ATA_REG_LBA1).out<u8>(0);
     m_io_group.io_base().offset(ATA_REG_LBA2).out<u8>(0);
 
-    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(request.block_count());
+    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(count & 0xff);
     m_io_group.io_base().offset(ATA_REG_LBA0).out<u8>((lba & 0x000000ff) >> 0);
     m_io_group.io_base().offset(ATA_REG_LBA1).out<u8>((lba & 0x0000ff00) >> 8);
     m_io_group.io_base().offset(ATA_REG_LBA2).out<u8>((lba & 0x00ff0000) >> 16);
@@ -414,12 +460,20 @@ void IDEChannel::ata_read_sectors_with_dma(bool slave_request)
             break;
     }
 
-    m_io_group.io_base().offset(ATA_REG_COMMAND).out<u8>(ATA_CMD_READ_DMA_EXT);
+    m_io_group.io_base().offset(ATA_REG_COMMAND).out<u8>(is_write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT);
     io_delay();
 
     enable_irq();
     // Start bus master
-    m_io_group.bus_master_base().out<u8>(0x9);
+    m_io_group.bus_master_base().out<u8>(is_write ? 0x1 : 0x9);
+}
+
+void IDEChannel::ata_read_sectors_with_dma(bool slave_request)
+{
+#ifdef PATA_DEBUG
+    dbg() << "IDEChannel::ata_read_sectors_with_dma (" << m_current_request->block_index() << " x" << m_current_run_block_count << ")";
+#endif
+    ata_issue_dma_command(slave_request, false);
 }
 
 bool IDEChannel::ata_do_read_sector()
@@ -487,62 +541,20 @@ void IDEChannel::ata_read_sectors(bool slave_request)
 
 void IDEChannel::ata_write_sectors_with_dma(bool slave_request)
 {
-    auto& request = *m_current_request;
-    u32 lba = request.block_index();
 #ifdef PATA_DEBUG
-    dbg() << "IDEChannel::ata_write_sectors_with_dma (" << lba << " x" << request.block_count() << ")";
+    dbg() << "IDEChannel::ata_write_sectors_with_dma (" << m_current_request->block_index() << " x" << m_current_run_block_count << ")";
 #endif
 
-    prdt().offset = m_dma_buffer_page->paddr();
-    prdt().size = 512 * request.block_count();
-
-    if (!request.read_from_buffer(request.buffer(), m_dma_buffer_page->paddr().offset(0xc0000000).as_ptr(), 512 * request.block_count())) {
-        complete_current_request(AsyncDeviceRequest::MemoryFault);
-        return;
-    }
-
-    ASSERT(prdt().size <= PAGE_SIZE);
-
-    // Stop bus master
-    m_io_group.bus_master_base().out<u8>(0);
-
-    // Write the PRDT location
-    m_io_group.bus_master_base().offset(4).out<u32>(m_prdt_page->paddr().get());
-
-    // Turn on "Interrupt" and "Error" flag. The error flag should be cleared by hardware.
-    m_io_group.bus_master_base().offset(2).out<u8>(m_io_group.bus_master_base().offset(2).in<u8>() | 0x6);
-
-    while (m_io_group.io_base().offset(ATA_REG_STATUS).in<u8>() & ATA_SR_BSY)
-        ;
-
-    m_io_group.control_base().offset(ATA_CTL_CONTROL).out<u8>(0);
-    m_io_group.io_base().offset(ATA_REG_HDDEVSEL).out<u8>(0x40 | (static_cast<u8>(slave_request) << 4));
-    io_delay();
-
-    m_io_group.io_base().offset(ATA_REG_FEATURES).out<u16>(0);
-
-    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(0);
-    m_io_group.io_base().offset(ATA_REG_LBA0).out<u8>(0);
-    m_io_group.io_base().offset(ATA_REG_LBA1).out<u8>(0);
-    m_io_group.io_base().offset(ATA_REG_LBA2).out<u8>(0);
-
-    m_io_group.io_base().offset(ATA_REG_SECCOUNT0).out<u8>(request.block_count());
-    m_io_group.io_base().offset(ATA_REG_LBA0).out<u8>((lba & 0x000000ff) >> 0);
-    m_io_group.io_base().offset(ATA_REG_LBA1).out<u8>((lba & 0x0000ff00) >> 8);
-    m_io_group.io_base().offset(ATA_REG_LBA2).out<u8>((lba & 0x00ff0000) >> 16);
-
-    for (;;) {
-        auto status = m_io_group.io_base().offset(ATA_REG_STATUS).in<u8>();
-        if (!(status & ATA_SR_BSY) && (status & ATA_SR_DRDY))
-            break;
+    u32 run_block_index = m_current_request->block_index();
+    for (auto* request : m_current_run) {
+        auto* data = m_dma_buffer_region->vaddr().offset((request->block_index() - run_block_index) * 512).as_ptr();
+        if (!request->read_from_buffer(request->buffer(), data, 512 * request->block_count())) {
+            complete_current_request(AsyncDeviceRequest::MemoryFault);
+            return;
+        }
     }
 
-    m_io_group.io_base().offset(ATA_REG_COMMAND).out<u8>(ATA_CMD_WRITE_DMA_EXT);
-    io_delay();
-
-    enable_irq();
-    // Start bus master
-    m_io_group.bus_master_base().out<u8>(0x1);
+    ata_issue_dma_command(slave_request, true);
 }
 
 void IDEChannel::ata_do_write_sector()
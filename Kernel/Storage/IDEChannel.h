@@ -111,6 +111,9 @@ public:
     RefPtr<StorageDevice> master_device() const;
     RefPtr<StorageDevice> slave_device() const;
 
+    // LBA48 commands could do more, but this is what our DMA buffer holds.
+    static constexpr size_t max_sectors_per_command = 256;
+
     virtual const char* purpose() const override { return "PATA Channel"; }
 
 private:
@@ -120,9 +123,13 @@ private:
     void initialize(bool force_pio);
     void detect_disks();
 
-    void start_request(AsyncBlockDeviceRequest&, bool, bool);
+    bool can_use_dma();
+    void start_request(const StorageDevice::RequestRun&, bool, bool);
     void complete_current_request(AsyncDeviceRequest::RequestResult);
 
+    size_t build_prdt(size_t byte_count);
+    void ata_issue_dma_command(bool slave_request, bool is_write);
+
     void ata_read_sectors_with_dma(bool);
     void ata_read_sectors(bool);
     bool ata_do_read_sector();
@@ -135,9 +142,9 @@ private:
 
     volatile u8 m_device_error { 0 };
 
-    PhysicalRegionDescriptor& prdt() { return *reinterpret_cast<PhysicalRegionDescriptor*>(m_prdt_page->paddr().offset(0xc0000000).as_ptr()); }
+    PhysicalRegionDescriptor* prdt() { return reinterpret_cast<PhysicalRegionDescriptor*>(m_prdt_page->paddr().offset(0xc0000000).as_ptr()); }
     RefPtr<PhysicalPage> m_prdt_page;
-    RefPtr<PhysicalPage> m_dma_buffer_page;
+    OwnPtr<Region> m_dma_buffer_region;
     Lockable<bool> m_dma_enabled;
     EntropySource m_entropy_source;
 
@@ -145,6 +152,8 @@ private:
     RefPtr<StorageDevice> m_slave;
 
     AsyncBlockDeviceRequest* m_current_request { nullptr };
+    StorageDevice::RequestRun m_current_run;
+    u32 m_current_run_block_count { 0 };
     u32 m_current_request_block_index { 0 };
     bool m_current_request_uses_dma { false };
     bool m_current_request_flushing_cache { false };
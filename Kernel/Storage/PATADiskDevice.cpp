@@ -59,10 +59,18 @@ const char* PATADiskDevice::class_name() const
     return "PATADiskDevice";
 }
 
-void PATADiskDevice::start_request(AsyncBlockDeviceRequest& request)
+bool PATADiskDevice::can_merge_requests() const
 {
-    bool use_dma = !m_channel.m_io_group.bus_master_base().is_null() && m_channel.m_dma_enabled.resource();
-    m_channel.start_request(request, use_dma, is_slave());
+    // The PIO path transfers into a single request's buffer, block by block.
+    return m_channel.can_use_dma();
+}
+
+void PATADiskDevice::start_run(const RequestRun& run)
+{
+    // Runs of several requests are only ever built while DMA is usable,
+    // so don't let the ide_dma sysctl flipping in between trip us up.
+    bool use_dma = run.size() > 1 || m_channel.can_use_dma();
+    m_channel.start_request(run, use_dma, is_slave());
 }
 
 size_t PATADiskDevice::max_addressable_block() const
@@ -70,6 +78,11 @@ size_t PATADiskDevice::max_addressable_block() const
     return m_cylinders * m_heads * m_sectors_per_track;
 }
 
+size_t PATADiskDevice::max_blocks_per_request() const
+{
+    return IDEChannel::max_sectors_per_command;
+}
+
 bool PATADiskDevice::is_slave() const
 {
     return m_drive_type == DriveType::Slave;
@@ -58,13 +58,15 @@ public:
     // ^StorageDevice
     virtual Type type() const override { return StorageDevice::Type::IDE; }
     virtual size_t max_addressable_block() const override;
-
-    // ^BlockDevice
-    virtual void start_request(AsyncBlockDeviceRequest&) override;
+    virtual size_t max_blocks_per_request() const override;
 
 private:
     PATADiskDevice(const IDEController&, IDEChannel&, DriveType, u8, u8, u8, int major, int minor);
 
+    // ^StorageDevice
+    virtual bool can_merge_requests() const override;
+    virtual void start_run(const RequestRun&) override;
+
     // ^DiskDevice
     virtual const char* class_name() const override;
 
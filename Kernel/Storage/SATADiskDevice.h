@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// A Disk Device Connected to an AHCI Port
+//
+
+#pragma once
+
+#include <Kernel/Storage/StorageDevice.h>
+
+namespace Kernel {
+
+class AHCIController;
+class AHCIPort;
+
+class SATADiskDevice final : public StorageDevice {
+    AK_MAKE_ETERNAL
+public:
+    static NonnullRefPtr<SATADiskDevice> create(const AHCIController&, AHCIPort&, size_t max_addressable_block, int major, int minor);
+    virtual ~SATADiskDevice() override;
+
+    // ^StorageDevice
+    virtual Type type() const override { return StorageDevice::Type::AHCI; }
+    virtual size_t max_blocks_per_request() const override;
+
+    // ^Device
+    virtual size_t max_outstanding_requests() const override;
+
+private:
+    SATADiskDevice(const AHCIController&, AHCIPort&, size_t max_addressable_block, int major, int minor);
+
+    // ^StorageDevice
+    virtual bool can_merge_requests() const override { return true; }
+    virtual void start_run(const RequestRun&) override;
+
+    // ^DiskDevice
+    virtual const char* class_name() const override;
+
+    AHCIPort& m_port;
+};
+
+}
@@ -48,7 +48,9 @@ class StorageController : public RefCounted<StorageController>
 public:
     enum class Type : u8 {
         IDE,
-        NVMe
+        NVMe,
+        AHCI,
+        VirtIO
     };
     virtual Type type() const = 0;
     virtual RefPtr<StorageDevice> device(u32 index) const = 0;
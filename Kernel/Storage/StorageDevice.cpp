@@ -27,12 +27,20 @@
 //#define STORAGE_DEVICE_DEBUG
 
 #include <AK/Memory.h>
+#include <AK/NonnullRefPtrVector.h>
 #include <AK/StringView.h>
 #include <Kernel/FileSystem/FileDescription.h>
 #include <Kernel/Storage/StorageDevice.h>
 
 namespace Kernel {
 
+// How many requests a single read() or write() may have queued at once.
+static constexpr size_t max_requests_in_flight = 8;
+
+// A request is never sorted ahead of one that was queued this many requests
+// earlier, so a steady stream of nearby requests can't starve far away ones.
+static constexpr u32 max_request_bypass = 32;
+
 StorageDevice::StorageDevice(const StorageController& controller, int major, int minor, size_t sector_size, size_t max_addressable_block)
     : BlockDevice(major, minor, sector_size)
     , m_storage_controller(controller)
@@ -50,40 +58,122 @@ NonnullRefPtr<StorageController> StorageDevice::controller() const
     return m_storage_controller;
 }
 
-KResultOr<size_t> StorageDevice::read(FileDescription&, size_t offset, UserOrKernelBuffer& outbuf, size_t len)
+void StorageDevice::queue_request(NonnullRefPtr<AsyncDeviceRequest> request)
 {
-    unsigned index = offset / block_size();
-    u16 whole_blocks = len / block_size();
-    ssize_t remaining = len % block_size();
+    ASSERT(m_requests_lock.is_locked());
+    auto& new_request = static_cast<AsyncBlockDeviceRequest&>(*request);
+    new_request.m_queue_sequence = m_next_queue_sequence++;
 
-    unsigned blocks_per_page = PAGE_SIZE / block_size();
+    // Keep the queue in one-way elevator (C-LOOK) order: first everything at or
+    // after the position the drive is moving to, in ascending order, then
+    // everything before it, again ascending.
+    u32 head_position = m_head_position;
+    auto sort_key = [head_position](const AsyncBlockDeviceRequest& request) -> u64 {
+        if (request.block_index() >= head_position)
+            return request.block_index();
+        return (u64)request.block_index() + 0x100000000ull;
+    };
+    u64 new_key = sort_key(new_request);
 
-    // PATAChannel will chuck a wobbly if we try to read more than PAGE_SIZE
-    // at a time, because it uses a single page for its DMA buffer.
-    if (whole_blocks >= blocks_per_page) {
-        whole_blocks = blocks_per_page;
-        remaining = 0;
+    auto insert_before = m_requests.end();
+    for (auto it = m_requests.begin(); it != m_requests.end(); ++it) {
+        auto& queued = static_cast<AsyncBlockDeviceRequest&>(**it);
+        if (new_request.m_queue_sequence - queued.m_queue_sequence > max_request_bypass) {
+            insert_before = m_requests.end();
+            continue;
+        }
+        if (insert_before.is_end() && sort_key(queued) > new_key)
+            insert_before = it;
     }
+    m_requests.insert_before(insert_before, move(request));
+}
 
+void StorageDevice::start_request(AsyncBlockDeviceRequest& request)
+{
+    RequestRun run;
+    run.append(&request);
+    {
+        ScopedSpinLock lock(m_requests_lock);
+        size_t block_count = request.block_count();
+        while (can_merge_requests() && run.size() < max_merged_requests) {
+            auto it = m_requests.begin();
+            for (; it != m_requests.end(); ++it) {
+                auto& next = static_cast<AsyncBlockDeviceRequest&>(**it);
+                if (next.request_type() == request.request_type() && next.block_index() == request.block_index() + block_count)
+                    break;
+            }
+            if (it.is_end())
+                break;
+            auto& next = static_cast<AsyncBlockDeviceRequest&>(**it);
+            if (block_count + next.block_count() > max_blocks_per_request())
+                break;
+            block_count += next.block_count();
+            run.append(&next);
+            attach_queued_request(it);
+        }
+        m_head_position = request.block_index() + block_count;
 #ifdef STORAGE_DEVICE_DEBUG
-    klog() << "StorageDevice::read() index=" << index << " whole_blocks=" << whole_blocks << " remaining=" << remaining;
+        if (run.size() > 1)
+            klog() << "StorageDevice: Merged " << run.size() << " requests into " << block_count << " blocks @ " << request.block_index();
 #endif
+    }
+    start_run(run);
+}
 
-    if (whole_blocks > 0) {
-        auto read_request = make_request<AsyncBlockDeviceRequest>(AsyncBlockDeviceRequest::Read, index, whole_blocks, outbuf, whole_blocks * block_size());
-        auto result = read_request->wait();
-        if (result.wait_result().was_interrupted())
+KResult StorageDevice::transfer_whole_blocks(AsyncBlockDeviceRequest::RequestType request_type, u32 index, size_t count, const UserOrKernelBuffer& buffer)
+{
+    // Queue everything before waiting, so the drive doesn't sit idle between
+    // the requests and the elevator gets a chance to merge them.
+    NonnullRefPtrVector<AsyncBlockDeviceRequest, max_requests_in_flight> requests;
+    for (size_t done = 0; done < count;) {
+        size_t blocks = min(count - done, max_blocks_per_request());
+        requests.append(make_request<AsyncBlockDeviceRequest>(request_type, index + done, blocks, buffer.offset(done * block_size()), blocks * block_size()));
+        done += blocks;
+    }
+
+    KResult result = KSuccess;
+    for (auto& request : requests) {
+        auto wait_result = request.wait();
+        if (wait_result.wait_result().was_interrupted())
             return KResult(-EINTR);
-        switch (result.request_result()) {
+        if (result.is_error())
+            continue;
+        switch (wait_result.request_result()) {
         case AsyncDeviceRequest::Failure:
         case AsyncDeviceRequest::Cancelled:
-            return KResult(-EIO);
+            result = KResult(-EIO);
+            break;
         case AsyncDeviceRequest::MemoryFault:
-            return KResult(-EFAULT);
+            result = KResult(-EFAULT);
+            break;
         default:
             break;
         }
     }
+    return result;
+}
+
+KResultOr<size_t> StorageDevice::read(FileDescription&, size_t offset, UserOrKernelBuffer& outbuf, size_t len)
+{
+    unsigned index = offset / block_size();
+    size_t whole_blocks = len / block_size();
+    ssize_t remaining = len % block_size();
+
+    size_t max_blocks = max_blocks_per_request() * max_requests_in_flight;
+    if (whole_blocks >= max_blocks) {
+        whole_blocks = max_blocks;
+        remaining = 0;
+    }
+
+#ifdef STORAGE_DEVICE_DEBUG
+    klog() << "StorageDevice::read() index=" << index << " whole_blocks=" << whole_blocks << " remaining=" << remaining;
+#endif
+
+    if (whole_blocks > 0) {
+        auto result = transfer_whole_blocks(AsyncBlockDeviceRequest::Read, index, whole_blocks, outbuf);
+        if (result.is_error())
+            return result;
+    }
 
     off_t pos = whole_blocks * block_size();
 
@@ -120,15 +210,12 @@ bool StorageDevice::can_read(const FileDescription&, size_t offset) const
 KResultOr<size_t> StorageDevice::write(FileDescription&, size_t offset, const UserOrKernelBuffer& inbuf, size_t len)
 {
     unsigned index = offset / block_size();
-    u16 whole_blocks = len / block_size();
+    size_t whole_blocks = len / block_size();
     ssize_t remaining = len % block_size();
 
-    unsigned blocks_per_page = PAGE_SIZE / block_size();
-
-    // PATAChannel will chuck a wobbly if we try to write more than PAGE_SIZE
-    // at a time, because it uses a single page for its DMA buffer.
-    if (whole_blocks >= blocks_per_page) {
-        whole_blocks = blocks_per_page;
+    size_t max_blocks = max_blocks_per_request() * max_requests_in_flight;
+    if (whole_blocks >= max_blocks) {
+        whole_blocks = max_blocks;
         remaining = 0;
     }
 
@@ -137,19 +224,9 @@ KResultOr<size_t> StorageDevice::write(FileDescription&, size_t offset, const Us
 #endif
 
     if (whole_blocks > 0) {
-        auto write_request = make_request<AsyncBlockDeviceRequest>(AsyncBlockDeviceRequest::Write, index, whole_blocks, inbuf, whole_blocks * block_size());
-        auto result = write_request->wait();
-        if (result.wait_result().was_interrupted())
-            return KResult(-EINTR);
-        switch (result.request_result()) {
-        case AsyncDeviceRequest::Failure:
-        case AsyncDeviceRequest::Cancelled:
-            return KResult(-EIO);
-        case AsyncDeviceRequest::MemoryFault:
-            return KResult(-EFAULT);
-        default:
-            break;
-        }
+        auto result = transfer_whole_blocks(AsyncBlockDeviceRequest::Write, index, whole_blocks, inbuf);
+        if (result.is_error())
+            return result;
     }
 
     off_t pos = whole_blocks * block_size();
@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <AK/Vector.h>
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/Interrupts/IRQHandler.h>
 #include <Kernel/Lock.h>
@@ -39,12 +40,22 @@ public:
     enum class Type : u8 {
         IDE,
         NVMe,
+        AHCI,
+        VirtIO,
     };
 
 public:
+    // Queued requests of the same type that cover consecutive blocks are
+    // handed to the driver together, so it can service them with one command.
+    static constexpr size_t max_merged_requests = 16;
+    using RequestRun = Vector<AsyncBlockDeviceRequest*, max_merged_requests>;
+
     virtual Type type() const = 0;
     virtual size_t max_addressable_block() const { return m_max_addressable_block; }
 
+    // The largest number of blocks the driver can transfer with one command.
+    virtual size_t max_blocks_per_request() const { return PAGE_SIZE / block_size(); }
+
     NonnullRefPtr<StorageController> controller() const;
 
     // ^BlockDevice
@@ -52,15 +63,26 @@ public:
     virtual bool can_read(const FileDescription&, size_t) const override;
     virtual KResultOr<size_t> write(FileDescription&, size_t, const UserOrKernelBuffer&, size_t) override;
     virtual bool can_write(const FileDescription&, size_t) const override;
+    virtual void start_request(AsyncBlockDeviceRequest&) override final;
 
 protected:
     StorageDevice(const StorageController&, int, int, size_t, size_t);
     // ^DiskDevice
     virtual const char* class_name() const override;
 
+    virtual bool can_merge_requests() const { return false; }
+    virtual void start_run(const RequestRun&) = 0;
+
+    // ^Device
+    virtual void queue_request(NonnullRefPtr<AsyncDeviceRequest>) override;
+
 private:
+    KResult transfer_whole_blocks(AsyncBlockDeviceRequest::RequestType, u32 index, size_t count, const UserOrKernelBuffer&);
+
     NonnullRefPtr<StorageController> m_storage_controller;
     size_t m_max_addressable_block;
+    u32 m_next_queue_sequence { 0 };
+    u32 m_head_position { 0 };
 };
 
 }
@@ -26,13 +26,19 @@
 
 #include <Kernel/Devices/BlockDevice.h>
 #include <Kernel/PCI/Access.h>
+#include <Kernel/Storage/AHCIController.h>
 #include <Kernel/Storage/IDEController.h>
 #include <Kernel/Storage/StorageManagement.h>
+#include <Kernel/Storage/VirtIOBlockController.h>
+#include <Kernel/VirtIO/VirtIO.h>
 
 namespace Kernel {
 
 static StorageManagement* s_the;
 
+// PATA disks use minors 0 through 3.
+static int s_next_disk_minor = 4;
+
 StorageManagement::StorageManagement(String root_device, bool force_pio)
     : m_controllers(enumerate_controllers(force_pio))
     , m_boot_device(determine_boot_device(root_device))
@@ -69,6 +75,12 @@ NonnullRefPtrVector<StorageController> StorageManagement::enumerate_controllers(
         if (PCI::get_class(address) == 0x1 && PCI::get_subclass(address) == 0x1) {
             controllers.append(IDEController::initialize(address, force_pio));
         }
+        if (PCI::get_class(address) == 0x1 && PCI::get_subclass(address) == 0x6 && PCI::get_programming_interface(address) == 0x1) {
+            controllers.append(AHCIController::initialize(address));
+        }
+        if (VirtIODevice::is_virtio_device(address, VIRTIO_PCI_BLOCK_DEVICE_ID)) {
+            controllers.append(VirtIOBlockController::initialize(address));
+        }
     });
     return controllers;
 }
@@ -98,6 +110,11 @@ void StorageManagement::initialize(String root_device, bool force_pio)
     s_the = new StorageManagement(root_device, force_pio);
 }
 
+int StorageManagement::allocate_disk_minor()
+{
+    return s_next_disk_minor++;
+}
+
 StorageManagement& StorageManagement::the()
 {
     return *s_the;
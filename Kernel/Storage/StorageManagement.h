@@ -43,6 +43,9 @@ public:
     static void initialize(String root_device, bool force_pio);
     static StorageManagement& the();
 
+    // Minor numbers (on major 3) for disks beyond the four PATA ones.
+    static int allocate_disk_minor();
+
     NonnullRefPtr<StorageDevice> boot_device() const;
     NonnullRefPtrVector<StorageController> ide_controllers() const;
     NonnullRefPtrVector<StorageDevice> storage_devices() const;
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Storage/StorageManagement.h>
+#include <Kernel/Storage/VirtIOBlockController.h>
+#include <Kernel/Storage/VirtIOBlockDevice.h>
+
+namespace Kernel {
+
+NonnullRefPtr<VirtIOBlockController> VirtIOBlockController::initialize(PCI::Address address)
+{
+    return adopt(*new VirtIOBlockController(address));
+}
+
+VirtIOBlockController::VirtIOBlockController(PCI::Address address)
+    : StorageController(address)
+{
+    m_device = VirtIOBlockDevice::create(*this, address, 3, StorageManagement::allocate_disk_minor());
+}
+
+VirtIOBlockController::~VirtIOBlockController()
+{
+}
+
+bool VirtIOBlockController::reset()
+{
+    TODO();
+}
+
+bool VirtIOBlockController::shutdown()
+{
+    TODO();
+}
+
+size_t VirtIOBlockController::devices_count() const
+{
+    return m_device ? 1 : 0;
+}
+
+RefPtr<StorageDevice> VirtIOBlockController::device(u32 index) const
+{
+    if (index != 0)
+        return nullptr;
+    return m_device;
+}
+
+void VirtIOBlockController::start_request(const StorageDevice&, AsyncBlockDeviceRequest&)
+{
+    ASSERT_NOT_REACHED();
+}
+
+void VirtIOBlockController::complete_current_request(AsyncDeviceRequest::RequestResult)
+{
+    ASSERT_NOT_REACHED();
+}
+
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define VIRTIO_BLOCK_DEBUG
+
+#include <AK/Memory.h>
+#include <AK/NumericLimits.h>
+#include <Kernel/Storage/VirtIOBlockController.h>
+#include <Kernel/Storage/VirtIOBlockDevice.h>
+#include <Kernel/VM/MemoryManager.h>
+
+namespace Kernel {
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+
+#define VIRTIO_BLK_S_OK 0
+
+#define REQUEST_QUEUE 0
+
+struct [[gnu::packed]] VirtIOBlockRequestHeader {
+    u32 type;
+    u32 reserved;
+    u64 sector;
+};
+
+// Each slot gets a header followed by the status byte the device writes back.
+static constexpr size_t slot_header_size = 32;
+static constexpr size_t status_offset = sizeof(VirtIOBlockRequestHeader);
+
+// Every request is a chain of three descriptors: header, data and status.
+static constexpr size_t descriptors_per_request = 3;
+
+RefPtr<VirtIOBlockDevice> VirtIOBlockDevice::create(const VirtIOBlockController& controller, PCI::Address address, int major, int minor)
+{
+    auto device = adopt(*new VirtIOBlockDevice(controller, address, major, minor));
+    if (!device->m_initialized)
+        return nullptr;
+    return device;
+}
+
+VirtIOBlockDevice::VirtIOBlockDevice(const VirtIOBlockController& controller, PCI::Address address, int major, int minor)
+    : StorageDevice(controller, major, minor, 512, 0)
+    , VirtIODevice(address, "VirtIOBlockDevice")
+{
+    m_initialized = initialize();
+    if (!m_initialized)
+        fail_initialization();
+}
+
+VirtIOBlockDevice::~VirtIOBlockDevice()
+{
+}
+
+const char* VirtIOBlockDevice::class_name() const
+{
+    return "VirtIOBlockDevice";
+}
+
+bool VirtIOBlockDevice::initialize()
+{
+    negotiate_features(VIRTIO_F_RING_EVENT_IDX);
+    if (!setup_queues(1))
+        return false;
+
+    m_capacity = min(config_read64(0), (u64)NumericLimits<u32>::max());
+    m_request_slots = min((size_t)32, queue(REQUEST_QUEUE).size() / descriptors_per_request);
+
+    m_headers_region = MM.allocate_contiguous_kernel_region(PAGE_ROUND_UP(m_request_slots * slot_header_size), "VirtIO Block Headers", Region::Access::Read | Region::Access::Write);
+    if (!m_headers_region)
+        return false;
+    for (size_t i = 0; i < m_request_slots; i++) {
+        // Keep each buffer contiguous so it only takes up one descriptor.
+        auto region = MM.allocate_contiguous_kernel_region(max_sectors_per_request * 512, "VirtIO Block Buffer", Region::Access::Read | Region::Access::Write);
+        if (!region)
+            return false;
+        m_buffer_regions.append(region.release_nonnull());
+    }
+    m_free_slots = m_request_slots >= 32 ? 0xffffffff : (1u << m_request_slots) - 1;
+
+    klog() << "VirtIOBlockDevice: " << m_capacity << " sectors, " << m_request_slots << " requests in flight" << (is_feature_accepted(VIRTIO_F_RING_EVENT_IDX) ? ", event index" : "");
+    finish_initialization();
+    return true;
+}
+
+u8* VirtIOBlockDevice::slot_header(u8 slot)
+{
+    return m_headers_region->vaddr().offset(slot * slot_header_size).as_ptr();
+}
+
+void VirtIOBlockDevice::start_run(const RequestRun& run)
+{
+    auto& first_request = *run[0];
+    bool is_write = first_request.request_type() == AsyncBlockDeviceRequest::Write;
+    size_t block_count = 0;
+    for (auto* request : run)
+        block_count += request->block_count();
+    ASSERT(block_count <= max_sectors_per_request);
+
+    auto& request_queue = queue(REQUEST_QUEUE);
+    u8 slot;
+    {
+        ScopedSpinLock lock(request_queue.lock());
+        // We never have more requests outstanding than we have slots.
+        ASSERT(m_free_slots != 0);
+        slot = __builtin_ctz(m_free_slots);
+        m_free_slots &= ~(1u << slot);
+    }
+
+    auto* buffer = m_buffer_regions[slot].vaddr().as_ptr();
+    if (is_write) {
+        for (auto* request : run) {
+            auto* data = buffer + (request->block_index() - first_request.block_index()) * 512;
+            if (!request->read_from_buffer(request->buffer(), data, request->block_count() * 512)) {
+                {
+                    ScopedSpinLock lock(request_queue.lock());
+                    m_free_slots |= 1u << slot;
+                }
+                for (auto* request : run)
+                    request->complete(AsyncDeviceRequest::MemoryFault);
+                return;
+            }
+        }
+    }
+
+    auto& request_slot = m_slots[slot];
+    request_slot.run = run;
+    request_slot.block_index = first_request.block_index();
+    request_slot.is_write = is_write;
+
+    auto* header = (VirtIOBlockRequestHeader*)slot_header(slot);
+    header->type = is_write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    header->reserved = 0;
+    header->sector = first_request.block_index();
+    slot_header(slot)[status_offset] = 0xff;
+
+#ifdef VIRTIO_BLOCK_DEBUG
+    dbg() << "VirtIOBlockDevice: Slot " << slot << (is_write ? " write " : " read ") << block_count << " blocks @ " << request_slot.block_index;
+#endif
+
+    auto header_address = m_headers_region->physical_page(0)->paddr().offset(slot * slot_header_size);
+    VirtIOQueue::Buffer buffers[descriptors_per_request] = {
+        { header_address, sizeof(VirtIOBlockRequestHeader), false },
+        { m_buffer_regions[slot].physical_page(0)->paddr(), (u32)(block_count * 512), !is_write },
+        { header_address.offset(status_offset), 1, true },
+    };
+    ScopedSpinLock lock(request_queue.lock());
+    bool supplied = request_queue.supply_buffers(buffers, descriptors_per_request, (void*)(FlatPtr)slot);
+    ASSERT(supplied);
+}
+
+void VirtIOBlockDevice::did_start_requests()
+{
+    // Requests started together only cost one notification.
+    ScopedSpinLock lock(queue(REQUEST_QUEUE).lock());
+    notify_queue(REQUEST_QUEUE);
+}
+
+void VirtIOBlockDevice::handle_queue_update(u16 queue_index)
+{
+    ASSERT(queue_index == REQUEST_QUEUE);
+    auto& request_queue = queue(REQUEST_QUEUE);
+    u32 finished_slots = 0;
+    {
+        ScopedSpinLock lock(request_queue.lock());
+        void* token;
+        u32 length;
+        while (request_queue.take_used_buffers(token, length))
+            finished_slots |= 1u << (FlatPtr)token;
+    }
+    if (!finished_slots)
+        return;
+
+    // Copying the data out may page fault, so leave that until we're out of
+    // the interrupt handler.
+    Processor::deferred_call_queue([this, finished_slots]() {
+        finish_requests(finished_slots);
+    });
+}
+
+void VirtIOBlockDevice::finish_requests(u32 finished_slots)
+{
+    for (u8 slot = 0; slot < m_request_slots; slot++) {
+        u32 slot_bit = 1u << slot;
+        if (!(finished_slots & slot_bit))
+            continue;
+
+        auto& request_slot = m_slots[slot];
+        auto run = request_slot.run;
+        bool failed = slot_header(slot)[status_offset] != VIRTIO_BLK_S_OK;
+        Vector<AsyncDeviceRequest::RequestResult, max_merged_requests> results;
+        for (auto* request : run) {
+            auto result = failed ? AsyncDeviceRequest::Failure : AsyncDeviceRequest::Success;
+            if (!failed && !request_slot.is_write) {
+                auto* data = m_buffer_regions[slot].vaddr().offset((request->block_index() - request_slot.block_index) * 512).as_ptr();
+                if (!request->write_to_buffer(request->buffer(), data, request->block_count() * 512))
+                    result = AsyncDeviceRequest::MemoryFault;
+            }
+            results.append(result);
+        }
+
+        {
+            ScopedSpinLock lock(queue(REQUEST_QUEUE).lock());
+            m_free_slots |= slot_bit;
+        }
+        for (size_t i = 0; i < run.size(); i++)
+            run[i]->complete(results[i]);
+    }
+}
+
+}
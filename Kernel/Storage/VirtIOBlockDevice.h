@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/OwnPtr.h>
+#include <Kernel/Storage/StorageDevice.h>
+#include <Kernel/VirtIO/VirtIO.h>
+
+namespace Kernel {
+
+class VirtIOBlockController;
+
+class VirtIOBlockDevice final : public StorageDevice
+    , public VirtIODevice {
+    AK_MAKE_ETERNAL
+public:
+    static constexpr size_t max_sectors_per_request = 128;
+
+    static RefPtr<VirtIOBlockDevice> create(const VirtIOBlockController&, PCI::Address, int major, int minor);
+    virtual ~VirtIOBlockDevice() override;
+
+    // ^StorageDevice
+    virtual Type type() const override { return StorageDevice::Type::VirtIO; }
+    virtual size_t max_addressable_block() const override { return m_capacity; }
+    virtual size_t max_blocks_per_request() const override { return max_sectors_per_request; }
+
+    // ^Device
+    virtual size_t max_outstanding_requests() const override { return m_request_slots; }
+
+private:
+    VirtIOBlockDevice(const VirtIOBlockController&, PCI::Address, int major, int minor);
+
+    bool initialize();
+
+    // ^StorageDevice
+    virtual bool can_merge_requests() const override { return true; }
+    virtual void start_run(const RequestRun&) override;
+
+    // ^Device
+    virtual void did_start_requests() override;
+
+    // ^VirtIODevice
+    virtual void handle_queue_update(u16 queue_index) override;
+
+    // ^DiskDevice
+    virtual const char* class_name() const override;
+
+    struct RequestSlot {
+        RequestRun run;
+        u32 block_index { 0 };
+        bool is_write { false };
+    };
+
+    u8* slot_header(u8 slot);
+    void finish_requests(u32 finished_slots);
+
+    size_t m_capacity { 0 };
+    size_t m_request_slots { 0 };
+    bool m_initialized { false };
+
+    OwnPtr<Region> m_headers_region;
+    NonnullOwnPtrVector<Region> m_buffer_regions;
+
+    // Protected by the request queue's lock.
+    u32 m_free_slots { 0 };
+    RequestSlot m_slots[32];
+};
+
+}
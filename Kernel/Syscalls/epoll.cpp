@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ScopeGuard.h>
+#include <Kernel/FileSystem/EventQueue.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/Process.h>
+
+namespace Kernel {
+
+// We never hand out more than this many events per call; the rest stay queued.
+static constexpr size_t max_events_per_wait = 256;
+
+int Process::sys$epoll_create(int flags)
+{
+    REQUIRE_PROMISE(stdio);
+    if ((flags & EPOLL_CLOEXEC) != flags)
+        return -EINVAL;
+
+    int fd = alloc_fd();
+    if (fd < 0)
+        return fd;
+
+    m_fds[fd].set(FileDescription::create(*EventQueue::create()), (flags & EPOLL_CLOEXEC) ? FD_CLOEXEC : 0);
+    m_fds[fd].description()->set_readable(true);
+    return fd;
+}
+
+int Process::sys$epoll_ctl(Userspace<const Syscall::SC_epoll_ctl_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_ctl_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    auto queue_description = file_description(params.epfd);
+    if (!queue_description)
+        return -EBADF;
+    if (!queue_description->file().is_event_queue())
+        return -EINVAL;
+    auto& queue = static_cast<EventQueue&>(queue_description->file());
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+
+    epoll_event event {};
+    if (params.op != EPOLL_CTL_DEL) {
+        if (!copy_from_user(&event, params.event))
+            return -EFAULT;
+    }
+
+    switch (params.op) {
+    case EPOLL_CTL_ADD:
+        return queue.add_watch(params.fd, *description, event);
+    case EPOLL_CTL_MOD:
+        return queue.modify_watch(params.fd, *description, event);
+    case EPOLL_CTL_DEL:
+        return queue.remove_watch(params.fd, *description);
+    default:
+        return -EINVAL;
+    }
+}
+
+int Process::sys$epoll_wait(Userspace<const Syscall::SC_epoll_wait_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_epoll_wait_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    if (params.max_events <= 0)
+        return -EINVAL;
+
+    auto description = file_description(params.epfd);
+    if (!description)
+        return -EBADF;
+    if (!description->file().is_event_queue())
+        return -EINVAL;
+    auto& queue = static_cast<EventQueue&>(description->file());
+
+    Thread::BlockTimeout timeout;
+    if (params.timeout) {
+        timespec timeout_copy;
+        if (!copy_from_user(&timeout_copy, params.timeout))
+            return -EFAULT;
+        timeout = Thread::BlockTimeout(false, &timeout_copy);
+    }
+
+    sigset_t sigmask = {};
+    if (params.sigmask && !copy_from_user(&sigmask, params.sigmask))
+        return -EFAULT;
+
+    auto current_thread = Thread::current();
+
+    u32 previous_signal_mask = 0;
+    if (params.sigmask)
+        previous_signal_mask = current_thread->update_signal_mask(sigmask);
+    ScopeGuard rollback_signal_mask([&]() {
+        if (params.sigmask)
+            current_thread->update_signal_mask(previous_signal_mask);
+    });
+
+    Vector<epoll_event> events;
+    events.resize(min((size_t)params.max_events, max_events_per_wait));
+
+    for (;;) {
+        size_t count = queue.collect_ready_events(events.data(), events.size());
+        if (count > 0) {
+            if (!copy_to_user(params.events, events.data(), count * sizeof(epoll_event)))
+                return -EFAULT;
+            return (int)count;
+        }
+        if (!timeout.should_block())
+            return 0;
+
+        // Everything on the ready list may have gone stale by the time we looked,
+        // so keep waiting until we have something to report (or time runs out).
+        // The timeout is absolute internally, so retrying doesn't extend it.
+        auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+        auto result = current_thread->block<Thread::ReadBlocker>(timeout, *description, unblock_flags);
+        if (result.was_interrupted())
+            return -EINTR;
+        if (result.timed_out())
+            return 0;
+    }
+}
+
+}
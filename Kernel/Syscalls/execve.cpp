@@ -291,6 +291,7 @@ int Process::do_exec(NonnullRefPtr<FileDescription> main_program_description, Ve
     current_thread->set_default_signal_dispositions();
     current_thread->clear_signals();
 
+    current_thread->clear_owned_pi_futexes();
     m_futex_queues.clear();
 
     m_region_lookup_cache = {};
@@ -398,6 +399,7 @@ Vector<AuxiliaryValue> Process::generate_auxiliary_vector() const
     auxv.append({ AuxiliaryValue::HwCap, (long)CPUID(1).edx() });
 
     auxv.append({ AuxiliaryValue::ClockTick, (long)TimeManagement::the().ticks_per_second() });
+    auxv.append({ AuxiliaryValue::TimePage, TimeManagement::the().time_page_address_for_userspace().as_ptr() });
 
     // FIXME: Also take into account things like extended filesystem permissions? That's what linux does...
     auxv.append({ AuxiliaryValue::Secure, ((m_uid != m_euid) || (m_gid != m_egid)) ? 1 : 0 });
@@ -25,6 +25,7 @@
  */
 
 #include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/PageRingBuffer.h>
 #include <Kernel/Process.h>
 
 namespace Kernel {
@@ -63,6 +64,25 @@ int Process::sys$fcntl(int fd, int cmd, u32 arg)
         break;
     case F_ISTTY:
         return description->is_tty();
+    case F_SETPIPE_SZ: {
+        if ((int)arg < 0)
+            return -EINVAL;
+        size_t capacity = PAGE_ROUND_UP(max((size_t)arg, (size_t)PAGE_SIZE));
+        if (capacity > PageRingBuffer::max_capacity)
+            return -EINVAL;
+        if (capacity > PageRingBuffer::max_unprivileged_capacity && !is_superuser())
+            return -EPERM;
+        auto result = description->file().set_buffer_capacity(*description, capacity);
+        if (result.is_error())
+            return result;
+        return capacity;
+    }
+    case F_GETPIPE_SZ: {
+        auto capacity_or_error = description->file().buffer_capacity(*description);
+        if (capacity_or_error.is_error())
+            return capacity_or_error.error();
+        return capacity_or_error.value();
+    }
     default:
         return -EINVAL;
     }
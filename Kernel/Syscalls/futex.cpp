@@ -24,19 +24,32 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+
 #include <AK/Time.h>
+#include <Kernel/FutexQueue.h>
 #include <Kernel/Process.h>
+#include <Kernel/VM/MemoryManager.h>
 
 namespace Kernel {
 
-WaitQueue& Process::futex_queue(Userspace<const i32*> userspace_address)
+FutexQueue& Process::futex_queue(Userspace<const i32*> userspace_address)
 {
+    LOCKER(m_futex_lock);
     auto& queue = m_futex_queues.ensure(userspace_address.ptr());
     if (!queue)
-        queue = make<WaitQueue>();
+        queue = make<FutexQueue>();
     return *queue;
 }
 
+static int block_result_to_errno(Thread::BlockResult result)
+{
+    if (result == Thread::BlockResult::InterruptedByTimeout)
+        return -ETIMEDOUT;
+    if (result.was_interrupted())
+        return -EINTR;
+    return 0;
+}
+
 int Process::sys$futex(Userspace<const Syscall::SC_futex_params*> user_params)
 {
     REQUIRE_PROMISE(thread);
@@ -45,41 +58,206 @@ int Process::sys$futex(Userspace<const Syscall::SC_futex_params*> user_params)
     if (!copy_from_user(&params, user_params))
         return -EFAULT;
 
-    switch (params.futex_op) {
-    case FUTEX_WAIT: {
-        i32 user_value;
-        if (!copy_from_user(&user_value, params.userspace_address))
-            return -EFAULT;
-        if (user_value != params.val)
-            return -EAGAIN;
+    auto validate_address = [](const i32* address) {
+        return !((FlatPtr)address & 3) && is_user_range(VirtualAddress(address), sizeof(i32));
+    };
+    if (!validate_address(params.userspace_address))
+        return -EFAULT;
+    Userspace<const i32*> userspace_address((FlatPtr)params.userspace_address);
 
-        Thread::BlockTimeout timeout;
+    Thread::BlockTimeout timeout;
+    timespec ts_abstimeout { 0, 0 };
+    switch (params.futex_op) {
+    case FUTEX_WAIT:
+    case FUTEX_WAIT_BITSET:
+    case FUTEX_LOCK_PI:
         if (params.timeout) {
-            timespec ts_abstimeout { 0, 0 };
             if (!copy_from_user(&ts_abstimeout, params.timeout))
                 return -EFAULT;
             timeout = Thread::BlockTimeout(true, &ts_abstimeout);
         }
+        break;
+    }
+
+    auto do_wait = [&](u32 bitset) -> int {
+        auto& queue = futex_queue(userspace_address);
+        queue.queue_imminent_wait();
+        i32 user_value;
+        if (!copy_from_user(&user_value, userspace_address)) {
+            queue.abort_imminent_wait();
+            return -EFAULT;
+        }
+        if (user_value != params.val) {
+            queue.abort_imminent_wait();
+            return -EAGAIN;
+        }
+        return block_result_to_errno(queue.wait_on(timeout, bitset));
+    };
 
-        WaitQueue& wait_queue = futex_queue((FlatPtr)params.userspace_address);
-        Thread::BlockResult result = wait_queue.wait_on(timeout, "Futex");
-        if (result == Thread::BlockResult::InterruptedByTimeout) {
-            return -ETIMEDOUT;
+    auto do_requeue = [&](Optional<i32> expected_value) -> int {
+        if (!validate_address(params.userspace_address2))
+            return -EFAULT;
+        Userspace<const i32*> userspace_address2((FlatPtr)params.userspace_address2);
+        if (expected_value.has_value()) {
+            i32 user_value;
+            if (!copy_from_user(&user_value, userspace_address))
+                return -EFAULT;
+            if (user_value != expected_value.value())
+                return -EAGAIN;
         }
+        if (params.val < 0)
+            return -EINVAL;
+        auto& queue = futex_queue(userspace_address);
+        auto& target_queue = futex_queue(userspace_address2);
+        return queue.wake_n_requeue(params.val, target_queue, params.val2);
+    };
 
-        break;
-    }
+    switch (params.futex_op) {
+    case FUTEX_WAIT:
+        return do_wait(FUTEX_BITSET_MATCH_ANY);
+    case FUTEX_WAIT_BITSET:
+        if (!params.val3)
+            return -EINVAL;
+        return do_wait(params.val3);
     case FUTEX_WAKE:
-        if (params.val == 0)
+        if (params.val <= 0)
+            return 0;
+        return futex_queue(userspace_address).wake_n(params.val, FUTEX_BITSET_MATCH_ANY);
+    case FUTEX_WAKE_BITSET:
+        if (!params.val3)
+            return -EINVAL;
+        if (params.val <= 0)
             return 0;
-        if (params.val == 1) {
-            futex_queue((FlatPtr)params.userspace_address).wake_one();
-        } else {
-            futex_queue((FlatPtr)params.userspace_address).wake_n(params.val);
+        return futex_queue(userspace_address).wake_n(params.val, params.val3);
+    case FUTEX_REQUEUE:
+        return do_requeue({});
+    case FUTEX_CMP_REQUEUE:
+        return do_requeue(params.val3);
+    case FUTEX_LOCK_PI:
+    case FUTEX_TRYLOCK_PI:
+        return futex_lock_pi(userspace_address, timeout, params.futex_op == FUTEX_TRYLOCK_PI);
+    case FUTEX_UNLOCK_PI:
+        return futex_unlock_pi(userspace_address);
+    }
+
+    return -ENOSYS;
+}
+
+int Process::futex_lock_pi(Userspace<const i32*> userspace_address, const Thread::BlockTimeout& timeout, bool try_only)
+{
+    auto* futex = (volatile u32*)userspace_address.unsafe_userspace_ptr();
+    auto current_thread = Thread::current();
+    u32 tid = current_thread->tid().value();
+    auto& queue = futex_queue(userspace_address);
+
+    for (;;) {
+        queue.queue_imminent_wait();
+
+        u32 value;
+        if (!copy_from_user(&value, (const u32*)futex)) {
+            queue.abort_imminent_wait();
+            return -EFAULT;
         }
-        break;
+
+        u32 owner = value & FUTEX_TID_MASK;
+        if (owner == tid) {
+            queue.abort_imminent_wait();
+            return -EDEADLK;
+        }
+
+        if (owner == 0) {
+            // Keep the waiters bit, so that whoever we beat to it gets woken
+            // again when we unlock.
+            auto did_exchange = user_atomic_compare_exchange_relaxed(futex, value, tid | (value & FUTEX_WAITERS));
+            if (!did_exchange.has_value()) {
+                queue.abort_imminent_wait();
+                return -EFAULT;
+            }
+            if (did_exchange.value()) {
+                queue.abort_imminent_wait();
+                current_thread->add_owned_pi_futex(queue);
+                current_thread->update_inherited_priority();
+                return 0;
+            }
+            queue.abort_imminent_wait();
+            continue;
+        }
+
+        if (try_only) {
+            queue.abort_imminent_wait();
+            return -EAGAIN;
+        }
+
+        // Make sure the owner comes into the kernel to unlock it.
+        if (!(value & FUTEX_WAITERS)) {
+            auto did_exchange = user_atomic_compare_exchange_relaxed(futex, value, value | FUTEX_WAITERS);
+            if (!did_exchange.has_value()) {
+                queue.abort_imminent_wait();
+                return -EFAULT;
+            }
+            if (!did_exchange.value()) {
+                queue.abort_imminent_wait();
+                continue;
+            }
+        }
+
+        auto owner_thread = Thread::from_tid(owner);
+        if (!owner_thread || owner_thread->pid() != pid()) {
+            queue.abort_imminent_wait();
+            return -ESRCH;
+        }
+
+        // Lend our priority to the owner until it unlocks, so that a lower
+        // priority thread can't keep us waiting by holding the lock.
+        // The owner may have taken the lock without entering the kernel, so
+        // this may be the first we hear of it owning it.
+        owner_thread->add_owned_pi_futex(queue);
+        owner_thread->boost_inherited_priority(current_thread->effective_priority());
+
+        auto result = queue.wait_on(timeout, FUTEX_BITSET_MATCH_ANY);
+
+        // We're not waiting anymore, and if the owner let go of the lock
+        // meanwhile, it shouldn't keep inheriting priority through it.
+        u32 new_value;
+        if (copy_from_user(&new_value, (const u32*)futex) && (new_value & FUTEX_TID_MASK) != owner)
+            owner_thread->remove_owned_pi_futex(queue);
+        owner_thread->update_inherited_priority();
+
+        if (int rc = block_result_to_errno(result); rc < 0)
+            return rc;
     }
+}
+
+int Process::futex_unlock_pi(Userspace<const i32*> userspace_address)
+{
+    auto* futex = (volatile u32*)userspace_address.unsafe_userspace_ptr();
+    auto current_thread = Thread::current();
+    u32 tid = current_thread->tid().value();
+    auto& queue = futex_queue(userspace_address);
+
+    u32 value;
+    if (!copy_from_user(&value, (const u32*)futex))
+        return -EFAULT;
+
+    for (;;) {
+        if ((value & FUTEX_TID_MASK) != tid)
+            return -EPERM;
+        // Rather than handing the lock over, we release it and let the waiter
+        // we wake race for it. That way a waiter that times out at the same
+        // time can't leave the lock owned by nobody.
+        u32 new_value = queue.has_waiters() ? FUTEX_WAITERS : 0;
+        auto did_exchange = user_atomic_compare_exchange_relaxed(futex, value, new_value);
+        if (!did_exchange.has_value())
+            return -EFAULT;
+        if (did_exchange.value())
+            break;
+    }
+
+    current_thread->remove_owned_pi_futex(queue);
+    current_thread->update_inherited_priority();
 
+    bool has_more_waiters;
+    queue.wake_highest_priority(has_more_waiters);
     return 0;
 }
 
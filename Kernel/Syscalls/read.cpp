@@ -31,6 +31,19 @@
 
 namespace Kernel {
 
+static KResult block_until_readable(FileDescription& description)
+{
+    if (!description.is_blocking() || description.can_read())
+        return KSuccess;
+    auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+    if (Thread::current()->block<Thread::ReadBlocker>(nullptr, description, unblock_flags).was_interrupted())
+        return KResult(-EINTR);
+    if (!((u32)unblock_flags & (u32)Thread::FileBlocker::BlockFlags::Read))
+        return KResult(-EAGAIN);
+    // TODO: handle exceptions in unblock_flags
+    return KSuccess;
+}
+
 ssize_t Process::sys$read(int fd, Userspace<u8*> buffer, ssize_t size)
 {
     REQUIRE_PROMISE(stdio);
@@ -48,16 +61,9 @@ ssize_t Process::sys$read(int fd, Userspace<u8*> buffer, ssize_t size)
         return -EBADF;
     if (description->is_directory())
         return -EISDIR;
-    if (description->is_blocking()) {
-        if (!description->can_read()) {
-            auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
-            if (Thread::current()->block<Thread::ReadBlocker>(nullptr, *description, unblock_flags).was_interrupted())
-                return -EINTR;
-            if (!((u32)unblock_flags & (u32)Thread::FileBlocker::BlockFlags::Read))
-                return -EAGAIN;
-            // TODO: handle exceptions in unblock_flags
-        }
-    }
+    auto block_result = block_until_readable(*description);
+    if (block_result.is_error())
+        return block_result;
     auto user_buffer = UserOrKernelBuffer::for_user_buffer(buffer, size);
     if (!user_buffer.has_value())
         return -EFAULT;
@@ -67,4 +73,127 @@ ssize_t Process::sys$read(int fd, Userspace<u8*> buffer, ssize_t size)
     return result.value();
 }
 
+ssize_t Process::sys$readv(int fd, Userspace<const struct iovec*> iov, int iov_count)
+{
+    REQUIRE_PROMISE(stdio);
+    Vector<iovec, 32> vecs;
+    size_t total_length = 0;
+    auto result = copy_iovecs_from_user(vecs, iov, iov_count, total_length);
+    if (result.is_error())
+        return result;
+
+    auto description = file_description(fd);
+    if (!description)
+        return -EBADF;
+    if (!description->is_readable())
+        return -EBADF;
+    if (description->is_directory())
+        return -EISDIR;
+    if (total_length == 0)
+        return 0;
+
+    // Like read(), we only wait for the first byte; after that we take what we can get.
+    auto block_result = block_until_readable(*description);
+    if (block_result.is_error())
+        return block_result;
+
+    ssize_t nread = 0;
+    for (auto& vec : vecs) {
+        auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)vec.iov_base, vec.iov_len);
+        if (!buffer.has_value())
+            return -EFAULT;
+        auto nread_or_error = description->read(buffer.value(), vec.iov_len);
+        if (nread_or_error.is_error()) {
+            if (nread == 0)
+                return nread_or_error.error();
+            return nread;
+        }
+        nread += nread_or_error.value();
+        if (nread_or_error.value() < vec.iov_len)
+            break;
+    }
+
+    return nread;
+}
+
+ssize_t Process::sys$pread(Userspace<const Syscall::SC_pread_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_pread_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+    if ((ssize_t)params.size < 0)
+        return -EINVAL;
+    if (params.offset < 0)
+        return -EINVAL;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+    if (!description->is_readable())
+        return -EBADF;
+    if (description->is_directory())
+        return -EISDIR;
+    if (params.size == 0)
+        return 0;
+
+    auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)params.buffer, params.size);
+    if (!buffer.has_value())
+        return -EFAULT;
+    // The positional read leaves the description's offset alone, so concurrent
+    // readers of the same description don't have to serialize on its lock.
+    auto result = description->read(buffer.value(), params.offset, params.size);
+    if (result.is_error())
+        return result.error();
+    return result.value();
+}
+
+ssize_t Process::sys$preadv(Userspace<const Syscall::SC_preadv_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_preadv_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    Userspace<const struct iovec*> user_iov((FlatPtr)params.iov);
+    Vector<iovec, 32> vecs;
+    size_t total_length = 0;
+    auto result = copy_iovecs_from_user(vecs, user_iov, params.iov_count, total_length);
+    if (result.is_error())
+        return result;
+
+    if (params.offset < 0)
+        return -EINVAL;
+    Checked<off_t> end_offset = params.offset;
+    end_offset += total_length;
+    if (end_offset.has_overflow())
+        return -EOVERFLOW;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+    if (!description->is_readable())
+        return -EBADF;
+    if (description->is_directory())
+        return -EISDIR;
+
+    ssize_t nread = 0;
+    for (auto& vec : vecs) {
+        auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)vec.iov_base, vec.iov_len);
+        if (!buffer.has_value())
+            return -EFAULT;
+        auto nread_or_error = description->read(buffer.value(), params.offset + nread, vec.iov_len);
+        if (nread_or_error.is_error()) {
+            if (nread == 0)
+                return nread_or_error.error();
+            return nread;
+        }
+        nread += nread_or_error.value();
+        if (nread_or_error.value() < vec.iov_len)
+            break;
+    }
+
+    return nread;
+}
+
 }
@@ -133,6 +133,10 @@ int Process::sys$set_process_boost(pid_t pid, int amount)
     if (!is_superuser() && process->uid() != euid())
         return -EPERM;
     process->m_priority_boost = amount;
+    process->for_each_thread([](Thread& thread) {
+        thread.did_change_effective_priority();
+        return IterationDecision::Continue;
+    });
     return 0;
 }
 
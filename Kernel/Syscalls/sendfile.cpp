@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/NumericLimits.h>
+#include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FileSystem/Inode.h>
+#include <Kernel/KBuffer.h>
+#include <Kernel/PageRingBuffer.h>
+#include <Kernel/Process.h>
+#include <Kernel/VM/AnonymousVMObject.h>
+#include <Kernel/VM/MemoryManager.h>
+
+//#define DEBUG_IO
+
+namespace Kernel {
+
+static constexpr size_t transfer_chunk_size = 64 * KiB;
+
+// Maps the page cache pages holding `size` bytes at `offset` into the file into the kernel,
+// so they can be written out without being copied into a buffer first. Returns nullptr if
+// the filesystem doesn't keep the file in the page cache.
+static OwnPtr<Region> map_cached_pages(const Inode& inode, size_t offset, size_t size)
+{
+    size_t first_page_index = offset / PAGE_SIZE;
+    size_t page_count = PAGE_ROUND_UP(offset % PAGE_SIZE + size) / PAGE_SIZE;
+    NonnullRefPtrVector<PhysicalPage> pages;
+    pages.ensure_capacity(page_count);
+    for (size_t i = 0; i < page_count; ++i) {
+        auto page = inode.cached_page(first_page_index + i);
+        if (!page)
+            return nullptr;
+        pages.unchecked_append(page.release_nonnull());
+    }
+    auto vmobject = AnonymousVMObject::create_with_physical_pages(pages);
+    return MM.allocate_kernel_region_with_vmobject(*vmobject, page_count * PAGE_SIZE, "Transfer pages", Region::Access::Read);
+}
+
+// Moves up to `count` bytes from `source` to `destination` without copying them out to
+// userspace and back. If an offset pointer is given it is used (and advanced) instead of
+// the description's own file offset.
+//
+// We only read from the source once the destination can accept data, and once a chunk has been
+// read we wait for all of it to be written, since we may not be able to put it back (pipes and
+// sockets). A seekable source gets rewound if the destination stops short.
+//
+// Regular files that live in the page cache are written straight from the cached pages. Between
+// two files backed by a PageRingBuffer (pipes and local sockets) the buffers hand their segments
+// over. Everything else goes through a kernel bounce buffer.
+static KResultOr<size_t> transfer_between_descriptions(FileDescription& source, ssize_t* source_offset, FileDescription& destination, ssize_t* destination_offset, size_t count, bool nonblocking)
+{
+    OwnPtr<KBuffer> buffer;
+    bool source_is_seekable = source.file().is_seekable();
+    const Inode* source_inode = nullptr;
+    if (source.file().is_inode() && source.inode() && source.inode()->metadata().is_regular_file() && !source.is_direct())
+        source_inode = source.inode();
+
+    if (!destination_offset && destination.should_append())
+        destination.seek(0, SEEK_END);
+
+    auto current_thread = Thread::current();
+    size_t total_transferred = 0;
+    while (total_transferred < count) {
+        if (!source.can_read()) {
+            if (total_transferred > 0)
+                break;
+            if (nonblocking || !source.is_blocking())
+                return KResult(-EAGAIN);
+            auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+            if (current_thread->block<Thread::ReadBlocker>(nullptr, source, unblock_flags).was_interrupted())
+                return KResult(-EINTR);
+            if (!((u32)unblock_flags & (u32)Thread::FileBlocker::BlockFlags::Read))
+                return KResult(-EAGAIN);
+        }
+
+        if (!destination_offset && !destination.can_write()) {
+            if (total_transferred > 0)
+                break;
+            if (nonblocking || !destination.is_blocking())
+                return KResult(-EAGAIN);
+            auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+            if (current_thread->block<Thread::WriteBlocker>(nullptr, destination, unblock_flags).was_interrupted())
+                return KResult(-EINTR);
+        }
+
+        if (!source_offset && !destination_offset) {
+            auto* source_buffer = source.file().buffer_for_reading(source);
+            auto* destination_buffer = destination.file().buffer_for_writing(destination);
+            if (source_buffer && destination_buffer && source_buffer != destination_buffer) {
+                size_t moved = source_buffer->move_to(*destination_buffer, count - total_transferred);
+                if (moved > 0) {
+                    total_transferred += moved;
+                    continue;
+                }
+            }
+        }
+
+        size_t chunk_size = min(count - total_transferred, transfer_chunk_size);
+        u8* chunk_data = nullptr;
+        OwnPtr<Region> cached_pages;
+        if (source_inode) {
+            size_t position = source_offset ? *source_offset : source.offset();
+            size_t file_size = source_inode->size();
+            if (position >= file_size)
+                break;
+            chunk_size = min(chunk_size, file_size - position);
+            cached_pages = map_cached_pages(*source_inode, position, chunk_size);
+            if (cached_pages) {
+                chunk_data = cached_pages->vaddr().as_ptr() + position % PAGE_SIZE;
+                if (!source_offset)
+                    source.seek(chunk_size, SEEK_CUR);
+            } else {
+                // Don't bother trying again for the rest of the file.
+                source_inode = nullptr;
+            }
+        }
+
+        size_t nread;
+        if (cached_pages) {
+            nread = chunk_size;
+        } else {
+            if (!buffer) {
+                buffer = KBuffer::try_create_with_size(min(count, transfer_chunk_size), Region::Access::Read | Region::Access::Write, "Transfer buffer");
+                if (!buffer) {
+                    if (total_transferred > 0)
+                        break;
+                    return KResult(-ENOMEM);
+                }
+            }
+            chunk_data = buffer->data();
+            chunk_size = min(chunk_size, buffer->size());
+            auto read_buffer = UserOrKernelBuffer::for_kernel_buffer(chunk_data);
+            auto nread_or_error = source_offset ? source.read(read_buffer, *source_offset, chunk_size) : source.read(read_buffer, chunk_size);
+            if (nread_or_error.is_error()) {
+                if (total_transferred > 0)
+                    break;
+                return nread_or_error.error();
+            }
+            nread = nread_or_error.value();
+            if (nread == 0)
+                break;
+        }
+        if (source_offset)
+            *source_offset += nread;
+        auto kernel_buffer = UserOrKernelBuffer::for_kernel_buffer(chunk_data);
+
+        size_t nwritten = 0;
+        KResult write_result = KSuccess;
+        while (nwritten < nread) {
+            if (!destination_offset && !destination.can_write()) {
+                if (source_is_seekable && (nonblocking || !destination.is_blocking())) {
+                    write_result = KResult(-EAGAIN);
+                    break;
+                }
+                auto unblock_flags = Thread::FileBlocker::BlockFlags::None;
+                if (current_thread->block<Thread::WriteBlocker>(nullptr, destination, unblock_flags).was_interrupted()) {
+                    write_result = KResult(-EINTR);
+                    break;
+                }
+            }
+            auto data = kernel_buffer.offset(nwritten);
+            auto nwritten_or_error = destination_offset ? destination.write(data, *destination_offset, nread - nwritten) : destination.write(data, nread - nwritten);
+            if (nwritten_or_error.is_error()) {
+                write_result = nwritten_or_error.error();
+                break;
+            }
+            if (nwritten_or_error.value() == 0)
+                break;
+            nwritten += nwritten_or_error.value();
+            if (destination_offset)
+                *destination_offset += nwritten_or_error.value();
+        }
+
+        total_transferred += nwritten;
+        if (nwritten < nread) {
+            size_t unwritten = nread - nwritten;
+            if (source_offset)
+                *source_offset -= unwritten;
+            else if (source_is_seekable)
+                source.seek(-(ssize_t)unwritten, SEEK_CUR);
+            if (total_transferred == 0 && write_result.is_error())
+                return write_result;
+            break;
+        }
+    }
+    return total_transferred;
+}
+
+static KResult validate_transfer_endpoints(FileDescription& source, bool source_has_offset, FileDescription& destination, bool destination_has_offset)
+{
+    if (!source.is_readable() || !destination.is_writable())
+        return KResult(-EBADF);
+    if (source.is_directory())
+        return KResult(-EISDIR);
+    if (&source == &destination)
+        return KResult(-EINVAL);
+    if (source_has_offset && !source.file().is_seekable())
+        return KResult(-ESPIPE);
+    if (destination_has_offset && !destination.file().is_seekable())
+        return KResult(-ESPIPE);
+    return KSuccess;
+}
+
+ssize_t Process::sys$sendfile(Userspace<const Syscall::SC_sendfile_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_sendfile_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+#ifdef DEBUG_IO
+    dbg() << "sys$sendfile(" << params.out_fd << ", " << params.in_fd << ", " << params.offset << ", " << params.count << ")";
+#endif
+    auto source = file_description(params.in_fd);
+    auto destination = file_description(params.out_fd);
+    if (!source || !destination)
+        return -EBADF;
+
+    ssize_t offset = 0;
+    if (params.offset) {
+        if (!copy_from_user(&offset, params.offset))
+            return -EFAULT;
+        if (offset < 0)
+            return -EINVAL;
+    }
+
+    auto result = validate_transfer_endpoints(*source, params.offset, *destination, false);
+    if (result.is_error())
+        return result;
+
+    size_t count = min(params.count, (size_t)NumericLimits<ssize_t>::max());
+    if (count == 0)
+        return 0;
+
+    auto transferred_or_error = transfer_between_descriptions(*source, params.offset ? &offset : nullptr, *destination, nullptr, count, false);
+    if (params.offset && !copy_to_user(params.offset, &offset))
+        return -EFAULT;
+    if (transferred_or_error.is_error())
+        return transferred_or_error.error();
+    return transferred_or_error.value();
+}
+
+ssize_t Process::sys$splice(Userspace<const Syscall::SC_splice_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_splice_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    if (params.flags & ~(SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE))
+        return -EINVAL;
+
+    auto source = file_description(params.in_fd);
+    auto destination = file_description(params.out_fd);
+    if (!source || !destination)
+        return -EBADF;
+
+    ssize_t in_offset = 0;
+    ssize_t out_offset = 0;
+    if (params.in_offset && !copy_from_user(&in_offset, params.in_offset))
+        return -EFAULT;
+    if (params.out_offset && !copy_from_user(&out_offset, params.out_offset))
+        return -EFAULT;
+    if (in_offset < 0 || out_offset < 0)
+        return -EINVAL;
+
+    auto result = validate_transfer_endpoints(*source, params.in_offset, *destination, params.out_offset);
+    if (result.is_error())
+        return result;
+
+    size_t count = min(params.length, (size_t)NumericLimits<ssize_t>::max());
+    if (count == 0)
+        return 0;
+
+    auto transferred_or_error = transfer_between_descriptions(
+        *source, params.in_offset ? &in_offset : nullptr,
+        *destination, params.out_offset ? &out_offset : nullptr,
+        count, params.flags & SPLICE_F_NONBLOCK);
+    if (params.in_offset && !copy_to_user(params.in_offset, &in_offset))
+        return -EFAULT;
+    if (params.out_offset && !copy_to_user(params.out_offset, &out_offset))
+        return -EFAULT;
+    if (transferred_or_error.is_error())
+        return transferred_or_error.error();
+    return transferred_or_error.value();
+}
+
+}
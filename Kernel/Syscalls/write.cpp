@@ -30,29 +30,39 @@
 
 namespace Kernel {
 
-ssize_t Process::sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count)
+KResult Process::copy_iovecs_from_user(Vector<iovec, 32>& vecs, Userspace<const struct iovec*> iov, int iov_count, size_t& total_length)
 {
-    REQUIRE_PROMISE(stdio);
     if (iov_count < 0)
-        return -EINVAL;
+        return KResult(-EINVAL);
 
     {
         Checked checked_iov_count = sizeof(iovec);
         checked_iov_count *= iov_count;
         if (checked_iov_count.has_overflow())
-            return -EFAULT;
+            return KResult(-EFAULT);
     }
 
-    u64 total_length = 0;
-    Vector<iovec, 32> vecs;
+    u64 checked_total_length = 0;
     vecs.resize(iov_count);
     if (!copy_n_from_user(vecs.data(), iov, iov_count))
-        return -EFAULT;
+        return KResult(-EFAULT);
     for (auto& vec : vecs) {
-        total_length += vec.iov_len;
-        if (total_length > NumericLimits<i32>::max())
-            return -EINVAL;
+        checked_total_length += vec.iov_len;
+        if (checked_total_length > NumericLimits<i32>::max())
+            return KResult(-EINVAL);
     }
+    total_length = checked_total_length;
+    return KSuccess;
+}
+
+ssize_t Process::sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_count)
+{
+    REQUIRE_PROMISE(stdio);
+    Vector<iovec, 32> vecs;
+    size_t total_length = 0;
+    auto result = copy_iovecs_from_user(vecs, iov, iov_count, total_length);
+    if (result.is_error())
+        return result;
 
     auto description = file_description(fd);
     if (!description)
@@ -78,6 +88,52 @@ ssize_t Process::sys$writev(int fd, Userspace<const struct iovec*> iov, int iov_
     return nwritten;
 }
 
+ssize_t Process::sys$pwritev(Userspace<const Syscall::SC_preadv_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_preadv_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+
+    Userspace<const struct iovec*> user_iov((FlatPtr)params.iov);
+    Vector<iovec, 32> vecs;
+    size_t total_length = 0;
+    auto result = copy_iovecs_from_user(vecs, user_iov, params.iov_count, total_length);
+    if (result.is_error())
+        return result;
+
+    if (params.offset < 0)
+        return -EINVAL;
+    Checked<off_t> end_offset = params.offset;
+    end_offset += total_length;
+    if (end_offset.has_overflow())
+        return -EOVERFLOW;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+    if (!description->is_writable())
+        return -EBADF;
+
+    ssize_t nwritten = 0;
+    for (auto& vec : vecs) {
+        auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)vec.iov_base, vec.iov_len);
+        if (!buffer.has_value())
+            return -EFAULT;
+        ssize_t rc = do_pwrite(*description, buffer.value(), params.offset + nwritten, vec.iov_len);
+        if (rc < 0) {
+            if (nwritten == 0)
+                return rc;
+            return nwritten;
+        }
+        nwritten += rc;
+        if ((size_t)rc < vec.iov_len)
+            break;
+    }
+
+    return nwritten;
+}
+
 ssize_t Process::do_write(FileDescription& description, const UserOrKernelBuffer& data, size_t data_size)
 {
     ssize_t total_nwritten = 0;
@@ -116,6 +172,25 @@ ssize_t Process::do_write(FileDescription& description, const UserOrKernelBuffer
     return total_nwritten;
 }
 
+ssize_t Process::do_pwrite(FileDescription& description, const UserOrKernelBuffer& data, off_t offset, size_t data_size)
+{
+    // Positional writes go straight to the file at the given offset. They leave
+    // the description's offset alone, so there's no need to take its lock.
+    size_t total_nwritten = 0;
+    while (total_nwritten < data_size) {
+        auto nwritten_or_error = description.write(data.offset(total_nwritten), offset + total_nwritten, data_size - total_nwritten);
+        if (nwritten_or_error.is_error()) {
+            if (total_nwritten)
+                return total_nwritten;
+            return nwritten_or_error.error();
+        }
+        if (nwritten_or_error.value() == 0)
+            break;
+        total_nwritten += nwritten_or_error.value();
+    }
+    return total_nwritten;
+}
+
 ssize_t Process::sys$write(int fd, const u8* data, ssize_t size)
 {
     REQUIRE_PROMISE(stdio);
@@ -139,4 +214,29 @@ ssize_t Process::sys$write(int fd, const u8* data, ssize_t size)
     return do_write(*description, buffer.value(), size);
 }
 
+ssize_t Process::sys$pwrite(Userspace<const Syscall::SC_pwrite_params*> user_params)
+{
+    REQUIRE_PROMISE(stdio);
+    Syscall::SC_pwrite_params params;
+    if (!copy_from_user(&params, user_params))
+        return -EFAULT;
+    if ((ssize_t)params.size < 0)
+        return -EINVAL;
+    if (params.offset < 0)
+        return -EINVAL;
+
+    auto description = file_description(params.fd);
+    if (!description)
+        return -EBADF;
+    if (!description->is_writable())
+        return -EBADF;
+    if (params.size == 0)
+        return 0;
+
+    auto buffer = UserOrKernelBuffer::for_user_buffer((u8*)const_cast<void*>(params.buffer), params.size);
+    if (!buffer.has_value())
+        return -EFAULT;
+    return do_pwrite(*description, buffer.value(), params.offset, params.size);
+}
+
 }
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/Process.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/Tasks/ReadaheadTask.h>
+#include <Kernel/VM/InodeVMObject.h>
+#include <Kernel/WaitQueue.h>
+
+namespace Kernel {
+
+struct ReadaheadRequest {
+    RefPtr<InodeVMObject> vmobject;
+    size_t first_page { 0 };
+    size_t page_count { 0 };
+};
+
+static constexpr size_t max_pending_requests = 16;
+static ReadaheadRequest s_requests[max_pending_requests];
+static size_t s_request_head;
+static size_t s_request_count;
+static SpinLock<u8> s_requests_lock;
+static WaitQueue* s_readahead_wait_queue;
+
+void ReadaheadTask::queue(InodeVMObject& vmobject, size_t first_page, size_t page_count)
+{
+    if (!s_readahead_wait_queue)
+        return;
+    {
+        ScopedSpinLock lock(s_requests_lock);
+        if (s_request_count == max_pending_requests)
+            return;
+        for (size_t i = 0; i < s_request_count; ++i) {
+            auto& request = s_requests[(s_request_head + i) % max_pending_requests];
+            if (request.vmobject == &vmobject && request.first_page == first_page)
+                return;
+        }
+        auto& request = s_requests[(s_request_head + s_request_count) % max_pending_requests];
+        request.vmobject = vmobject;
+        request.first_page = first_page;
+        request.page_count = page_count;
+        s_request_count++;
+    }
+    s_readahead_wait_queue->wake_one();
+}
+
+static bool take_request(ReadaheadRequest& request)
+{
+    ScopedSpinLock lock(s_requests_lock);
+    if (s_request_count == 0)
+        return false;
+    auto& pending = s_requests[s_request_head];
+    request.vmobject = move(pending.vmobject);
+    request.first_page = pending.first_page;
+    request.page_count = pending.page_count;
+    s_request_head = (s_request_head + 1) % max_pending_requests;
+    s_request_count--;
+    return true;
+}
+
+void ReadaheadTask::spawn()
+{
+    s_readahead_wait_queue = new WaitQueue;
+
+    RefPtr<Thread> readahead_thread;
+    Process::create_kernel_process(readahead_thread, "ReadaheadTask", [] {
+        Thread::current()->set_priority(THREAD_PRIORITY_LOW);
+        for (;;) {
+            ReadaheadRequest request;
+            while (take_request(request)) {
+                request.vmobject->read_ahead(request.first_page, request.page_count);
+                request.vmobject = nullptr;
+            }
+            s_readahead_wait_queue->wait_on(nullptr, "ReadaheadTask");
+        }
+    });
+}
+
+}
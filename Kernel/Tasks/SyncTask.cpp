@@ -24,7 +24,7 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <Kernel/FileSystem/VirtualFileSystem.h>
+#include <Kernel/FileSystem/FileSystem.h>
 #include <Kernel/Process.h>
 #include <Kernel/Tasks/SyncTask.h>
 #include <Kernel/Time/TimeManagement.h>
@@ -37,7 +37,9 @@ void SyncTask::spawn()
     Process::create_kernel_process(syncd_thread, "SyncTask", [] {
         dbg() << "SyncTask is running";
         for (;;) {
-            VFS::the().sync();
+            // Filesystems write back their dirty pages at their own pace, we only
+            // make sure everything has made it into their caches by now.
+            FS::sync_in_background();
             Thread::current()->sleep({ 1, 0 });
         }
     });
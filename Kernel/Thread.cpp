@@ -29,6 +29,7 @@
 #include <AK/Time.h>
 #include <Kernel/Arch/i386/CPU.h>
 #include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FutexQueue.h>
 #include <Kernel/KSyms.h>
 #include <Kernel/Process.h>
 #include <Kernel/Profiling.h>
@@ -124,6 +125,7 @@ Thread::~Thread()
         // the middle of being destroyed.
         ScopedSpinLock lock(g_scheduler_lock);
         g_scheduler_data->thread_list_for_state(m_state).remove(*this);
+        Scheduler::dequeue_runnable_thread(*this);
     }
 }
 
@@ -410,6 +412,71 @@ bool Thread::tick()
     return --m_ticks_left;
 }
 
+void Thread::add_owned_pi_futex(FutexQueue& queue)
+{
+    ScopedSpinLock lock(m_owned_pi_futexes_lock);
+    if (!m_owned_pi_futexes.contains_slow(&queue))
+        m_owned_pi_futexes.append(&queue);
+}
+
+void Thread::remove_owned_pi_futex(FutexQueue& queue)
+{
+    ScopedSpinLock lock(m_owned_pi_futexes_lock);
+    m_owned_pi_futexes.remove_first_matching([&](auto* owned_queue) { return owned_queue == &queue; });
+}
+
+void Thread::clear_owned_pi_futexes()
+{
+    ScopedSpinLock lock(m_owned_pi_futexes_lock);
+    m_owned_pi_futexes.clear();
+    m_inherited_priority = 0;
+}
+
+void Thread::set_priority(u32 priority)
+{
+    m_priority = priority;
+    did_change_effective_priority();
+}
+
+void Thread::set_priority_boost(u32 boost)
+{
+    m_priority_boost = boost;
+    did_change_effective_priority();
+}
+
+void Thread::boost_inherited_priority(u32 priority)
+{
+    {
+        ScopedSpinLock lock(m_owned_pi_futexes_lock);
+        if (m_inherited_priority >= priority)
+            return;
+        m_inherited_priority = priority;
+    }
+    did_change_effective_priority();
+}
+
+void Thread::update_inherited_priority()
+{
+    {
+        // We may still own other PI futexes after unlocking one, so take
+        // the highest priority of anyone waiting on any of them.
+        ScopedSpinLock lock(m_owned_pi_futexes_lock);
+        u32 priority = 0;
+        for (auto* queue : m_owned_pi_futexes)
+            priority = max(priority, queue->highest_waiter_priority());
+        if (m_inherited_priority == priority)
+            return;
+        m_inherited_priority = priority;
+    }
+    did_change_effective_priority();
+}
+
+void Thread::did_change_effective_priority()
+{
+    ScopedSpinLock lock(g_scheduler_lock);
+    Scheduler::requeue_runnable_thread(*this);
+}
+
 void Thread::check_dispatch_pending_signal()
 {
     auto result = DispatchSignalResult::Continue;
@@ -1021,6 +1088,13 @@ void Thread::update_state_for_thread(Thread::State previous_state)
         previous_list.remove(*this);
     }
 
+    // Only threads waiting for a processor live in the ready queues,
+    // the ones currently Running are not eligible to be picked.
+    if (previous_state == Runnable)
+        Scheduler::dequeue_runnable_thread(*this);
+    if (state() == Runnable)
+        Scheduler::queue_runnable_thread(*this);
+
     if (list.contains(*this))
         return;
 
@@ -99,14 +99,24 @@ public:
     ThreadID tid() const { return m_tid; }
     ProcessID pid() const;
 
-    void set_priority(u32 p) { m_priority = p; }
+    void set_priority(u32);
     u32 priority() const { return m_priority; }
 
-    void set_priority_boost(u32 boost) { m_priority_boost = boost; }
+    void set_priority_boost(u32);
     u32 priority_boost() const { return m_priority_boost; }
 
     u32 effective_priority() const;
 
+    // Priority inherited from threads waiting on the PI futexes we own.
+    u32 inherited_priority() const { return m_inherited_priority; }
+    void add_owned_pi_futex(FutexQueue&);
+    void remove_owned_pi_futex(FutexQueue&);
+    void clear_owned_pi_futexes();
+    // Lends a waiter's priority to us before it is on the futex queue to be counted.
+    void boost_inherited_priority(u32 priority);
+    void update_inherited_priority();
+    void did_change_effective_priority();
+
     void detach()
     {
         ScopedSpinLock lock(m_lock);
@@ -262,6 +272,7 @@ public:
             Unknown = 0,
             File,
             Plan9FS,
+            Futex,
             Join,
             Queue,
             Routing,
@@ -353,6 +364,15 @@ public:
 
         bool set_block_condition(BlockCondition&, void* = nullptr);
 
+        // Moves a blocker that is still on its block condition's list to
+        // another one. Both block conditions must be locked.
+        void did_move_to_block_condition(BlockCondition& block_condition)
+        {
+            ScopedSpinLock lock(m_lock);
+            ASSERT(m_block_condition);
+            m_block_condition = &block_condition;
+        }
+
         mutable RecursiveSpinLock m_lock;
 
     private:
@@ -466,13 +486,12 @@ public:
 
         virtual bool should_add_blocker(Blocker&, void*) { return true; }
 
-        SpinLock<u8> m_lock;
-
-    private:
         struct BlockerInfo {
             Blocker* blocker;
             void* data;
         };
+
+        SpinLock<u8> m_lock;
         Vector<BlockerInfo, 4> m_blockers;
     };
 
@@ -518,6 +537,31 @@ public:
         bool m_did_unblock { false };
     };
 
+    class FutexBlocker : public Blocker {
+    public:
+        explicit FutexBlocker(FutexQueue&, u32 bitset);
+        virtual ~FutexBlocker();
+
+        virtual Type blocker_type() const override { return Type::Futex; }
+        virtual const char* state_string() const override { return "Futex"; }
+        virtual void not_blocking(bool) override { }
+
+        virtual bool should_block() override
+        {
+            return m_should_block;
+        }
+
+        u32 bitset() const { return m_bitset; }
+
+        bool unblock();
+        void move_to(FutexQueue&);
+
+    protected:
+        u32 m_bitset;
+        bool m_should_block { true };
+        bool m_did_unblock { false };
+    };
+
     class FileBlocker : public Blocker {
     public:
         enum class BlockFlags : u32 {
@@ -1115,6 +1159,9 @@ public:
 
 private:
     IntrusiveListNode m_runnable_list_node;
+    IntrusiveListNode m_ready_queue_node;
+    int m_runnable_priority { -1 };
+    u32 m_ready_queue_cpu { 0 };
 
 private:
     friend struct SchedulerData;
@@ -1235,8 +1282,10 @@ private:
     State m_state { Invalid };
     String m_name;
     u32 m_priority { THREAD_PRIORITY_NORMAL };
-    u32 m_extra_priority { 0 };
     u32 m_priority_boost { 0 };
+    Atomic<u32> m_inherited_priority { 0 };
+    SpinLock<u8> m_owned_pi_futexes_lock;
+    Vector<FutexQueue*, 2> m_owned_pi_futexes;
 
     State m_stop_state { Invalid };
 
@@ -1293,6 +1342,7 @@ const LogStream& operator<<(const LogStream&, const Thread&);
 
 struct SchedulerData {
     typedef IntrusiveList<Thread, &Thread::m_runnable_list_node> ThreadList;
+    typedef IntrusiveList<Thread, &Thread::m_ready_queue_node> ReadyQueueList;
 
     ThreadList m_runnable_threads;
     ThreadList m_nonrunnable_threads;
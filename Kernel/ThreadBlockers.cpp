@@ -25,6 +25,7 @@
  */
 
 #include <Kernel/FileSystem/FileDescription.h>
+#include <Kernel/FutexQueue.h>
 #include <Kernel/Net/Socket.h>
 #include <Kernel/Process.h>
 #include <Kernel/Scheduler.h>
@@ -148,6 +149,35 @@ bool Thread::QueueBlocker::unblock()
     return true;
 }
 
+Thread::FutexBlocker::FutexBlocker(FutexQueue& futex_queue, u32 bitset)
+    : m_bitset(bitset)
+{
+    if (!set_block_condition(futex_queue, Thread::current()))
+        m_should_block = false;
+}
+
+Thread::FutexBlocker::~FutexBlocker()
+{
+}
+
+bool Thread::FutexBlocker::unblock()
+{
+    {
+        ScopedSpinLock lock(m_lock);
+        if (m_did_unblock)
+            return false;
+        m_did_unblock = true;
+    }
+
+    unblock_from_blocker();
+    return true;
+}
+
+void Thread::FutexBlocker::move_to(FutexQueue& futex_queue)
+{
+    did_move_to_block_condition(futex_queue);
+}
+
 Thread::FileDescriptionBlocker::FileDescriptionBlocker(FileDescription& description, BlockFlags flags, BlockFlags& unblocked_flags)
     : m_blocked_description(description)
     , m_flags(flags)
@@ -39,6 +39,7 @@
 #include <Kernel/Time/RTC.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/TimerQueue.h>
+#include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
 
 //#define TIME_DEBUG
@@ -90,6 +91,7 @@ void TimeManagement::set_epoch_time(timespec ts)
     InterruptDisabler disabler;
     m_epoch_time = ts;
     m_remaining_epoch_time_adjustment = { 0, 0 };
+    update_time_page();
 }
 
 u64 TimeManagement::monotonic_ticks() const
@@ -135,6 +137,7 @@ void TimeManagement::initialize(u32 cpu)
     if (cpu == 0) {
         ASSERT(!s_the.is_initialized());
         s_the.ensure_instance();
+        TimerQueue::the().initialize_processor();
 
         // Initialize the APIC timers after the other timers as the
         // initialization needs to briefly enable interrupts, which then
@@ -148,6 +151,7 @@ void TimeManagement::initialize(u32 cpu)
         ASSERT(s_the.is_initialized());
         if (auto* apic_timer = APIC::the().get_timer()) {
             klog() << "Time: Enable APIC timer on CPU #" << cpu;
+            TimerQueue::the().initialize_processor();
             apic_timer->enable_local_timer();
         }
     }
@@ -172,6 +176,8 @@ time_t TimeManagement::boot_time() const
 
 TimeManagement::TimeManagement()
 {
+    create_time_page();
+
     bool probe_non_legacy_hardware_timers = !(kernel_command_line().lookup("time").value_or("modern") == "legacy");
     if (ACPI::is_enabled()) {
         if (!ACPI::Parser::the()->x86_specific_flags().cmos_rtc_not_present) {
@@ -194,6 +200,36 @@ TimeManagement::TimeManagement()
     }
 }
 
+void TimeManagement::create_time_page()
+{
+    auto page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
+    ASSERT(page);
+    auto vmobject = AnonymousVMObject::create_with_physical_page(*page);
+    m_time_page_region = MM.allocate_kernel_region_with_vmobject(*vmobject, PAGE_SIZE, "Time page", Region::Access::Read | Region::Access::Write);
+    m_time_page_region_for_userspace = MM.allocate_kernel_region_with_vmobject(*vmobject, PAGE_SIZE, "Time page (userspace)", Region::Access::Read, true);
+    ASSERT(m_time_page_region && m_time_page_region_for_userspace);
+}
+
+VirtualAddress TimeManagement::time_page_address_for_userspace() const
+{
+    return m_time_page_region_for_userspace->vaddr();
+}
+
+void TimeManagement::update_time_page()
+{
+    auto monotonic = ticks_to_time(m_ticks_this_second + (u64)m_seconds_since_boot * ticks_per_second(), ticks_per_second());
+
+    ScopedSpinLock lock(m_time_page_lock);
+    auto& page = *reinterpret_cast<volatile TimePage*>(m_time_page_region->vaddr().as_ptr());
+    u32 sequence = page.sequence;
+    AK::atomic_store(&page.sequence, sequence + 1, AK::MemoryOrder::memory_order_release);
+    page.monotonic_seconds = monotonic.tv_sec;
+    page.monotonic_nanoseconds = monotonic.tv_nsec;
+    page.realtime_seconds = m_epoch_time.tv_sec;
+    page.realtime_nanoseconds = m_epoch_time.tv_nsec;
+    AK::atomic_store(&page.sequence, sequence + 2, AK::MemoryOrder::memory_order_release);
+}
+
 timeval TimeManagement::now_as_timeval()
 {
     timespec ts = s_the.ptr()->epoch_time();
@@ -335,6 +371,7 @@ void TimeManagement::increment_time_since_boot(const RegisterState&)
         ++m_seconds_since_boot;
         m_ticks_this_second = 0;
     }
+    update_time_page();
     m_update2.store(update_iteration + 1, AK::MemoryOrder::memory_order_release);
 }
 
@@ -27,10 +27,14 @@
 #pragma once
 
 #include <AK/NonnullRefPtrVector.h>
+#include <AK/OwnPtr.h>
 #include <AK/RefPtr.h>
 #include <AK/Types.h>
+#include <Kernel/API/TimePage.h>
 #include <Kernel/KResult.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/UnixTypes.h>
+#include <Kernel/VirtualAddress.h>
 
 namespace Kernel {
 
@@ -71,6 +75,9 @@ public:
     timespec remaining_epoch_time_adjustment() const { return m_remaining_epoch_time_adjustment; }
     void set_remaining_epoch_time_adjustment(const timespec& adjustment) { m_remaining_epoch_time_adjustment = adjustment; }
 
+    // Where userspace can find the (read-only) TimePage.
+    VirtualAddress time_page_address_for_userspace() const;
+
 private:
     bool probe_and_set_legacy_hardware_timers();
     bool probe_and_set_non_legacy_hardware_timers();
@@ -80,6 +87,9 @@ private:
     void set_system_timer(HardwareTimerBase&);
     static void timer_tick(const RegisterState&);
 
+    void create_time_page();
+    void update_time_page();
+
     // Variables between m_update1 and m_update2 are synchronized
     Atomic<u32> m_update1 { 0 };
     u32 m_ticks_this_second { 0 };
@@ -90,6 +100,11 @@ private:
 
     RefPtr<HardwareTimerBase> m_system_timer;
     RefPtr<HardwareTimerBase> m_time_keeper_timer;
+
+    // The same page, mapped writable for us and read-only for userspace.
+    OwnPtr<Region> m_time_page_region;
+    OwnPtr<Region> m_time_page_region_for_userspace;
+    SpinLock<u8> m_time_page_lock;
 };
 
 }
@@ -29,6 +29,7 @@
 #include <AK/OwnPtr.h>
 #include <AK/Singleton.h>
 #include <AK/Time.h>
+#include <AK/Vector.h>
 #include <Kernel/Scheduler.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/TimerQueue.h>
@@ -36,7 +37,6 @@
 namespace Kernel {
 
 static AK::Singleton<TimerQueue> s_the;
-static SpinLock<u8> g_timerqueue_lock;
 
 timespec Timer::remaining() const
 {
@@ -60,6 +60,30 @@ TimerQueue::TimerQueue()
     m_ticks_per_second = TimeManagement::the().ticks_per_second();
 }
 
+void TimerQueue::initialize_processor()
+{
+    auto& processor = Processor::current();
+    ASSERT(!processor.has_timer_queue_data());
+    ASSERT(m_boot_processor_data || processor.id() == 0);
+
+    auto* data = new TimerQueuePerProcessorData;
+    data->processor_id = processor.id();
+    // The processor id goes into the low bits of timer ids, see add_timer().
+    ASSERT(data->processor_id <= 0xff);
+    processor.set_timer_queue_data(*data);
+    if (!m_boot_processor_data)
+        m_boot_processor_data = data;
+}
+
+TimerQueuePerProcessorData& TimerQueue::data_for_current_processor()
+{
+    auto& processor = Processor::current();
+    if (processor.has_timer_queue_data())
+        return processor.get_timer_queue_data();
+    ASSERT(m_boot_processor_data);
+    return *m_boot_processor_data;
+}
+
 RefPtr<Timer> TimerQueue::add_timer_without_id(clockid_t clock_id, const timespec& deadline, Function<void()>&& callback)
 {
     if (deadline <= TimeManagement::the().current_time(clock_id).value())
@@ -72,50 +96,116 @@ RefPtr<Timer> TimerQueue::add_timer_without_id(clockid_t clock_id, const timespe
     // returning from the timer handler and a call to cancel_timer().
     auto timer = adopt(*new Timer(clock_id, time_to_ticks(clock_id, deadline), move(callback)));
 
-    ScopedSpinLock lock(g_timerqueue_lock);
+    auto& data = data_for_current_processor();
+    ScopedSpinLock lock(data.lock);
     timer->m_id = 0; // Don't generate a timer id
-    add_timer_locked(timer);
+    add_timer_locked(data, timer);
     return timer;
 }
 
 TimerId TimerQueue::add_timer(NonnullRefPtr<Timer>&& timer)
 {
-    ScopedSpinLock lock(g_timerqueue_lock);
+    auto& data = data_for_current_processor();
+    ScopedSpinLock lock(data.lock);
+
+    // Keep the processor id in the low bits, so cancel_timer() knows where to look.
+    timer->m_id = (++data.timer_id_count << 8) | data.processor_id;
+    ASSERT(data.timer_id_count < (1ull << 56)); // wrapped
+    auto id = timer->m_id;
+    data.timers_by_id.set(id, timer.ptr());
+    add_timer_locked(data, move(timer));
+    return id;
+}
 
-    timer->m_id = ++m_timer_id_count;
-    ASSERT(timer->m_id != 0); // wrapped
-    add_timer_locked(move(timer));
-    return m_timer_id_count;
+void TimerQueue::add_timer_locked(TimerQueuePerProcessorData& data, NonnullRefPtr<Timer> timer)
+{
+    u64 now = timer->now();
+    ASSERT(timer->m_expires >= now);
+    ASSERT(!timer->is_queued());
+
+    auto& wheel = wheel_for_timer(data, *timer);
+    if (wheel.timer_count == 0) {
+        // Nothing is waiting to fire, so there's no need to walk the wheel up to the present.
+        wheel.current_tick = wheel_tick(timer->m_clock_id, now);
+    }
+
+    timer->m_processor_data = &data;
+    timer->set_queued(true);
+    add_to_wheel(wheel, timer.leak_ref());
 }
 
-void TimerQueue::add_timer_locked(NonnullRefPtr<Timer> timer)
+void TimerQueue::add_to_wheel(TimerWheel& wheel, Timer& timer)
 {
-    u64 timer_expiration = timer->m_expires;
-    ASSERT(timer_expiration >= time_to_ticks(timer->m_clock_id, TimeManagement::the().current_time(timer->m_clock_id).value()));
+    u64 tick = max(wheel_tick(timer.m_clock_id, timer.m_expires), wheel.current_tick);
+    u64 ticks_from_now = tick - wheel.current_tick;
+
+    auto* slot = &wheel.overflow;
+    for (size_t level = 0; level < TimerWheel::level_count; ++level) {
+        size_t shift = level * TimerWheel::slot_bits;
+        if (ticks_from_now < (1ull << (shift + TimerWheel::slot_bits))) {
+            slot = &wheel.slots[level][(tick >> shift) & (TimerWheel::slots_per_level - 1)];
+            break;
+        }
+    }
 
-    ASSERT(!timer->is_queued());
+    slot->append(&timer);
+    timer.m_slot = slot;
+    wheel.timer_count++;
+}
 
-    auto& queue = queue_for_timer(*timer);
-    if (queue.list.is_empty()) {
-        queue.list.append(&timer.leak_ref());
-        queue.next_timer_due = timer_expiration;
-    } else {
-        Timer* following_timer = nullptr;
-        queue.list.for_each([&](Timer& t) {
-            if (t.m_expires > timer_expiration) {
-                following_timer = &t;
-                return IterationDecision::Break;
+void TimerQueue::advance_wheel(TimerWheel& wheel, u64 now_tick, InlineLinkedList<Timer>& due_timers)
+{
+    // A wheel tick is over once the clock has moved past it.
+    while (wheel.current_tick < now_tick) {
+        if (wheel.timer_count == 0) {
+            wheel.current_tick = now_tick;
+            return;
+        }
+
+        u64 tick = wheel.current_tick;
+
+        // Whenever a level comes around to a new slot, spread its timers out over the levels below.
+        for (size_t level = 1; level <= TimerWheel::level_count; ++level) {
+            size_t shift = level * TimerWheel::slot_bits;
+            if (tick & ((1ull << shift) - 1))
+                break;
+            auto& slot = level == TimerWheel::level_count ? wheel.overflow : wheel.slots[level][(tick >> shift) & (TimerWheel::slots_per_level - 1)];
+            InlineLinkedList<Timer> timers;
+            timers.append(slot);
+            while (auto* timer = timers.remove_head()) {
+                wheel.timer_count--;
+                add_to_wheel(wheel, *timer);
             }
-            return IterationDecision::Continue;
-        });
-        if (following_timer) {
-            bool next_timer_needs_update = queue.list.head() == following_timer;
-            queue.list.insert_before(following_timer, &timer.leak_ref());
-            if (next_timer_needs_update)
-                queue.next_timer_due = timer_expiration;
-        } else {
-            queue.list.append(&timer.leak_ref());
         }
+
+        auto& slot = wheel.slots[0][tick & (TimerWheel::slots_per_level - 1)];
+        while (auto* timer = slot.remove_head()) {
+            wheel.timer_count--;
+            due_timers.append(timer);
+        }
+
+        wheel.current_tick++;
+    }
+}
+
+void TimerQueue::rebuild_wheel(TimerWheel& wheel, u64 now_tick, InlineLinkedList<Timer>& due_timers)
+{
+    // The clock jumped (e.g. someone set the time), so rather than walking
+    // the wheel tick by tick, take all the timers out and file them again.
+    InlineLinkedList<Timer> timers;
+    for (auto& level : wheel.slots) {
+        for (auto& slot : level)
+            timers.append(slot);
+    }
+    timers.append(wheel.overflow);
+
+    wheel.timer_count = 0;
+    wheel.current_tick = now_tick;
+    while (auto* timer = timers.remove_head()) {
+        if (wheel_tick(timer->m_clock_id, timer->m_expires) < now_tick)
+            due_timers.append(timer);
+        else
+            add_to_wheel(wheel, *timer);
     }
 }
 
@@ -162,37 +252,36 @@ u64 TimerQueue::time_to_ticks(clockid_t clock_id, const timespec& tspec) const
     return ticks;
 }
 
-bool TimerQueue::cancel_timer(TimerId id)
+u64 TimerQueue::wheel_tick(clockid_t clock_id, u64 ticks) const
 {
-    Timer* found_timer = nullptr;
-    Queue* timer_queue = nullptr;
-
-    ScopedSpinLock lock(g_timerqueue_lock);
-    if (m_timer_queue_monotonic.list.for_each([&](Timer& timer) {
-            if (timer.m_id == id) {
-                found_timer = &timer;
-                timer_queue = &m_timer_queue_monotonic;
-                return IterationDecision::Break;
-            }
-            return IterationDecision::Continue;
-        })
-        != IterationDecision::Break) {
-        m_timer_queue_realtime.list.for_each([&](Timer& timer) {
-            if (timer.m_id == id) {
-                found_timer = &timer;
-                timer_queue = &m_timer_queue_realtime;
-                return IterationDecision::Break;
-            }
-            return IterationDecision::Continue;
-        });
+    switch (clock_id) {
+    case CLOCK_MONOTONIC:
+        return ticks;
+    case CLOCK_REALTIME:
+        return ticks / (1'000'000'000 / m_ticks_per_second);
+    default:
+        ASSERT_NOT_REACHED();
     }
+}
+
+bool TimerQueue::cancel_timer(TimerId id)
+{
+    u32 processor_id = id & 0xff;
+    if (id == 0 || processor_id >= Processor::count())
+        return false;
+    auto& processor = Processor::by_id(processor_id);
+    if (!processor.has_timer_queue_data())
+        return false;
+    auto& data = processor.get_timer_queue_data();
 
-    if (!found_timer) {
+    ScopedSpinLock lock(data.lock);
+    auto it = data.timers_by_id.find(id);
+    if (it == data.timers_by_id.end()) {
         // The timer may be executing right now, if it is then it should
-        // be in m_timers_executing. If it is then release the lock
+        // be in timers_executing. If it is then release the lock
         // briefly to allow it to finish by removing itself
         // NOTE: This can only happen with multiple processors!
-        while (m_timers_executing.for_each([&](Timer& timer) {
+        while (data.timers_executing.for_each([&](Timer& timer) {
             if (timer.m_id == id)
                 return IterationDecision::Break;
             return IterationDecision::Continue;
@@ -210,22 +299,24 @@ bool TimerQueue::cancel_timer(TimerId id)
         return false;
     }
 
-    ASSERT(found_timer);
-    ASSERT(timer_queue);
-    remove_timer_locked(*timer_queue, *found_timer);
+    remove_timer_locked(*it->value);
     return true;
 }
 
 bool TimerQueue::cancel_timer(Timer& timer)
 {
-    auto& timer_queue = queue_for_timer(timer);
-    ScopedSpinLock lock(g_timerqueue_lock);
-    if (!timer_queue.list.contains_slow(&timer)) {
+    // A timer stays on the wheels of the processor it was added on.
+    auto* data = timer.m_processor_data;
+    if (!data)
+        return false;
+
+    ScopedSpinLock lock(data->lock);
+    if (!timer.is_queued()) {
         // The timer may be executing right now, if it is then it should
-        // be in m_timers_executing. If it is then release the lock
+        // be in timers_executing. If it is then release the lock
         // briefly to allow it to finish by removing itself
         // NOTE: This can only happen with multiple processors!
-        while (m_timers_executing.contains_slow(&timer)) {
+        while (data->timers_executing.contains_slow(&timer)) {
             // NOTE: This isn't the most efficient way to wait, but
             // it should only happen when multiple processors are used.
             // Also, the timers should execute pretty quickly, so it
@@ -240,21 +331,25 @@ bool TimerQueue::cancel_timer(Timer& timer)
     }
 
     ASSERT(timer.ref_count() > 1);
-    remove_timer_locked(timer_queue, timer);
+    remove_timer_locked(timer);
     return true;
 }
 
-void TimerQueue::remove_timer_locked(Queue& queue, Timer& timer)
+void TimerQueue::remove_timer_locked(Timer& timer)
 {
-    bool was_next_timer = (queue.list.head() == &timer);
-    queue.list.remove(&timer);
+    auto& data = *timer.m_processor_data;
+    ASSERT(data.lock.is_locked());
+
+    timer.m_slot->remove(&timer);
+    timer.m_slot = nullptr;
+    wheel_for_timer(data, timer).timer_count--;
+    if (timer.m_id)
+        data.timers_by_id.remove(timer.m_id);
     timer.set_queued(false);
     auto now = timer.now();
     if (timer.m_expires > now)
         timer.m_remaining = timer.m_expires - now;
 
-    if (was_next_timer)
-        update_next_timer_due(queue);
     // Whenever we remove a timer that was still queued (but hasn't been
     // fired) we added a reference to it. So, when removing it from the
     // queue we need to drop that reference.
@@ -263,51 +358,51 @@ void TimerQueue::remove_timer_locked(Queue& queue, Timer& timer)
 
 void TimerQueue::fire()
 {
-    ScopedSpinLock lock(g_timerqueue_lock);
-
-    auto fire_timers = [&](Queue& queue) {
-        auto* timer = queue.list.head();
-        ASSERT(timer);
-        ASSERT(queue.next_timer_due == timer->m_expires);
-
-        while (timer && timer->now() > timer->m_expires) {
-            queue.list.remove(timer);
-            timer->set_queued(false);
-
-            m_timers_executing.append(timer);
-
-            update_next_timer_due(queue);
-
-            lock.unlock();
-
-            // Defer executing the timer outside of the irq handler
-            Processor::current().deferred_call_queue([this, timer]() {
-                timer->m_callback();
-                ScopedSpinLock lock(g_timerqueue_lock);
-                m_timers_executing.remove(timer);
-                // Drop the reference we added when queueing the timer
-                timer->unref();
-            });
-
-            lock.lock();
-            timer = queue.list.head();
-        }
+    auto& processor = Processor::current();
+    if (!processor.has_timer_queue_data())
+        return;
+    auto& data = processor.get_timer_queue_data();
+    ScopedSpinLock lock(data.lock);
+
+    InlineLinkedList<Timer> due_timers;
+    auto collect_due_timers = [&](TimerWheel& wheel, clockid_t clock_id) {
+        auto now = time_to_ticks(clock_id, TimeManagement::the().current_time(clock_id).value());
+        auto now_tick = wheel_tick(clock_id, now);
+        if (now_tick < wheel.current_tick || now_tick - wheel.current_tick > TimerWheel::slots_per_level)
+            rebuild_wheel(wheel, now_tick, due_timers);
+        else
+            advance_wheel(wheel, now_tick, due_timers);
     };
+    collect_due_timers(data.monotonic_wheel, CLOCK_MONOTONIC);
+    collect_due_timers(data.realtime_wheel, CLOCK_REALTIME);
+
+    if (due_timers.is_empty())
+        return;
+
+    // Mark all of them as executing before dropping the lock, so that
+    // cancel_timer() waits for them rather than looking in the wheels.
+    Vector<Timer*, 16> timers_to_execute;
+    while (auto* timer = due_timers.remove_head()) {
+        timer->m_slot = nullptr;
+        if (timer->m_id)
+            data.timers_by_id.remove(timer->m_id);
+        timer->set_queued(false);
+        data.timers_executing.append(timer);
+        timers_to_execute.append(timer);
+    }
 
-    if (!m_timer_queue_monotonic.list.is_empty())
-        fire_timers(m_timer_queue_monotonic);
-    if (!m_timer_queue_realtime.list.is_empty())
-        fire_timers(m_timer_queue_realtime);
-}
-
-void TimerQueue::update_next_timer_due(Queue& queue)
-{
-    ASSERT(g_timerqueue_lock.is_locked());
+    lock.unlock();
 
-    if (auto* next_timer = queue.list.head())
-        queue.next_timer_due = next_timer->m_expires;
-    else
-        queue.next_timer_due = 0;
+    for (auto* timer : timers_to_execute) {
+        // Defer executing the timer outside of the irq handler
+        processor.deferred_call_queue([timer, data = &data]() {
+            timer->m_callback();
+            ScopedSpinLock lock(data->lock);
+            data->timers_executing.remove(timer);
+            // Drop the reference we added when queueing the timer
+            timer->unref();
+        });
+    }
 }
 
 }
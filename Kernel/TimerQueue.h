@@ -27,16 +27,20 @@
 #pragma once
 
 #include <AK/Function.h>
+#include <AK/HashMap.h>
 #include <AK/InlineLinkedList.h>
 #include <AK/NonnullRefPtr.h>
 #include <AK/OwnPtr.h>
 #include <AK/RefCounted.h>
+#include <Kernel/SpinLock.h>
 #include <Kernel/Time/TimeManagement.h>
 
 namespace Kernel {
 
 typedef u64 TimerId;
 
+struct TimerQueuePerProcessorData;
+
 class Timer : public RefCounted<Timer>
     , public InlineLinkedListNode<Timer> {
     friend class TimerQueue;
@@ -66,6 +70,10 @@ private:
     Timer* m_prev { nullptr };
     Atomic<bool> m_queued { false };
 
+    // The processor whose wheels the timer was added to, and the wheel slot it's in while queued.
+    TimerQueuePerProcessorData* m_processor_data { nullptr };
+    InlineLinkedList<Timer>* m_slot { nullptr };
+
     bool operator<(const Timer& rhs) const
     {
         return m_expires < rhs.m_expires;
@@ -83,6 +91,43 @@ private:
     u64 now() const;
 };
 
+// A hierarchical timing wheel. Each level has 64 slots, and each slot of a level
+// spans 64 times as many wheel ticks as a slot of the level below it. Timers are
+// filed in the lowest level that reaches their expiration, and move down a level
+// whenever the wheel comes around to their slot, so adding and removing a timer
+// takes constant time.
+//
+// A wheel tick is one tick of the time keeper timer. Timers keep their exact
+// expiration (ticks for CLOCK_MONOTONIC, nanoseconds for CLOCK_REALTIME), the
+// wheel only uses it to pick a slot.
+struct TimerWheel {
+    static constexpr size_t slot_bits = 6;
+    static constexpr size_t slots_per_level = 1 << slot_bits;
+    static constexpr size_t level_count = 4;
+
+    InlineLinkedList<Timer> slots[level_count][slots_per_level];
+
+    // Timers that expire beyond what the last level reaches.
+    InlineLinkedList<Timer> overflow;
+
+    // The first wheel tick whose timers haven't fired yet.
+    u64 current_tick { 0 };
+    size_t timer_count { 0 };
+};
+
+// Every processor whose timer ticks drive TimerQueue::fire() has its own wheels,
+// and timers are added to the wheels of the processor they're added on. Other
+// processors share the boot processor's wheels.
+struct TimerQueuePerProcessorData {
+    SpinLock<u8> lock;
+    u32 processor_id { 0 };
+    TimerWheel monotonic_wheel;
+    TimerWheel realtime_wheel;
+    InlineLinkedList<Timer> timers_executing;
+    HashMap<TimerId, Timer*> timers_by_id;
+    u64 timer_id_count { 0 };
+};
+
 class TimerQueue {
     friend class Timer;
 
@@ -90,6 +135,10 @@ public:
     TimerQueue();
     static TimerQueue& the();
 
+    // Gives the current processor its own timer wheels. Only call this
+    // on processors that call fire() on their own timer ticks.
+    void initialize_processor();
+
     TimerId add_timer(NonnullRefPtr<Timer>&&);
     RefPtr<Timer> add_timer_without_id(clockid_t, const timespec&, Function<void()>&&);
     TimerId add_timer(clockid_t, timeval& timeout, Function<void()>&& callback);
@@ -102,21 +151,20 @@ public:
     void fire();
 
 private:
-    struct Queue {
-        InlineLinkedList<Timer> list;
-        u64 next_timer_due { 0 };
-    };
-    void remove_timer_locked(Queue&, Timer&);
-    void update_next_timer_due(Queue&);
-    void add_timer_locked(NonnullRefPtr<Timer>);
-
-    Queue& queue_for_timer(Timer& timer)
+    TimerQueuePerProcessorData& data_for_current_processor();
+    void remove_timer_locked(Timer&);
+    void add_timer_locked(TimerQueuePerProcessorData&, NonnullRefPtr<Timer>);
+    void add_to_wheel(TimerWheel&, Timer&);
+    void rebuild_wheel(TimerWheel&, u64 now_tick, InlineLinkedList<Timer>& due_timers);
+    void advance_wheel(TimerWheel&, u64 now_tick, InlineLinkedList<Timer>& due_timers);
+
+    TimerWheel& wheel_for_timer(TimerQueuePerProcessorData& data, Timer& timer)
     {
         switch (timer.m_clock_id) {
         case CLOCK_MONOTONIC:
-            return m_timer_queue_monotonic;
+            return data.monotonic_wheel;
         case CLOCK_REALTIME:
-            return m_timer_queue_realtime;
+            return data.realtime_wheel;
         default:
             ASSERT_NOT_REACHED();
         }
@@ -124,12 +172,10 @@ private:
 
     timespec ticks_to_time(clockid_t, u64 ticks) const;
     u64 time_to_ticks(clockid_t, const timespec&) const;
+    u64 wheel_tick(clockid_t, u64 ticks) const;
 
-    u64 m_timer_id_count { 0 };
     u64 m_ticks_per_second { 0 };
-    Queue m_timer_queue_monotonic;
-    Queue m_timer_queue_realtime;
-    InlineLinkedList<Timer> m_timers_executing;
+    TimerQueuePerProcessorData* m_boot_processor_data { nullptr };
 };
 
 }
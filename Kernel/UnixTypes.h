@@ -45,6 +45,10 @@
 #define O_CLOEXEC (1 << 11)
 #define O_DIRECT (1 << 12)
 
+#define SPLICE_F_MOVE (1u << 0)
+#define SPLICE_F_NONBLOCK (1u << 1)
+#define SPLICE_F_MORE (1u << 2)
+
 // Kernel internal options.
 #define O_NOFOLLOW_NOERROR (1 << 29)
 #define O_UNLINK_INTERNAL (1 << 30)
@@ -111,11 +115,26 @@ enum {
 #define F_GETFL 3
 #define F_SETFL 4
 #define F_ISTTY 5
+#define F_SETPIPE_SZ 8
+#define F_GETPIPE_SZ 9
 
 #define FD_CLOEXEC 1
 
 #define FUTEX_WAIT 1
 #define FUTEX_WAKE 2
+#define FUTEX_REQUEUE 3
+#define FUTEX_CMP_REQUEUE 4
+#define FUTEX_LOCK_PI 6
+#define FUTEX_UNLOCK_PI 7
+#define FUTEX_TRYLOCK_PI 8
+#define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
+
+#define FUTEX_BITSET_MATCH_ANY 0xffffffff
+
+// For PI futexes, the futex word holds the owner's thread id and these flags.
+#define FUTEX_WAITERS 0x80000000
+#define FUTEX_TID_MASK 0x3fffffff
 
 #define S_IFMT 0170000
 #define S_IFDIR 0040000
@@ -441,6 +460,33 @@ struct pollfd {
     short revents;
 };
 
+#define EPOLLIN (1u << 0)
+#define EPOLLPRI (1u << 1)
+#define EPOLLOUT (1u << 2)
+#define EPOLLERR (1u << 3)
+#define EPOLLHUP (1u << 4)
+#define EPOLLRDHUP (1u << 13)
+#define EPOLLONESHOT (1u << 30)
+#define EPOLLET (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_CLOEXEC O_CLOEXEC
+
+typedef union epoll_data {
+    void* ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event {
+    uint32_t events;
+    epoll_data_t data;
+};
+
 #define AF_MASK 0xff
 #define AF_UNSPEC 0
 #define AF_LOCAL 1
@@ -51,6 +51,14 @@ NonnullRefPtr<AnonymousVMObject> AnonymousVMObject::create_with_physical_page(Ph
     return vmobject;
 }
 
+NonnullRefPtr<AnonymousVMObject> AnonymousVMObject::create_with_physical_pages(NonnullRefPtrVector<PhysicalPage>& pages)
+{
+    auto vmobject = create_with_size(pages.size() * PAGE_SIZE);
+    for (size_t i = 0; i < pages.size(); ++i)
+        vmobject->m_physical_pages[i] = pages[i];
+    return vmobject;
+}
+
 AnonymousVMObject::AnonymousVMObject(size_t size)
     : VMObject(size)
 {
@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <AK/NonnullRefPtrVector.h>
 #include <Kernel/PhysicalAddress.h>
 #include <Kernel/VM/VMObject.h>
 
@@ -38,6 +39,7 @@ public:
     static NonnullRefPtr<AnonymousVMObject> create_with_size(size_t);
     static RefPtr<AnonymousVMObject> create_for_physical_range(PhysicalAddress, size_t);
     static NonnullRefPtr<AnonymousVMObject> create_with_physical_page(PhysicalPage&);
+    static NonnullRefPtr<AnonymousVMObject> create_with_physical_pages(NonnullRefPtrVector<PhysicalPage>&);
     virtual NonnullRefPtr<VMObject> clone() override;
 
 protected:
@@ -25,8 +25,10 @@
  */
 
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/KBuffer.h>
 #include <Kernel/VM/InodeVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <Kernel/VM/Region.h>
 
 namespace Kernel {
@@ -72,6 +74,64 @@ size_t InodeVMObject::amount_dirty() const
     return count * PAGE_SIZE;
 }
 
+size_t InodeVMObject::read_ahead(size_t first_page, size_t page_count)
+{
+    OwnPtr<KBuffer> page_buffer;
+    size_t pages_read = 0;
+
+    for (size_t page_index = first_page; page_index < first_page + page_count; ++page_index) {
+        u32 generation;
+        {
+            ScopedSpinLock lock(s_mm_lock);
+            if (page_index >= this->page_count())
+                break;
+            if (m_physical_pages[page_index])
+                continue;
+            generation = m_contents_generation;
+        }
+
+        // Read without holding s_mm_lock so page faults can proceed meanwhile.
+        // Filesystems with a page cache read straight into the page we'll map.
+        RefPtr<PhysicalPage> page = m_inode->cached_page(page_index);
+        if (!page) {
+            if (!page_buffer) {
+                page_buffer = KBuffer::try_create_with_size(PAGE_SIZE, Region::Access::Read | Region::Access::Write, "InodeVMObject readahead");
+                if (!page_buffer)
+                    break;
+            }
+            auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer->data());
+            auto nread = m_inode->read_bytes(page_index * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
+            if (nread <= 0)
+                break;
+            if (nread < PAGE_SIZE)
+                memset(page_buffer->data() + nread, 0, PAGE_SIZE - nread);
+        }
+
+        ScopedSpinLock lock(s_mm_lock);
+        // Someone else may have faulted the page in or written to the inode while we were reading.
+        if (page_index >= this->page_count() || generation != m_contents_generation)
+            break;
+        if (m_physical_pages[page_index])
+            continue;
+
+        if (!page) {
+            page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
+            if (!page)
+                break;
+            u8* dest_ptr = MM.quickmap_page(*page);
+            memcpy(dest_ptr, page_buffer->data(), PAGE_SIZE);
+            MM.unquickmap_page();
+        }
+
+        m_physical_pages[page_index] = move(page);
+        ++pages_read;
+    }
+
+    ScopedSpinLock lock(s_mm_lock);
+    MM.m_readahead_pages += pages_read;
+    return pages_read;
+}
+
 void InodeVMObject::inode_size_changed(Badge<Inode>, size_t old_size, size_t new_size)
 {
     dbg() << "VMObject::inode_size_changed: {" << m_inode->fsid() << ":" << m_inode->index() << "} " << old_size << " -> " << new_size;
@@ -94,6 +154,8 @@ void InodeVMObject::inode_contents_changed(Badge<Inode>, off_t offset, [[maybe_u
     InterruptDisabler disabler;
     ASSERT(offset >= 0);
 
+    m_contents_generation++;
+
     // FIXME: Only invalidate the parts that actually changed.
     for (auto& physical_page : m_physical_pages)
         physical_page = nullptr;
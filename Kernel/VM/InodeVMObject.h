@@ -47,6 +47,8 @@ public:
 
     int release_all_clean_pages();
 
+    size_t read_ahead(size_t first_page, size_t page_count);
+
     u32 writable_mappings() const;
     u32 executable_mappings() const;
 
@@ -64,6 +66,7 @@ protected:
 
     NonnullRefPtr<Inode> m_inode;
     Bitmap m_dirty_pages;
+    u32 m_contents_generation { 0 };
 };
 
 }
@@ -37,6 +37,7 @@
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/ContiguousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/PhysicalRegion.h>
 #include <Kernel/VM/PurgeableVMObject.h>
@@ -75,7 +76,7 @@ MemoryManager::MemoryManager()
     ScopedSpinLock lock(s_mm_lock);
     m_kernel_page_directory = PageDirectory::create_kernel_page_directory();
     parse_memory_map();
-    write_cr3(kernel_page_directory().cr3());
+    Processor::current().load_cr3(kernel_page_directory().cr3());
     protect_kernel_image();
 
     m_shared_zero_page = allocate_user_physical_page();
@@ -382,7 +383,10 @@ PageFaultResponse MemoryManager::handle_page_fault(const PageFault& fault)
         return PageFaultResponse::ShouldCrash;
     }
 
-    return region->handle_fault(fault);
+    auto start = read_tsc();
+    auto response = region->handle_fault(fault);
+    m_page_fault_latency.add(read_tsc() - start);
+    return response;
 }
 
 OwnPtr<Region> MemoryManager::allocate_contiguous_kernel_region(size_t size, const StringView& name, u8 access, bool user_accessible, bool cacheable)
@@ -469,23 +473,94 @@ OwnPtr<Region> MemoryManager::allocate_kernel_region_with_vmobject(VMObject& vmo
     return allocate_kernel_region_with_vmobject(range, vmobject, name, access, user_accessible, cacheable);
 }
 
-void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+PhysicalRegion* MemoryManager::user_physical_region_for(PhysicalAddress paddr)
 {
-    ScopedSpinLock lock(s_mm_lock);
     for (auto& region : m_user_physical_regions) {
-        if (!region.contains(page)) {
-            klog() << "MM: deallocate_user_physical_page: " << page.paddr() << " not in " << region.lower() << " -> " << region.upper();
-            continue;
+        if (region.contains(paddr))
+            return &region;
+    }
+    return nullptr;
+}
+
+void MemoryManager::deallocate_user_physical_page(const PhysicalPage& page)
+{
+    --m_user_physical_pages_used;
+
+    {
+        auto& mm_data = get_data();
+        ScopedSpinLock cache_lock(mm_data.m_user_page_cache_lock);
+        if (mm_data.m_user_page_cache_count < MemoryManagerData::user_page_cache_size) {
+            mm_data.m_user_page_cache[mm_data.m_user_page_cache_count++] = page.paddr();
+            return;
         }
+    }
 
-        region.return_page(page);
-        --m_user_physical_pages_used;
+    // This processor's cache is full. Give the page back along with half of
+    // the cache, so we don't come back here on the very next free.
+    ScopedSpinLock lock(s_mm_lock);
+    auto* region = user_physical_region_for(page.paddr());
+    if (!region) {
+        klog() << "MM: deallocate_user_physical_page couldn't figure out region for user page @ " << page.paddr();
+        ASSERT_NOT_REACHED();
+    }
+    region->return_page(page);
+    drain_user_page_cache(get_data(), MemoryManagerData::user_page_cache_size / 2);
+}
 
-        return;
+size_t MemoryManager::drain_user_page_cache(MemoryManagerData& mm_data, size_t count)
+{
+    ASSERT(s_mm_lock.own_lock());
+    ScopedSpinLock cache_lock(mm_data.m_user_page_cache_lock);
+    size_t drained = 0;
+    while (drained < count && mm_data.m_user_page_cache_count > 0) {
+        auto paddr = mm_data.m_user_page_cache[--mm_data.m_user_page_cache_count];
+        auto* region = user_physical_region_for(paddr);
+        ASSERT(region);
+        region->return_page(paddr);
+        drained++;
     }
+    return drained;
+}
 
-    klog() << "MM: deallocate_user_physical_page couldn't figure out region for user page @ " << page.paddr();
-    ASSERT_NOT_REACHED();
+size_t MemoryManager::drain_user_page_caches()
+{
+    ASSERT(s_mm_lock.own_lock());
+    size_t drained = 0;
+    Processor::for_each([&](Processor& processor) {
+        if (processor.has_mm_data())
+            drained += drain_user_page_cache(processor.get_mm_data(), MemoryManagerData::user_page_cache_size);
+        return IterationDecision::Continue;
+    });
+    return drained;
+}
+
+void MemoryManager::refill_user_page_cache()
+{
+    ASSERT(s_mm_lock.own_lock());
+    auto& mm_data = get_data();
+    ScopedSpinLock cache_lock(mm_data.m_user_page_cache_lock);
+    for (auto& region : m_user_physical_regions) {
+        while (mm_data.m_user_page_cache_count < MemoryManagerData::user_page_cache_size / 2) {
+            auto paddr = region.take_free_page_address();
+            if (!paddr.has_value())
+                break;
+            mm_data.m_user_page_cache[mm_data.m_user_page_cache_count++] = paddr.value();
+        }
+    }
+}
+
+RefPtr<PhysicalPage> MemoryManager::take_cached_user_physical_page()
+{
+    PhysicalAddress paddr;
+    {
+        auto& mm_data = get_data();
+        ScopedSpinLock cache_lock(mm_data.m_user_page_cache_lock);
+        if (mm_data.m_user_page_cache_count == 0)
+            return nullptr;
+        paddr = mm_data.m_user_page_cache[--mm_data.m_user_page_cache_count];
+    }
+    // Creating the PhysicalPage may allocate, so don't hold the cache lock for it.
+    return PhysicalPage::create(paddr, false);
 }
 
 RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page()
@@ -500,12 +575,107 @@ RefPtr<PhysicalPage> MemoryManager::find_free_user_physical_page()
     return page;
 }
 
-RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge)
+RefPtr<PhysicalPage> MemoryManager::take_zeroed_user_physical_page()
+{
+    ASSERT(s_mm_lock.is_locked());
+    if (m_zeroed_user_page_count == 0)
+        return nullptr;
+    return move(m_zeroed_user_pages[--m_zeroed_user_page_count]);
+}
+
+bool MemoryManager::refill_zeroed_page_pool()
 {
     ScopedSpinLock lock(s_mm_lock);
-    auto page = find_free_user_physical_page();
+    if (m_zeroed_user_page_count >= zeroed_page_pool_size)
+        return false;
+
+    // Don't hoard pages when memory is getting tight.
+    if (m_user_physical_pages - m_user_physical_pages_used < 2 * zeroed_page_pool_size)
+        return false;
+
+    RefPtr<PhysicalPage> page;
+    for (auto& region : m_user_physical_regions) {
+        page = region.take_free_page(false);
+        if (!page.is_null())
+            break;
+    }
+    if (!page)
+        return false;
+
+    auto* ptr = quickmap_page(*page);
+    memset(ptr, 0, PAGE_SIZE);
+    unquickmap_page();
+
+    m_zeroed_user_pages[m_zeroed_user_page_count++] = move(page);
+    return true;
+}
+
+RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill should_zero_fill, bool* did_purge)
+{
+    RefPtr<PhysicalPage> page;
+    bool is_zeroed = false;
     bool purged_pages = false;
 
+    if (should_zero_fill == ShouldZeroFill::Yes) {
+        // Only take the lock when the pool is likely to have something for us.
+        if (m_zeroed_user_page_count > 0) {
+            ScopedSpinLock lock(s_mm_lock);
+            page = take_zeroed_user_physical_page();
+        }
+        is_zeroed = !page.is_null();
+        if (is_zeroed)
+            m_zeroed_page_pool_hits++;
+        else
+            m_zeroed_page_pool_misses++;
+    }
+
+    // The common case: take a page from this processor's cache without
+    // touching s_mm_lock.
+    if (!page)
+        page = take_cached_user_physical_page();
+
+    if (!page)
+        page = allocate_user_physical_page_slow(is_zeroed, purged_pages);
+
+    if (!page)
+        return {};
+
+#ifdef MM_DEBUG
+    dbg() << "MM: allocate_user_physical_page vending " << page->paddr();
+#endif
+
+    if (should_zero_fill == ShouldZeroFill::Yes && !is_zeroed) {
+        InterruptDisabler disabler;
+        auto* ptr = quickmap_page(*page);
+        memset(ptr, 0, PAGE_SIZE);
+        unquickmap_page();
+    }
+
+    if (did_purge)
+        *did_purge = purged_pages;
+
+    ++m_user_physical_pages_used;
+    return page;
+}
+
+RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page_slow(bool& is_zeroed, bool& purged_pages)
+{
+    ScopedSpinLock lock(s_mm_lock);
+
+    refill_user_page_cache();
+    RefPtr<PhysicalPage> page = take_cached_user_physical_page();
+
+    if (!page && drain_user_page_caches() > 0)
+        page = find_free_user_physical_page();
+
+    if (!page) {
+        page = take_zeroed_user_physical_page();
+        is_zeroed = !page.is_null();
+    }
+
+    if (!page && PageCache::the().reclaim(32) > 0)
+        page = find_free_user_physical_page();
+
     if (!page) {
         // We didn't have a single free physical page. Let's try to free something up!
         // First, we look for a purgeable VMObject in the volatile state.
@@ -527,20 +697,6 @@ RefPtr<PhysicalPage> MemoryManager::allocate_user_physical_page(ShouldZeroFill s
         }
     }
 
-#ifdef MM_DEBUG
-    dbg() << "MM: allocate_user_physical_page vending " << page->paddr();
-#endif
-
-    if (should_zero_fill == ShouldZeroFill::Yes) {
-        auto* ptr = quickmap_page(*page);
-        memset(ptr, 0, PAGE_SIZE);
-        unquickmap_page();
-    }
-
-    if (did_purge)
-        *did_purge = purged_pages;
-
-    ++m_user_physical_pages_used;
     return page;
 }
 
@@ -628,7 +784,7 @@ void MemoryManager::enter_process_paging_scope(Process& process)
     ScopedSpinLock lock(s_mm_lock);
 
     current_thread->tss().cr3 = process.page_directory().cr3();
-    write_cr3(process.page_directory().cr3());
+    Processor::current().load_cr3(process.page_directory().cr3());
 }
 
 void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
@@ -639,12 +795,12 @@ void MemoryManager::flush_tlb_local(VirtualAddress vaddr, size_t page_count)
     Processor::flush_tlb_local(vaddr, page_count);
 }
 
-void MemoryManager::flush_tlb(VirtualAddress vaddr, size_t page_count)
+void MemoryManager::flush_tlb(const PageDirectory* page_directory, VirtualAddress vaddr, size_t page_count)
 {
 #ifdef MM_DEBUG
     dbg() << "MM: Flush " << page_count << " pages at " << vaddr;
 #endif
-    Processor::flush_tlb(vaddr, page_count);
+    Processor::flush_tlb(page_directory, vaddr, page_count);
 }
 
 extern "C" PageTableEntry boot_pd3_pt1023[1024];
@@ -73,12 +73,42 @@ struct MemoryManagerData {
 
     PhysicalAddress m_last_quickmap_pd;
     PhysicalAddress m_last_quickmap_pt;
+
+    // Recently freed user pages, handed out again first while they are still
+    // warm in this processor's cache. Only this processor uses the cache, so
+    // its lock is uncontended unless someone drains it because memory ran out.
+    // When both are needed, s_mm_lock is taken first.
+    static constexpr size_t user_page_cache_size = 32;
+    SpinLock<u8> m_user_page_cache_lock;
+    PhysicalAddress m_user_page_cache[user_page_cache_size];
+    size_t m_user_page_cache_count { 0 };
+};
+
+struct PageFaultLatencyHistogram {
+    // Bucket N counts faults that took less than 2^(N + first_bucket_shift)
+    // TSC cycles, the last bucket catches everything slower than that.
+    static constexpr size_t bucket_count = 16;
+    static constexpr size_t first_bucket_shift = 10;
+
+    void add(u64 cycles)
+    {
+        size_t bucket = 0;
+        while (bucket < bucket_count - 1 && cycles >= (1ull << (bucket + first_bucket_shift)))
+            bucket++;
+        buckets[bucket]++;
+        count++;
+    }
+
+    size_t buckets[bucket_count] {};
+    size_t count { 0 };
 };
 
 extern RecursiveSpinLock s_mm_lock;
 
 class MemoryManager {
     AK_MAKE_ETERNAL
+    friend class InodeVMObject;
+    friend class PageCache;
     friend class PageDirectory;
     friend class PhysicalPage;
     friend class PhysicalRegion;
@@ -86,6 +116,7 @@ class MemoryManager {
     friend class VMObject;
     friend OwnPtr<KBuffer> procfs$mm(InodeIdentifier);
     friend OwnPtr<KBuffer> procfs$memstat(InodeIdentifier);
+    friend OwnPtr<KBuffer> procfs$pagefaults(InodeIdentifier);
 
 public:
     static MemoryManager& the();
@@ -115,6 +146,8 @@ public:
     void deallocate_user_physical_page(const PhysicalPage&);
     void deallocate_supervisor_physical_page(const PhysicalPage&);
 
+    bool refill_zeroed_page_pool();
+
     OwnPtr<Region> allocate_contiguous_kernel_region(size_t, const StringView& name, u8 access, bool user_accessible = false, bool cacheable = true);
     OwnPtr<Region> allocate_kernel_region(size_t, const StringView& name, u8 access, bool user_accessible = false, bool should_commit = true, bool cacheable = true);
     OwnPtr<Region> allocate_kernel_region(PhysicalAddress, size_t, const StringView& name, u8 access, bool user_accessible = false, bool cacheable = true);
@@ -177,14 +210,21 @@ private:
     void protect_kernel_image();
     void parse_memory_map();
     static void flush_tlb_local(VirtualAddress, size_t page_count = 1);
-    static void flush_tlb(VirtualAddress, size_t page_count = 1);
+    static void flush_tlb(const PageDirectory*, VirtualAddress, size_t page_count = 1);
 
     static Region* user_region_from_vaddr(Process&, VirtualAddress);
     static Region* kernel_region_from_vaddr(VirtualAddress);
 
     static Region* find_region_from_vaddr(VirtualAddress);
 
+    RefPtr<PhysicalPage> allocate_user_physical_page_slow(bool& is_zeroed, bool& purged_pages);
     RefPtr<PhysicalPage> find_free_user_physical_page();
+    PhysicalRegion* user_physical_region_for(PhysicalAddress);
+    RefPtr<PhysicalPage> take_cached_user_physical_page();
+    void refill_user_page_cache();
+    size_t drain_user_page_cache(MemoryManagerData&, size_t count);
+    size_t drain_user_page_caches();
+    RefPtr<PhysicalPage> take_zeroed_user_physical_page();
     u8* quickmap_page(PhysicalPage&);
     void unquickmap_page();
 
@@ -201,10 +241,27 @@ private:
     RefPtr<PhysicalPage> m_shared_zero_page;
 
     unsigned m_user_physical_pages { 0 };
-    unsigned m_user_physical_pages_used { 0 };
+    Atomic<unsigned> m_user_physical_pages_used { 0 };
     unsigned m_super_physical_pages { 0 };
     unsigned m_super_physical_pages_used { 0 };
 
+    // User pages zeroed ahead of time by the PageZeroingTask. They are taken
+    // out of their regions but still count as available.
+    static constexpr size_t zeroed_page_pool_size = 256;
+    RefPtr<PhysicalPage> m_zeroed_user_pages[zeroed_page_pool_size];
+    size_t m_zeroed_user_page_count { 0 };
+    Atomic<size_t> m_zeroed_page_pool_hits { 0 };
+    Atomic<size_t> m_zeroed_page_pool_misses { 0 };
+
+    PageFaultLatencyHistogram m_page_fault_latency;
+    PageFaultLatencyHistogram m_zero_fault_latency;
+
+    size_t m_inode_faults { 0 };
+    size_t m_inode_faults_resident { 0 };
+    size_t m_fault_around_pages { 0 };
+    size_t m_readahead_requests { 0 };
+    size_t m_readahead_pages { 0 };
+
     NonnullRefPtrVector<PhysicalRegion> m_user_physical_regions;
     NonnullRefPtrVector<PhysicalRegion> m_super_physical_regions;
 
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ScopeGuard.h>
+#include <AK/Singleton.h>
+#include <AK/TemporaryChange.h>
+#include <AK/Vector.h>
+#include <Kernel/StdLib.h>
+#include <Kernel/Time/TimeManagement.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
+
+namespace Kernel {
+
+static AK::Singleton<PageCache> s_the;
+
+PageCache& PageCache::the()
+{
+    return *s_the;
+}
+
+PageCacheEntry* PageCache::find(InodeIdentifier inode, size_t page_index, u8 required_blocks)
+{
+    ASSERT(m_lock.own_lock());
+    bool is_block = inode.index() == 0;
+    auto it = m_entries.find({ inode, page_index });
+    if (it == m_entries.end() || (it->value->valid_blocks & required_blocks) != required_blocks) {
+        if (is_block)
+            m_block_misses++;
+        else
+            m_inode_misses++;
+        return nullptr;
+    }
+    if (is_block)
+        m_block_hits++;
+    else
+        m_inode_hits++;
+    auto& entry = *it->value;
+    m_lru_list.append(entry);
+    return &entry;
+}
+
+PageCacheEntry* PageCache::peek(InodeIdentifier inode, size_t page_index)
+{
+    ASSERT(m_lock.own_lock());
+    auto it = m_entries.find({ inode, page_index });
+    if (it == m_entries.end())
+        return nullptr;
+    return it->value;
+}
+
+PageCacheEntry& PageCache::add(InodeIdentifier inode, size_t page_index, PhysicalPage& page, u8 valid_blocks)
+{
+    ASSERT(m_lock.own_lock());
+    PageCacheKey key { inode, page_index };
+    ASSERT(!m_entries.contains(key));
+    TemporaryChange busy_change(m_busy, true);
+    auto* entry = new PageCacheEntry(key, page);
+    entry->valid_blocks = valid_blocks;
+    m_entries.set(key, entry);
+    m_lru_list.append(*entry);
+    return *entry;
+}
+
+void PageCache::mark_dirty(PageCacheEntry& entry, u8 blocks)
+{
+    ASSERT(m_lock.own_lock());
+    ASSERT((entry.valid_blocks & blocks) == blocks);
+    if (!entry.is_dirty()) {
+        // Counting the page may allocate, don't let that reclaim it.
+        TemporaryChange busy_change(m_busy, true);
+        m_dirty_list.append(entry);
+        m_dirty_page_count++;
+        m_dirty_page_counts.ensure(entry.key.inode.fsid())++;
+        entry.dirty_since_ms = TimeManagement::the().uptime_ms();
+    }
+    entry.dirty_blocks |= blocks;
+    if (entry.under_writeback)
+        entry.redirtied_blocks |= blocks;
+}
+
+void PageCache::mark_clean(PageCacheEntry& entry, u8 blocks)
+{
+    ASSERT(m_lock.own_lock());
+    if (!entry.is_dirty())
+        return;
+    entry.dirty_blocks &= ~blocks;
+    if (!entry.is_dirty()) {
+        m_dirty_list.remove(entry);
+        did_clean_page(entry);
+    }
+}
+
+void PageCache::start_writeback(PageCacheEntry& entry)
+{
+    ASSERT(m_lock.own_lock());
+    ASSERT(!entry.under_writeback);
+    entry.under_writeback = true;
+    entry.redirtied_blocks = 0;
+}
+
+void PageCache::finish_writeback(PageCacheEntry& entry, u8 written_blocks)
+{
+    ASSERT(m_lock.own_lock());
+    ASSERT(entry.under_writeback);
+    entry.under_writeback = false;
+    mark_clean(entry, written_blocks & ~entry.redirtied_blocks);
+    entry.redirtied_blocks = 0;
+}
+
+void PageCache::did_clean_page(const PageCacheEntry& entry)
+{
+    m_dirty_page_count--;
+    auto fsid = entry.key.inode.fsid();
+    auto it = m_dirty_page_counts.find(fsid);
+    ASSERT(it != m_dirty_page_counts.end() && it->value);
+    if (--it->value == 0)
+        m_dirty_page_counts.remove(it);
+}
+
+size_t PageCache::oldest_dirty_entries(u32 fsid, u64 dirtied_before_ms, PageCacheEntry** entries, size_t max_count)
+{
+    ASSERT(m_lock.own_lock());
+    // Pages only join the dirty list when they become dirty, so it's in age order.
+    size_t count = 0;
+    for (auto& entry : m_dirty_list) {
+        if (count == max_count || entry.dirty_since_ms > dirtied_before_ms)
+            break;
+        if (entry.key.inode.fsid() == fsid)
+            entries[count++] = &entry;
+    }
+    return count;
+}
+
+void PageCache::remove(PageCacheEntry& entry)
+{
+    if (entry.is_dirty())
+        did_clean_page(entry);
+    m_entries.remove(entry.key);
+    // Removes the entry from the lists and drops our reference to the page.
+    delete &entry;
+}
+
+void PageCache::invalidate(InodeIdentifier inode, size_t first_page_index, size_t page_count)
+{
+    ASSERT(m_lock.own_lock());
+    TemporaryChange busy_change(m_busy, true);
+    if (page_count <= m_entries.size()) {
+        for (size_t page_index = first_page_index; page_index < first_page_index + page_count; ++page_index) {
+            if (auto* entry = peek(inode, page_index))
+                remove(*entry);
+        }
+        return;
+    }
+
+    Vector<PageCacheEntry*> entries_to_remove;
+    for (auto& it : m_entries) {
+        auto& key = it.key;
+        if (key.inode == inode && key.page_index >= first_page_index && key.page_index - first_page_index < page_count)
+            entries_to_remove.append(it.value);
+    }
+    for (auto* entry : entries_to_remove)
+        remove(*entry);
+}
+
+void PageCache::invalidate_all(u32 fsid)
+{
+    ASSERT(m_lock.own_lock());
+    TemporaryChange busy_change(m_busy, true);
+    Vector<PageCacheEntry*> entries_to_remove;
+    for (auto& it : m_entries) {
+        if (it.key.inode.fsid() == fsid)
+            entries_to_remove.append(it.value);
+    }
+    for (auto* entry : entries_to_remove)
+        remove(*entry);
+}
+
+size_t PageCache::reclaim(size_t page_count)
+{
+    ASSERT(s_mm_lock.own_lock());
+    // Whoever holds our lock may be waiting for s_mm_lock, which we hold.
+    u32 prev_flags;
+    if (!m_lock.try_lock(prev_flags))
+        return 0;
+    ScopeGuard unlock_guard([&] { m_lock.unlock(prev_flags); });
+    // Allocating memory while we're modifying the cache can end up in here,
+    // don't pull the rug out from under ourselves.
+    if (m_busy)
+        return 0;
+    // Walk from the least recently used end, skipping pages that still need
+    // writing back or that are mapped by someone other than us.
+    Vector<PageCacheEntry*, 32> entries_to_remove;
+    for (auto& entry : m_lru_list) {
+        if (entries_to_remove.size() == min(page_count, entries_to_remove.capacity()))
+            break;
+        if (entry.is_dirty() || entry.under_writeback || entry.page->ref_count() > 1)
+            continue;
+        entries_to_remove.append(&entry);
+    }
+    for (auto* entry : entries_to_remove)
+        remove(*entry);
+    m_reclaimed_pages += entries_to_remove.size();
+    return entries_to_remove.size();
+}
+
+void PageCache::read_from_page(const PageCacheEntry& entry, size_t offset, u8* data, size_t size)
+{
+    read_from_page(const_cast<PhysicalPage&>(*entry.page), offset, data, size);
+}
+
+void PageCache::read_from_page(PhysicalPage& page, size_t offset, u8* data, size_t size)
+{
+    ASSERT(offset + size <= PAGE_SIZE);
+    InterruptDisabler disabler;
+    auto* ptr = MM.quickmap_page(page);
+    memcpy(data, ptr + offset, size);
+    MM.unquickmap_page();
+}
+
+void PageCache::write_to_page(PageCacheEntry& entry, size_t offset, const u8* data, size_t size)
+{
+    ASSERT(offset + size <= PAGE_SIZE);
+    auto* ptr = MM.quickmap_page(*entry.page);
+    memcpy(ptr + offset, data, size);
+    MM.unquickmap_page();
+}
+
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/HashMap.h>
+#include <AK/IntrusiveList.h>
+#include <AK/NonnullRefPtr.h>
+#include <Kernel/FileSystem/InodeIdentifier.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/VM/PhysicalPage.h>
+
+namespace Kernel {
+
+struct PageCacheKey {
+    InodeIdentifier inode;
+    size_t page_index { 0 };
+
+    bool operator==(const PageCacheKey& other) const { return inode == other.inode && page_index == other.page_index; }
+};
+
+}
+
+namespace AK {
+
+template<>
+struct Traits<Kernel::PageCacheKey> : public GenericTraits<Kernel::PageCacheKey> {
+    static unsigned hash(const Kernel::PageCacheKey& key) { return pair_int_hash(pair_int_hash(key.inode.fsid(), key.inode.index()), key.page_index); }
+};
+
+}
+
+namespace Kernel {
+
+struct PageCacheEntry {
+    PageCacheEntry(const PageCacheKey& key, PhysicalPage& page)
+        : key(key)
+        , page(page)
+    {
+    }
+
+    bool is_dirty() const { return dirty_blocks != 0; }
+
+    IntrusiveListNode lru_list_node;
+    IntrusiveListNode dirty_list_node;
+    PageCacheKey key;
+    NonnullRefPtr<PhysicalPage> page;
+
+    // Block-based filesystems cache their own blocks too, under inode index 0.
+    // Those pages may only have some of their blocks read in, and only some
+    // of those may need writing back. Inode pages are always fully valid.
+    u8 valid_blocks { 0xff };
+    u8 dirty_blocks { 0 };
+
+    // While a page is being written back it stays dirty and can't be reclaimed.
+    // Blocks that are dirtied again meanwhile have to be written again afterwards.
+    bool under_writeback { false };
+    u8 redirtied_blocks { 0 };
+
+    // When the page went from clean to dirty, in milliseconds of uptime.
+    u64 dirty_since_ms { 0 };
+};
+
+// A single cache of file pages keyed by inode and page index, shared by
+// read() and by mmap()ed InodeVMObjects. Clean pages that nobody else has
+// mapped are reclaimed by the MemoryManager when it runs out of memory.
+//
+// Everything in here is protected by the cache's own lock(). An entry pointer
+// is only valid until the lock is dropped or a physical page is allocated,
+// since both may cause the entry to be reclaimed.
+//
+// The MemoryManager reclaims pages with s_mm_lock held, so it only ever tries
+// to take our lock. That way, pages may be allocated and quickmapped while
+// holding it.
+class PageCache {
+    AK_MAKE_ETERNAL
+
+public:
+    static PageCache& the();
+
+    PageCache() { }
+
+    RecursiveSpinLock& lock() { return m_lock; }
+
+    PageCacheEntry* find(InodeIdentifier, size_t page_index, u8 required_blocks = 0xff);
+    PageCacheEntry* peek(InodeIdentifier, size_t page_index);
+    PageCacheEntry& add(InodeIdentifier, size_t page_index, PhysicalPage&, u8 valid_blocks = 0xff);
+
+    void mark_dirty(PageCacheEntry&, u8 blocks);
+    void mark_clean(PageCacheEntry&, u8 blocks);
+
+    void start_writeback(PageCacheEntry&);
+    // Cleans the blocks that were written, unless they were dirtied again since start_writeback().
+    void finish_writeback(PageCacheEntry&, u8 written_blocks);
+
+    // Fills `entries` with up to `max_count` of the filesystem's dirty pages, oldest first,
+    // leaving out any that were dirtied after `dirtied_before_ms`. Returns how many it found.
+    size_t oldest_dirty_entries(u32 fsid, u64 dirtied_before_ms, PageCacheEntry** entries, size_t max_count);
+
+    void invalidate(InodeIdentifier, size_t first_page_index, size_t page_count);
+    void invalidate_all(u32 fsid);
+    size_t reclaim(size_t page_count);
+
+    void read_from_page(const PageCacheEntry&, size_t offset, u8* data, size_t size);
+    // For pages we hold a reference to, so it doesn't matter if they get reclaimed meanwhile.
+    static void read_from_page(PhysicalPage&, size_t offset, u8* data, size_t size);
+    void write_to_page(PageCacheEntry&, size_t offset, const u8* data, size_t size);
+
+    size_t page_count() const { return m_entries.size(); }
+    size_t dirty_page_count() const { return m_dirty_page_count; }
+    size_t dirty_page_count(u32 fsid) const { return m_dirty_page_counts.get(fsid).value_or(0); }
+    size_t inode_hits() const { return m_inode_hits; }
+    size_t inode_misses() const { return m_inode_misses; }
+    size_t block_hits() const { return m_block_hits; }
+    size_t block_misses() const { return m_block_misses; }
+    size_t reclaimed_pages() const { return m_reclaimed_pages; }
+
+private:
+    void remove(PageCacheEntry&);
+    void did_clean_page(const PageCacheEntry&);
+
+    RecursiveSpinLock m_lock;
+    HashMap<PageCacheKey, PageCacheEntry*> m_entries;
+    IntrusiveList<PageCacheEntry, &PageCacheEntry::lru_list_node> m_lru_list;
+    IntrusiveList<PageCacheEntry, &PageCacheEntry::dirty_list_node> m_dirty_list;
+    size_t m_dirty_page_count { 0 };
+    // Each filesystem writes back its own pages, so it has to know how many of them there are.
+    HashMap<u32, size_t> m_dirty_page_counts;
+    size_t m_inode_hits { 0 };
+    size_t m_inode_misses { 0 };
+    size_t m_block_hits { 0 };
+    size_t m_block_misses { 0 };
+    size_t m_reclaimed_pages { 0 };
+    bool m_busy { false };
+};
+
+}
@@ -25,11 +25,11 @@
  */
 
 #include <AK/Bitmap.h>
+#include <AK/Memory.h>
 #include <AK/NonnullRefPtr.h>
 #include <AK/RefPtr.h>
 #include <AK/Vector.h>
 #include <Kernel/Assertions.h>
-#include <Kernel/Random.h>
 #include <Kernel/VM/PhysicalPage.h>
 #include <Kernel/VM/PhysicalRegion.h>
 
@@ -55,6 +55,60 @@ void PhysicalRegion::expand(PhysicalAddress lower, PhysicalAddress upper)
     m_upper = upper;
 }
 
+void PhysicalRegion::FreeList::initialize(size_t block_count)
+{
+    size_t words = max(ceil_div(block_count, (size_t)32), (size_t)1);
+    for (;;) {
+        ASSERT(m_level_count < max_levels);
+        m_levels[m_level_count++].resize(words);
+        if (words == 1)
+            break;
+        words = ceil_div(words, (size_t)32);
+    }
+    for (size_t level = 0; level < m_level_count; level++)
+        fast_u32_fill(m_levels[level].data(), 0, m_levels[level].size());
+}
+
+void PhysicalRegion::FreeList::set(size_t index)
+{
+    ASSERT(!get(index));
+    m_count++;
+    for (size_t level = 0; level < m_level_count; level++) {
+        auto& word = m_levels[level][index / 32];
+        bool was_empty = word == 0;
+        word |= 1u << (index % 32);
+        if (!was_empty)
+            break;
+        index /= 32;
+    }
+}
+
+void PhysicalRegion::FreeList::clear(size_t index)
+{
+    ASSERT(get(index));
+    m_count--;
+    for (size_t level = 0; level < m_level_count; level++) {
+        auto& word = m_levels[level][index / 32];
+        word &= ~(1u << (index % 32));
+        if (word != 0)
+            break;
+        index /= 32;
+    }
+}
+
+Optional<size_t> PhysicalRegion::FreeList::find_first() const
+{
+    if (m_count == 0)
+        return {};
+    size_t index = 0;
+    for (size_t level = m_level_count; level > 0; level--) {
+        auto word = m_levels[level - 1][index];
+        ASSERT(word != 0);
+        index = index * 32 + __builtin_ctz(word);
+    }
+    return index;
+}
+
 unsigned PhysicalRegion::finalize_capacity()
 {
     ASSERT(!m_pages);
@@ -62,90 +116,129 @@ unsigned PhysicalRegion::finalize_capacity()
     m_pages = (m_upper.get() - m_lower.get()) / PAGE_SIZE;
     m_bitmap.grow(m_pages, false);
 
+    for (size_t order = 0; order <= max_order; order++)
+        m_free_lists[order].initialize(m_pages >> order);
+
+    // Carve the region up into the largest naturally aligned blocks we can
+    unsigned index = 0;
+    while (index < m_pages) {
+        size_t order = max_order;
+        while ((index & ((1u << order) - 1)) != 0 || index + (1u << order) > m_pages)
+            order--;
+        m_free_lists[order].set(index >> order);
+        index += 1u << order;
+    }
+
     return size();
 }
 
+static size_t order_for_page_count(size_t count)
+{
+    size_t order = 0;
+    while ((1u << order) < count)
+        order++;
+    return order;
+}
+
+Optional<unsigned> PhysicalRegion::allocate_block(size_t order)
+{
+    ASSERT(order <= max_order);
+    for (size_t current_order = order; current_order <= max_order; current_order++) {
+        auto& free_list = m_free_lists[current_order];
+        auto block = free_list.find_first();
+        if (!block.has_value())
+            continue;
+        free_list.clear(block.value());
+
+        // Split the block, giving back the upper halves
+        unsigned index = block.value() << current_order;
+        while (current_order > order) {
+            current_order--;
+            m_free_lists[current_order].set((index >> current_order) + 1);
+        }
+        return index;
+    }
+    return {};
+}
+
+void PhysicalRegion::free_block(unsigned index, size_t order)
+{
+    while (order < max_order) {
+        auto buddy = index ^ (1u << order);
+        if (buddy + (1u << order) > m_pages)
+            break;
+        auto& free_list = m_free_lists[order];
+        if (!free_list.get(buddy >> order))
+            break;
+        free_list.clear(buddy >> order);
+        index = min(index, buddy);
+        order++;
+    }
+    m_free_lists[order].set(index >> order);
+}
+
 NonnullRefPtrVector<PhysicalPage> PhysicalRegion::take_contiguous_free_pages(size_t count, bool supervisor)
 {
     ASSERT(m_pages);
-    ASSERT(m_used != m_pages);
+    ASSERT(count != 0);
 
     NonnullRefPtrVector<PhysicalPage> physical_pages;
-    physical_pages.ensure_capacity(count);
+    auto order = order_for_page_count(count);
+    if (order > max_order || m_pages - m_used < count)
+        return physical_pages;
+
+    auto block = allocate_block(order);
+    if (!block.has_value())
+        return physical_pages;
 
-    auto first_contiguous_page = find_contiguous_free_pages(count);
+    // Give back the tail of the block that we don't need
+    auto first_page = block.value();
+    for (unsigned index = first_page + count; index < first_page + (1u << order); index++)
+        free_block(index, 0);
 
+    m_bitmap.set_range(first_page, count, true);
+    m_used += count;
+
+    physical_pages.ensure_capacity(count);
     for (size_t index = 0; index < count; index++)
-        physical_pages.append(PhysicalPage::create(m_lower.offset(PAGE_SIZE * (index + first_contiguous_page)), supervisor));
+        physical_pages.append(PhysicalPage::create(m_lower.offset(PAGE_SIZE * (index + first_page)), supervisor));
     return physical_pages;
 }
 
-unsigned PhysicalRegion::find_contiguous_free_pages(size_t count)
-{
-    ASSERT(count != 0);
-    // search from the last page we allocated
-    auto range = find_and_allocate_contiguous_range(count);
-    ASSERT(range.has_value());
-    return range.value();
-}
-
 Optional<unsigned> PhysicalRegion::find_one_free_page()
 {
-    if (m_used == m_pages) {
-        // We know we don't have any free pages, no need to check the bitmap
-        // Check if we can draw one from the return queue
-        if (m_recently_returned.size() > 0) {
-            u8 index = get_fast_random<u8>() % m_recently_returned.size();
-            ptrdiff_t local_offset = m_recently_returned[index].get() - m_lower.get();
-            m_recently_returned.remove(index);
-            ASSERT(local_offset >= 0);
-            ASSERT((FlatPtr)local_offset < (FlatPtr)(m_pages * PAGE_SIZE));
-            return local_offset / PAGE_SIZE;
-        }
+    if (m_used == m_pages)
         return {};
-    }
-    auto free_index = m_bitmap.find_one_anywhere_unset(m_free_hint);
-    if (!free_index.has_value())
+    auto page_index = allocate_block(0);
+    if (!page_index.has_value())
         return {};
 
-    auto page_index = free_index.value();
-    m_bitmap.set(page_index, true);
+    ASSERT(!m_bitmap.get(page_index.value()));
+    m_bitmap.set(page_index.value(), true);
     m_used++;
-    m_free_hint = free_index.value() + 1; // Just a guess
-    if (m_free_hint >= m_bitmap.size())
-        m_free_hint = 0;
     return page_index;
 }
 
-Optional<unsigned> PhysicalRegion::find_and_allocate_contiguous_range(size_t count)
+RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
 {
-    ASSERT(count != 0);
-    size_t found_pages_count = 0;
-    auto first_index = m_bitmap.find_longest_range_of_unset_bits(count, found_pages_count);
-    if (!first_index.has_value())
-        return {};
+    ASSERT(m_pages);
 
-    auto page = first_index.value();
-    if (count == found_pages_count) {
-        m_bitmap.set_range<true>(page, count);
-        m_used += count;
-        m_free_hint = first_index.value() + count + 1; // Just a guess
-        if (m_free_hint >= m_bitmap.size())
-            m_free_hint = 0;
-        return page;
-    }
-    return {};
+    auto free_index = find_one_free_page();
+    if (!free_index.has_value())
+        return nullptr;
+
+    return PhysicalPage::create(m_lower.offset(free_index.value() * PAGE_SIZE), supervisor);
 }
 
-RefPtr<PhysicalPage> PhysicalRegion::take_free_page(bool supervisor)
+Optional<PhysicalAddress> PhysicalRegion::take_free_page_address()
 {
     ASSERT(m_pages);
 
     auto free_index = find_one_free_page();
     if (!free_index.has_value())
-        return nullptr;
+        return {};
 
-    return PhysicalPage::create(m_lower.offset(free_index.value() * PAGE_SIZE), supervisor);
+    return m_lower.offset(free_index.value() * PAGE_SIZE);
 }
 
 void PhysicalRegion::free_page_at(PhysicalAddress addr)
@@ -161,24 +254,23 @@ void PhysicalRegion::free_page_at(PhysicalAddress addr)
     ASSERT((FlatPtr)local_offset < (FlatPtr)(m_pages * PAGE_SIZE));
 
     auto page = (FlatPtr)local_offset / PAGE_SIZE;
+    ASSERT(m_bitmap.get(page));
     m_bitmap.set(page, false);
-    m_free_hint = page; // We know we can find one here for sure
+    free_block(page, 0);
     m_used--;
 }
 
 void PhysicalRegion::return_page(const PhysicalPage& page)
 {
-    auto returned_count = m_recently_returned.size();
-    if (returned_count >= m_recently_returned.capacity()) {
-        // Return queue is full, pick a random entry and free that page
-        // and replace the entry with this page
-        auto& entry = m_recently_returned[get_fast_random<u8>()];
-        free_page_at(entry);
-        entry = page.paddr();
-    } else {
-        // Still filling the return queue, just append it
-        m_recently_returned.append(page.paddr());
-    }
+    return_page(page.paddr());
+}
+
+void PhysicalRegion::return_page(PhysicalAddress paddr)
+{
+    // Free the page right away so it can coalesce with its buddy. Recently
+    // freed user pages are kept warm in MemoryManager's per-processor caches
+    // instead.
+    free_page_at(paddr);
 }
 
 }
@@ -38,6 +38,11 @@ class PhysicalRegion : public RefCounted<PhysicalRegion> {
     AK_MAKE_ETERNAL
 
 public:
+    // Blocks handed out by the buddy allocator are 2^order pages large.
+    // Large enough for a block to span all of physical memory, so no
+    // contiguous allocation that fits in a region is ever out of reach.
+    static constexpr size_t max_order = 20;
+
     static NonnullRefPtr<PhysicalRegion> create(PhysicalAddress lower, PhysicalAddress upper);
     ~PhysicalRegion() { }
 
@@ -47,18 +52,42 @@ public:
     PhysicalAddress lower() const { return m_lower; }
     PhysicalAddress upper() const { return m_upper; }
     unsigned size() const { return m_pages; }
-    unsigned used() const { return m_used - m_recently_returned.size(); }
-    unsigned free() const { return m_pages - m_used + m_recently_returned.size(); }
+    unsigned used() const { return m_used; }
+    unsigned free() const { return m_pages - m_used; }
     bool contains(const PhysicalPage& page) const { return page.paddr() >= m_lower && page.paddr() <= m_upper; }
+    bool contains(PhysicalAddress paddr) const { return paddr >= m_lower && paddr <= m_upper; }
+
+    size_t free_blocks_of_order(size_t order) const { return m_free_lists[order].count(); }
 
     RefPtr<PhysicalPage> take_free_page(bool supervisor);
+    Optional<PhysicalAddress> take_free_page_address();
     NonnullRefPtrVector<PhysicalPage> take_contiguous_free_pages(size_t count, bool supervisor);
     void return_page(const PhysicalPage& page);
+    void return_page(PhysicalAddress);
 
 private:
-    unsigned find_contiguous_free_pages(size_t count);
-    Optional<unsigned> find_and_allocate_contiguous_range(size_t count);
+    class FreeList {
+    public:
+        // A bitmap of free blocks with summary levels on top, each bit in a
+        // level saying whether the corresponding word below it has any bits
+        // set. Finding the lowest free block is O(log n).
+        void initialize(size_t block_count);
+        bool get(size_t index) const { return m_levels[0][index / 32] & (1u << (index % 32)); }
+        void set(size_t index);
+        void clear(size_t index);
+        Optional<size_t> find_first() const;
+        size_t count() const { return m_count; }
+
+    private:
+        static constexpr size_t max_levels = 5;
+        Vector<u32> m_levels[max_levels];
+        size_t m_level_count { 0 };
+        size_t m_count { 0 };
+    };
+
     Optional<unsigned> find_one_free_page();
+    Optional<unsigned> allocate_block(size_t order);
+    void free_block(unsigned index, size_t order);
     void free_page_at(PhysicalAddress addr);
 
     PhysicalRegion(PhysicalAddress lower, PhysicalAddress upper);
@@ -68,8 +97,7 @@ private:
     unsigned m_pages { 0 };
     unsigned m_used { 0 };
     Bitmap m_bitmap;
-    size_t m_free_hint { 0 };
-    Vector<PhysicalAddress, 256> m_recently_returned;
+    FreeList m_free_lists[max_order + 1];
 };
 
 }
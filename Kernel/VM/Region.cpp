@@ -27,10 +27,13 @@
 #include <AK/Memory.h>
 #include <AK/StringView.h>
 #include <Kernel/FileSystem/Inode.h>
+#include <Kernel/KBuffer.h>
 #include <Kernel/Process.h>
+#include <Kernel/Tasks/ReadaheadTask.h>
 #include <Kernel/Thread.h>
 #include <Kernel/VM/AnonymousVMObject.h>
 #include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VM/PageCache.h>
 #include <Kernel/VM/PageDirectory.h>
 #include <Kernel/VM/Region.h>
 #include <Kernel/VM/SharedInodeVMObject.h>
@@ -126,11 +129,11 @@ bool Region::commit()
         if (!commit(i)) {
             // Flush what we did commit
             if (i > 0)
-                MM.flush_tlb(vaddr(), i + 1);
+                MM.flush_tlb(m_page_directory, vaddr(), i + 1);
             return false;
         }
     }
-    MM.flush_tlb(vaddr(), page_count());
+    MM.flush_tlb(m_page_directory, vaddr(), page_count());
     return true;
 }
 
@@ -267,7 +270,7 @@ bool Region::remap_page(size_t page_index, bool with_flush)
     ASSERT(physical_page(page_index));
     bool success = map_individual_page_impl(page_index);
     if (with_flush)
-        MM.flush_tlb(vaddr_from_page_index(page_index));
+        MM.flush_tlb(m_page_directory, vaddr_from_page_index(page_index));
     return success;
 }
 
@@ -285,7 +288,7 @@ void Region::unmap(ShouldDeallocateVirtualMemoryRange deallocate_range)
         dbg() << "MM: >> Unmapped " << vaddr << " => P" << String::format("%p", page ? page->paddr().get() : 0) << " <<";
 #endif
     }
-    MM.flush_tlb(vaddr(), page_count());
+    MM.flush_tlb(m_page_directory, vaddr(), page_count());
     if (deallocate_range == ShouldDeallocateVirtualMemoryRange::Yes) {
         if (m_page_directory->range_allocator().contains(range()))
             m_page_directory->range_allocator().deallocate(range());
@@ -317,7 +320,7 @@ bool Region::map(PageDirectory& page_directory)
         ++page_index;
     }
     if (page_index > 0) {
-        MM.flush_tlb(vaddr(), page_index);
+        MM.flush_tlb(m_page_directory, vaddr(), page_index);
         return page_index == page_count();
     }
     return false;
@@ -398,6 +401,7 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
     if (current_thread != nullptr)
         current_thread->did_zero_fault();
 
+    auto start = read_tsc();
     auto page = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::Yes);
     if (page.is_null()) {
         klog() << "MM: handle_zero_fault was unable to allocate a physical page";
@@ -412,6 +416,7 @@ PageFaultResponse Region::handle_zero_fault(size_t page_index_in_region)
         klog() << "MM: handle_zero_fault was unable to allocate a page table to map " << page_slot;
         return PageFaultResponse::OutOfMemory;
     }
+    MM.m_zero_fault_latency.add(read_tsc() - start);
     return PageFaultResponse::Continue;
 }
 
@@ -486,30 +491,53 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region)
 #ifdef PAGE_FAULT_DEBUG
         dbg() << ("MM: page_in_from_inode() but page already present. Fine with me!");
 #endif
+        if (inode_vmobject.is_private_inode() && vmobject_physical_page_entry->ref_count() > 1)
+            set_should_cow(page_index_in_region, true);
         if (!remap_page(page_index_in_region))
             return PageFaultResponse::OutOfMemory;
+        MM.m_inode_faults_resident++;
+        fault_around(page_index_in_region);
         return PageFaultResponse::Continue;
     }
 
     auto current_thread = Thread::current();
     if (current_thread)
         current_thread->did_inode_fault();
+    MM.m_inode_faults++;
 
 #ifdef MM_DEBUG
     dbg() << "MM: page_in_from_inode ready to read from inode";
 #endif
 
-    u8 page_buffer[PAGE_SIZE];
     auto& inode = inode_vmobject.inode();
-    auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer);
-    auto nread = inode.read_bytes((first_page_index() + page_index_in_region) * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
+    auto page_index_in_vmobject = first_page_index() + page_index_in_region;
+
+    // If the filesystem keeps its pages in the page cache, map that page
+    // instead of making another copy of it.
+    if (auto page = inode.cached_page(page_index_in_vmobject)) {
+        vmobject_physical_page_entry = move(page);
+        if (inode_vmobject.is_private_inode())
+            set_should_cow(page_index_in_region, true);
+        remap_page(page_index_in_region);
+        fault_around(page_index_in_region);
+        return PageFaultResponse::Continue;
+    }
+
+    auto page_buffer = KBuffer::try_create_with_size(PAGE_SIZE, Region::Access::Read | Region::Access::Write, "Inode fault");
+    if (!page_buffer) {
+        klog() << "MM: handle_inode_fault was unable to allocate a buffer to read into";
+        return PageFaultResponse::OutOfMemory;
+    }
+    auto buffer = UserOrKernelBuffer::for_kernel_buffer(page_buffer->data());
+    auto nread = inode.read_bytes(page_index_in_vmobject * PAGE_SIZE, PAGE_SIZE, buffer, nullptr);
     if (nread < 0) {
         klog() << "MM: handle_inode_fault had error (" << nread << ") while reading!";
         return PageFaultResponse::ShouldCrash;
     }
+
     if (nread < PAGE_SIZE) {
         // If we read less than a page, zero out the rest to avoid leaking uninitialized data.
-        memset(page_buffer + nread, 0, PAGE_SIZE - nread);
+        memset(page_buffer->data() + nread, 0, PAGE_SIZE - nread);
     }
 
     vmobject_physical_page_entry = MM.allocate_user_physical_page(MemoryManager::ShouldZeroFill::No);
@@ -521,7 +549,7 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region)
     u8* dest_ptr = MM.quickmap_page(*vmobject_physical_page_entry);
     {
         void* fault_at;
-        if (!safe_memcpy(dest_ptr, page_buffer, PAGE_SIZE, fault_at)) {
+        if (!safe_memcpy(dest_ptr, page_buffer->data(), PAGE_SIZE, fault_at)) {
             if ((u8*)fault_at >= dest_ptr && (u8*)fault_at <= dest_ptr + PAGE_SIZE)
                 dbg() << "      >> inode fault: error copying data to " << vmobject_physical_page_entry->paddr() << "/" << VirtualAddress(dest_ptr) << ", failed at " << VirtualAddress(fault_at);
             else
@@ -531,7 +559,50 @@ PageFaultResponse Region::handle_inode_fault(size_t page_index_in_region)
     MM.unquickmap_page();
 
     remap_page(page_index_in_region);
+    fault_around(page_index_in_region);
     return PageFaultResponse::Continue;
 }
 
+void Region::fault_around(size_t page_index_in_region)
+{
+    ASSERT(s_mm_lock.own_lock());
+    static constexpr size_t min_window = 4;
+    static constexpr size_t max_window = 32;
+
+    // Grow the window while the region is being faulted in front to back,
+    // and shrink it back down as soon as we see a random access.
+    bool is_sequential = m_fault_around_window && page_index_in_region > m_last_inode_fault_index && page_index_in_region <= m_last_inode_fault_index + m_fault_around_window;
+    if (is_sequential)
+        m_fault_around_window = min(m_fault_around_window * 2, max_window);
+    else
+        m_fault_around_window = min_window;
+    m_last_inode_fault_index = page_index_in_region;
+
+    // Map the pages around the faulting one that are already resident,
+    // so touching them won't fault again.
+    size_t first = page_index_in_region & ~(m_fault_around_window - 1);
+    size_t end = min(first + m_fault_around_window, page_count());
+    for (size_t page_index = first; page_index < end; ++page_index) {
+        if (page_index == page_index_in_region || !physical_page(page_index))
+            continue;
+        {
+            ScopedSpinLock page_lock(m_page_directory->get_lock());
+            auto* pte = MM.pte(*m_page_directory, vaddr_from_page_index(page_index));
+            if (pte && pte->is_present())
+                continue;
+        }
+        if (vmobject().is_private_inode() && physical_page(page_index)->ref_count() > 1)
+            set_should_cow(page_index, true);
+        // The page wasn't mapped before, so there's nothing to flush.
+        if (!remap_page(page_index, false))
+            break;
+        MM.m_fault_around_pages++;
+    }
+
+    if (is_sequential && end < page_count()) {
+        ReadaheadTask::queue(static_cast<InodeVMObject&>(vmobject()), first_page_index() + end, m_fault_around_window);
+        MM.m_readahead_requests++;
+    }
+}
+
 }
@@ -207,6 +207,7 @@ private:
     PageFaultResponse handle_cow_fault(size_t page_index);
     PageFaultResponse handle_inode_fault(size_t page_index);
     PageFaultResponse handle_zero_fault(size_t page_index);
+    void fault_around(size_t page_index);
 
     bool map_individual_page_impl(size_t page_index);
 
@@ -224,6 +225,10 @@ private:
     bool m_mmap : 1 { false };
     bool m_kernel : 1 { false };
     mutable OwnPtr<Bitmap> m_cow_map;
+
+    // Sequential access tracking for inode faults, see fault_around().
+    size_t m_last_inode_fault_index { 0 };
+    size_t m_fault_around_window { 0 };
 };
 
 inline unsigned prot_to_region_access_flags(int prot)
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <Kernel/VirtIO/VirtIO.h>
+
+//#define VIRTIO_DEBUG
+
+namespace Kernel {
+
+#define DEVICE_STATUS_ACKNOWLEDGE 1
+#define DEVICE_STATUS_DRIVER 2
+#define DEVICE_STATUS_DRIVER_OK 4
+#define DEVICE_STATUS_FAILED 128
+
+#define ISR_QUEUE_INTERRUPT 1
+#define ISR_CONFIG_INTERRUPT 2
+
+class VirtIODevice::InterruptHandler final : public IRQHandler {
+public:
+    InterruptHandler(VirtIODevice& device, u8 irq)
+        : IRQHandler(irq)
+        , m_device(device)
+    {
+    }
+
+    virtual const char* purpose() const override { return m_device.m_name; }
+
+private:
+    virtual void handle_irq(const RegisterState&) override { m_device.handle_interrupt(); }
+
+    VirtIODevice& m_device;
+};
+
+bool VirtIODevice::is_virtio_device(PCI::Address address, u16 device_id)
+{
+    auto id = PCI::get_id(address);
+    return id.vendor_id == VIRTIO_PCI_VENDOR_ID && id.device_id == device_id;
+}
+
+VirtIODevice::VirtIODevice(PCI::Address address, const char* name)
+    : m_io_base(PCI::get_BAR0(address) & ~1)
+    , m_name(name)
+{
+    u8 irq = PCI::get_interrupt_line(address);
+    klog() << m_name << ": Found @ " << address << ", I/O base " << m_io_base << ", IRQ " << irq;
+    PCI::enable_bus_mastering(address);
+    m_interrupt_handler = make<InterruptHandler>(*this, irq);
+}
+
+VirtIODevice::~VirtIODevice()
+{
+}
+
+void VirtIODevice::set_status_bit(u8 bit)
+{
+    auto status = m_io_base.offset(DeviceStatus);
+    status.out<u8>(status.in<u8>() | bit);
+}
+
+u32 VirtIODevice::negotiate_features(u32 wanted_features)
+{
+    // Writing zero resets the device.
+    m_io_base.offset(DeviceStatus).out<u8>(0);
+    set_status_bit(DEVICE_STATUS_ACKNOWLEDGE);
+    set_status_bit(DEVICE_STATUS_DRIVER);
+
+    u32 device_features = m_io_base.offset(DeviceFeatures).in<u32>();
+    m_accepted_features = device_features & wanted_features;
+    m_io_base.offset(DriverFeatures).out<u32>(m_accepted_features);
+#ifdef VIRTIO_DEBUG
+    dbg() << m_name << ": Device features " << String::format("%08x", device_features) << ", accepted " << String::format("%08x", m_accepted_features);
+#endif
+    return m_accepted_features;
+}
+
+bool VirtIODevice::setup_queues(u16 count)
+{
+    for (u16 index = 0; index < count; index++) {
+        m_io_base.offset(QueueSelect).out<u16>(index);
+        u16 queue_size = m_io_base.offset(QueueSize).in<u16>();
+        if (queue_size == 0) {
+            klog() << m_name << ": Queue " << index << " doesn't exist";
+            return false;
+        }
+        auto queue = VirtIOQueue::create(queue_size, is_feature_accepted(VIRTIO_F_RING_EVENT_IDX));
+        if (!queue) {
+            klog() << m_name << ": Failed to allocate queue " << index << " with " << queue_size << " entries";
+            return false;
+        }
+        m_io_base.offset(QueueAddress).out<u32>(queue->physical_address().get() / PAGE_SIZE);
+#ifdef VIRTIO_DEBUG
+        dbg() << m_name << ": Queue " << index << " has " << queue_size << " entries @ " << queue->physical_address();
+#endif
+        m_queues.append(queue.release_nonnull());
+    }
+    return true;
+}
+
+void VirtIODevice::notify_queue(u16 index)
+{
+    if (m_queues[index].should_notify())
+        m_io_base.offset(QueueNotify).out<u16>(index);
+}
+
+void VirtIODevice::finish_initialization()
+{
+    set_status_bit(DEVICE_STATUS_DRIVER_OK);
+    m_interrupt_handler->enable_irq();
+}
+
+void VirtIODevice::fail_initialization()
+{
+    set_status_bit(DEVICE_STATUS_FAILED);
+}
+
+void VirtIODevice::handle_interrupt()
+{
+    // Reading the ISR status acknowledges the interrupt.
+    u8 isr = m_io_base.offset(ISRStatus).in<u8>();
+    if (isr & ISR_QUEUE_INTERRUPT) {
+        for (u16 index = 0; index < m_queues.size(); index++)
+            handle_queue_update(index);
+    }
+    if (isr & ISR_CONFIG_INTERRUPT)
+        handle_config_change();
+}
+
+}
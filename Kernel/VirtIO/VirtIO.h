@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/OwnPtr.h>
+#include <AK/Types.h>
+#include <Kernel/IO.h>
+#include <Kernel/Interrupts/IRQHandler.h>
+#include <Kernel/PCI/Access.h>
+#include <Kernel/VirtIO/VirtIOQueue.h>
+
+namespace Kernel {
+
+#define VIRTIO_PCI_VENDOR_ID 0x1af4
+#define VIRTIO_PCI_NETWORK_DEVICE_ID 0x1000
+#define VIRTIO_PCI_BLOCK_DEVICE_ID 0x1001
+
+#define VIRTIO_F_RING_EVENT_IDX (1u << 29)
+
+// A virtio device behind the legacy PCI transport. QEMU's virtio-*-pci
+// devices are transitional, so they all have it.
+//
+// The interrupt handler is a separate object, so subclasses are free to
+// also be a StorageDevice or a NetworkAdapter.
+class VirtIODevice {
+public:
+    virtual ~VirtIODevice();
+
+    static bool is_virtio_device(PCI::Address, u16 device_id);
+
+protected:
+    VirtIODevice(PCI::Address, const char* name);
+
+    // Resets the device and accepts whichever of the wanted features it has.
+    // Returns the accepted ones.
+    u32 negotiate_features(u32 wanted_features);
+    bool is_feature_accepted(u32 feature) const { return m_accepted_features & feature; }
+
+    bool setup_queues(u16 count);
+    VirtIOQueue& queue(u16 index) { return m_queues[index]; }
+
+    // Tells the device about newly supplied buffers, unless it said it
+    // doesn't need to know yet. Called with the queue's lock held.
+    void notify_queue(u16 index);
+
+    void finish_initialization();
+    void fail_initialization();
+
+    u8 config_read8(u32 offset) { return m_io_base.offset(device_config_offset + offset).in<u8>(); }
+    u16 config_read16(u32 offset) { return m_io_base.offset(device_config_offset + offset).in<u16>(); }
+    u32 config_read32(u32 offset) { return m_io_base.offset(device_config_offset + offset).in<u32>(); }
+    u64 config_read64(u32 offset) { return config_read32(offset) | ((u64)config_read32(offset + 4) << 32); }
+
+    // Called from the interrupt handler.
+    virtual void handle_queue_update(u16 queue_index) = 0;
+    virtual void handle_config_change() { }
+
+private:
+    // Legacy (virtio 0.9.5) register layout, without MSI-X.
+    enum Register : u8 {
+        DeviceFeatures = 0x00,
+        DriverFeatures = 0x04,
+        QueueAddress = 0x08,
+        QueueSize = 0x0c,
+        QueueSelect = 0x0e,
+        QueueNotify = 0x10,
+        DeviceStatus = 0x12,
+        ISRStatus = 0x13,
+    };
+    static constexpr u32 device_config_offset = 0x14;
+
+    class InterruptHandler;
+    void handle_interrupt();
+
+    void set_status_bit(u8);
+
+    IOAddress m_io_base;
+    const char* m_name { nullptr };
+    u32 m_accepted_features { 0 };
+    NonnullOwnPtrVector<VirtIOQueue> m_queues;
+    OwnPtr<IRQHandler> m_interrupt_handler;
+};
+
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Memory.h>
+#include <Kernel/Arch/i386/CPU.h>
+#include <Kernel/VM/MemoryManager.h>
+#include <Kernel/VirtIO/VirtIOQueue.h>
+
+namespace Kernel {
+
+#define VIRTQ_DESC_F_NEXT 1
+#define VIRTQ_DESC_F_WRITE 2
+#define VIRTQ_USED_F_NO_NOTIFY 1
+
+// The legacy interface lays out rings with this alignment.
+static constexpr size_t queue_alignment = PAGE_SIZE;
+
+OwnPtr<VirtIOQueue> VirtIOQueue::create(u16 queue_size, bool use_event_index)
+{
+    // Descriptors, then the available ring (flags, index, ring, used_event),
+    // then the used ring (flags, index, ring, available_event).
+    size_t available_offset = sizeof(Descriptor) * queue_size;
+    size_t used_offset = PAGE_ROUND_UP(available_offset + sizeof(u16) * (3 + queue_size));
+    size_t size = used_offset + PAGE_ROUND_UP(sizeof(u16) * 3 + sizeof(UsedElement) * queue_size);
+    static_assert(queue_alignment == PAGE_SIZE);
+
+    auto region = MM.allocate_contiguous_kernel_region(size, "VirtIO Queue", Region::Access::Read | Region::Access::Write);
+    if (!region)
+        return nullptr;
+    auto* queue = new VirtIOQueue(queue_size, use_event_index, region.release_nonnull());
+    queue->m_available_offset = available_offset;
+    queue->m_used_offset = used_offset;
+    return adopt_own(*queue);
+}
+
+VirtIOQueue::VirtIOQueue(u16 queue_size, bool use_event_index, NonnullOwnPtr<Region> region)
+    : m_queue_size(queue_size)
+    , m_use_event_index(use_event_index)
+    , m_region(move(region))
+    , m_free_descriptors(queue_size)
+{
+    memset(m_region->vaddr().as_ptr(), 0, m_region->size());
+    // Free descriptors are chained through their next fields.
+    for (u16 i = 0; i < queue_size; i++)
+        descriptors()[i].next = i + 1 < queue_size ? i + 1 : 0;
+    m_tokens.resize(queue_size);
+}
+
+VirtIOQueue::~VirtIOQueue()
+{
+}
+
+bool VirtIOQueue::supply_buffers(const Buffer* buffers, size_t count, void* token)
+{
+    ASSERT(m_lock.is_locked());
+    ASSERT(count > 0);
+    if (count > m_free_descriptors)
+        return false;
+
+    // The free list is already linked through the next fields, so taking
+    // descriptors off its head in order gives us a ready-made chain.
+    u16 head = m_free_head;
+    u16 descriptor_index = head;
+    for (size_t i = 0; i < count; i++) {
+        auto& descriptor = descriptors()[descriptor_index];
+        descriptor.address = buffers[i].address.get();
+        descriptor.length = buffers[i].length;
+        descriptor.flags = (buffers[i].device_writable ? VIRTQ_DESC_F_WRITE : 0) | (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+        descriptor_index = descriptor.next;
+    }
+    m_free_head = descriptor_index;
+    m_free_descriptors -= count;
+    m_tokens[head] = token;
+
+    auto* ring = available_ring();
+    ring[2 + m_available_index % m_queue_size] = head;
+    // The device may look at the ring as soon as the index moves.
+    memory_barrier();
+    m_available_index++;
+    ring[1] = m_available_index;
+    return true;
+}
+
+bool VirtIOQueue::should_notify()
+{
+    ASSERT(m_lock.is_locked());
+    u16 new_index = m_available_index;
+    u16 old_index = m_last_notified_index;
+    m_last_notified_index = new_index;
+    if (new_index == old_index)
+        return false;
+
+    // Make sure the index update is visible before we look at what the
+    // device asked for, or we could miss a notification it needs.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (m_use_event_index) {
+        u16 event_index = used_ring()[2 + m_queue_size * sizeof(UsedElement) / sizeof(u16)];
+        return (u16)(new_index - event_index - 1) < (u16)(new_index - old_index);
+    }
+    return !(used_ring()[0] & VIRTQ_USED_F_NO_NOTIFY);
+}
+
+bool VirtIOQueue::has_used_buffers() const
+{
+    ASSERT(m_lock.is_locked());
+    return m_last_used_index != used_ring()[1];
+}
+
+bool VirtIOQueue::take_used_buffers(void*& token, u32& length)
+{
+    ASSERT(m_lock.is_locked());
+    if (!has_used_buffers())
+        return false;
+    memory_barrier();
+
+    auto& element = used_elements()[m_last_used_index % m_queue_size];
+    u16 head = element.id;
+    length = element.length;
+    token = m_tokens[head];
+    m_tokens[head] = nullptr;
+    m_last_used_index++;
+
+    // Put the chain back on the free list.
+    size_t count = 1;
+    u16 last = head;
+    while (descriptors()[last].flags & VIRTQ_DESC_F_NEXT) {
+        last = descriptors()[last].next;
+        count++;
+    }
+    descriptors()[last].next = m_free_head;
+    m_free_head = head;
+    m_free_descriptors += count;
+
+    if (m_use_event_index) {
+        // Ask for an interrupt as soon as the device uses anything past
+        // what we've consumed.
+        available_ring()[2 + m_queue_size] = m_last_used_index;
+    }
+    return true;
+}
+
+}
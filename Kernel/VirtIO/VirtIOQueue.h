@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <AK/OwnPtr.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+#include <Kernel/PhysicalAddress.h>
+#include <Kernel/SpinLock.h>
+#include <Kernel/VM/PhysicalPage.h>
+#include <Kernel/VM/Region.h>
+
+namespace Kernel {
+
+// A split virtqueue, laid out the way the legacy PCI transport wants it:
+// descriptor table and available ring first, then the used ring on the next
+// page boundary, all of it physically contiguous.
+class VirtIOQueue {
+    AK_MAKE_NONCOPYABLE(VirtIOQueue);
+    AK_MAKE_NONMOVABLE(VirtIOQueue);
+
+public:
+    struct Buffer {
+        PhysicalAddress address;
+        u32 length { 0 };
+        bool device_writable { false };
+    };
+
+    static OwnPtr<VirtIOQueue> create(u16 queue_size, bool use_event_index);
+    ~VirtIOQueue();
+
+    u16 size() const { return m_queue_size; }
+    PhysicalAddress physical_address() const { return m_region->physical_page(0)->paddr(); }
+    SpinLock<u8>& lock() { return m_lock; }
+
+    size_t free_descriptors() const { return m_free_descriptors; }
+
+    // Makes a chain of buffers available to the device. The token is handed
+    // back by take_used() once the device is done with it. Returns false if
+    // there aren't enough free descriptors. Called with lock() held.
+    bool supply_buffers(const Buffer*, size_t count, void* token);
+
+    // Whether the device wants to be told about the buffers supplied since the
+    // last time we asked. Called with lock() held.
+    bool should_notify();
+
+    // Called with lock() held.
+    bool has_used_buffers() const;
+    bool take_used_buffers(void*& token, u32& length);
+
+private:
+    VirtIOQueue(u16 queue_size, bool use_event_index, NonnullOwnPtr<Region>);
+
+    struct [[gnu::packed]] Descriptor {
+        u64 address;
+        u32 length;
+        u16 flags;
+        u16 next;
+    };
+
+    struct [[gnu::packed]] UsedElement {
+        u32 id;
+        u32 length;
+    };
+
+    Descriptor* descriptors() { return (Descriptor*)m_region->vaddr().as_ptr(); }
+    volatile u16* available_ring() { return (volatile u16*)(m_region->vaddr().as_ptr() + m_available_offset); }
+    volatile u16* used_ring() const { return (volatile u16*)(m_region->vaddr().as_ptr() + m_used_offset); }
+    volatile UsedElement* used_elements() const { return (volatile UsedElement*)(used_ring() + 2); }
+
+    u16 m_queue_size { 0 };
+    bool m_use_event_index { false };
+    size_t m_available_offset { 0 };
+    size_t m_used_offset { 0 };
+    NonnullOwnPtr<Region> m_region;
+
+    u16 m_free_head { 0 };
+    size_t m_free_descriptors { 0 };
+    u16 m_available_index { 0 };
+    u16 m_last_notified_index { 0 };
+    u16 m_last_used_index { 0 };
+    Vector<void*> m_tokens;
+    SpinLock<u8> m_lock;
+};
+
+}
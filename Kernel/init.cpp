@@ -59,6 +59,7 @@
 #include <Kernel/Net/LoopbackAdapter.h>
 #include <Kernel/Net/NetworkTask.h>
 #include <Kernel/Net/RTL8139NetworkAdapter.h>
+#include <Kernel/Net/VirtIONetworkAdapter.h>
 #include <Kernel/PCI/Access.h>
 #include <Kernel/PCI/Initializer.h>
 #include <Kernel/Process.h>
@@ -69,6 +70,8 @@
 #include <Kernel/TTY/PTYMultiplexer.h>
 #include <Kernel/TTY/VirtualConsole.h>
 #include <Kernel/Tasks/FinalizerTask.h>
+#include <Kernel/Tasks/PageZeroingTask.h>
+#include <Kernel/Tasks/ReadaheadTask.h>
 #include <Kernel/Tasks/SyncTask.h>
 #include <Kernel/Time/TimeManagement.h>
 #include <Kernel/VM/MemoryManager.h>
@@ -221,6 +224,8 @@ void init_stage2(void*)
 
     SyncTask::spawn();
     FinalizerTask::spawn();
+    PageZeroingTask::spawn();
+    ReadaheadTask::spawn();
 
     PCI::initialize();
 
@@ -254,6 +259,7 @@ void init_stage2(void*)
 
     E1000NetworkAdapter::detect();
     RTL8139NetworkAdapter::detect();
+    VirtIONetworkAdapter::detect();
 
     LoopbackAdapter::the();
 
@@ -48,6 +48,13 @@ int watch_file(const char* path, size_t path_length)
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
 
+ssize_t splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t length, unsigned flags)
+{
+    Syscall::SC_splice_params params { in_fd, in_offset, out_fd, out_offset, length, flags };
+    int rc = syscall(SC_splice, &params);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
+
 int creat(const char* path, mode_t mode)
 {
     return open(path, O_CREAT | O_WRONLY | O_TRUNC, mode);
@@ -37,6 +37,8 @@ __BEGIN_DECLS
 #define F_GETFL 3
 #define F_SETFL 4
 #define F_ISTTY 5
+#define F_SETPIPE_SZ 8
+#define F_GETPIPE_SZ 9
 
 #define FD_CLOEXEC 1
 
@@ -56,6 +58,10 @@ __BEGIN_DECLS
 #define O_CLOEXEC (1 << 11)
 #define O_DIRECT (1 << 12)
 
+#define SPLICE_F_MOVE (1u << 0)
+#define SPLICE_F_NONBLOCK (1u << 1)
+#define SPLICE_F_MORE (1u << 2)
+
 #define S_IFMT 0170000
 #define S_IFDIR 0040000
 #define S_IFCHR 0020000
@@ -93,6 +99,7 @@ int openat_with_path_length(int dirfd, const char* path, size_t path_length, int
 
 int fcntl(int fd, int cmd, ...);
 int watch_file(const char* path, size_t path_length);
+ssize_t splice(int in_fd, off_t* in_offset, int out_fd, off_t* out_offset, size_t length, unsigned flags);
 
 #define F_RDLCK 0
 #define F_WRLCK 1
@@ -25,6 +25,7 @@
  */
 
 #include <AK/Types.h>
+#include <LibELF/AuxiliaryVector.h>
 #include <assert.h>
 #include <sys/internals.h>
 #include <unistd.h>
@@ -40,8 +41,23 @@ char** environ;
 bool __environ_is_malloced;
 bool __stdio_is_initialized;
 
+static void __auxiliary_vector_init()
+{
+    // The kernel puts the auxiliary vector right after the initial environment.
+    if (!environ || __environ_is_malloced)
+        return;
+    char** env = environ;
+    while (*env)
+        ++env;
+    for (auto* auxvp = (auxv_t*)(env + 1); auxvp->a_type != AT_NULL; ++auxvp) {
+        if (auxvp->a_type == AT_TIME_PAGE)
+            __time_page = (const volatile TimePage*)auxvp->a_un.a_ptr;
+    }
+}
+
 void __libc_init()
 {
+    __auxiliary_vector_init();
     __malloc_init();
     __stdio_init();
 }
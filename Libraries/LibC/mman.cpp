@@ -97,4 +97,10 @@ void* allocate_tls(size_t size)
     }
     return (void*)rc;
 }
+
+int anon_create(size_t size, int options)
+{
+    int rc = syscall(SC_anon_create, size, options);
+    __RETURN_WITH_ERRNO(rc, rc, -1);
+}
 }
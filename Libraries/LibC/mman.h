@@ -62,5 +62,6 @@ int set_mmap_name(void*, size_t, const char*);
 int madvise(void*, size_t, int advice);
 int minherit(void*, size_t, int inherit);
 void* allocate_tls(size_t);
+int anon_create(size_t size, int options);
 
 __END_DECLS
@@ -57,8 +57,23 @@ int set_process_boost(pid_t, int amount);
 
 #define FUTEX_WAIT 1
 #define FUTEX_WAKE 2
-
-int futex(int32_t* userspace_address, int futex_op, int32_t value, const struct timespec* timeout);
+#define FUTEX_REQUEUE 3
+#define FUTEX_CMP_REQUEUE 4
+#define FUTEX_LOCK_PI 6
+#define FUTEX_UNLOCK_PI 7
+#define FUTEX_TRYLOCK_PI 8
+#define FUTEX_WAIT_BITSET 9
+#define FUTEX_WAKE_BITSET 10
+
+#define FUTEX_BITSET_MATCH_ANY 0xffffffff
+
+// For PI futexes, the futex word holds the owner's thread id and these flags.
+#define FUTEX_WAITERS 0x80000000
+#define FUTEX_TID_MASK 0x3fffffff
+
+// For FUTEX_REQUEUE and FUTEX_CMP_REQUEUE, timeout is the maximum number of
+// waiters to requeue, cast to a pointer, as on Linux.
+int futex(int32_t* userspace_address, int futex_op, int32_t value, const struct timespec* timeout, int32_t* userspace_address2, int32_t value3);
 
 #define PURGE_ALL_VOLATILE 0x1
 #define PURGE_ALL_CLEAN_INODE 0x2
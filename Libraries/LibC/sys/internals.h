@@ -32,12 +32,15 @@ __BEGIN_DECLS
 
 typedef void (*AtExitFunction)(void*);
 
+struct TimePage;
+
 extern void __libc_init();
 extern void __malloc_init();
 extern void __stdio_init();
 extern void _init();
 extern bool __environ_is_malloced;
 extern bool __stdio_is_initialized;
+extern const volatile struct TimePage* __time_page;
 
 int __cxa_atexit(AtExitFunction exit_function, void* parameter, void* dso_handle);
 void __cxa_finalize(void* dso_handle);
@@ -24,20 +24,56 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <AK/Atomic.h>
 #include <AK/String.h>
 #include <AK/StringBuilder.h>
 #include <AK/Time.h>
 #include <Kernel/API/Syscall.h>
+#include <Kernel/API/TimePage.h>
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/internals.h>
 #include <sys/time.h>
 #include <sys/times.h>
 #include <time.h>
 
 extern "C" {
 
+const volatile TimePage* __time_page;
+
+// Reads the clock from the time page the kernel shares with us, if it has one.
+// Returns false if the caller has to ask the kernel instead.
+static bool read_clock_from_time_page(clockid_t clock_id, struct timespec* ts)
+{
+    auto* page = __time_page;
+    if (!page || !ts)
+        return false;
+    if (clock_id != CLOCK_MONOTONIC && clock_id != CLOCK_REALTIME)
+        return false;
+
+    for (;;) {
+        u32 sequence = AK::atomic_load(&page->sequence, AK::memory_order_acquire);
+        if (sequence & 1)
+            continue;
+        time_t seconds;
+        long nanoseconds;
+        if (clock_id == CLOCK_MONOTONIC) {
+            seconds = page->monotonic_seconds;
+            nanoseconds = page->monotonic_nanoseconds;
+        } else {
+            seconds = page->realtime_seconds;
+            nanoseconds = page->realtime_nanoseconds;
+        }
+        if (AK::atomic_load(&page->sequence, AK::memory_order_acquire) == sequence) {
+            ts->tv_sec = seconds;
+            ts->tv_nsec = nanoseconds;
+            return true;
+        }
+    }
+}
+
 time_t time(time_t* tloc)
 {
     struct timeval tv;
@@ -57,6 +93,12 @@ int adjtime(const struct timeval* delta, struct timeval* old_delta)
 
 int gettimeofday(struct timeval* __restrict__ tv, void* __restrict__)
 {
+    timespec ts;
+    if (tv && read_clock_from_time_page(CLOCK_REALTIME, &ts)) {
+        TIMESPEC_TO_TIMEVAL(tv, &ts);
+        return 0;
+    }
+
     int rc = syscall(SC_gettimeofday, tv);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
@@ -342,6 +384,9 @@ clock_t clock()
 
 int clock_gettime(clockid_t clock_id, struct timespec* ts)
 {
+    if (read_clock_from_time_page(clock_id, ts))
+        return 0;
+
     int rc = syscall(SC_clock_gettime, clock_id, ts);
     __RETURN_WITH_ERRNO(rc, rc, -1);
 }
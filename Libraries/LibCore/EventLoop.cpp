@@ -46,7 +46,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -80,7 +80,8 @@ static EventLoop* s_main_event_loop;
 static Vector<EventLoop*>* s_event_loop_stack;
 static NeverDestroyed<IDAllocator> s_id_allocator;
 static HashMap<int, NonnullOwnPtr<EventLoopTimer>>* s_timers;
-static HashTable<Notifier*>* s_notifiers;
+static HashMap<int, Vector<Notifier*, 1>>* s_notifiers;
+static int s_event_queue_fd = -1;
 int EventLoop::s_wake_pipe_fds[2];
 HashMap<int, EventLoop::SignalHandlers> EventLoop::s_signal_handlers;
 int EventLoop::s_handling_signal = 0;
@@ -221,13 +222,49 @@ private:
     int m_client_id { -1 };
 };
 
+// The kernel keeps a persistent interest list for us, so all we need to do is
+// tell it when the combined event mask of the notifiers on an fd changes.
+static void update_event_queue_interest(int fd)
+{
+    if (s_event_queue_fd < 0)
+        return;
+
+    u32 events = 0;
+    auto it = s_notifiers->find(fd);
+    if (it != s_notifiers->end()) {
+        for (auto* notifier : it->value) {
+            if (notifier->event_mask() & Notifier::Read)
+                events |= EPOLLIN;
+            if (notifier->event_mask() & Notifier::Write)
+                events |= EPOLLOUT;
+            if (notifier->event_mask() & Notifier::Exceptional)
+                ASSERT_NOT_REACHED();
+        }
+    }
+
+    if (!events) {
+        // The fd may already be closed, in which case the kernel has forgotten about it anyway.
+        epoll_ctl(s_event_queue_fd, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = fd;
+    int rc = epoll_ctl(s_event_queue_fd, EPOLL_CTL_MOD, fd, &event);
+    if (rc < 0 && errno == ENOENT)
+        rc = epoll_ctl(s_event_queue_fd, EPOLL_CTL_ADD, fd, &event);
+    if (rc < 0)
+        perror("EventLoop: epoll_ctl");
+}
+
 EventLoop::EventLoop()
     : m_private(make<Private>())
 {
     if (!s_event_loop_stack) {
         s_event_loop_stack = new Vector<EventLoop*>;
         s_timers = new HashMap<int, NonnullOwnPtr<EventLoopTimer>>;
-        s_notifiers = new HashTable<Notifier*>;
+        s_notifiers = new HashMap<int, Vector<Notifier*, 1>>;
     }
 
     if (!s_main_event_loop) {
@@ -242,6 +279,20 @@ EventLoop::EventLoop()
 
 #endif
         ASSERT(rc == 0);
+
+        s_event_queue_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (s_event_queue_fd < 0) {
+            perror("EventLoop: epoll_create1");
+            ASSERT_NOT_REACHED();
+        }
+        epoll_event wake_event {};
+        wake_event.events = EPOLLIN;
+        wake_event.data.fd = s_wake_pipe_fds[0];
+        rc = epoll_ctl(s_event_queue_fd, EPOLL_CTL_ADD, s_wake_pipe_fds[0], &wake_event);
+        ASSERT(rc == 0);
+        for (auto& it : *s_notifiers)
+            update_event_queue_interest(it.key);
+
         s_event_loop_stack->append(this);
 
         if (!s_rpc_server) {
@@ -528,6 +579,9 @@ void EventLoop::notify_forked(ForkEvent event)
         s_event_loop_stack->clear();
         s_timers->clear();
         s_notifiers->clear();
+        // The event queue is shared with our parent, so let go of it before we touch it.
+        close(s_event_queue_fd);
+        s_event_queue_fd = -1;
         s_signal_handlers.clear();
         s_handling_signal = 0;
         s_next_signal_id = 0;
@@ -542,31 +596,10 @@ void EventLoop::notify_forked(ForkEvent event)
 
 void EventLoop::wait_for_event(WaitMode mode)
 {
-    fd_set rfds;
-    fd_set wfds;
-retry:
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-
-    int max_fd = 0;
-    auto add_fd_to_set = [&max_fd](int fd, fd_set& set) {
-        FD_SET(fd, &set);
-        if (fd > max_fd)
-            max_fd = fd;
-    };
-
-    int max_fd_added = -1;
-    add_fd_to_set(s_wake_pipe_fds[0], rfds);
-    max_fd = max(max_fd, max_fd_added);
-    for (auto& notifier : *s_notifiers) {
-        if (notifier->event_mask() & Notifier::Read)
-            add_fd_to_set(notifier->fd(), rfds);
-        if (notifier->event_mask() & Notifier::Write)
-            add_fd_to_set(notifier->fd(), wfds);
-        if (notifier->event_mask() & Notifier::Exceptional)
-            ASSERT_NOT_REACHED();
-    }
+    static constexpr int max_events_per_wait = 64;
+    epoll_event events[max_events_per_wait];
 
+retry:
     bool queued_events_is_empty;
     {
         LOCKER(m_private->lock);
@@ -593,14 +626,17 @@ retry:
         }
     }
 
-try_select_again:
-    int marked_fd_count = select(max_fd + 1, &rfds, &wfds, nullptr, should_wait_forever ? nullptr : &timeout);
+    // Round up, so we don't spin on timers that are less than a millisecond away.
+    int timeout_ms = should_wait_forever ? -1 : timeout.tv_sec * 1000 + (timeout.tv_usec + 999) / 1000;
+
+try_wait_again:
+    int marked_fd_count = epoll_wait(s_event_queue_fd, events, max_events_per_wait, timeout_ms);
     if (marked_fd_count < 0) {
         int saved_errno = errno;
         if (saved_errno == EINTR) {
             if (m_exit_requested)
                 return;
-            goto try_select_again;
+            goto try_wait_again;
         }
 #ifdef EVENTLOOP_DEBUG
         dbgln("Core::EventLoop::wait_for_event: {} ({}: {})", marked_fd_count, saved_errno, strerror(saved_errno));
@@ -608,7 +644,14 @@ try_select_again:
         // Blow up, similar to Core::safe_syscall.
         ASSERT_NOT_REACHED();
     }
-    if (FD_ISSET(s_wake_pipe_fds[0], &rfds)) {
+
+    bool wake_pipe_is_readable = false;
+    for (int i = 0; i < marked_fd_count; ++i) {
+        if (events[i].data.fd == s_wake_pipe_fds[0])
+            wake_pipe_is_readable = true;
+    }
+
+    if (wake_pipe_is_readable) {
         int wake_events[8];
         auto nread = read(s_wake_pipe_fds[0], wake_events, sizeof(wake_events));
         if (nread < 0) {
@@ -661,13 +704,18 @@ try_select_again:
     if (!marked_fd_count)
         return;
 
-    for (auto& notifier : *s_notifiers) {
-        if (FD_ISSET(notifier->fd(), &rfds)) {
-            if (notifier->event_mask() & Notifier::Event::Read)
+    for (int i = 0; i < marked_fd_count; ++i) {
+        auto& event = events[i];
+        auto it = s_notifiers->find(event.data.fd);
+        if (it == s_notifiers->end())
+            continue;
+        // Like select(), treat errors and hangups as readiness and let read()/write() report them.
+        bool readable = event.events & (EPOLLIN | EPOLLHUP | EPOLLERR);
+        bool writable = event.events & (EPOLLOUT | EPOLLHUP | EPOLLERR);
+        for (auto* notifier : it->value) {
+            if (readable && (notifier->event_mask() & Notifier::Event::Read))
                 post_event(*notifier, make<NotifierReadEvent>(notifier->fd()));
-        }
-        if (FD_ISSET(notifier->fd(), &wfds)) {
-            if (notifier->event_mask() & Notifier::Event::Write)
+            if (writable && (notifier->event_mask() & Notifier::Event::Write))
                 post_event(*notifier, make<NotifierWriteEvent>(notifier->fd()));
         }
     }
@@ -733,12 +781,29 @@ bool EventLoop::unregister_timer(int timer_id)
 
 void EventLoop::register_notifier(Badge<Notifier>, Notifier& notifier)
 {
-    s_notifiers->set(&notifier);
+    auto& notifiers = s_notifiers->ensure(notifier.fd());
+    if (!notifiers.contains_slow(&notifier))
+        notifiers.append(&notifier);
+    update_event_queue_interest(notifier.fd());
 }
 
 void EventLoop::unregister_notifier(Badge<Notifier>, Notifier& notifier)
 {
-    s_notifiers->remove(&notifier);
+    auto it = s_notifiers->find(notifier.fd());
+    if (it == s_notifiers->end())
+        return;
+    it->value.remove_first_matching([&](auto* entry) { return entry == &notifier; });
+    if (it->value.is_empty())
+        s_notifiers->remove(it);
+    update_event_queue_interest(notifier.fd());
+}
+
+void EventLoop::notifier_event_mask_changed(Badge<Notifier>, Notifier& notifier)
+{
+    auto it = s_notifiers->find(notifier.fd());
+    if (it == s_notifiers->end() || !it->value.contains_slow(&notifier))
+        return;
+    update_event_queue_interest(notifier.fd());
 }
 
 void EventLoop::wake()
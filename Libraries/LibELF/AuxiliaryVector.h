@@ -62,6 +62,7 @@ typedef struct
 #define AT_EXECFN 31        /* a_ptr points to file name of executed program */
 #define AT_EXE_BASE 32      /* a_ptr holds base address where main program was loaded into memory */
 #define AT_EXE_SIZE 33      /* a_val holds the size of the main program in memory */
+#define AT_TIME_PAGE 34     /* a_ptr holds address of the kernel's read-only time page */
 
 #ifdef __cplusplus
 #    include <AK/String.h>
@@ -93,7 +94,8 @@ struct AuxiliaryValue {
         HwCap2 = AT_HWCAP2,
         ExecFilename = AT_EXECFN,
         ExeBaseAddress = AT_EXE_BASE,
-        ExeSize = AT_EXE_SIZE
+        ExeSize = AT_EXE_SIZE,
+        TimePage = AT_TIME_PAGE
     };
 
     AuxiliaryValue(Type type, long val)
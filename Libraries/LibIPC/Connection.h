@@ -35,9 +35,13 @@
 #include <LibCore/SyscallUtils.h>
 #include <LibCore/Timer.h>
 #include <LibIPC/Message.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -45,6 +49,24 @@
 
 namespace IPC {
 
+// Messages at least this big don't go through the socket. Instead, their body is put into
+// an anonymous file that is passed to the peer, which maps it and copies it out to decode it.
+static constexpr size_t large_message_threshold = 64 * KiB;
+
+// Sent in place of the message size, followed by the real size, for messages sent that way.
+static constexpr uint32_t large_message_marker = 0xffffffff;
+
+struct ConnectionStatistics {
+    size_t messages_sent { 0 };
+    size_t messages_received { 0 };
+    size_t bytes_sent { 0 };
+    size_t bytes_received { 0 };
+    // Message bytes that were copied through the socket (counted once per side).
+    size_t bytes_copied { 0 };
+    // Message bytes that were handed over in an anonymous file instead.
+    size_t bytes_shared { 0 };
+};
+
 template<typename LocalEndpoint, typename PeerEndpoint>
 class Connection : public Core::Object {
 public:
@@ -58,9 +80,17 @@ public:
             drain_messages_from_peer();
             handle_messages();
         };
+
+        register_property("messages_sent", [this] { return JsonValue((u32)m_statistics.messages_sent); });
+        register_property("messages_received", [this] { return JsonValue((u32)m_statistics.messages_received); });
+        register_property("bytes_sent", [this] { return JsonValue((u32)m_statistics.bytes_sent); });
+        register_property("bytes_received", [this] { return JsonValue((u32)m_statistics.bytes_received); });
+        register_property("bytes_copied", [this] { return JsonValue((u32)m_statistics.bytes_copied); });
+        register_property("bytes_shared", [this] { return JsonValue((u32)m_statistics.bytes_shared); });
     }
 
     pid_t peer_pid() const { return m_peer_pid; }
+    const ConnectionStatistics& statistics() const { return m_statistics; }
 
     template<typename MessageType>
     OwnPtr<MessageType> wait_for_specific_message()
@@ -76,11 +106,20 @@ public:
             return;
 
         auto buffer = message.encode();
-        // Prepend the message size.
         uint32_t message_size = buffer.data.size();
-        buffer.data.prepend(reinterpret_cast<const u8*>(&message_size), sizeof(message_size));
+        bool body_is_shared = false;
 
 #ifdef __serenity__
+        if (message_size >= large_message_threshold) {
+            // The peer picks up the body before decoding the message (and receiving its fds), so it goes first.
+            // If the peer has too many fds queued up already, just send the message the regular way.
+            int body_fd = copy_to_anonymous_file(buffer.data);
+            if (body_fd >= 0) {
+                body_is_shared = sendfd(m_socket->fd(), body_fd) == 0;
+                close(body_fd);
+            }
+        }
+
         for (int fd : buffer.fds) {
             auto rc = sendfd(m_socket->fd(), fd);
             if (rc < 0) {
@@ -93,27 +132,20 @@ public:
             warnln("fd passing is not supported on this platform, sorry :(");
 #endif
 
-        size_t total_nwritten = 0;
-        while (total_nwritten < buffer.data.size()) {
-            auto nwritten = write(m_socket->fd(), buffer.data.data() + total_nwritten, buffer.data.size() - total_nwritten);
-            if (nwritten < 0) {
-                switch (errno) {
-                case EPIPE:
-                    dbg() << *this << "::post_message: Disconnected from peer";
-                    shutdown();
-                    return;
-                case EAGAIN:
-                    dbg() << *this << "::post_message: Peer buffer overflowed";
-                    shutdown();
-                    return;
-                default:
-                    perror("Connection::post_message write");
-                    shutdown();
-                    return;
-                }
-            }
-            total_nwritten += nwritten;
+        if (body_is_shared) {
+            uint32_t header[] = { large_message_marker, message_size };
+            if (!write_to_peer(reinterpret_cast<const u8*>(header), sizeof(header)))
+                return;
+            m_statistics.bytes_shared += message_size;
+        } else {
+            // Prepend the message size.
+            buffer.data.prepend(reinterpret_cast<const u8*>(&message_size), sizeof(message_size));
+            if (!write_to_peer(buffer.data.data(), buffer.data.size()))
+                return;
+            m_statistics.bytes_copied += message_size;
         }
+        ++m_statistics.messages_sent;
+        m_statistics.bytes_sent += message_size;
 
         m_responsiveness_timer->start();
     }
@@ -141,6 +173,101 @@ public:
 
 protected:
     Core::LocalSocket& socket() { return *m_socket; }
+
+    bool write_to_peer(const u8* data, size_t size)
+    {
+        size_t total_nwritten = 0;
+        while (total_nwritten < size) {
+            auto nwritten = write(m_socket->fd(), data + total_nwritten, size - total_nwritten);
+            if (nwritten < 0) {
+                switch (errno) {
+                case EPIPE:
+                    dbg() << *this << "::post_message: Disconnected from peer";
+                    shutdown();
+                    return false;
+                case EAGAIN:
+                    dbg() << *this << "::post_message: Peer buffer overflowed";
+                    shutdown();
+                    return false;
+                default:
+                    perror("Connection::post_message write");
+                    shutdown();
+                    return false;
+                }
+            }
+            total_nwritten += nwritten;
+        }
+        return true;
+    }
+
+#ifdef __serenity__
+    // Returns an fd for a new anonymous file holding `data`, or -1 if we should use the socket instead.
+    static int copy_to_anonymous_file(const Vector<u8, 1024>& data)
+    {
+        size_t file_size = round_up_to_page_size(data.size());
+        int fd = anon_create(file_size, O_CLOEXEC);
+        if (fd < 0) {
+            perror("anon_create");
+            return -1;
+        }
+        auto* mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return -1;
+        }
+        memcpy(mapping, data.data(), data.size());
+        munmap(mapping, file_size);
+        return fd;
+    }
+#endif
+
+    bool receive_message_from_anonymous_file(size_t message_size)
+    {
+#ifdef __serenity__
+        int fd = recvfd(m_socket->fd());
+        if (fd < 0) {
+            perror("recvfd");
+            return false;
+        }
+        size_t file_size = round_up_to_page_size(message_size);
+        auto* mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+        // The peer may still have the file mapped and could change it under us while we decode,
+        // so work from our own copy.
+        auto bytes = ByteBuffer::copy(mapping, message_size);
+        munmap(mapping, file_size);
+        bool decoded = decode_message(bytes);
+        if (decoded)
+            m_statistics.bytes_shared += message_size;
+        return decoded;
+#else
+        (void)message_size;
+        warnln("fd passing is not supported on this platform, sorry :(");
+        return false;
+#endif
+    }
+
+    static size_t round_up_to_page_size(size_t size)
+    {
+        return (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    }
+
+    bool decode_message(ReadonlyBytes bytes)
+    {
+        if (auto message = LocalEndpoint::decode_message(bytes, m_socket->fd())) {
+            m_unprocessed_messages.append(message.release_nonnull());
+        } else if (auto message = PeerEndpoint::decode_message(bytes, m_socket->fd())) {
+            m_unprocessed_messages.append(message.release_nonnull());
+        } else {
+            return false;
+        }
+        return true;
+    }
     void set_peer_pid(pid_t pid) { m_peer_pid = pid; }
 
     template<typename MessageType, typename Endpoint>
@@ -176,16 +303,13 @@ protected:
 
     bool drain_messages_from_peer()
     {
-        Vector<u8> bytes;
-
-        if (!m_unprocessed_bytes.is_empty()) {
-            bytes.append(m_unprocessed_bytes.data(), m_unprocessed_bytes.size());
-            m_unprocessed_bytes.clear();
-        }
+        // Pick up where we left off, and receive straight into the same buffer.
+        Vector<u8> bytes = move(m_unprocessed_bytes);
+        size_t received_bytes = bytes.size();
 
         while (m_socket->is_open()) {
-            u8 buffer[4096];
-            ssize_t nread = recv(m_socket->fd(), buffer, sizeof(buffer), MSG_DONTWAIT);
+            bytes.resize(received_bytes + 4096);
+            ssize_t nread = recv(m_socket->fd(), bytes.data() + received_bytes, 4096, MSG_DONTWAIT);
             if (nread < 0) {
                 if (errno == EAGAIN)
                     break;
@@ -194,13 +318,14 @@ protected:
                 return false;
             }
             if (nread == 0) {
-                if (bytes.is_empty()) {
+                if (received_bytes == 0) {
                     deferred_invoke([this](auto&) { die(); });
                 }
                 return false;
             }
-            bytes.append(buffer, nread);
+            received_bytes += nread;
         }
+        bytes.resize(received_bytes);
 
         if (!bytes.is_empty()) {
             m_responsiveness_timer->stop();
@@ -208,34 +333,49 @@ protected:
         }
 
         size_t index = 0;
-        uint32_t message_size = 0;
-        for (; index + sizeof(message_size) < bytes.size(); index += message_size) {
-            message_size = *reinterpret_cast<uint32_t*>(bytes.data() + index);
+        while (index + sizeof(uint32_t) < bytes.size()) {
+            uint32_t message_size = *reinterpret_cast<uint32_t*>(bytes.data() + index);
+            if (message_size == large_message_marker) {
+                if (bytes.size() - index < 2 * sizeof(uint32_t))
+                    break;
+                message_size = *reinterpret_cast<uint32_t*>(bytes.data() + index + sizeof(uint32_t));
+                index += 2 * sizeof(uint32_t);
+                // We've taken the body fd off the socket, so there's no way to retry this.
+                if (!receive_message_from_anonymous_file(message_size)) {
+                    dbgln("Failed to receive a large message");
+                    shutdown();
+                    return false;
+                }
+                ++m_statistics.messages_received;
+                m_statistics.bytes_received += message_size;
+                continue;
+            }
             if (message_size == 0 || bytes.size() - index - sizeof(uint32_t) < message_size)
                 break;
-            index += sizeof(message_size);
-            auto remaining_bytes = ReadonlyBytes { bytes.data() + index, bytes.size() - index };
-            if (auto message = LocalEndpoint::decode_message(remaining_bytes, m_socket->fd())) {
-                m_unprocessed_messages.append(message.release_nonnull());
-            } else if (auto message = PeerEndpoint::decode_message(remaining_bytes, m_socket->fd())) {
-                m_unprocessed_messages.append(message.release_nonnull());
-            } else {
+            auto remaining_bytes = ReadonlyBytes { bytes.data() + index + sizeof(uint32_t), bytes.size() - index - sizeof(uint32_t) };
+            if (!decode_message(remaining_bytes)) {
                 dbgln("Failed to parse a message");
                 break;
             }
+            index += sizeof(uint32_t) + message_size;
+            ++m_statistics.messages_received;
+            m_statistics.bytes_received += message_size;
+            m_statistics.bytes_copied += message_size;
         }
 
         if (index < bytes.size()) {
             // Sometimes we might receive a partial message. That's okay, just stash away
             // the unprocessed bytes and we'll prepend them to the next incoming message
             // in the next run of this function.
-            auto remaining_bytes = ByteBuffer::copy(bytes.data() + index, bytes.size() - index);
             if (!m_unprocessed_bytes.is_empty()) {
                 dbg() << *this << "::drain_messages_from_peer: Already have unprocessed bytes";
                 shutdown();
                 return false;
             }
-            m_unprocessed_bytes = remaining_bytes;
+            if (index == 0)
+                m_unprocessed_bytes = move(bytes);
+            else
+                m_unprocessed_bytes.append(bytes.data() + index, bytes.size() - index);
         }
 
         if (!m_unprocessed_messages.is_empty()) {
@@ -274,7 +414,8 @@ protected:
 
     RefPtr<Core::Notifier> m_notifier;
     NonnullOwnPtrVector<Message> m_unprocessed_messages;
-    ByteBuffer m_unprocessed_bytes;
+    Vector<u8> m_unprocessed_bytes;
+    ConnectionStatistics m_statistics;
     pid_t m_peer_pid { -1 };
 };
 
@@ -157,12 +157,59 @@ int pthread_sigmask(int how, const sigset_t* set, sigset_t* old_set)
     return 0;
 }
 
+// Normal mutexes use the classic three-state futex lock word:
+// 0 = unlocked, 1 = locked, 2 = locked and there may be threads sleeping on it.
+// Priority-inheriting mutexes store the owner's tid instead, plus FUTEX_WAITERS.
+enum : u32 {
+    MUTEX_UNLOCKED = 0,
+    MUTEX_LOCKED = 1,
+    MUTEX_LOCKED_CONTENDED = 2,
+};
+
+static inline Atomic<u32>& mutex_lock_word(pthread_mutex_t* mutex)
+{
+    return reinterpret_cast<Atomic<u32>&>(mutex->lock);
+}
+
+static inline i32* mutex_futex(pthread_mutex_t* mutex)
+{
+    return reinterpret_cast<i32*>(&mutex->lock);
+}
+
+static void mutex_lock_contended(pthread_mutex_t* mutex)
+{
+    auto& lock = mutex_lock_word(mutex);
+    while (lock.exchange(MUTEX_LOCKED_CONTENDED, AK::memory_order_acquire) != MUTEX_UNLOCKED)
+        futex(mutex_futex(mutex), FUTEX_WAIT, MUTEX_LOCKED_CONTENDED, nullptr, nullptr, 0);
+}
+
+static void mutex_lock_pi(pthread_mutex_t* mutex, pthread_t this_thread)
+{
+    u32 expected = MUTEX_UNLOCKED;
+    if (mutex_lock_word(mutex).compare_exchange_strong(expected, this_thread, AK::memory_order_acquire))
+        return;
+    while (futex(mutex_futex(mutex), FUTEX_LOCK_PI, 0, nullptr, nullptr, 0) < 0) {
+        ASSERT(errno == EINTR);
+    }
+}
+
+static void mutex_unlock_pi(pthread_mutex_t* mutex, pthread_t this_thread)
+{
+    u32 expected = this_thread;
+    if (mutex_lock_word(mutex).compare_exchange_strong(expected, MUTEX_UNLOCKED, AK::memory_order_release))
+        return;
+    // Somebody is waiting; let the kernel pick the next owner and undo our priority boost.
+    int rc = futex(mutex_futex(mutex), FUTEX_UNLOCK_PI, 0, nullptr, nullptr, 0);
+    ASSERT(rc == 0);
+}
+
 int pthread_mutex_init(pthread_mutex_t* mutex, const pthread_mutexattr_t* attributes)
 {
-    mutex->lock = 0;
+    mutex->lock = MUTEX_UNLOCKED;
     mutex->owner = 0;
     mutex->level = 0;
     mutex->type = attributes ? attributes->type : PTHREAD_MUTEX_NORMAL;
+    mutex->protocol = attributes ? attributes->protocol : PTHREAD_PRIO_NONE;
     return 0;
 }
 
@@ -173,36 +220,35 @@ int pthread_mutex_destroy(pthread_mutex_t*)
 
 int pthread_mutex_lock(pthread_mutex_t* mutex)
 {
-    auto& atomic = reinterpret_cast<Atomic<u32>&>(mutex->lock);
     pthread_t this_thread = pthread_self();
-    for (;;) {
-        u32 expected = false;
-        if (!atomic.compare_exchange_strong(expected, true, AK::memory_order_acq_rel)) {
-            if (mutex->type == PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
-                mutex->level++;
-                return 0;
-            }
-            sched_yield();
-            continue;
-        }
-        mutex->owner = this_thread;
-        mutex->level = 0;
+    if (mutex->type == PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
+        mutex->level++;
         return 0;
     }
+    if (mutex->protocol == PTHREAD_PRIO_INHERIT) {
+        mutex_lock_pi(mutex, this_thread);
+    } else {
+        u32 expected = MUTEX_UNLOCKED;
+        if (!mutex_lock_word(mutex).compare_exchange_strong(expected, MUTEX_LOCKED, AK::memory_order_acquire))
+            mutex_lock_contended(mutex);
+    }
+    mutex->owner = this_thread;
+    mutex->level = 0;
+    return 0;
 }
 
 int pthread_mutex_trylock(pthread_mutex_t* mutex)
 {
-    auto& atomic = reinterpret_cast<Atomic<u32>&>(mutex->lock);
-    u32 expected = false;
-    if (!atomic.compare_exchange_strong(expected, true, AK::memory_order_acq_rel)) {
-        if (mutex->type == PTHREAD_MUTEX_RECURSIVE && mutex->owner == pthread_self()) {
-            mutex->level++;
-            return 0;
-        }
-        return EBUSY;
+    pthread_t this_thread = pthread_self();
+    if (mutex->type == PTHREAD_MUTEX_RECURSIVE && mutex->owner == this_thread) {
+        mutex->level++;
+        return 0;
     }
-    mutex->owner = pthread_self();
+    u32 expected = MUTEX_UNLOCKED;
+    u32 desired = mutex->protocol == PTHREAD_PRIO_INHERIT ? (u32)this_thread : MUTEX_LOCKED;
+    if (!mutex_lock_word(mutex).compare_exchange_strong(expected, desired, AK::memory_order_acquire))
+        return EBUSY;
+    mutex->owner = this_thread;
     mutex->level = 0;
     return 0;
 }
@@ -214,13 +260,19 @@ int pthread_mutex_unlock(pthread_mutex_t* mutex)
         return 0;
     }
     mutex->owner = 0;
-    mutex->lock = 0;
+    if (mutex->protocol == PTHREAD_PRIO_INHERIT) {
+        mutex_unlock_pi(mutex, pthread_self());
+        return 0;
+    }
+    if (mutex_lock_word(mutex).exchange(MUTEX_UNLOCKED, AK::memory_order_release) == MUTEX_LOCKED_CONTENDED)
+        futex(mutex_futex(mutex), FUTEX_WAKE, 1, nullptr, nullptr, 0);
     return 0;
 }
 
 int pthread_mutexattr_init(pthread_mutexattr_t* attr)
 {
     attr->type = PTHREAD_MUTEX_NORMAL;
+    attr->protocol = PTHREAD_PRIO_NONE;
     return 0;
 }
 
@@ -239,6 +291,24 @@ int pthread_mutexattr_settype(pthread_mutexattr_t* attr, int type)
     return 0;
 }
 
+int pthread_mutexattr_setprotocol(pthread_mutexattr_t* attr, int protocol)
+{
+    if (!attr)
+        return EINVAL;
+    if (protocol != PTHREAD_PRIO_NONE && protocol != PTHREAD_PRIO_INHERIT)
+        return EINVAL;
+    attr->protocol = protocol;
+    return 0;
+}
+
+int pthread_mutexattr_getprotocol(const pthread_mutexattr_t* attr, int* protocol)
+{
+    if (!attr || !protocol)
+        return EINVAL;
+    *protocol = attr->protocol;
+    return 0;
+}
+
 int pthread_attr_init(pthread_attr_t* attributes)
 {
     auto* impl = new PthreadAttrImpl {};
@@ -473,7 +543,7 @@ int pthread_setschedparam([[maybe_unused]] pthread_t thread, [[maybe_unused]] in
 int pthread_cond_init(pthread_cond_t* cond, const pthread_condattr_t* attr)
 {
     cond->value = 0;
-    cond->previous = 0;
+    cond->mutex = nullptr;
     cond->clockid = attr ? attr->clockid : CLOCK_MONOTONIC;
     return 0;
 }
@@ -483,21 +553,37 @@ int pthread_cond_destroy(pthread_cond_t*)
     return 0;
 }
 
+static inline Atomic<i32>& cond_value(pthread_cond_t* cond)
+{
+    return reinterpret_cast<Atomic<i32>&>(cond->value);
+}
+
 static int cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* abstime)
 {
-    i32 value = cond->value;
-    cond->previous = value;
+    i32 value = cond_value(cond).load(AK::memory_order_relaxed);
+    cond->mutex = mutex;
     pthread_mutex_unlock(mutex);
-    int rc = futex(&cond->value, FUTEX_WAIT, value, abstime);
-    pthread_mutex_lock(mutex);
-    return rc;
+    int rc = futex(&cond->value, FUTEX_WAIT, value, abstime, nullptr, 0);
+    int saved_errno = errno;
+
+    if (mutex->protocol == PTHREAD_PRIO_INHERIT || mutex->type == PTHREAD_MUTEX_RECURSIVE) {
+        pthread_mutex_lock(mutex);
+    } else {
+        // We may have been requeued onto the mutex by pthread_cond_broadcast(), with other waiters
+        // behind us. Take the mutex as contended so that our unlock hands it to the next one.
+        mutex_lock_contended(mutex);
+        mutex->owner = pthread_self();
+        mutex->level = 0;
+    }
+
+    if (rc < 0 && saved_errno == ETIMEDOUT)
+        return ETIMEDOUT;
+    return 0;
 }
 
 int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
 {
-    int rc = cond_wait(cond, mutex, nullptr);
-    ASSERT(rc == 0);
-    return 0;
+    return cond_wait(cond, mutex, nullptr);
 }
 
 int pthread_condattr_init(pthread_condattr_t* attr)
@@ -524,19 +610,28 @@ int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const s
 
 int pthread_cond_signal(pthread_cond_t* cond)
 {
-    u32 value = cond->previous + 1;
-    cond->value = value;
-    int rc = futex(&cond->value, FUTEX_WAKE, 1, nullptr);
-    ASSERT(rc == 0);
+    cond_value(cond).fetch_add(1, AK::memory_order_release);
+    futex(&cond->value, FUTEX_WAKE, 1, nullptr, nullptr, 0);
     return 0;
 }
 
 int pthread_cond_broadcast(pthread_cond_t* cond)
 {
-    u32 value = cond->previous + 1;
-    cond->value = value;
-    int rc = futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr);
-    ASSERT(rc == 0);
+    i32 value = cond_value(cond).fetch_add(1, AK::memory_order_release) + 1;
+    auto* mutex = cond->mutex;
+    if (!mutex || mutex->protocol == PTHREAD_PRIO_INHERIT || mutex->type == PTHREAD_MUTEX_RECURSIVE) {
+        futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        return 0;
+    }
+
+    // Waking everyone would just have them all pile onto the mutex. Wake a single waiter and move
+    // the rest onto the mutex's wait queue instead; each unlock will then release the next one.
+    auto* requeue_count = reinterpret_cast<const struct timespec*>(static_cast<uintptr_t>(INT32_MAX));
+    int rc = futex(&cond->value, FUTEX_CMP_REQUEUE, 1, requeue_count, mutex_futex(mutex), value);
+    if (rc < 0 && errno == EAGAIN) {
+        // Someone changed the condition under our feet; fall back to waking everyone.
+        futex(&cond->value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+    }
     return 0;
 }
 
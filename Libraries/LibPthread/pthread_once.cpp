@@ -65,7 +65,7 @@ int pthread_once(pthread_once_t* self, void (*callback)())
             // anyone.
             break;
         case State::PERFORMING_WITH_WAITERS:
-            futex(self, FUTEX_WAKE, INT_MAX, nullptr);
+            futex(self, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
             break;
         }
 
@@ -95,7 +95,7 @@ int pthread_once(pthread_once_t* self, void (*callback)())
             [[fallthrough]];
         case State::PERFORMING_WITH_WAITERS:
             // Let's wait for it.
-            futex(self, FUTEX_WAIT, state2, nullptr);
+            futex(self, FUTEX_WAIT, state2, nullptr, nullptr, 0);
             // We have been woken up, but that might have been due to a signal
             // or something, so we have to reevaluate. We need acquire ordering
             // here for the same reason as above. Hopefully we'll just see
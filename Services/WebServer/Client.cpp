@@ -35,7 +35,10 @@
 #include <LibCore/File.h>
 #include <LibCore/MimeData.h>
 #include <LibHTTP/HttpRequest.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
@@ -125,10 +128,10 @@ void Client::handle_request(ReadonlyBytes raw_request)
         return;
     }
 
-    send_response(file->read_all(), request, Core::guess_mime_type_based_on_filename(real_path));
+    send_file_response(file->fd(), request, Core::guess_mime_type_based_on_filename(real_path));
 }
 
-void Client::send_response(StringView response, const HTTP::HttpRequest& request, const String& content_type)
+void Client::send_response_header(const String& content_type, size_t content_length)
 {
     StringBuilder builder;
     builder.append("HTTP/1.0 200 OK\r\n");
@@ -136,14 +139,54 @@ void Client::send_response(StringView response, const HTTP::HttpRequest& request
     builder.append("Content-Type: ");
     builder.append(content_type);
     builder.append("\r\n");
+    builder.appendf("Content-Length: %zu\r\n", content_length);
     builder.append("\r\n");
 
     m_socket->write(builder.to_string());
+}
+
+void Client::send_response(StringView response, const HTTP::HttpRequest& request, const String& content_type)
+{
+    send_response_header(content_type, response.length());
     m_socket->write(response);
 
     log_response(200, request);
 }
 
+void Client::send_file_response(int fd, const HTTP::HttpRequest& request, const String& content_type)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("fstat");
+        send_error_response(500, "Internal server error!", request);
+        return;
+    }
+
+    send_response_header(content_type, st.st_size);
+
+    // Let the kernel move the file straight into the socket instead of copying it through our address space.
+    size_t remaining = st.st_size;
+    while (remaining > 0) {
+        ssize_t nsent = sendfile(m_socket->fd(), fd, nullptr, remaining);
+        if (nsent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                pollfd pfd { m_socket->fd(), POLLOUT, 0 };
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            perror("sendfile");
+            break;
+        }
+        if (nsent == 0)
+            break;
+        remaining -= nsent;
+    }
+
+    log_response(200, request);
+}
+
 void Client::send_redirect(StringView redirect_path, const HTTP::HttpRequest& request)
 {
     StringBuilder builder;
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Function.h>
+#include <AK/JsonObject.h>
+#include <AK/JsonValue.h>
+#include <AK/String.h>
+#include <AK/StringBuilder.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/File.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Measures how fast the kernel resolves paths, by calling stat() in a loop.
+//
+// "deep" and "missing" walk the same chain of nested directories again and
+// again, so every component should come out of the dentry cache. "wide" cycles
+// through a few files in one directory, while "thrash" cycles through more files
+// than the dentry cache can hold, so the last component of every path misses
+// and has to be looked up in the filesystem. The difference between "wide" and
+// "thrash" is roughly what the cache saves per path component.
+
+struct DentryCacheStats {
+    u32 hits { 0 };
+    u32 negative_hits { 0 };
+    u32 misses { 0 };
+};
+
+static DentryCacheStats dentry_cache_stats()
+{
+    DentryCacheStats stats;
+    auto file = Core::File::construct("/proc/memstat");
+    if (!file->open(Core::IODevice::OpenMode::ReadOnly))
+        return stats;
+    auto json = JsonValue::from_string(file->read_all());
+    if (!json.has_value() || !json.value().is_object())
+        return stats;
+    auto& object = json.value().as_object();
+    stats.hits = object.get("dentry_cache_hits").to_u32();
+    stats.negative_hits = object.get("dentry_cache_negative_hits").to_u32();
+    stats.misses = object.get("dentry_cache_misses").to_u32();
+    return stats;
+}
+
+static void run(const char* name, int duration_ms, Function<void(u64)> step)
+{
+    auto before = dentry_cache_stats();
+    Core::ElapsedTimer timer;
+    timer.start();
+    u64 count = 0;
+    while (timer.elapsed() < duration_ms)
+        step(count++);
+    auto elapsed_ms = max(timer.elapsed(), 1);
+    auto after = dentry_cache_stats();
+
+    u64 hits = (after.hits - before.hits) + (after.negative_hits - before.negative_hits);
+    u64 lookups = hits + (after.misses - before.misses);
+    printf("%8s %14llu %14llu %9llu%%\n", name, count * 1000 / elapsed_ms, lookups * 1000 / elapsed_ms, lookups ? hits * 100 / lookups : 0);
+}
+
+int main(int argc, char** argv)
+{
+    int duration_ms = 2000;
+    int depth = 8;
+    int wide_count = 256;
+    int thrash_count = 8192;
+    const char* root = "/tmp/path-walk-rate";
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(duration_ms, "Duration of each run in milliseconds", "duration", 'd', "ms");
+    args_parser.add_option(depth, "Number of nested directories in the deep path", "depth", 'n', "count");
+    args_parser.add_option(wide_count, "Number of files to cycle through without thrashing the cache", "wide", 'w', "count");
+    args_parser.add_option(thrash_count, "Number of files to cycle through when thrashing the cache", "thrash", 't', "count");
+    args_parser.add_option(root, "Directory to create the test tree in", "root", 'r', "path");
+    args_parser.parse(argc, argv);
+
+    if (mkdir(root, 0755) < 0) {
+        perror("mkdir");
+        return 1;
+    }
+
+    Vector<String> deep_directories;
+    StringBuilder builder;
+    builder.append(root);
+    for (int i = 0; i < depth; ++i) {
+        builder.appendf("/d%d", i);
+        deep_directories.append(builder.to_string());
+        if (mkdir(deep_directories.last().characters(), 0755) < 0) {
+            perror("mkdir");
+            return 1;
+        }
+    }
+    auto deep_directory = builder.to_string();
+    auto deep_path = String::formatted("{}/file", deep_directory);
+    auto missing_path = String::formatted("{}/missing", deep_directory);
+    int fd = creat(deep_path.characters(), 0644);
+    if (fd < 0) {
+        perror("creat");
+        return 1;
+    }
+    close(fd);
+
+    auto wide_directory = String::formatted("{}/wide", root);
+    if (mkdir(wide_directory.characters(), 0755) < 0) {
+        perror("mkdir");
+        return 1;
+    }
+    Vector<String> wide_paths;
+    for (int i = 0; i < max(wide_count, thrash_count); ++i) {
+        wide_paths.append(String::formatted("{}/f{}", wide_directory, i));
+        fd = creat(wide_paths.last().characters(), 0644);
+        if (fd < 0) {
+            perror("creat");
+            return 1;
+        }
+        close(fd);
+    }
+
+    printf("%8s %14s %14s %10s\n", "test", "stats/s", "components/s", "cache hits");
+
+    struct stat st;
+    run("deep", duration_ms, [&](u64) {
+        stat(deep_path.characters(), &st);
+    });
+    run("missing", duration_ms, [&](u64) {
+        stat(missing_path.characters(), &st);
+    });
+    run("wide", duration_ms, [&](u64 i) {
+        stat(wide_paths[i % wide_count].characters(), &st);
+    });
+    run("thrash", duration_ms, [&](u64 i) {
+        stat(wide_paths[i % thrash_count].characters(), &st);
+    });
+
+    for (auto& path : wide_paths)
+        unlink(path.characters());
+    rmdir(wide_directory.characters());
+    unlink(deep_path.characters());
+    for (size_t i = deep_directories.size(); i > 0; --i)
+        rmdir(deep_directories[i - 1].characters());
+    rmdir(root);
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018-2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// A low priority thread holds a PI mutex that a high priority thread wants,
+// while medium priority threads keep every processor busy. The owner was
+// queued before it inherited the waiter's priority, so unless it's moved to
+// the ready queue for its new priority, the medium priority threads starve it.
+
+static pthread_mutex_t s_mutex;
+static Atomic<bool> s_owner_has_lock;
+static Atomic<bool> s_spinners_running;
+static Atomic<bool> s_done;
+static long s_wait_ms;
+
+static long now_ms()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static pthread_t create_thread(int priority, void* (*entry)(void*))
+{
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    sched_param param { priority };
+    pthread_attr_setschedparam(&attributes, &param);
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, entry, nullptr) != 0) {
+        perror("pthread_create");
+        _exit(1);
+    }
+    pthread_attr_destroy(&attributes);
+    return thread;
+}
+
+static void* owner(void*)
+{
+    pthread_mutex_lock(&s_mutex);
+    s_owner_has_lock = true;
+    while (!s_spinners_running)
+        usleep(1000);
+    // Hold on to the lock for a bit, this is where we get preempted.
+    auto start = now_ms();
+    while (now_ms() - start < 20)
+        ;
+    pthread_mutex_unlock(&s_mutex);
+    return nullptr;
+}
+
+static void* spinner(void*)
+{
+    while (!s_done)
+        ;
+    return nullptr;
+}
+
+int main(int, char**)
+{
+    pthread_mutexattr_t mutex_attributes;
+    pthread_mutexattr_init(&mutex_attributes);
+    pthread_mutexattr_setprotocol(&mutex_attributes, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&s_mutex, &mutex_attributes);
+
+    auto owner_thread = create_thread(10, owner);
+    while (!s_owner_has_lock)
+        usleep(1000);
+
+    // The waiter starts the spinners itself; it doesn't get starved by them.
+    auto waiter_thread = create_thread(90, [](void*) -> void* {
+        long spinner_count = sysconf(_SC_NPROCESSORS_ONLN) * 2;
+        for (long i = 0; i < spinner_count; ++i)
+            pthread_detach(create_thread(50, spinner));
+        s_spinners_running = true;
+
+        auto start = now_ms();
+        pthread_mutex_lock(&s_mutex);
+        s_wait_ms = now_ms() - start;
+        pthread_mutex_unlock(&s_mutex);
+        s_done = true;
+        return nullptr;
+    });
+
+    pthread_join(waiter_thread, nullptr);
+    pthread_join(owner_thread, nullptr);
+
+    if (s_wait_ms > 250) {
+        printf("FAIL: waited %ldms for a lock held for 20ms\n", s_wait_ms);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
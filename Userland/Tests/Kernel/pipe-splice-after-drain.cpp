@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2018-2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Splicing a large run into a pipe that has just been drained used to relink it
+// behind the drained segment, which read() then mistook for EOF.
+
+int main(int, char**)
+{
+    int source[2];
+    int destination[2];
+    if (pipe(source) < 0 || pipe(destination) < 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    char byte = 'x';
+    if (write(destination[1], &byte, 1) != 1 || read(destination[0], &byte, 1) != 1) {
+        perror("drain");
+        return 1;
+    }
+
+    static char data[16384];
+    for (size_t i = 0; i < sizeof(data); ++i)
+        data[i] = (char)i;
+    if (write(source[1], data, sizeof(data)) != (ssize_t)sizeof(data)) {
+        perror("write");
+        return 1;
+    }
+
+    ssize_t nspliced = splice(source[0], nullptr, destination[1], nullptr, sizeof(data), 0);
+    if (nspliced != (ssize_t)sizeof(data)) {
+        printf("FAIL: spliced %zd bytes, expected %zu\n", nspliced, sizeof(data));
+        return 1;
+    }
+
+    static char buffer[sizeof(data)];
+    size_t nread = 0;
+    while (nread < sizeof(buffer)) {
+        ssize_t rc = read(destination[0], buffer + nread, sizeof(buffer) - nread);
+        if (rc <= 0) {
+            printf("FAIL: read returned %zd after %zu bytes\n", rc, nread);
+            return 1;
+        }
+        nread += rc;
+    }
+
+    if (memcmp(buffer, data, sizeof(data)) != 0) {
+        printf("FAIL: spliced data was corrupted\n");
+        return 1;
+    }
+
+    printf("PASS\n");
+    return 0;
+}
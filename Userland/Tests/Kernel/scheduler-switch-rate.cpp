@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/NonnullOwnPtrVector.h>
+#include <AK/String.h>
+#include <AK/Vector.h>
+#include <LibCore/ArgsParser.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/ProcessStatisticsReader.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Measures how fast the scheduler can switch between runnable threads.
+// Every worker does nothing but sched_yield(), so with more runnable
+// threads than CPUs almost every yield ends up being a context switch.
+
+static Atomic<bool> s_stop { false };
+
+struct Worker {
+    pthread_t thread;
+    Atomic<u32> yields { 0 };
+};
+
+static void* run_worker(void* arg)
+{
+    auto& worker = *reinterpret_cast<Worker*>(arg);
+    while (!s_stop.load(AK::MemoryOrder::memory_order_relaxed)) {
+        sched_yield();
+        worker.yields.fetch_add(1, AK::MemoryOrder::memory_order_relaxed);
+    }
+    return nullptr;
+}
+
+static u64 total_yields(const NonnullOwnPtrVector<Worker>& workers)
+{
+    u64 total = 0;
+    for (auto& worker : workers)
+        total += worker.yields.load(AK::MemoryOrder::memory_order_relaxed);
+    return total;
+}
+
+static u64 times_scheduled_for_this_process()
+{
+    auto all_processes = Core::ProcessStatisticsReader::get_all();
+    auto it = all_processes.find(getpid());
+    if (it == all_processes.end())
+        return 0;
+    u64 total = 0;
+    for (auto& thread : it->value.threads)
+        total += thread.times_scheduled;
+    return total;
+}
+
+int main(int argc, char** argv)
+{
+    int duration_ms = 2000;
+    const char* thread_counts_string = "1,2,4,8,16,32,64";
+
+    Core::ArgsParser args_parser;
+    args_parser.add_option(duration_ms, "Duration of each run in milliseconds", "duration", 'd', "ms");
+    args_parser.add_option(thread_counts_string, "Comma-separated list of thread counts", "threads", 't', "counts");
+    args_parser.parse(argc, argv);
+
+    Vector<int> thread_counts;
+    for (auto& count : String(thread_counts_string).split(','))
+        thread_counts.append(atoi(count.characters()));
+
+    auto cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("CPUs: %ld\n", cpu_count);
+    printf("%8s %14s %14s %14s\n", "threads", "yields/s", "switches/s", "switches/s/cpu");
+
+    for (auto thread_count : thread_counts) {
+        if (thread_count <= 0)
+            continue;
+
+        s_stop.store(false);
+        NonnullOwnPtrVector<Worker> workers;
+        for (int i = 0; i < thread_count; ++i)
+            workers.append(make<Worker>());
+
+        for (auto& worker : workers) {
+            if (pthread_create(&worker.thread, nullptr, run_worker, &worker) != 0) {
+                perror("pthread_create");
+                return 1;
+            }
+        }
+
+        // Sample while all workers are alive, joined threads vanish from /proc/all.
+        auto scheduled_before = times_scheduled_for_this_process();
+        auto yields_before = total_yields(workers);
+        Core::ElapsedTimer timer;
+        timer.start();
+        usleep(duration_ms * 1000);
+        auto yields_after = total_yields(workers);
+        auto scheduled_after = times_scheduled_for_this_process();
+        auto elapsed_ms = max(timer.elapsed(), 1);
+
+        s_stop.store(true);
+        for (auto& worker : workers)
+            pthread_join(worker.thread, nullptr);
+
+        u64 switches = scheduled_after - scheduled_before;
+        u64 yields_per_second = (yields_after - yields_before) * 1000 / elapsed_ms;
+        u64 switches_per_second = switches * 1000 / elapsed_ms;
+        printf("%8d %14llu %14llu %14llu\n", thread_count, yields_per_second, switches_per_second, switches_per_second / max(cpu_count, 1L));
+    }
+
+    return 0;
+}
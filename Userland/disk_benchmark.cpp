@@ -44,7 +44,7 @@ struct Result {
 
 static Result average_result(const Vector<Result>& results)
 {
-    Result average;
+    Result average {};
 
     for (auto& res : results) {
         average.write_bps += res.write_bps;
@@ -59,22 +59,25 @@ static Result average_result(const Vector<Result>& results)
 
 static void exit_with_usage(int rc)
 {
-    fprintf(stderr, "Usage: disk_benchmark [-h] [-d directory] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]\n");
+    fprintf(stderr, "Usage: disk_benchmark [-h] [-c] [-d directory | -r path] [-t time_per_benchmark] [-f file_size1,file_size2,...] [-b block_size1,block_size2,...]\n");
+    fprintf(stderr, "  -r path  Only measure sequential reads from an existing file or block device (e.g. /dev/hda)\n");
     exit(rc);
 }
 
 static Result benchmark(const String& filename, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache);
+static Result benchmark_read_only(const String& path, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache);
 
 int main(int argc, char** argv)
 {
     char* directory = strdup(".");
+    char* read_only_path = nullptr;
     int time_per_benchmark = 10;
     Vector<int> file_sizes;
     Vector<int> block_sizes;
     bool allow_cache = false;
 
     int opt;
-    while ((opt = getopt(argc, argv, "chd:t:f:b:")) != -1) {
+    while ((opt = getopt(argc, argv, "chd:r:t:f:b:")) != -1) {
         switch (opt) {
         case 'h':
             exit_with_usage(0);
@@ -85,6 +88,9 @@ int main(int argc, char** argv)
         case 'd':
             directory = strdup(optarg);
             break;
+        case 'r':
+            read_only_path = strdup(optarg);
+            break;
         case 't':
             time_per_benchmark = atoi(optarg);
             break;
@@ -125,7 +131,10 @@ int main(int argc, char** argv)
             while (timer.elapsed() < time_per_benchmark * 1000) {
                 printf(".");
                 fflush(stdout);
-                results.append(benchmark(filename, file_size, block_size, buffer, allow_cache));
+                if (read_only_path)
+                    results.append(benchmark_read_only(read_only_path, file_size, block_size, buffer, allow_cache));
+                else
+                    results.append(benchmark(filename, file_size, block_size, buffer, allow_cache));
                 usleep(100);
             }
             auto average = average_result(results);
@@ -206,3 +215,46 @@ Result benchmark(const String& filename, int file_size, int block_size, ByteBuff
 
     return res;
 }
+
+Result benchmark_read_only(const String& path, int file_size, int block_size, ByteBuffer& buffer, bool allow_cache)
+{
+    int flags = O_RDONLY;
+    if (!allow_cache)
+        flags |= O_DIRECT;
+
+    int fd = open(path.characters(), flags);
+    if (fd == -1) {
+        perror("open");
+        exit(1);
+    }
+
+    Result res {};
+
+    Core::ElapsedTimer timer;
+
+    timer.start();
+    int nread = 0;
+    while (nread < file_size) {
+        int n = read(fd, buffer.data(), min(block_size, file_size - nread));
+        if (n < 0) {
+            perror("read");
+            close(fd);
+            exit(1);
+        }
+        if (n == 0) {
+            fprintf(stderr, "%s is smaller than %d bytes\n", path.characters(), file_size);
+            close(fd);
+            exit(1);
+        }
+        nread += n;
+    }
+
+    res.read_bps = (u64)(timer.elapsed() ? (file_size / timer.elapsed()) : file_size) * 1000;
+
+    if (close(fd) != 0) {
+        perror("close");
+        exit(1);
+    }
+
+    return res;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/Atomic.h>
+#include <AK/Types.h>
+#include <AK/Vector.h>
+#include <LibCore/ElapsedTimer.h>
+#include <LibCore/ProcessStatisticsReader.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <serenity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_all_acknowledged = PTHREAD_COND_INITIALIZER;
+static u32 s_generation;
+static u32 s_acknowledged;
+static u32 s_thread_count;
+static bool s_wake_all;
+
+static void exit_with_usage(int rc)
+{
+    fprintf(stderr, "Usage: futex_benchmark [-h] [-w] [-t threads] [-b broadcasts]\n");
+    fprintf(stderr, "  -w  Wake every waiter on broadcast instead of requeueing them onto the mutex\n");
+    exit(rc);
+}
+
+static unsigned context_switches()
+{
+    unsigned total = 0;
+    auto all_processes = Core::ProcessStatisticsReader::get_all();
+    auto it = all_processes.find(getpid());
+    if (it == all_processes.end())
+        return 0;
+    for (auto& thread : it->value.threads)
+        total += thread.times_scheduled;
+    return total;
+}
+
+static void broadcast()
+{
+    if (!s_wake_all) {
+        pthread_cond_broadcast(&s_cond);
+        return;
+    }
+    // This is what pthread_cond_broadcast() did before it learned to requeue.
+    reinterpret_cast<Atomic<i32>&>(s_cond.value).fetch_add(1);
+    futex(&s_cond.value, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+static void* waiter(void* argument)
+{
+    u32 broadcasts = (u32)(uintptr_t)argument;
+    u32 seen = 0;
+    pthread_mutex_lock(&s_mutex);
+    while (seen < broadcasts) {
+        while (s_generation == seen)
+            pthread_cond_wait(&s_cond, &s_mutex);
+        seen = s_generation;
+        if (++s_acknowledged == s_thread_count)
+            pthread_cond_signal(&s_all_acknowledged);
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return nullptr;
+}
+
+int main(int argc, char** argv)
+{
+    int thread_count = 16;
+    int broadcast_count = 1000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hwt:b:")) != -1) {
+        switch (opt) {
+        case 'h':
+            exit_with_usage(0);
+            break;
+        case 'w':
+            s_wake_all = true;
+            break;
+        case 't':
+            thread_count = atoi(optarg);
+            break;
+        case 'b':
+            broadcast_count = atoi(optarg);
+            break;
+        default:
+            exit_with_usage(1);
+        }
+    }
+
+    if (thread_count <= 0 || broadcast_count <= 0)
+        exit_with_usage(1);
+
+    s_thread_count = thread_count;
+    Vector<pthread_t> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_t thread;
+        int rc = pthread_create(&thread, nullptr, waiter, (void*)(uintptr_t)broadcast_count);
+        if (rc != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            return 1;
+        }
+        threads.append(thread);
+    }
+
+    unsigned switches_before = context_switches();
+    Core::ElapsedTimer timer;
+    timer.start();
+
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < broadcast_count; ++i) {
+        s_acknowledged = 0;
+        s_generation++;
+        broadcast();
+        // Wait until every waiter has seen this generation, so each broadcast has a full house.
+        while (s_acknowledged != s_thread_count)
+            pthread_cond_wait(&s_all_acknowledged, &s_mutex);
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    // Sample before joining, while the waiters' statistics are still around.
+    auto elapsed_ms = timer.elapsed();
+    unsigned switches = context_switches() - switches_before;
+
+    for (auto thread : threads)
+        pthread_join(thread, nullptr);
+
+    printf("%s: %d threads, %d broadcasts in %d ms\n", s_wake_all ? "wake-all" : "requeue", thread_count, broadcast_count, elapsed_ms);
+    printf("%u context switches, %u.%02u per broadcast\n", switches, switches / broadcast_count, (switches % broadcast_count) * 100 / broadcast_count);
+    return 0;
+}
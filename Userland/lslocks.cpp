@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ByteBuffer.h>
+#include <AK/JsonArray.h>
+#include <AK/JsonObject.h>
+#include <AK/QuickSort.h>
+#include <AK/String.h>
+#include <LibCore/File.h>
+#include <stdio.h>
+
+struct LockStatistics {
+    String name;
+    u32 acquisitions;
+    u32 contended;
+    u32 spin_acquisitions;
+    u32 sleeps;
+    u64 wait_cycles;
+    u64 max_wait_cycles;
+};
+
+int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv)
+{
+    if (pledge("stdio rpath", nullptr) < 0) {
+        perror("pledge");
+        return 1;
+    }
+
+    if (unveil("/proc/locks", "r") < 0) {
+        perror("unveil");
+        return 1;
+    }
+
+    unveil(nullptr, nullptr);
+
+    auto proc_locks = Core::File::construct("/proc/locks");
+    if (!proc_locks->open(Core::IODevice::ReadOnly)) {
+        fprintf(stderr, "Error: %s\n", proc_locks->error_string());
+        return 1;
+    }
+
+    if (pledge("stdio", nullptr) < 0) {
+        perror("pledge");
+        return 1;
+    }
+
+    auto file_contents = proc_locks->read_all();
+    auto json = JsonValue::from_string(file_contents);
+    ASSERT(json.has_value());
+
+    Vector<LockStatistics> locks;
+    json.value().as_array().for_each([&](const JsonValue& value) {
+        auto lock = value.as_object();
+        locks.append({
+            lock.get("name").to_string(),
+            lock.get("acquisitions").to_u32(),
+            lock.get("contended").to_u32(),
+            lock.get("spin_acquisitions").to_u32(),
+            lock.get("sleeps").to_u32(),
+            lock.get("wait_cycles").to_number<u64>(),
+            lock.get("max_wait_cycles").to_number<u64>(),
+        });
+    });
+
+    // The locks we spend the most time waiting for are the interesting ones.
+    quick_sort(locks, [](auto& a, auto& b) { return a.wait_cycles > b.wait_cycles; });
+
+    printf("%-32s %12s %10s %10s %10s %16s %14s\n", "NAME", "ACQUIRED", "CONTENDED", "SPUN", "SLEPT", "WAIT CYCLES", "MAX WAIT");
+    for (auto& lock : locks) {
+        printf("%-32s %12u %10u %10u %10u %16llu %14llu\n",
+            lock.name.characters(), lock.acquisitions, lock.contended, lock.spin_acquisitions, lock.sleeps, lock.wait_cycles, lock.max_wait_cycles);
+    }
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2020, the SerenityOS developers.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <AK/ByteBuffer.h>
+#include <AK/String.h>
+#include <AK/Types.h>
+#include <LibCore/ElapsedTimer.h>
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void exit_with_usage(int rc)
+{
+    fprintf(stderr, "Usage: tcp_benchmark [-h] [-a address] [-p port] [-s size_in_mib] [-b block_size]\n");
+    fprintf(stderr, "  -a address  Send to a sink listening on this address instead of a local receiver\n");
+    exit(rc);
+}
+
+static int connect_to(const char* address, u16 port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    sockaddr_in peer {};
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &peer.sin_addr) <= 0) {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        exit(1);
+    }
+
+    if (connect(fd, (const sockaddr*)&peer, sizeof(peer)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+static int listen_on(u16 port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        exit(1);
+    }
+
+    sockaddr_in local {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (const sockaddr*)&local, sizeof(local)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    if (listen(fd, 1) < 0) {
+        perror("listen");
+        exit(1);
+    }
+    return fd;
+}
+
+static u64 send_all(int fd, u64 total_size, ByteBuffer& buffer)
+{
+    u64 nsent = 0;
+    while (nsent < total_size) {
+        size_t chunk = min((u64)buffer.size(), total_size - nsent);
+        ssize_t n = write(fd, buffer.data(), chunk);
+        if (n < 0) {
+            perror("write");
+            exit(1);
+        }
+        nsent += n;
+    }
+    return nsent;
+}
+
+static u64 receive_all(int fd, ByteBuffer& buffer)
+{
+    u64 nreceived = 0;
+    for (;;) {
+        ssize_t n = read(fd, buffer.data(), buffer.size());
+        if (n < 0) {
+            perror("read");
+            exit(1);
+        }
+        if (n == 0)
+            break;
+        nreceived += n;
+    }
+    return nreceived;
+}
+
+static void print_result(const char* what, u64 bytes, int elapsed_ms)
+{
+    u64 bps = (u64)(elapsed_ms ? (bytes / elapsed_ms) : bytes) * 1000;
+    printf("%s: bytes=%llu time=%dms bps=%llu (%llu KiB/s)\n", what, bytes, elapsed_ms, bps, bps / KiB);
+}
+
+int main(int argc, char** argv)
+{
+    const char* address = nullptr;
+    u16 port = 8989;
+    int size_in_mib = 64;
+    int block_size = 65536;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "ha:p:s:b:")) != -1) {
+        switch (opt) {
+        case 'h':
+            exit_with_usage(0);
+            break;
+        case 'a':
+            address = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 's':
+            size_in_mib = atoi(optarg);
+            break;
+        case 'b':
+            block_size = atoi(optarg);
+            break;
+        default:
+            exit_with_usage(1);
+        }
+    }
+
+    if (size_in_mib <= 0 || block_size <= 0)
+        exit_with_usage(1);
+
+    u64 total_size = (u64)size_in_mib * MiB;
+    auto buffer = ByteBuffer::create_zeroed(block_size);
+
+    printf("Running: size=%dMiB block_size=%d\n", size_in_mib, block_size);
+
+    if (address) {
+        int fd = connect_to(address, port);
+        Core::ElapsedTimer timer;
+        timer.start();
+        auto nsent = send_all(fd, total_size, buffer);
+        close(fd);
+        print_result("Sent", nsent, timer.elapsed());
+        return 0;
+    }
+
+    int listen_fd = listen_on(port);
+
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        close(listen_fd);
+        int fd = connect_to("127.0.0.1", port);
+        send_all(fd, total_size, buffer);
+        close(fd);
+        exit(0);
+    }
+
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+        perror("accept");
+        return 1;
+    }
+
+    Core::ElapsedTimer timer;
+    timer.start();
+    auto nreceived = receive_all(fd, buffer);
+    print_result("Received", nreceived, timer.elapsed());
+
+    close(fd);
+    close(listen_fd);
+    waitpid(child, nullptr, 0);
+
+    if (nreceived != total_size) {
+        fprintf(stderr, "Expected %llu bytes, received %llu\n", total_size, nreceived);
+        return 1;
+    }
+    return 0;
+}